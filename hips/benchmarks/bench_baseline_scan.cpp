@@ -0,0 +1,112 @@
+/*
+ * Baseline inventory scan benchmark
+ *
+ * Walks a large tree with BaselineScanner at increasing thread counts and
+ * reports files per second, plus one DirectorySnapshot::Capture of the
+ * same tree (one task per top-level subdirectory) for comparison; its row
+ * counts entries, directories included. The tree is the one given with
+ * --root, or a synthetic one of --files files that is deliberately
+ * lopsided: half of the files sit under the first of eight top-level
+ * directories, so a split by subtree leaves most threads idle. Runs are
+ * timed after one warm-up pass, so they measure a tree in the page cache.
+ * With --hash 1 every file is also hashed (the hasher's cache is cleared
+ * before each run). --threads sets the largest thread count (default: the
+ * hardware threads).
+ *
+ * Usage: bench_baseline_scan [--files N] [--root DIR] [--depth D] [--hash 0|1] [--threads T]
+ */
+
+#include "baseline_scanner.h"
+#include "directory_snapshot.h"
+#include "bench_util.h"
+#include <filesystem>
+#include <iostream>
+#include <thread>
+
+using namespace HIPS;
+
+namespace fs = std::filesystem;
+
+// Eight top-level directories of 10 x 10 leaves; the first holds half
+static void BuildTree(const fs::path& root, long files) {
+    const long leaves_per_top = 100;
+    for (long i = 0; i < files; ++i) {
+        long top = (i % 2 == 0) ? 0 : 1 + (i / 2) % 7;
+        long leaf = (i / 16) % leaves_per_top;
+        fs::path directory = root / ("top" + std::to_string(top)) / ("mid" + std::to_string(leaf / 10)) /
+                             ("leaf" + std::to_string(leaf % 10));
+        fs::create_directories(directory);
+        std::ofstream file(directory / ("file" + std::to_string(i) + ".dat"), std::ios::binary);
+        file << "baseline benchmark file " << i << "\n";
+    }
+}
+
+int main(int argc, char** argv) {
+    const long files = std::max(Bench::ArgValue(argc, argv, "--files", 100000), 1L);
+    const int depth = static_cast<int>(Bench::ArgValue(argc, argv, "--depth", 8));
+    const bool hash = Bench::ArgValue(argc, argv, "--hash", 0) != 0;
+    std::string root;
+    for (int i = 1; i + 1 < argc; ++i) {
+        if (std::string(argv[i]) == "--root") {
+            root = argv[i + 1];
+        }
+    }
+
+    fs::path generated;
+    if (root.empty()) {
+        generated = fs::temp_directory_path() / "hips_bench_baseline_scan";
+        fs::remove_all(generated);
+        BuildTree(generated, files);
+        root = generated.string();
+    }
+
+    const size_t hardware = static_cast<size_t>(std::max(
+        Bench::ArgValue(argc, argv, "--threads", std::max(std::thread::hardware_concurrency(), 1u)), 1L));
+    auto pool = std::make_shared<WorkerPool>(hardware);
+    auto hasher = std::make_shared<ContentHasher>(1);
+
+    BaselineScanOptions options;
+    options.max_depth = depth;
+    options.max_entries = SIZE_MAX;
+    options.hash_contents = hash;
+
+    // Warm-up: pulls the tree into the page cache
+    {
+        BaselineScanner scanner(pool, hasher);
+        scanner.Scan({root}, options, nullptr);
+    }
+
+    std::cout << "mode,threads,files,directories,seconds,files_per_sec,steals,hashed_bytes" << std::endl;
+    std::vector<size_t> thread_counts;
+    for (size_t threads = 1; threads < hardware; threads *= 2) {
+        thread_counts.push_back(threads);
+    }
+    thread_counts.push_back(hardware);
+
+    for (size_t threads : thread_counts) {
+        hasher->ClearCache();
+        options.threads = threads;
+        BaselineScanner scanner(pool, hasher);
+        BaselineScanStats stats = scanner.Scan({root}, options, [](const InventoryEntry&) {});
+        std::cout << "baseline," << threads << ","
+                  << stats.files << ","
+                  << stats.directories << ","
+                  << stats.elapsed_seconds << ","
+                  << static_cast<uint64_t>(stats.FilesPerSecond()) << ","
+                  << stats.steals << ","
+                  << stats.hashed_bytes << std::endl;
+    }
+
+    Bench::Stopwatch timer;
+    DirectorySnapshot snapshot = DirectorySnapshot::Capture(root, depth, SIZE_MAX, pool.get());
+    double seconds = timer.ElapsedSeconds();
+    std::cout << "snapshot," << hardware << ","
+              << snapshot.GetEntryCount() << ",,"
+              << seconds << ","
+              << static_cast<uint64_t>(snapshot.GetEntryCount() / seconds) << ",,0" << std::endl;
+
+    if (!generated.empty()) {
+        fs::remove_all(generated);
+    }
+    return 0;
+}
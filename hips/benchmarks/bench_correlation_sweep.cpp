@@ -0,0 +1,234 @@
+/*
+ * CorrelationEngine scalability sweep
+ *
+ * Starting from a baseline configuration, varies one dimension at a time
+ * (active pids, distinct targets, time_window_seconds,
+ * max_events_per_process, each enable_*_correlation flag, and
+ * sketch_target_tracking) and reports throughput, per-event latency
+ * percentiles and memory for every case as one CSV row. Each case runs on a fresh engine with a pre-generated,
+ * seeded workload so runs are comparable across releases.
+ *
+ * Usage: bench_correlation_sweep [--events N] [--rate R] [--case K] [--list 1]
+ *   --rate R runs the engine on a simulated clock advanced by 1/R seconds
+ *   per event, so windows and idle timeouts roll over as they would at R
+ *   events/sec however long the run takes (default: wall clock).
+ *   --list 1 prints the case numbers; --case K runs only case K, e.g. to
+ *   get an isolated RSS per process:
+ *   for k in $(bench_correlation_sweep --list 1 | cut -d, -f1); do
+ *       bench_correlation_sweep --case $k | tail -n +2; done
+ */
+
+#include "correlation_engine.h"
+#include "bench_util.h"
+#include <iostream>
+#include <string>
+
+using namespace HIPS;
+
+namespace {
+
+struct SweepCase {
+    std::string dimension;
+    int pids = 256;
+    int targets = 4096;
+    CorrelationConfig config;
+};
+
+struct FlagSet {
+    const char* name;
+    bool process, time, target, sequence, escalation, lineage;
+};
+
+void ApplyFlags(CorrelationConfig& config, const FlagSet& flags) {
+    config.enable_process_correlation = flags.process;
+    config.enable_time_correlation = flags.time;
+    config.enable_target_correlation = flags.target;
+    config.enable_sequence_correlation = flags.sequence;
+    config.enable_threat_escalation = flags.escalation;
+    config.enable_lineage_correlation = flags.lineage;
+}
+
+std::vector<SweepCase> BuildCases() {
+    std::vector<SweepCase> cases;
+    const SweepCase baseline{"baseline", 256, 4096, CorrelationConfig()};
+    cases.push_back(baseline);
+
+    for (int pids : {16, 1024, 4096, 16384}) {
+        SweepCase c = baseline;
+        c.dimension = "pids";
+        c.pids = pids;
+        cases.push_back(c);
+    }
+    for (int targets : {64, 65536, 262144}) {
+        SweepCase c = baseline;
+        c.dimension = "targets";
+        c.targets = targets;
+        cases.push_back(c);
+    }
+    for (int window : {5, 300, 3600}) {
+        SweepCase c = baseline;
+        c.dimension = "time_window";
+        c.config.time_window_seconds = window;
+        cases.push_back(c);
+    }
+    for (int max_events : {10, 500, 2000}) {
+        SweepCase c = baseline;
+        c.dimension = "max_events";
+        c.config.max_events_per_process = max_events;
+        cases.push_back(c);
+    }
+
+    static const FlagSet kFlagSets[] = {
+        {"none",       false, false, false, false, false, false},
+        {"process",    true,  false, false, false, false, false},
+        {"time",       false, true,  false, false, false, false},
+        {"target",     false, false, true,  false, false, false},
+        {"sequence",   false, false, false, true,  false, false},
+        {"escalation", false, false, false, false, true,  false},
+        {"lineage",    false, false, false, false, false, true},
+    };
+    for (const auto& flags : kFlagSets) {
+        SweepCase c = baseline;
+        c.dimension = std::string("only_") + flags.name;
+        ApplyFlags(c.config, flags);
+        cases.push_back(c);
+    }
+
+    // Exact windows for the sketched top-K targets only
+    for (int targets : {4096, 262144}) {
+        SweepCase c = baseline;
+        c.dimension = "sketch_targets";
+        c.targets = targets;
+        c.config.sketch_target_tracking = true;
+        cases.push_back(c);
+    }
+
+    return cases;
+}
+
+// Deterministic 64-bit LCG so every release replays the same workload
+class Random {
+public:
+    explicit Random(uint64_t seed) : state_(seed) {}
+    uint32_t Next() {
+        state_ = state_ * 6364136223846793005ULL + 1442695040888963407ULL;
+        return static_cast<uint32_t>(state_ >> 33);
+    }
+private:
+    uint64_t state_;
+};
+
+std::vector<SecurityEvent> BuildWorkload(int pids, int targets, long count) {
+    static const EventType kTypes[] = {
+        EventType::FILE_ACCESS, EventType::FILE_MODIFICATION, EventType::FILE_DELETION,
+        EventType::REGISTRY_MODIFICATION, EventType::NETWORK_CONNECTION,
+        EventType::MEMORY_INJECTION
+    };
+
+    Random random(0x5eed);
+    std::vector<SecurityEvent> events;
+    events.reserve(static_cast<size_t>(count));
+
+    for (long i = 0; i < count; ++i) {
+        DWORD pid = static_cast<DWORD>(1000 + (random.Next() % static_cast<uint32_t>(pids)) * 4);
+
+        // Mostly benign traffic with occasional high-threat events
+        uint32_t roll = random.Next() % 100;
+        ThreatLevel level = roll < 70 ? ThreatLevel::LOW :
+                            roll < 90 ? ThreatLevel::MEDIUM :
+                            roll < 98 ? ThreatLevel::HIGH : ThreatLevel::CRITICAL;
+
+        std::string target = "C:\\ProgramData\\sweep\\t" +
+                             std::to_string(random.Next() % static_cast<uint32_t>(targets)) + ".dat";
+
+        SecurityEvent event;
+        if (random.Next() % 20 == 0) {
+            // Process creation from a random parent feeds lineage tracking
+            event = Bench::MakeEvent(EventType::PROCESS_CREATION, level, pid, "");
+            DWORD parent = static_cast<DWORD>(1000 + (random.Next() % static_cast<uint32_t>(pids)) * 4);
+            event.metadata["parent_pid"] = std::to_string(parent);
+        } else {
+            EventType type = kTypes[random.Next() % (sizeof(kTypes) / sizeof(kTypes[0]))];
+            event = Bench::MakeEvent(type, level, pid, target);
+        }
+        events.push_back(std::move(event));
+    }
+    return events;
+}
+
+void RunCase(size_t index, const SweepCase& sweep, long event_count, long rate) {
+    std::vector<SecurityEvent> events = BuildWorkload(sweep.pids, sweep.targets, event_count);
+    std::vector<double> latencies_us;
+    latencies_us.reserve(events.size());
+
+    CorrelationEngine engine;
+    std::shared_ptr<SimulatedClock> clock;
+    if (rate > 0) {
+        clock = std::make_shared<SimulatedClock>();
+        engine.SetClock(clock);
+    }
+    engine.Initialize(sweep.config);
+    const auto tick = std::chrono::microseconds(rate > 0 ? 1000000 / rate : 0);
+
+    Bench::Stopwatch total;
+    for (const auto& event : events) {
+        Bench::Stopwatch one;
+        engine.ProcessEvent(event);
+        latencies_us.push_back(static_cast<double>(one.ElapsedNanoseconds()) / 1000.0);
+        if (clock) {
+            clock->AdvanceTo(clock->Now() + tick);
+        }
+    }
+    double seconds = total.ElapsedSeconds();
+
+    const CorrelationConfig& c = sweep.config;
+    std::cout << index << "," << sweep.dimension << ","
+              << sweep.pids << "," << sweep.targets << ","
+              << c.time_window_seconds << "," << c.max_events_per_process << ","
+              << c.enable_process_correlation << c.enable_time_correlation
+              << c.enable_target_correlation << c.enable_sequence_correlation
+              << c.enable_threat_escalation << c.enable_lineage_correlation << ","
+              << events.size() << ","
+              << static_cast<uint64_t>(static_cast<double>(events.size()) / seconds) << ","
+              << Bench::Percentile(latencies_us, 50) << ","
+              << Bench::Percentile(latencies_us, 90) << ","
+              << Bench::Percentile(latencies_us, 99) << ","
+              << Bench::Percentile(latencies_us, 99.9) << ","
+              << latencies_us.back() << ","     // Sorted by Percentile()
+              << Bench::ResidentMemoryBytes() << ","
+              << engine.GetTrackedMemoryBytes() << ","
+              << engine.GetCorrelationMemoryBytes() << ","
+              << engine.GetCorrelationCount() << std::endl;
+}
+
+} // namespace
+
+int main(int argc, char** argv) {
+    const long events = Bench::ArgValue(argc, argv, "--events", 50000);
+    const long rate = Bench::ArgValue(argc, argv, "--rate", 0);
+    const long only_case = Bench::ArgValue(argc, argv, "--case", -1);
+    const bool list = Bench::ArgValue(argc, argv, "--list", 0) != 0;
+
+    std::vector<SweepCase> cases = BuildCases();
+
+    if (list) {
+        for (size_t i = 0; i < cases.size(); ++i) {
+            std::cout << i << "," << cases[i].dimension << std::endl;
+        }
+        return 0;
+    }
+
+    // flags column: process,time,target,sequence,escalation,lineage as 0/1
+    std::cout << "case,dimension,pids,targets,time_window_s,max_events,flags,events,"
+                 "events_per_sec,p50_us,p90_us,p99_us,p999_us,max_us,"
+                 "rss_bytes,tracked_bytes,correlation_bytes,correlations" << std::endl;
+
+    for (size_t i = 0; i < cases.size(); ++i) {
+        if (only_case >= 0 && static_cast<size_t>(only_case) != i) {
+            continue;
+        }
+        RunCase(i, cases[i], events, rate);
+    }
+
+    return 0;
+}
@@ -0,0 +1,122 @@
+/*
+ * Inventory database load benchmark
+ *
+ * Builds compacted inventory databases of increasing size and reports,
+ * for each, the time and page faults to open it, the cost of random
+ * lookups through the mapped directory, and a full pass over every record
+ * (what a format that parses everything on load would pay up front).
+ * --log appends that many updated records after compaction, which are
+ * the only records read on open.
+ *
+ * Usage: bench_inventory_load [--entries N] [--lookups L] [--log K] [--path FILE]
+ */
+
+#include "inventory_database.h"
+#include "bench_util.h"
+#include <cstdio>
+#include <iostream>
+#include <random>
+
+#ifndef _WIN32
+#include <sys/resource.h>
+#endif
+
+using namespace HIPS;
+
+// Minor plus major page faults so far (0 if unavailable)
+static uint64_t PageFaults() {
+#ifndef _WIN32
+    struct rusage usage;
+    if (getrusage(RUSAGE_SELF, &usage) == 0) {
+        return static_cast<uint64_t>(usage.ru_minflt + usage.ru_majflt);
+    }
+#endif
+    return 0;
+}
+
+static std::string EntryPath(long i) {
+    return "C:\\Program Files\\Vendor" + std::to_string(i % 97) + "\\bin\\module_" + std::to_string(i) + ".dll";
+}
+
+int main(int argc, char** argv) {
+    const long max_entries = std::max(Bench::ArgValue(argc, argv, "--entries", 1000000), 1L);
+    const long lookups = std::max(Bench::ArgValue(argc, argv, "--lookups", 10000), 1L);
+    const long log_records = std::max(Bench::ArgValue(argc, argv, "--log", 0), 0L);
+    std::string path = "bench_inventory_load.db";
+    for (int i = 1; i + 1 < argc; ++i) {
+        if (std::string(argv[i]) == "--path") {
+            path = argv[i + 1];
+        }
+    }
+
+    std::cout << "entries,file_bytes,open_ms,open_page_faults,lookup_ns,scan_ms,scan_page_faults" << std::endl;
+    std::mt19937_64 random(42);
+    for (long entries = 10000; entries <= max_entries; entries *= 10) {
+        std::remove(path.c_str());
+        {
+            InventoryDatabase database;
+            database.Open(path);
+            InventoryEntry entry;
+            entry.attributes = 0644;
+            entry.hashed = true;
+            entry.hashes.sha256 = std::string(64, 'a');
+            for (long i = 0; i < entries; ++i) {
+                entry.path = EntryPath(i);
+                entry.size = static_cast<uint64_t>(i);
+                entry.modified_ns = i * 1000;
+                entry.hashes.xxh64 = static_cast<uint64_t>(i);
+                database.Put(entry);
+            }
+            database.Compact();
+            for (long i = 0; i < log_records; ++i) {
+                entry.path = EntryPath(i);
+                entry.size = static_cast<uint64_t>(i) + 1;
+                database.Put(entry);
+            }
+            database.Flush();
+        }
+
+        uint64_t faults = PageFaults();
+        Bench::Stopwatch timer;
+        InventoryDatabase database;
+        if (!database.Open(path)) {
+            std::cerr << "failed to open " << path << std::endl;
+            return 1;
+        }
+        double open_ms = timer.ElapsedSeconds() * 1000.0;
+        uint64_t open_faults = PageFaults() - faults;
+
+        std::vector<std::string> probes;
+        probes.reserve(lookups);
+        for (long i = 0; i < lookups; ++i) {
+            probes.push_back(EntryPath(static_cast<long>(random() % static_cast<uint64_t>(entries))));
+        }
+        InventoryEntry found;
+        size_t hits = 0;
+        timer.Reset();
+        for (const auto& probe : probes) {
+            hits += database.Lookup(probe, found);
+        }
+        double lookup_ns = static_cast<double>(timer.ElapsedNanoseconds()) / lookups;
+        if (hits != probes.size()) {
+            std::cerr << "lookup missed " << probes.size() - hits << " entries" << std::endl;
+        }
+
+        faults = PageFaults();
+        timer.Reset();
+        size_t visited = 0;
+        database.ForEach([&visited](const InventoryEntry&) { visited++; });
+        double scan_ms = timer.ElapsedSeconds() * 1000.0;
+
+        std::cout << entries << ","
+                  << database.GetStats().file_bytes << ","
+                  << open_ms << ","
+                  << open_faults << ","
+                  << lookup_ns << ","
+                  << scan_ms << ","
+                  << PageFaults() - faults << std::endl;
+    }
+
+    std::remove(path.c_str());
+    return 0;
+}
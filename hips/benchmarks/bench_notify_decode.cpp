@@ -0,0 +1,228 @@
+/*
+ * Change notification decoding benchmark
+ *
+ * Decodes one ReadDirectoryChangesW completion buffer repeatedly, the way
+ * FileSystemMonitor does, and reports throughput and heap allocations per
+ * record for two strategies:
+ *   legacy  - size and convert each name separately, build the full path
+ *             with string concatenation, then classify it
+ *   decoder - NotifyBufferDecoder into the watch's scratch buffer, classify
+ *             the view and copy only the paths that are reported
+ * The buffer is a captured completion given with --buffer, or a synthetic
+ * one in the same layout with a mix of temp files, documents, binaries
+ * and non-ASCII names.
+ *
+ * Usage: bench_notify_decode [--iterations N] [--buffer FILE]
+ */
+
+#include "notify_decoder.h"
+#include "path_classifier.h"
+#include "bench_util.h"
+#include <atomic>
+#include <cstdlib>
+#include <iostream>
+#include <iterator>
+#include <new>
+
+using namespace HIPS;
+
+static std::atomic<uint64_t> g_allocations(0);
+
+void* operator new(size_t size) {
+    g_allocations++;
+    if (void* block = std::malloc(size ? size : 1)) {
+        return block;
+    }
+    throw std::bad_alloc();
+}
+
+void operator delete(void* block) noexcept {
+    std::free(block);
+}
+
+void operator delete(void* block, size_t) noexcept {
+    std::free(block);
+}
+
+static const char* const kDirectory = "C:\\Users\\bench";
+
+// UTF-8 name to UTF-16LE code units (names here are valid UTF-8)
+static std::vector<BYTE> EncodeName(const std::string& name) {
+    std::vector<BYTE> units;
+    for (size_t i = 0; i < name.size();) {
+        unsigned char lead = static_cast<unsigned char>(name[i]);
+        uint32_t code_point;
+        size_t length;
+        if (lead < 0x80) {
+            code_point = lead;
+            length = 1;
+        } else if (lead < 0xE0) {
+            code_point = lead & 0x1F;
+            length = 2;
+        } else if (lead < 0xF0) {
+            code_point = lead & 0x0F;
+            length = 3;
+        } else {
+            code_point = lead & 0x07;
+            length = 4;
+        }
+        for (size_t j = 1; j < length; ++j) {
+            code_point = (code_point << 6) | (static_cast<unsigned char>(name[i + j]) & 0x3F);
+        }
+        i += length;
+
+        auto push = [&units](uint32_t unit) {
+            units.push_back(static_cast<BYTE>(unit & 0xFF));
+            units.push_back(static_cast<BYTE>(unit >> 8));
+        };
+        if (code_point >= 0x10000) {
+            code_point -= 0x10000;
+            push(0xD800 + (code_point >> 10));
+            push(0xDC00 + (code_point & 0x3FF));
+        } else {
+            push(code_point);
+        }
+    }
+    return units;
+}
+
+static void AppendDword(std::vector<BYTE>& buffer, size_t offset, DWORD value) {
+    std::memcpy(&buffer[offset], &value, sizeof(value));
+}
+
+// Records in FILE_NOTIFY_INFORMATION layout, DWORD aligned, up to capacity
+static std::vector<BYTE> SynthesizeBuffer(size_t capacity) {
+    const size_t header = offsetof(FILE_NOTIFY_INFORMATION, FileName);
+    std::vector<BYTE> buffer;
+    size_t previous = SIZE_MAX;
+    for (size_t i = 0;; ++i) {
+        std::string name;
+        switch (i % 6) {
+            case 0: name = "AppData\\Local\\Temp\\~DF" + std::to_string(i) + ".tmp"; break;
+            case 1: name = "Documents\\Quarterly report " + std::to_string(i) + ".docx"; break;
+            case 2: name = "AppData\\Roaming\\Tools\\plugin" + std::to_string(i) + ".dll"; break;
+            case 3: name = "Downloads\\setup_" + std::to_string(i) + ".exe"; break;
+            case 4: name = "Documents\\R\xC3\xA9sum\xC3\xA9_" + std::to_string(i) + ".dat"; break;
+            default: name = "Pictures\\\xF0\x9F\x93\xB7 " + std::to_string(i) + ".cfg"; break;
+        }
+        std::vector<BYTE> units = EncodeName(name);
+        size_t record = (header + units.size() + 3) & ~size_t(3);
+        if (buffer.size() + record > capacity) {
+            break;
+        }
+
+        size_t offset = buffer.size();
+        buffer.resize(offset + record, 0);
+        AppendDword(buffer, offset, 0);
+        AppendDword(buffer, offset + sizeof(DWORD), static_cast<DWORD>(1 + i % 3));
+        AppendDword(buffer, offset + 2 * sizeof(DWORD), static_cast<DWORD>(units.size()));
+        std::memcpy(&buffer[offset + header], units.data(), units.size());
+        if (previous != SIZE_MAX) {
+            AppendDword(buffer, previous, static_cast<DWORD>(offset - previous));
+        }
+        previous = offset;
+    }
+    return buffer;
+}
+
+// The per-record work FileSystemMonitor did before NotifyBufferDecoder
+static size_t DecodeLegacy(const std::vector<BYTE>& buffer, const PathClassifier& classifier,
+                           std::vector<std::string>& reported) {
+    const size_t header = offsetof(FILE_NOTIFY_INFORMATION, FileName);
+    const std::string directory = kDirectory;
+    std::vector<char> sizing;
+    size_t records = 0;
+    size_t offset = 0;
+    while (offset + header <= buffer.size()) {
+        DWORD next_entry;
+        DWORD name_bytes;
+        std::memcpy(&next_entry, &buffer[offset], sizeof(DWORD));
+        std::memcpy(&name_bytes, &buffer[offset + 2 * sizeof(DWORD)], sizeof(DWORD));
+        const BYTE* units = &buffer[offset + header];
+
+        // Sizing call, then the conversion into a fresh string
+        const size_t count = name_bytes / 2;
+        sizing.resize(std::max(sizing.size(), count * kUtf8BytesPerUtf16Unit));
+        size_t size_needed = TranscodeUtf16ToUtf8(units, count, sizing.data());
+        std::string filename(size_needed, 0);
+        TranscodeUtf16ToUtf8(units, count, sizing.data());
+        std::memcpy(&filename[0], sizing.data(), size_needed);
+
+        std::string full_path = directory + "\\" + filename;
+        if (classifier.IsReported(classifier.Classify(full_path))) {
+            reported.push_back(full_path);
+        }
+        records++;
+
+        if (next_entry == 0) {
+            break;
+        }
+        offset += next_entry;
+    }
+    return records;
+}
+
+int main(int argc, char** argv) {
+    const long iterations = std::max(Bench::ArgValue(argc, argv, "--iterations", 2000), 1L);
+    std::vector<BYTE> buffer;
+    for (int i = 1; i + 1 < argc; ++i) {
+        if (std::string(argv[i]) == "--buffer") {
+            std::ifstream file(argv[i + 1], std::ios::binary);
+            buffer.assign(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+            if (buffer.empty()) {
+                std::cerr << "failed to read " << argv[i + 1] << std::endl;
+                return 1;
+            }
+        }
+    }
+    if (buffer.empty()) {
+        buffer = SynthesizeBuffer(64 * 1024);
+    }
+
+    PathClassifier classifier;
+    std::vector<std::string> reported;
+    reported.reserve(4096);
+
+    std::cout << "mode,buffer_bytes,records,ns_per_record,records_per_sec,allocations_per_record,reported"
+              << std::endl;
+    for (int mode = 0; mode < 2; ++mode) {
+        NotifyBufferDecoder decoder(kDirectory);
+        size_t records = 0;
+        size_t kept = 0;
+
+        // One warm-up pass sizes the scratch buffer and the output vector
+        auto run = [&]() {
+            reported.clear();
+            if (mode == 0) {
+                records += DecodeLegacy(buffer, classifier, reported);
+            } else {
+                records += decoder.Decode(buffer.data(), buffer.size(), [&](std::string_view path, DWORD) {
+                    if (classifier.IsReported(classifier.Classify(path.data(), path.size()))) {
+                        reported.emplace_back(path);
+                    }
+                });
+            }
+            kept = reported.size();
+        };
+        run();
+        records = 0;
+
+        uint64_t allocations = g_allocations.load();
+        Bench::Stopwatch timer;
+        for (long i = 0; i < iterations; ++i) {
+            run();
+        }
+        double seconds = timer.ElapsedSeconds();
+        allocations = g_allocations.load() - allocations;
+
+        std::cout << (mode == 0 ? "legacy" : "decoder") << ","
+                  << buffer.size() << ","
+                  << records / iterations << ","
+                  << seconds * 1e9 / records << ","
+                  << static_cast<uint64_t>(records / seconds) << ","
+                  << static_cast<double>(allocations) / records << ","
+                  << kept << std::endl;
+    }
+
+    return 0;
+}
@@ -0,0 +1,96 @@
+/*
+ * Shared helpers for HIPS benchmarks
+ *
+ * Benchmarks are standalone executables that print CSV to stdout so runs
+ * from different releases can be diffed and plotted.
+ */
+
+#ifndef HIPS_BENCH_UTIL_H
+#define HIPS_BENCH_UTIL_H
+
+#include "hips_core.h"
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <string>
+#include <vector>
+
+#ifndef _WIN32
+#include <unistd.h>
+#endif
+
+namespace HIPS {
+namespace Bench {
+
+class Stopwatch {
+public:
+    Stopwatch() : start_(std::chrono::steady_clock::now()) {}
+
+    void Reset() { start_ = std::chrono::steady_clock::now(); }
+
+    double ElapsedSeconds() const {
+        return std::chrono::duration<double>(std::chrono::steady_clock::now() - start_).count();
+    }
+
+    uint64_t ElapsedNanoseconds() const {
+        return static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(
+            std::chrono::steady_clock::now() - start_).count());
+    }
+
+private:
+    std::chrono::steady_clock::time_point start_;
+};
+
+// Resident set size of the current process in bytes (0 if unavailable)
+inline size_t ResidentMemoryBytes() {
+#ifdef __linux__
+    std::ifstream statm("/proc/self/statm");
+    size_t total_pages = 0;
+    size_t resident_pages = 0;
+    if (statm >> total_pages >> resident_pages) {
+        return resident_pages * static_cast<size_t>(sysconf(_SC_PAGESIZE));
+    }
+#endif
+    return 0;
+}
+
+// Nearest-rank percentile; sorts the samples in place
+inline double Percentile(std::vector<double>& samples, double percentile) {
+    if (samples.empty()) {
+        return 0.0;
+    }
+    std::sort(samples.begin(), samples.end());
+    size_t rank = static_cast<size_t>(percentile / 100.0 * static_cast<double>(samples.size()));
+    return samples[std::min(rank, samples.size() - 1)];
+}
+
+// Returns the value following "--name" on the command line, or fallback
+inline long ArgValue(int argc, char** argv, const char* name, long fallback) {
+    for (int i = 1; i + 1 < argc; ++i) {
+        if (std::strcmp(argv[i], name) == 0) {
+            return std::strtol(argv[i + 1], nullptr, 10);
+        }
+    }
+    return fallback;
+}
+
+inline SecurityEvent MakeEvent(EventType type, ThreatLevel level, DWORD pid,
+                               const std::string& target_path) {
+    SecurityEvent event;
+    event.type = type;
+    event.threat_level = level;
+    event.process_path = "C:\\bench\\proc_" + std::to_string(pid) + ".exe";
+    event.target_path = target_path;
+    event.description = "benchmark event";
+    event.process_id = pid;
+    event.thread_id = 0;
+    GetSystemTime(&event.timestamp);
+    return event;
+}
+
+} // namespace Bench
+} // namespace HIPS
+
+#endif // HIPS_BENCH_UTIL_H
@@ -35,6 +35,9 @@ void printCorrelation(const CorrelatedEventGroup& group) {
         case CorrelationType::THREAT_ESCALATION:
             std::cout << "Threat Escalation";
             break;
+        case CorrelationType::LINEAGE_BASED:
+            std::cout << "Lineage-Based";
+            break;
     }
     std::cout << std::endl;
     std::cout << "  Events: " << group.events.size() << std::endl;
@@ -206,6 +209,11 @@ int main() {
                             6000, "C:\\attacker\\dropper.exe");
     evt10.description = "Dropper process created";
     
+    auto evt10b = createEvent(EventType::PROCESS_CREATION, ThreatLevel::MEDIUM,
+                             6001, "C:\\attacker\\payload.exe");
+    evt10b.description = "Payload spawned by dropper";
+    evt10b.metadata["parent_pid"] = "6000";
+    
     auto evt11 = createEvent(EventType::FILE_MODIFICATION, ThreatLevel::HIGH,
                             6001, "C:\\attacker\\payload.exe",
                             "C:\\Windows\\System32\\driver.sys");
@@ -219,10 +227,13 @@ int main() {
     std::cout << "  1. Processing dropper execution..." << std::endl;
     engine.ProcessEvent(evt10);
     
-    std::cout << "  2. Processing driver modification..." << std::endl;
+    std::cout << "  2. Processing payload spawn..." << std::endl;
+    engine.ProcessEvent(evt10b);
+    
+    std::cout << "  3. Processing driver modification..." << std::endl;
     engine.ProcessEvent(evt11);
     
-    std::cout << "  3. Processing service installation..." << std::endl;
+    std::cout << "  4. Processing service installation..." << std::endl;
     engine.ProcessEvent(evt12);
     
     // Summary
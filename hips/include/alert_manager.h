@@ -2,6 +2,7 @@
 #define ALERT_MANAGER_H
 
 #include "hips_core.h"
+#include "state_snapshot.h"
 #include <string>
 #include <vector>
 #include <mutex>
@@ -25,6 +26,11 @@ public:
     std::vector<Alert> GetAlerts(bool include_acknowledged = false);
     void AcknowledgeAlert(size_t index);
     void ClearAlerts();
+    
+    // Checkpoint alerts into an ALERTS section; RestoreState replaces the
+    // current alerts without notifying or logging them again
+    void SaveState(SnapshotWriter& writer);
+    bool RestoreState(const SnapshotReader& snapshot);
 
 private:
     std::vector<Alert> alerts_;
@@ -0,0 +1,112 @@
+/*
+ * Baseline Inventory Scanner for HIPS
+ *
+ * Walks the watched trees once to record what is already there, so files
+ * dropped before monitoring started can be evaluated like new ones. The
+ * traversal is spread over worker threads that each own a deque of
+ * directories: a worker lists its newest directory and pushes the
+ * subdirectories it finds onto its own deque, and an idle worker steals
+ * the oldest directory from another one, which keeps every thread busy on
+ * deep or lopsided trees. Contents can be hashed through ContentHasher as
+ * the tree is walked. An I/O budget in bytes per second (directory entries
+ * are charged a nominal cost, hashed files their size) throttles the scan
+ * so it does not compete with live monitoring.
+ */
+
+#ifndef BASELINE_SCANNER_H
+#define BASELINE_SCANNER_H
+
+#include "content_hasher.h"
+#include "worker_pool.h"
+#include <string>
+#include <vector>
+#include <memory>
+#include <functional>
+#include <atomic>
+#include <mutex>
+#include <chrono>
+#include <cstdint>
+
+namespace HIPS {
+
+// Attribute bits above the permission bits
+constexpr uint32_t kInventoryDirectory = 1u << 16;
+constexpr uint32_t kInventorySymlink = 1u << 17;
+
+struct InventoryEntry {
+    std::string path;
+    uint64_t size = 0;
+    int64_t modified_ns = 0;        // Same clock as SnapshotEntry
+    uint32_t attributes = 0;        // Permission bits and kInventory* flags
+    bool hashed = false;
+    FileHashes hashes;
+
+    bool IsDirectory() const { return (attributes & kInventoryDirectory) != 0; }
+};
+
+struct BaselineScanOptions {
+    int max_depth = 5;              // Subdirectory levels below each root
+    size_t max_entries = 1000000;
+    size_t threads = 0;             // 0 uses one per pool thread
+    bool hash_contents = false;
+    uint64_t io_bytes_per_second = 0;   // 0 = unthrottled
+};
+
+struct BaselineScanStats {
+    uint64_t files = 0;
+    uint64_t directories = 0;
+    uint64_t hashed_files = 0;
+    uint64_t hashed_bytes = 0;
+    uint64_t errors = 0;            // Unreadable directories and files
+    uint64_t steals = 0;            // Directories taken from another worker
+    bool truncated = false;         // Hit max_entries or cancelled
+    double elapsed_seconds = 0.0;
+
+    double FilesPerSecond() const {
+        return elapsed_seconds > 0.0 ? static_cast<double>(files) / elapsed_seconds : 0.0;
+    }
+};
+
+class BaselineScanner {
+public:
+    // Called concurrently from the workers, once per entry
+    using EntryCallback = std::function<void(const InventoryEntry& entry)>;
+
+    // Runs on pool and hashes through hasher; nullptr uses the shared ones
+    explicit BaselineScanner(std::shared_ptr<WorkerPool> pool = nullptr,
+                             std::shared_ptr<ContentHasher> hasher = nullptr);
+
+    // Walk every root and return once the walk is done. Symbolic links are
+    // recorded but not followed; missing roots are skipped.
+    BaselineScanStats Scan(const std::vector<std::string>& roots, const BaselineScanOptions& options,
+                           const EntryCallback& callback);
+
+    // End a running scan early (it returns what was seen so far); later
+    // scans by this scanner return at once
+    void Cancel() { cancelled_ = true; }
+
+private:
+    std::shared_ptr<WorkerPool> pool_;
+    std::shared_ptr<ContentHasher> hasher_;
+    std::atomic<bool> cancelled_;
+};
+
+// Token bucket shared by the scan workers; Consume() sleeps while the scan
+// is ahead of its rate
+class IoBudget {
+public:
+    explicit IoBudget(uint64_t bytes_per_second);
+    // Sleeps in short slices and returns false as soon as cancelled is set
+    bool Consume(uint64_t bytes, const std::atomic<bool>* cancelled = nullptr);
+
+private:
+    using clock = std::chrono::steady_clock;
+
+    uint64_t bytes_per_second_;
+    clock::time_point next_free_;   // When everything consumed so far is paid for
+    std::mutex mutex_;
+};
+
+} // namespace HIPS
+
+#endif // BASELINE_SCANNER_H
@@ -0,0 +1,68 @@
+/*
+ * Clock Abstraction for HIPS
+ *
+ * Components that keep time windows or run periodic scans read time and
+ * wait through a Clock instead of calling std::chrono directly.
+ * SystemClock is the wall clock. SimulatedClock only moves when told to,
+ * so tests and benchmarks can fast-forward minutes or hours of windows,
+ * idle timeouts and scan intervals in milliseconds of real time.
+ */
+
+#ifndef CLOCK_H
+#define CLOCK_H
+
+#include <chrono>
+#include <memory>
+#include <atomic>
+#include <mutex>
+#include <condition_variable>
+
+namespace HIPS {
+
+class Clock {
+public:
+    using time_point = std::chrono::system_clock::time_point;
+
+    virtual ~Clock() = default;
+
+    virtual time_point Now() const = 0;
+
+    // Wait until Now() reaches deadline, but for no longer than max_wait of
+    // real time so callers can recheck their stop conditions
+    virtual void WaitUntil(const time_point& deadline, std::chrono::milliseconds max_wait) = 0;
+};
+
+class SystemClock : public Clock {
+public:
+    time_point Now() const override { return std::chrono::system_clock::now(); }
+    void WaitUntil(const time_point& deadline, std::chrono::milliseconds max_wait) override;
+
+    // Shared default instance
+    static std::shared_ptr<Clock> Instance();
+};
+
+// Manually advanced clock; Now() is safe to call from any thread
+class SimulatedClock : public Clock {
+public:
+    explicit SimulatedClock(const time_point& start = std::chrono::system_clock::now());
+
+    time_point Now() const override { return now_.load(); }
+    void WaitUntil(const time_point& deadline, std::chrono::milliseconds max_wait) override;
+
+    // Move time forward (never back) and wake waiters that are now due
+    void Advance(std::chrono::milliseconds duration);
+    void AdvanceTo(const time_point& time);
+
+private:
+    std::atomic<time_point> now_;
+    std::mutex mutex_;
+    std::condition_variable advanced_cv_;
+};
+
+// Scan loop wait: returns after interval of clock time, or within about
+// 100 ms of real time once keep_running is cleared
+void SleepFor(Clock& clock, std::chrono::milliseconds interval, const std::atomic<bool>& keep_running);
+
+} // namespace HIPS
+
+#endif // CLOCK_H
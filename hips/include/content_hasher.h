@@ -0,0 +1,163 @@
+/*
+ * Content Hashing for HIPS
+ *
+ * SHA-256 and XXH64 digests of file contents, computed in one pass over
+ * the file: through a read-only mapping, or with large sequential reads
+ * when the file cannot be mapped. Results are cached by file identity
+ * (device, file id, size and modification time), so an executable that
+ * has not changed is never hashed again. Asynchronous requests run on a
+ * small pool of their own, bounded by a queue limit so that bursts of file
+ * activity drop hash requests instead of piling up I/O; cache hits are
+ * answered on the calling thread. A file that changes while it is hashed
+ * is reported as unhashed rather than cached under a stale identity.
+ */
+
+#ifndef CONTENT_HASHER_H
+#define CONTENT_HASHER_H
+
+#include "hips_core.h"
+#include "worker_pool.h"
+#include <string>
+#include <list>
+#include <unordered_map>
+#include <memory>
+#include <functional>
+#include <mutex>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+
+namespace HIPS {
+
+// Incremental SHA-256 (FIPS 180-4)
+class Sha256 {
+public:
+    Sha256();
+    void Update(const void* data, size_t length);
+    // Lowercase hex digest; the hasher must not be updated afterwards
+    std::string Final();
+
+private:
+    uint32_t state_[8];
+    uint8_t block_[64];
+    size_t block_length_;
+    uint64_t total_length_;
+
+    void Transform(const uint8_t* block);
+};
+
+// Incremental XXH64 with seed 0; fast, not collision resistant
+class Xxh64 {
+public:
+    Xxh64();
+    void Update(const void* data, size_t length);
+    uint64_t Final() const;
+
+private:
+    uint64_t accumulators_[4];
+    uint8_t stripe_[32];
+    size_t stripe_length_;
+    uint64_t total_length_;
+};
+
+// What the cache key is made of; a rewrite changes size or mtime, a
+// replacement changes the file id
+struct FileIdentity {
+    uint64_t device = 0;
+    uint64_t file_id = 0;
+    uint64_t size = 0;
+    int64_t modified_ns = 0;
+
+    bool operator==(const FileIdentity& other) const {
+        return device == other.device && file_id == other.file_id && size == other.size &&
+               modified_ns == other.modified_ns;
+    }
+    bool operator!=(const FileIdentity& other) const { return !(*this == other); }
+};
+
+struct FileIdentityHash {
+    size_t operator()(const FileIdentity& identity) const;
+};
+
+struct FileHashes {
+    std::string sha256;         // Lowercase hex
+    uint64_t xxh64 = 0;
+    uint64_t size = 0;
+
+    std::string Xxh64Hex() const;
+};
+
+struct ContentHashStats {
+    uint64_t cache_hits = 0;
+    uint64_t files_hashed = 0;
+    uint64_t bytes_hashed = 0;
+    uint64_t failures = 0;          // Unreadable, too large or changed while hashed
+    uint64_t dropped = 0;           // Asynchronous requests over the queue limit
+    size_t cached = 0;
+};
+
+class ContentHasher {
+public:
+    // Called exactly once per accepted request; hashes are empty unless ok
+    using HashCallback = std::function<void(bool ok, const FileHashes& hashes)>;
+
+    // threads hash concurrently; at most max_pending requests wait for them
+    explicit ContentHasher(size_t threads = 2, size_t max_pending = 256);
+
+    ContentHasher(const ContentHasher&) = delete;
+    ContentHasher& operator=(const ContentHasher&) = delete;
+
+    // Hash on the calling thread, through the cache
+    bool Hash(const std::string& path, FileHashes& hashes);
+
+    // Hash on the pool and call back from it, or from the calling thread on
+    // a cache hit or an unreadable file. False (and no callback) when the
+    // queue is full.
+    bool HashAsync(const std::string& path, HashCallback callback);
+
+    // Files larger than this are not hashed (0 = no limit)
+    void SetMaxFileSize(uint64_t bytes) { max_file_size_ = bytes; }
+    uint64_t GetMaxFileSize() const { return max_file_size_.load(); }
+    void SetCacheCapacity(size_t capacity);
+    void ClearCache();
+
+    ContentHashStats GetStats() const;
+
+    // Identity of the file at path; false when it is not a regular file
+    static bool GetFileIdentity(const std::string& path, FileIdentity& identity);
+    // Both digests of the file contents, without the cache
+    static bool HashFileContents(const std::string& path, FileHashes& hashes);
+
+    // Process-wide hasher shared by the monitors unless one is injected
+    static std::shared_ptr<ContentHasher> Shared();
+
+private:
+    using CacheList = std::list<std::pair<FileIdentity, FileHashes>>;
+
+    // Least recently used hashes first
+    CacheList cache_;
+    std::unordered_map<FileIdentity, CacheList::iterator, FileIdentityHash> cache_index_;
+    size_t cache_capacity_;
+    mutable std::mutex cache_mutex_;
+
+    std::atomic<uint64_t> max_file_size_;
+    size_t max_pending_;
+    std::atomic<size_t> pending_;
+
+    std::atomic<uint64_t> cache_hits_;
+    std::atomic<uint64_t> files_hashed_;
+    std::atomic<uint64_t> bytes_hashed_;
+    std::atomic<uint64_t> failures_;
+    std::atomic<uint64_t> dropped_;
+
+    // Declared last so workers are joined before the cache goes away
+    WorkerPool pool_;
+
+    bool LookupCache(const FileIdentity& identity, FileHashes& hashes);
+    void StoreCache(const FileIdentity& identity, const FileHashes& hashes);
+    bool HashUncached(const std::string& path, const FileIdentity& identity, FileHashes& hashes);
+};
+
+} // namespace HIPS
+
+#endif // CONTENT_HASHER_H
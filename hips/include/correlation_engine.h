@@ -9,36 +9,30 @@
 #define CORRELATION_ENGINE_H
 
 #include "hips_core.h"
+#include "sequence_matcher.h"
+#include "process_lineage.h"
+#include "correlation_store.h"
+#include "timer_wheel.h"
+#include "heavy_hitters.h"
+#include "state_snapshot.h"
+#include "worker_pool.h"
+#include "clock.h"
+#include "window_aggregates.h"
 #include <string>
 #include <vector>
 #include <unordered_map>
 #include <deque>
+#include <list>
 #include <memory>
 #include <mutex>
 #include <chrono>
 
 namespace HIPS {
 
-// Correlation types
-enum class CorrelationType {
-    PROCESS_BASED,      // Events from same process
-    TIME_BASED,         // Events in time window
-    TARGET_BASED,       // Events targeting same file/registry
-    SEQUENCE_BASED,     // Events matching known attack patterns
-    THREAT_ESCALATION   // Increasing threat levels
-};
-
-// Correlated event group
-struct CorrelatedEventGroup {
-    std::string correlation_id;
-    CorrelationType type;
-    std::vector<SecurityEvent> events;
-    ThreatLevel combined_threat_level;
-    double correlation_score;
-    SYSTEMTIME first_event_time;
-    SYSTEMTIME last_event_time;
-    std::string description;
-    std::unordered_map<std::string, std::string> metadata;
+// Handling of events whose timestamp is already behind the watermark
+enum class LateEventPolicy {
+    MERGE,      // Correlate against the current windows with its own timestamp
+    DROP        // Count and discard
 };
 
 // Correlation configuration
@@ -58,18 +52,177 @@ struct CorrelationConfig {
     // Maximum correlation groups to maintain
     int max_correlation_groups = 1000;
     
+    // Approximate memory budget for stored correlation groups (0 = unlimited)
+    size_t max_correlation_memory_bytes = 16 * 1024 * 1024;
+    
     // Enable specific correlation types
     bool enable_process_correlation = true;
     bool enable_time_correlation = true;
     bool enable_target_correlation = true;
     bool enable_sequence_correlation = true;
     bool enable_threat_escalation = true;
+    
+    bool enable_lineage_correlation = true;
+    
+    // Run the DetectCorrelations() sweeps concurrently on the worker pool
+    bool parallel_detection = true;
+    
+    // Per-type windows in milliseconds (0 = time_window_seconds); see
+    // CorrelationEngine::WindowSpan() for which distances fall inside.
+    // Threat escalation follows the per-process state machine and has no
+    // window.
+    int process_window_ms = 0;
+    int target_window_ms = 0;
+    int burst_window_ms = 0;        // Time-based bursts
+    int lineage_window_ms = 0;
+    int sequence_window_ms = 0;     // Patterns without their own window; whole seconds
+    
+    // Process/target windows longer than this are scored from per-key
+    // multi-resolution aggregates instead of the raw events, which are
+    // still capped at max_events_per_process. Aggregated windows are
+    // clamped to MultiResolutionWindow::kHorizonMs (64 minutes).
+    int max_raw_window_seconds = 300;
+    
+    // Attack chains for sequence-based correlation
+    std::vector<AttackPattern> attack_patterns = DefaultAttackPatterns();
+    
+    // Maximum partial pattern matches tracked at once
+    int max_partial_matches = 10000;
+    
+    // Process lineage: ancestor levels aggregated per event, and exited
+    // processes kept so late events still reach their ancestors
+    int lineage_max_depth = 8;
+    int lineage_history_size = 4096;
+    
+    // Number of independently locked shards for process/target tracking
+    int shard_count = 16;
+    
+    // Process/target keys with no events for this long are evicted
+    // (0 = the longest of time_window_seconds and the process/target windows)
+    int key_idle_timeout_seconds = 0;
+    
+    // Approximate memory budget for process/target tracking, split evenly
+    // across shards; least recently used keys are evicted (0 = unlimited)
+    size_t max_tracked_memory_bytes = 64 * 1024 * 1024;
+    
+    // Heavy-hitter sketches: each shard keeps its top heavy_hitter_count
+    // targets and processes per time window (0 disables the sketches)
+    int heavy_hitter_count = 32;
+    
+    // Keep exact per-target windows only for the sketched top targets
+    // instead of for every target. Bounds target tracking memory however
+    // many paths are touched; targets outside the top-K are only counted.
+    bool sketch_target_tracking = false;
+    
+    // Event time: correlate by SecurityEvent::timestamp instead of arrival
+    // time. Events wait in a reorder buffer and are correlated in timestamp
+    // order once the watermark (latest timestamp seen minus
+    // allowed_lateness_ms) passes them; events already behind the watermark
+    // on arrival are late and handled by late_event_policy. Set before
+    // Initialize().
+    bool use_event_time = false;
+    int allowed_lateness_ms = 2000;
+    LateEventPolicy late_event_policy = LateEventPolicy::MERGE;
+    
+    // Timestamps further ahead of the engine clock than this are clamped
+    // to it, so one bad clock cannot drag the watermark into the future
+    // and make every later event late
+    int max_event_time_skew_ms = 300000;
+    
+    // Buffered events beyond this are released early, advancing the watermark
+    size_t max_reorder_buffer_events = 65536;
 };
 
-// Event tracking structure for correlation
+// Event tracking structure for correlation. The threat level and process
+// id are copied next to the timestamp so window scans and scoring read
+// only the compact window entries, never the shared SecurityEvent. An
+// event restored from a snapshot has no event until a group needs it;
+// archived_index then names it in the engine's archived events.
 struct TrackedEvent {
-    SecurityEvent event;
+    EventRef event;
     std::chrono::system_clock::time_point timestamp;
+    ThreatLevel threat_level = ThreatLevel::LOW;
+    uint32_t archived_index = 0;
+    DWORD process_id = 0;
+};
+
+// Recent events from a process and all of its descendants
+struct LineageWindow {
+    std::deque<TrackedEvent> events;
+    std::unordered_map<DWORD, uint32_t> process_event_counts;
+    ThreatCounts threat_counts;
+};
+
+// Sketch state of a top-K target: distinct processes in the current and
+// previous window, and the exact window when sketch_target_tracking is set
+struct TargetHitter {
+    HyperLogLog processes;
+    HyperLogLog previous_processes;
+    std::deque<TrackedEvent> events;
+    
+    void Reset() {
+        processes.Clear();
+        previous_processes.Clear();
+        events.clear();
+    }
+};
+
+// A top-K target or process. Counts cover the current time window plus
+// earlier windows at halving weights; the true count lies in
+// [guaranteed_events, estimated_events].
+struct HeavyHitter {
+    std::string target;                 // Set by GetTopTargets()
+    DWORD process_id = 0;               // Set by GetTopProcesses()
+    uint64_t estimated_events = 0;
+    uint64_t guaranteed_events = 0;
+    uint64_t distinct_processes = 0;    // Targets only, estimated
+};
+
+// Tracked events for one process id or target path
+struct TrackedKey {
+    std::deque<TrackedEvent> events;
+    std::chrono::system_clock::time_point last_access;
+    size_t tracked_bytes = 0;
+    
+    // Threat level counts over a long window, when the key kind has one
+    std::unique_ptr<MultiResolutionWindow> aggregate;
+    
+    // Sequence number of the next appended event; events.front() has
+    // next_sequence - events.size()
+    uint64_t next_sequence = 0;
+    
+    // Threat escalation state machine (process keys): level of the latest
+    // event and sequence numbers of the escalating events still in events
+    ThreatLevel last_threat_level = ThreatLevel::LOW;
+    std::deque<uint64_t> escalation_steps;
+    
+    // Identity, used to erase the key when it is evicted
+    bool is_target = false;
+    DWORD process_id = 0;
+    const std::string* target = nullptr;    // The owning map's key
+    
+    TimerWheel<TrackedKey>::Node idle_timer;
+    std::list<TrackedKey*>::iterator lru_position;
+};
+
+// One stripe of per-process and per-target tracking state. Keys are
+// assigned to shards by hash so producers touching different processes
+// or targets rarely contend on the same lock.
+struct CorrelationShard {
+    std::unordered_map<DWORD, TrackedKey> process_events;
+    std::unordered_map<std::string, TrackedKey> target_events;
+    std::list<TrackedKey*> lru;             // Least recently used first
+    TimerWheel<TrackedKey> idle_timers;     // One-second ticks
+    size_t tracked_bytes = 0;
+    
+    // Heavy-hitter sketches, aged once per time window
+    CountMinSketch target_counts;
+    CountMinSketch process_counts;
+    SpaceSavingTopK<std::string, TargetHitter> top_targets;
+    SpaceSavingTopK<DWORD> top_processes;
+    uint64_t sketch_window = 0;
+    
+    std::mutex mutex;
 };
 
 class CorrelationEngine {
@@ -82,74 +235,269 @@ public:
     bool Initialize(const CorrelationConfig& config);
     void Shutdown();
 
-    // Event processing
+    // Event processing (safe to call from multiple producer threads). In
+    // event-time mode events are correlated one at a time, in timestamp
+    // order, as the watermark releases them.
     void ProcessEvent(const SecurityEvent& event);
     
-    // Correlation detection
+    // Event-time mode: move the watermark forward (it never moves back) and
+    // correlate the buffered events it passes, e.g. when a source goes
+    // quiet or at the end of a replay
+    void AdvanceWatermark(const std::chrono::system_clock::time_point& watermark);
+    
+    // Correlation detection. DetectCorrelations() runs a full sweep and
+    // returns only the groups it newly stored. With parallel_detection the
+    // detectors run concurrently over a frozen view of the tracking state,
+    // holding every shard lock for the duration of the sweep.
     std::vector<CorrelatedEventGroup> DetectCorrelations();
     std::vector<CorrelatedEventGroup> GetActiveCorrelations() const;
     
+    // Non-copying reads. The visitor runs without engine locks held, on
+    // groups that stay valid for as long as the caller keeps a pointer.
+    void ForEachActiveCorrelation(const std::function<void(const CorrelatedEventGroup&)>& visitor) const;
+    // Reads groups stored since cursor (start at 0), oldest first
+    size_t ReadCorrelations(uint64_t& cursor, size_t max_groups,
+                            std::vector<CorrelationGroupPtr>& groups) const;
+    
     // Configuration
     void SetConfiguration(const CorrelationConfig& config);
     CorrelationConfig GetConfiguration() const;
     
+    // Pool for parallel detection; WorkerPool::Shared() when not set
+    void SetWorkerPool(std::shared_ptr<WorkerPool> pool);
+    
+    // Source of arrival times and sweep times; SystemClock by default. Set
+    // before processing events, e.g. to a SimulatedClock to fast-forward
+    // windows and idle timeouts in tests and benchmarks.
+    void SetClock(std::shared_ptr<Clock> clock);
+    
     // Statistics
     uint64_t GetProcessedEventCount() const;
     uint64_t GetCorrelationCount() const;
     uint64_t GetActiveCorrelationCount() const;
+    uint64_t GetCorrelationMemoryBytes() const;
+    uint64_t GetEvictedCorrelationCount() const;
+    uint64_t GetPartialMatchCount() const;
+    uint64_t GetLineageProcessCount() const;
+    uint64_t GetTrackedKeyCount() const;
+    uint64_t GetTrackedMemoryBytes() const;
+    uint64_t GetIdleEvictionCount() const;
+    uint64_t GetBudgetEvictionCount() const;
+    
+    // Event-time mode
+    std::chrono::system_clock::time_point GetWatermark() const;
+    uint64_t GetBufferedEventCount() const;
+    uint64_t GetLateEventCount() const;
+    uint64_t GetDroppedLateEventCount() const;
+    uint64_t GetClampedEventCount() const;
     
-    // Callbacks for correlation alerts
+    // Most frequent targets (with distinct process estimates) and
+    // processes in the recent time window, most frequent first. Bounded
+    // by heavy_hitter_count per shard. Read-only.
+    std::vector<HeavyHitter> GetTopTargets(size_t k) const;
+    std::vector<HeavyHitter> GetTopProcesses(size_t k) const;
+    
+    // Callbacks for correlation alerts. The callback is invoked without any
+    // engine lock held and may run concurrently on several producer threads.
     using CorrelationCallback = std::function<void(const CorrelatedEventGroup&)>;
     void RegisterCorrelationCallback(CorrelationCallback callback);
     
     // Clear old correlations
     void ClearOldCorrelations();
+    
+    // Checkpointing. SaveState appends a CORRELATION_STATE section holding
+    // the tracking windows, lineage, active groups and counters, with each
+    // shared event written once; every structure is captured under its own
+    // lock. RestoreState replaces the current state with the one in
+    // snapshot (call after Initialize) and leaves the engine empty if the
+    // section is missing or malformed. In-flight partial sequence matches
+    // are not saved.
+    void SaveState(SnapshotWriter& writer) const;
+    bool RestoreState(const SnapshotReader& snapshot);
 
 private:
     // Configuration
     CorrelationConfig config_;
     mutable std::mutex config_mutex_;
+    std::shared_ptr<WorkerPool> worker_pool_;   // Guarded by config_mutex_
+    std::shared_ptr<Clock> clock_;
+    
+    // Event tracking, striped by process id / target path
+    std::vector<std::unique_ptr<CorrelationShard>> shards_;
+    size_t shard_memory_budget_;
     
-    // Event tracking
-    std::unordered_map<DWORD, std::deque<TrackedEvent>> process_events_;
-    std::unordered_map<std::string, std::deque<TrackedEvent>> target_events_;
+    // Global time window
     std::deque<TrackedEvent> time_window_events_;
-    mutable std::mutex events_mutex_;
+    ThreatCounts window_threat_counts_;
+    mutable std::mutex window_mutex_;
+    
+    // Sequence pattern matching
+    SequenceMatcher sequence_matcher_;
+    std::chrono::system_clock::time_point last_sequence_sweep_;
+    mutable std::mutex sequence_mutex_;
+    
+    // Process lineage and per-ancestor subtree windows
+    ProcessLineageTable lineage_;
+    std::unordered_map<DWORD, LineageWindow> lineage_windows_;
+    std::vector<DWORD> lineage_scratch_;
+    mutable std::mutex lineage_mutex_;
+    
+    // Event-time reorder buffer, a min-heap on timestamp then arrival
+    struct PendingEvent {
+        TrackedEvent tracked;
+        uint64_t arrival;
+        
+        static bool Later(const PendingEvent& a, const PendingEvent& b) {
+            return a.tracked.timestamp != b.tracked.timestamp ?
+                a.tracked.timestamp > b.tracked.timestamp : a.arrival > b.arrival;
+        }
+    };
+    std::vector<PendingEvent> reorder_buffer_;
+    uint64_t reorder_arrivals_;
+    std::chrono::system_clock::time_point max_event_time_;
+    std::chrono::system_clock::time_point watermark_;
+    std::atomic<std::chrono::system_clock::time_point> event_clock_;   // Latest released event
+    mutable std::mutex event_time_mutex_;
     
     // Correlation results
-    std::vector<CorrelatedEventGroup> active_correlations_;
+    CorrelationGroupStore correlation_store_;
     mutable std::mutex correlations_mutex_;
     
+    // Events of the last restore, still encoded. Replaced only with the
+    // tracked state (Initialize, RestoreState), as shards_ is.
+    std::shared_ptr<const ArchivedEvents> archived_events_;
+    
     // Statistics
     std::atomic<uint64_t> processed_event_count_;
     std::atomic<uint64_t> correlation_count_;
+    std::atomic<uint64_t> idle_eviction_count_;
+    std::atomic<uint64_t> budget_eviction_count_;
+    std::atomic<uint64_t> late_event_count_;
+    std::atomic<uint64_t> dropped_late_event_count_;
+    std::atomic<uint64_t> clamped_event_count_;
     
     // Callback
     CorrelationCallback correlation_callback_;
     std::mutex callback_mutex_;
     
-    // Correlation detection methods
-    void DetectProcessBasedCorrelations();
-    void DetectTimeBasedCorrelations();
-    void DetectTargetBasedCorrelations();
-    void DetectSequenceBasedCorrelations();
-    void DetectThreatEscalation();
-    
-    // Helper methods
-    double CalculateCorrelationScore(const std::vector<SecurityEvent>& events, CorrelationType type);
-    ThreatLevel CalculateCombinedThreatLevel(const std::vector<SecurityEvent>& events);
-    bool IsCorrelationSignificant(const std::vector<SecurityEvent>& events, CorrelationType type);
-    void AddCorrelationGroup(const CorrelatedEventGroup& group);
-    void CleanupOldEvents();
+    // Shard lookup
+    CorrelationShard& ShardForProcess(DWORD process_id);
+    CorrelationShard& ShardForTarget(const std::string& target);
+    CorrelationShard& ShardForTargetHash(size_t target_hash);
+    void ResetShards(size_t shard_count);
+    void ClearShard(CorrelationShard& shard);
+    void ClearState();
+    void ResetEventTime();
+    bool ReadState(SnapshotReader& reader);
+    // The tracked event itself, decoding a restored one
+    EventRef EventOf(const TrackedEvent& tracked) const;
+    
+    // Correlate one event as of now; ProcessEvent and the reorder buffer
+    // decide when
+    void IngestEvent(TrackedEvent tracked, const std::chrono::system_clock::time_point& now,
+                     std::vector<CorrelatedEventGroup>& detected);
+    // Correlate buffered events up to the watermark; caller holds event_time_mutex_
+    void ReleaseEvents(std::vector<CorrelatedEventGroup>& detected);
+    // Arrival time, or in event-time mode the latest released event time
+    std::chrono::system_clock::time_point CurrentTime() const;
+    
+    // Key lifetime; callers hold the shard lock
+    TrackedKey& TouchProcessKey(CorrelationShard& shard, DWORD process_id,
+                                const std::chrono::system_clock::time_point& now);
+    TrackedKey& TouchTargetKey(CorrelationShard& shard, const std::string& target,
+                               const std::chrono::system_clock::time_point& now);
+    void AppendTrackedEvent(CorrelationShard& shard, TrackedKey& key, TrackedEvent tracked);
+    void ExpireIdleKeys(CorrelationShard& shard, const std::chrono::system_clock::time_point& now);
+    void EnforceMemoryBudget(CorrelationShard& shard, const TrackedKey& keep);
+    size_t EstimateTrackedBytes(const TrackedEvent& tracked) const;
+    void EraseTrackedKey(CorrelationShard& shard, TrackedKey& key);
+    std::chrono::seconds KeyIdleTimeout() const;
+    
+    // Heavy-hitter sketches; callers hold the shard lock. Only the ingest
+    // and sweep paths rotate; readers age what they report by the windows
+    // elapsed since the last rotation instead.
+    void RotateSketches(CorrelationShard& shard, const std::chrono::system_clock::time_point& now) const;
+    uint64_t SketchWindowsElapsed(const CorrelationShard& shard,
+                                  const std::chrono::system_clock::time_point& now) const;
+    TargetHitter* CountTarget(CorrelationShard& shard, const SecurityEvent& event, size_t target_hash);
+    void CountProcess(CorrelationShard& shard, DWORD process_id);
+    
+    // Correlation detection methods (full sweeps)
+    void DetectCorrelationsParallel(WorkerPool& pool, std::vector<CorrelatedEventGroup>& detected);
+    void DetectProcessBasedCorrelations(std::vector<CorrelatedEventGroup>& detected);
+    void DetectTimeBasedCorrelations(std::vector<CorrelatedEventGroup>& detected);
+    void DetectTargetBasedCorrelations(std::vector<CorrelatedEventGroup>& detected);
+    void DetectSequenceBasedCorrelations(const EventRef& event,
+                                         const std::chrono::system_clock::time_point& now,
+                                         std::vector<CorrelatedEventGroup>& detected);
+    void DetectThreatEscalation(std::vector<CorrelatedEventGroup>& detected);
+    void DetectLineageBasedCorrelations(const EventRef& event,
+                                        const std::chrono::system_clock::time_point& timestamp,
+                                        const std::chrono::system_clock::time_point& now,
+                                        std::vector<CorrelatedEventGroup>& detected);
+    
+    // One shard of a sweep; callers hold the shard lock
+    void SweepProcessEvents(const CorrelationShard& shard, const std::chrono::system_clock::time_point& now,
+                            std::vector<CorrelatedEventGroup>& detected);
+    void SweepTargetEvents(const CorrelationShard& shard, const std::chrono::system_clock::time_point& now,
+                           std::vector<CorrelatedEventGroup>& detected);
+    void SweepThreatEscalation(const CorrelationShard& shard, std::vector<CorrelatedEventGroup>& detected);
+    
+    // Per-key evaluation; callers hold the lock protecting the events
+    void EvaluateProcessEvents(DWORD process_id, const std::deque<TrackedEvent>& events,
+                               const MultiResolutionWindow* aggregate,
+                               const std::chrono::system_clock::time_point& now,
+                               std::vector<CorrelatedEventGroup>& detected);
+    void EvaluateTargetEvents(const std::string& target, const std::deque<TrackedEvent>& events,
+                              const MultiResolutionWindow* aggregate, const TargetHitter* hitter,
+                              const std::chrono::system_clock::time_point& now,
+                              std::vector<CorrelatedEventGroup>& detected);
+    void EvaluateThreatEscalation(DWORD process_id, const TrackedKey& key,
+                                  std::vector<CorrelatedEventGroup>& detected);
+    void EvaluateTimeWindow(std::vector<CorrelatedEventGroup>& detected);
+    void AppendLineageEvent(LineageWindow& window, const EventRef& event,
+                            const std::chrono::system_clock::time_point& timestamp,
+                            const std::chrono::system_clock::time_point& now);
+    
+    // Scoring, from the threat level counts of a candidate group; each
+    // candidate is scored once and only significant ones are materialized
+    double CalculateCorrelationScore(const ThreatCounts& counts, CorrelationType type) const;
+    ThreatLevel CalculateCombinedThreatLevel(const ThreatCounts& counts) const;
+    bool IsCorrelationSignificant(double score) const;
+    // Count the events of a window inside a window span, preferring the
+    // key's aggregate when the window is long
+    ThreatCounts CountRecentEvents(const std::deque<TrackedEvent>& events,
+                                   const MultiResolutionWindow* aggregate,
+                                   std::chrono::milliseconds span,
+                                   const std::chrono::system_clock::time_point& now) const;
+
+    
+    // Store non-duplicate groups, appending the stored copies to stored
+    void AddCorrelationGroups(std::vector<CorrelatedEventGroup>& groups,
+                              std::vector<CorrelationGroupPtr>& stored);
+    // Invoke the callback for each group; must be called with no locks held
+    void NotifyCorrelations(const std::vector<CorrelationGroupPtr>& groups);
+    
+    void CleanupOldEvents(const std::chrono::system_clock::time_point& now);
     std::string GenerateCorrelationId();
     
-    // Time utilities
-    bool IsWithinTimeWindow(const std::chrono::system_clock::time_point& time1,
-                           const std::chrono::system_clock::time_point& time2) const;
+    // Window boundary rule. A window of W ms has a span of W + 1 ms and a
+    // time_window_seconds window of S seconds a span of S + 1 seconds; two
+    // events correlate while their distance is strictly under the span
+    // (IsWithinSpan), i.e. while it is at most the window once truncated
+    // to the window's unit. Windows scored from aggregates
+    // (UsesAggregate) count every bucket that overlaps [now - span, now],
+    // so they can also take in events up to one bucket older: a second
+    // within the last 64 seconds, a minute before that.
+    std::chrono::milliseconds WindowSpan(int window_ms) const;
+    bool UsesAggregate(std::chrono::milliseconds span) const;
+    void ClampAggregateWindows();
+    static bool IsWithinSpan(const std::chrono::system_clock::time_point& time1,
+                             const std::chrono::system_clock::time_point& time2,
+                             std::chrono::milliseconds span);
     
-    // Pattern matching for sequence detection
-    bool MatchesAttackPattern(const std::vector<SecurityEvent>& events);
-    std::string DescribeAttackPattern(const std::vector<SecurityEvent>& events);
+    // Rebuild the sequence automaton from config_
+    void CompileAttackPatterns();
 };
 
 } // namespace HIPS
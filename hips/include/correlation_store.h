@@ -0,0 +1,133 @@
+/*
+ * Correlation Group Store for HIPS
+ *
+ * Holds active correlation groups under a group-count and memory budget.
+ * Groups are immutable once stored and handed out as shared pointers, so
+ * readers never deep-copy events; events themselves are shared references
+ * into the engine's tracking state. Duplicate detection uses a hash index
+ * on each group's precomputed summary instead of a linear scan.
+ */
+
+#ifndef CORRELATION_STORE_H
+#define CORRELATION_STORE_H
+
+#include "hips_core.h"
+#include "event_refs.h"
+#include <string>
+#include <vector>
+#include <deque>
+#include <unordered_map>
+#include <unordered_set>
+#include <memory>
+
+namespace HIPS {
+
+// Correlation types
+enum class CorrelationType {
+    PROCESS_BASED,      // Events from same process
+    TIME_BASED,         // Events in time window
+    TARGET_BASED,       // Events targeting same file/registry
+    SEQUENCE_BASED,     // Events matching known attack patterns
+    THREAT_ESCALATION,  // Increasing threat levels
+    LINEAGE_BASED       // Events from a process and its descendants
+};
+
+// Aggregates computed once when a group is stored
+struct CorrelationSummary {
+    size_t event_count = 0;
+    size_t process_count = 0;           // Distinct process ids
+    size_t high_threat_count = 0;       // HIGH or CRITICAL events
+    ThreatLevel max_threat_level = ThreatLevel::LOW;
+    DWORD first_process_id = 0;
+    DWORD last_process_id = 0;
+};
+
+// Correlated event group
+struct CorrelatedEventGroup {
+    std::string correlation_id;
+    CorrelationType type;
+    EventRefs events;
+    ThreatLevel combined_threat_level;
+    double correlation_score;
+    SYSTEMTIME first_event_time;
+    SYSTEMTIME last_event_time;
+    std::string description;
+    std::unordered_map<std::string, std::string> metadata;
+    CorrelationSummary summary;
+};
+
+using CorrelationGroupPtr = std::shared_ptr<const CorrelatedEventGroup>;
+
+CorrelationSummary SummarizeEvents(const EventRefs& events);
+
+// Not thread-safe; callers serialize access.
+class CorrelationGroupStore {
+public:
+    CorrelationGroupStore();
+    ~CorrelationGroupStore();
+
+    // 0 for either limit means unlimited
+    void Configure(size_t max_groups, size_t max_bytes);
+
+    // Store the group unless an equivalent one is active; evicts the oldest
+    // groups to stay within budget. Returns nullptr for duplicates.
+    CorrelationGroupPtr Add(CorrelatedEventGroup&& group);
+
+    // Groups with sequence >= cursor, oldest first, at most max_groups;
+    // cursor is advanced past the last group returned. Groups evicted
+    // before they were read are skipped.
+    size_t Read(uint64_t& cursor, size_t max_groups, std::vector<CorrelationGroupPtr>& groups) const;
+
+    // All active groups, oldest first (copies pointers only)
+    void Snapshot(std::vector<CorrelationGroupPtr>& groups) const;
+
+    // Keep only the newest keep_count groups
+    void TrimTo(size_t keep_count);
+    void Clear();
+
+    // Statistics
+    size_t Size() const { return groups_.size(); }
+    size_t GetMemoryBytes() const { return memory_bytes_; }
+    uint64_t GetEvictedCount() const { return evicted_count_; }
+    uint64_t GetNextSequence() const { return next_sequence_; }
+
+private:
+    struct DedupKey {
+        CorrelationType type;
+        size_t event_count;
+        DWORD first_process_id;
+        std::string pattern_name;       // SEQUENCE_BASED only
+
+        bool operator==(const DedupKey& other) const {
+            return type == other.type && event_count == other.event_count &&
+                   first_process_id == other.first_process_id &&
+                   pattern_name == other.pattern_name;
+        }
+    };
+
+    struct DedupKeyHash {
+        size_t operator()(const DedupKey& key) const;
+    };
+
+    struct StoredGroup {
+        CorrelationGroupPtr group;
+        size_t bytes;
+    };
+
+    std::deque<StoredGroup> groups_;    // groups_[i] has sequence first_sequence_ + i
+    std::unordered_set<DedupKey, DedupKeyHash> dedup_index_;
+    uint64_t first_sequence_;
+    uint64_t next_sequence_;
+    size_t max_groups_;
+    size_t max_bytes_;
+    size_t memory_bytes_;
+    uint64_t evicted_count_;
+
+    static DedupKey KeyFor(const CorrelatedEventGroup& group);
+    static size_t ApproximateGroupBytes(const CorrelatedEventGroup& group);
+    void PopOldest();
+};
+
+} // namespace HIPS
+
+#endif // CORRELATION_STORE_H
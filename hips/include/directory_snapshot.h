@@ -0,0 +1,69 @@
+/*
+ * Directory Snapshots for HIPS
+ *
+ * The size, modification time and type of every entry in a watched
+ * subtree at one point in time. When change notifications are lost to an
+ * overflow, FileSystemMonitor captures a fresh snapshot of the affected
+ * root and diffs it against the cached one to reconstruct what changed in
+ * between. Captures are bounded by depth and entry count, and the subtrees
+ * below the root are scanned in parallel on a worker pool.
+ */
+
+#ifndef DIRECTORY_SNAPSHOT_H
+#define DIRECTORY_SNAPSHOT_H
+
+#include "hips_core.h"
+#include <string>
+#include <unordered_map>
+#include <functional>
+#include <cstdint>
+
+namespace HIPS {
+
+class WorkerPool;
+
+struct SnapshotEntry {
+    uint64_t size = 0;
+    int64_t modified_ns = 0;
+    bool directory = false;
+
+    bool operator==(const SnapshotEntry& other) const {
+        return size == other.size && modified_ns == other.modified_ns && directory == other.directory;
+    }
+    bool operator!=(const SnapshotEntry& other) const { return !(*this == other); }
+};
+
+class DirectorySnapshot {
+public:
+    // Reconstructed change; action is a FILE_ACTION_* code
+    using ChangeCallback = std::function<void(const std::string& path, DWORD action)>;
+
+    DirectorySnapshot();
+
+    // Entries of root and of its subdirectories up to max_depth levels
+    // below it, at most max_entries of them. Subdirectories of the root
+    // are scanned as separate tasks on pool (inline when pool is null).
+    // Symbolic links are recorded but not followed.
+    static DirectorySnapshot Capture(const std::string& root, int max_depth, size_t max_entries,
+                                     WorkerPool* pool);
+
+    // Report what changed between older and this snapshot. Removals are
+    // only reported when this snapshot is complete and additions only when
+    // older is; directories report additions and removals but not
+    // modifications.
+    void Diff(const DirectorySnapshot& older, const ChangeCallback& callback) const;
+
+    const std::string& GetRoot() const { return root_; }
+    size_t GetEntryCount() const { return entries_.size(); }
+    bool IsTruncated() const { return truncated_; }
+    const SnapshotEntry* Find(const std::string& path) const;
+
+private:
+    std::string root_;
+    std::unordered_map<std::string, SnapshotEntry> entries_;
+    bool truncated_;            // Hit max_entries
+};
+
+} // namespace HIPS
+
+#endif // DIRECTORY_SNAPSHOT_H
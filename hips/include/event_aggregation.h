@@ -0,0 +1,263 @@
+/*
+ * Multi-Agent Event Aggregation for HIPS
+ *
+ * Lets several HIPS agents stream their security events to one collector
+ * so activity spread across hosts can be correlated. Agents batch events
+ * into length-prefixed frames (encoded with the state snapshot codec) and
+ * number every event with a per-agent sequence; the collector acknowledges
+ * each batch once it has been processed. Agents keep unacknowledged batches
+ * to resend after a reconnect and stop draining their queue while too many
+ * batches are unacknowledged, so a slow collector pushes back on its
+ * agents instead of growing buffers. A full agent queue drops new events
+ * and counts them.
+ *
+ * The collector partitions correlation by agent, one CorrelationEngine per
+ * agent so process ids and lineage stay meaningful within each host, and
+ * reports a cross-host correlation when the same kind of correlation shows
+ * up on several agents within a time window.
+ */
+
+#ifndef EVENT_AGGREGATION_H
+#define EVENT_AGGREGATION_H
+
+#include "hips_core.h"
+#include "correlation_engine.h"
+#ifdef _WIN32
+#include <winsock2.h>
+#include <ws2tcpip.h>
+#endif
+#include <string>
+#include <vector>
+#include <deque>
+#include <unordered_map>
+#include <memory>
+#include <thread>
+#include <atomic>
+#include <mutex>
+#include <condition_variable>
+#include <functional>
+#include <chrono>
+
+namespace HIPS {
+
+#ifdef _WIN32
+using AggregationSocket = SOCKET;
+#else
+using AggregationSocket = int;
+#endif
+
+constexpr uint32_t kAggregationProtocolVersion = 1;
+
+struct AggregationAgentConfig {
+    // Defaults to the host name
+    std::string agent_id;
+
+    // "host:port" for TCP, or "unix:/path" for a local socket (POSIX only)
+    std::string collector_address;
+
+    // A batch is sent when it is full or its oldest event is this old
+    size_t max_batch_events = 256;
+    int max_batch_delay_ms = 50;
+
+    // Events waiting to be batched; Submit() drops events beyond this
+    size_t max_queued_events = 65536;
+
+    // Batches sent but not yet acknowledged before the agent stops sending
+    size_t max_unacked_batches = 8;
+
+    int reconnect_delay_ms = 500;
+
+    // Stop() spends up to this long delivering queued and unacknowledged
+    // events before closing the connection (0 = drop them)
+    int stop_flush_timeout_ms = 2000;
+};
+
+// Streams events to a collector (safe to Submit from multiple threads)
+class AggregationAgent {
+public:
+    AggregationAgent();
+    ~AggregationAgent();
+
+    bool Initialize(const AggregationAgentConfig& config);
+    bool Start();
+    // Stops accepting work, then makes a bounded attempt to flush
+    bool Stop();
+
+    // Queue an event for the collector; returns false and counts the event
+    // as dropped when the queue is full
+    bool Submit(const SecurityEvent& event);
+
+    bool IsRunning() const { return running_.load(); }
+    bool IsConnected() const { return connected_.load(); }
+    const std::string& GetAgentId() const { return config_.agent_id; }
+
+    // Statistics
+    uint64_t GetQueuedEventCount() const;
+    uint64_t GetSentEventCount() const { return sent_event_count_.load(); }
+    uint64_t GetAckedEventCount() const { return acked_event_count_.load(); }
+    uint64_t GetDroppedEventCount() const { return dropped_event_count_.load(); }
+    uint64_t GetReconnectCount() const { return reconnect_count_.load(); }
+
+private:
+    struct PendingBatch {
+        uint64_t last_sequence;
+        size_t event_count;
+        std::string frame;
+    };
+
+    AggregationAgentConfig config_;
+    uint64_t session_id_;
+
+    std::deque<SecurityEvent> queue_;
+    std::chrono::steady_clock::time_point oldest_queued_;
+    mutable std::mutex queue_mutex_;
+    std::condition_variable queue_cv_;
+
+    // Owned by the sender thread
+    AggregationSocket socket_;
+    std::deque<PendingBatch> unacked_;
+    uint64_t next_sequence_;
+    std::string receive_buffer_;
+
+    std::thread sender_thread_;
+    std::atomic<bool> running_;
+    std::atomic<bool> connected_;
+    bool initialized_;
+
+    std::atomic<uint64_t> sent_event_count_;
+    std::atomic<uint64_t> acked_event_count_;
+    std::atomic<uint64_t> dropped_event_count_;
+    std::atomic<uint64_t> reconnect_count_;
+
+    void SenderThreadFunction();
+    void FlushRemaining();
+    bool Connect();
+    void Disconnect();
+    bool SendNextBatch();
+    bool ReceiveAcks(int timeout_ms);
+    void HandleAck(uint64_t sequence);
+};
+
+// Per-agent state as seen by the collector
+struct CollectorAgentStats {
+    std::string agent_id;
+    bool connected = false;
+    uint64_t last_sequence = 0;         // Highest sequence processed
+    uint64_t received_events = 0;
+    uint64_t duplicate_events = 0;      // Resent after a reconnect, ignored
+    uint64_t missing_events = 0;        // Sequence gaps
+};
+
+// The same kind of correlation observed on several agents
+struct CrossHostCorrelation {
+    std::string signature;              // Correlation type, plus pattern name for sequences
+    std::vector<std::string> agent_ids;
+    std::vector<CorrelationGroupPtr> groups;    // Latest group from each agent
+    std::chrono::system_clock::time_point first_seen;
+    std::chrono::system_clock::time_point last_seen;
+};
+
+struct AggregationCollectorConfig {
+    // "host:port" for TCP (port 0 picks a free port), or "unix:/path"
+    std::string listen_address = "127.0.0.1:0";
+
+    // Configuration of each agent's CorrelationEngine
+    CorrelationConfig engine_config;
+
+    // Cross-host correlation: groups of at least min_threat_level with the
+    // same signature from min_agents agents within window_seconds
+    int cross_host_window_seconds = 600;
+    int cross_host_min_agents = 2;
+    ThreatLevel cross_host_min_threat_level = ThreatLevel::HIGH;
+
+    size_t max_agents = 256;
+};
+
+class AggregationCollector {
+public:
+    AggregationCollector();
+    ~AggregationCollector();
+
+    bool Initialize(const AggregationCollectorConfig& config);
+    bool Start();
+    bool Stop();
+
+    bool IsRunning() const { return running_.load(); }
+
+    // Bound TCP port (useful with port 0), or 0 for local sockets
+    uint16_t GetPort() const { return port_; }
+
+    // Statistics
+    std::vector<CollectorAgentStats> GetAgentStats() const;
+    uint64_t GetReceivedEventCount() const { return received_event_count_.load(); }
+    uint64_t GetCrossHostCorrelationCount() const { return cross_host_count_.load(); }
+
+    // The agent's correlation partition, or nullptr for an unknown agent
+    std::shared_ptr<CorrelationEngine> GetAgentEngine(const std::string& agent_id) const;
+
+    // Callbacks run on connection threads without collector locks held
+    using AgentCorrelationCallback = std::function<void(const std::string&, const CorrelatedEventGroup&)>;
+    using CrossHostCallback = std::function<void(const CrossHostCorrelation&)>;
+    void RegisterCorrelationCallback(AgentCorrelationCallback callback);
+    void RegisterCrossHostCallback(CrossHostCallback callback);
+
+private:
+    struct AgentState {
+        CollectorAgentStats stats;
+        uint64_t session_id = 0;
+        uint64_t connection_id = 0;     // Latest connection; only it clears connected
+        std::shared_ptr<CorrelationEngine> engine;
+    };
+
+    struct Connection {
+        uint64_t id = 0;
+        AggregationSocket socket;
+        std::thread thread;
+        std::atomic<bool> finished{false};
+    };
+
+    struct CrossHostState {
+        struct Sighting {
+            std::chrono::system_clock::time_point time;
+            CorrelationGroupPtr group;
+        };
+        std::unordered_map<std::string, Sighting> agents;
+        size_t reported_agents = 0;
+    };
+
+    AggregationCollectorConfig config_;
+    AggregationSocket listen_socket_;
+    uint16_t port_;
+    std::string unix_path_;
+
+    std::thread accept_thread_;
+    std::vector<std::unique_ptr<Connection>> connections_;
+    uint64_t next_connection_id_;
+    std::mutex connections_mutex_;
+
+    std::unordered_map<std::string, AgentState> agents_;
+    mutable std::mutex agents_mutex_;
+
+    std::unordered_map<std::string, CrossHostState> cross_host_;
+    std::mutex cross_host_mutex_;
+
+    AgentCorrelationCallback correlation_callback_;
+    CrossHostCallback cross_host_callback_;
+    std::mutex callback_mutex_;
+
+    std::atomic<bool> running_;
+    bool initialized_;
+    std::atomic<uint64_t> received_event_count_;
+    std::atomic<uint64_t> cross_host_count_;
+
+    void AcceptThreadFunction();
+    void ConnectionThreadFunction(Connection& connection);
+    std::shared_ptr<CorrelationEngine> RegisterAgent(const std::string& agent_id, uint64_t session_id,
+                                                     uint64_t connection_id, uint64_t& last_sequence);
+    void OnAgentCorrelation(const std::string& agent_id, const CorrelatedEventGroup& group);
+    void ReapFinishedConnections();
+};
+
+} // namespace HIPS
+
+#endif // EVENT_AGGREGATION_H
@@ -0,0 +1,106 @@
+/*
+ * Shared Event References for HIPS
+ *
+ * Correlation state refers to each SecurityEvent through a shared pointer
+ * so tracking queues, pattern matches and correlation groups can hold the
+ * same event without copying it. EventRefs reads like a
+ * std::vector<SecurityEvent> (size, indexing, iteration yield
+ * const SecurityEvent&) so existing consumers keep working.
+ */
+
+#ifndef EVENT_REFS_H
+#define EVENT_REFS_H
+
+#include "hips_core.h"
+#include <vector>
+#include <memory>
+#include <iterator>
+
+namespace HIPS {
+
+using EventRef = std::shared_ptr<const SecurityEvent>;
+
+// Rough heap footprint of an event, used for memory budgets
+inline size_t ApproximateEventBytes(const SecurityEvent& event) {
+    size_t bytes = sizeof(SecurityEvent) + event.process_path.capacity() +
+                   event.target_path.capacity() + event.description.capacity();
+    for (const auto& [key, value] : event.metadata) {
+        bytes += 64 + key.capacity() + value.capacity();
+    }
+    return bytes;
+}
+
+class EventRefs {
+public:
+    class const_iterator {
+    public:
+        using iterator_category = std::random_access_iterator_tag;
+        using value_type = SecurityEvent;
+        using difference_type = std::ptrdiff_t;
+        using pointer = const SecurityEvent*;
+        using reference = const SecurityEvent&;
+
+        const_iterator() = default;
+        explicit const_iterator(std::vector<EventRef>::const_iterator it) : it_(it) {}
+
+        reference operator*() const { return **it_; }
+        pointer operator->() const { return it_->get(); }
+        reference operator[](difference_type n) const { return *it_[n]; }
+
+        const_iterator& operator++() { ++it_; return *this; }
+        const_iterator operator++(int) { const_iterator old = *this; ++it_; return old; }
+        const_iterator& operator--() { --it_; return *this; }
+        const_iterator operator--(int) { const_iterator old = *this; --it_; return old; }
+        const_iterator& operator+=(difference_type n) { it_ += n; return *this; }
+        const_iterator& operator-=(difference_type n) { it_ -= n; return *this; }
+        const_iterator operator+(difference_type n) const { return const_iterator(it_ + n); }
+        const_iterator operator-(difference_type n) const { return const_iterator(it_ - n); }
+        difference_type operator-(const const_iterator& other) const { return it_ - other.it_; }
+
+        bool operator==(const const_iterator& other) const { return it_ == other.it_; }
+        bool operator!=(const const_iterator& other) const { return it_ != other.it_; }
+        bool operator<(const const_iterator& other) const { return it_ < other.it_; }
+
+    private:
+        std::vector<EventRef>::const_iterator it_;
+    };
+
+    using value_type = SecurityEvent;
+    using iterator = const_iterator;
+
+    EventRefs() = default;
+
+    void push_back(EventRef event) { refs_.push_back(std::move(event)); }
+    void push_back(const SecurityEvent& event) { refs_.push_back(std::make_shared<const SecurityEvent>(event)); }
+    void reserve(size_t count) { refs_.reserve(count); }
+    void clear() { refs_.clear(); }
+
+    size_t size() const { return refs_.size(); }
+    bool empty() const { return refs_.empty(); }
+
+    const SecurityEvent& operator[](size_t index) const { return *refs_[index]; }
+    const SecurityEvent& front() const { return *refs_.front(); }
+    const SecurityEvent& back() const { return *refs_.back(); }
+
+    const_iterator begin() const { return const_iterator(refs_.begin()); }
+    const_iterator end() const { return const_iterator(refs_.end()); }
+
+    // Underlying references, for sharing events with other holders
+    const std::vector<EventRef>& refs() const { return refs_; }
+
+    // Approximate bytes kept alive by these references
+    size_t ApproximateBytes() const {
+        size_t bytes = refs_.capacity() * sizeof(EventRef);
+        for (const auto& ref : refs_) {
+            bytes += ApproximateEventBytes(*ref);
+        }
+        return bytes;
+    }
+
+private:
+    std::vector<EventRef> refs_;
+};
+
+} // namespace HIPS
+
+#endif // EVENT_REFS_H
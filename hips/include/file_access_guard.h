@@ -0,0 +1,173 @@
+/*
+ * File Access Guard for HIPS
+ *
+ * Blocking enforcement of file opens and executions under the watch roots.
+ * On Linux the guard holds each access with a fanotify permission event
+ * while a decider, normally the engine's rule evaluation, answers allow or
+ * deny. Every decision has a deadline: accesses still undecided when it
+ * passes are allowed (fail-open), so a slow or stuck decider delays file
+ * access by at most the deadline. Verdicts are cached per file and binary,
+ * so repeated opens of the same file by the same program are answered
+ * without asking the decider again.
+ */
+
+#ifndef FILE_ACCESS_GUARD_H
+#define FILE_ACCESS_GUARD_H
+
+#include "hips_core.h"
+#include <string>
+#include <vector>
+#include <deque>
+#include <list>
+#include <unordered_map>
+#include <functional>
+#include <thread>
+#include <atomic>
+#include <mutex>
+#include <condition_variable>
+#include <chrono>
+
+namespace HIPS {
+
+// An access waiting for a verdict
+struct FileAccessRequest {
+    std::string path;
+    std::string process_path;
+    DWORD process_id = 0;
+    bool execute = false;       // Opened for execution
+};
+
+// Returns true to allow the access
+using FileAccessDecider = std::function<bool(const FileAccessRequest&)>;
+
+// Accesses under the watch roots. Latency runs from reading the event to
+// answering it and covers the most recent decisions only.
+struct AccessDecisionStats {
+    uint64_t decisions = 0;
+    uint64_t denied = 0;
+    uint64_t timed_out = 0;     // Allowed by the deadline
+    uint64_t cache_hits = 0;
+    double p50_us = 0.0;
+    double p90_us = 0.0;
+    double p99_us = 0.0;
+    double max_us = 0.0;
+};
+
+class FileAccessGuard {
+public:
+    FileAccessGuard();
+    ~FileAccessGuard();
+
+    FileAccessGuard(const FileAccessGuard&) = delete;
+    FileAccessGuard& operator=(const FileAccessGuard&) = delete;
+
+    // Hold opens under roots (up to max_depth levels below them) for
+    // decider. Fails where permission events are not available.
+    bool Start(const std::vector<std::string>& roots, int max_depth, FileAccessDecider decider,
+               std::chrono::milliseconds deadline);
+    void Stop();
+
+    // False once enforcement has stopped, including after the kernel
+    // reported events in a format this build cannot parse
+    bool IsRunning() const { return enforcing_.load(); }
+
+    // Forget cached verdicts, e.g. after the rules changed. Verdicts from
+    // decisions already under way are not cached either.
+    void ClearVerdictCache();
+    void SetVerdictCacheCapacity(size_t capacity);
+
+    AccessDecisionStats GetStats() const;
+
+    // Allow every event in a buffer read from fanotify_fd and close its
+    // descriptors, without parsing anything but the event lengths.
+    // Returns the number of events allowed.
+    static size_t AllowEvents(int fanotify_fd, const char* buffer, size_t length);
+
+private:
+    // File and program identity; a file replaced or modified in place gets
+    // a new inode or change time and is decided again
+    struct VerdictKey {
+        uint64_t file_device;
+        uint64_t file_inode;
+        int64_t file_change_ns;
+        uint64_t program_device;
+        uint64_t program_inode;
+
+        bool operator==(const VerdictKey& other) const;
+    };
+    struct VerdictKeyHash {
+        size_t operator()(const VerdictKey& key) const;
+    };
+
+    struct PendingDecision {
+        uint64_t id;
+        int fd;                 // Event descriptor; answered and closed once
+        VerdictKey key;
+        FileAccessRequest request;
+        std::chrono::steady_clock::time_point received;
+        std::chrono::steady_clock::time_point deadline;
+    };
+
+    std::vector<std::string> roots_;
+    int max_depth_;
+    FileAccessDecider decider_;
+    std::chrono::milliseconds deadline_;
+    std::atomic<bool> running_;
+    std::atomic<bool> enforcing_;
+
+    int fanotify_fd_;
+    int epoll_fd_;
+    int stop_fd_;
+
+    // The event thread only reads, looks up and answers; deciders run on
+    // the decision thread so the deadline holds however long they take
+    std::thread event_thread_;
+    std::thread decision_thread_;
+    std::atomic<long> decision_thread_id_;
+
+    // Undecided accesses, by id; expiry follows arrival order
+    std::unordered_map<uint64_t, PendingDecision> pending_;
+    std::deque<std::pair<uint64_t, std::chrono::steady_clock::time_point>> expiry_order_;
+    std::deque<uint64_t> decision_queue_;
+    uint64_t next_id_;
+    bool stop_decisions_;
+    std::mutex pending_mutex_;
+    std::condition_variable decision_cv_;
+
+    // Least recently used verdicts last
+    std::list<std::pair<VerdictKey, bool>> verdicts_;
+    std::unordered_map<VerdictKey, std::list<std::pair<VerdictKey, bool>>::iterator, VerdictKeyHash> verdict_index_;
+    size_t verdict_capacity_;
+    std::atomic<uint64_t> verdict_generation_;  // Bumped by ClearVerdictCache()
+    mutable std::mutex verdict_mutex_;
+
+    // Statistics
+    std::atomic<uint64_t> decisions_;
+    std::atomic<uint64_t> denied_;
+    std::atomic<uint64_t> timed_out_;
+    std::atomic<uint64_t> cache_hits_;
+    std::vector<uint32_t> latency_us_;      // Ring of recent latencies
+    size_t latency_next_;
+    mutable std::mutex latency_mutex_;
+
+    void EventLoop();
+    void DecisionLoop();
+    // False once enforcement has stopped
+    bool ReadPermissionEvents();
+    void StopEnforcing();
+    void ReleasePending();
+    void ExpireDecisions(const std::chrono::steady_clock::time_point& now);
+
+    // Answer an access; false if it was already answered
+    bool Respond(uint64_t id, bool allow, bool timed_out);
+    void Answer(int fd, bool allow);
+
+    bool LookupVerdict(const VerdictKey& key, bool& allow);
+    // Dropped if the cache was cleared since generation was read
+    void StoreVerdict(const VerdictKey& key, bool allow, uint64_t generation);
+    void RecordLatency(const std::chrono::steady_clock::time_point& received);
+};
+
+} // namespace HIPS
+
+#endif // FILE_ACCESS_GUARD_H
@@ -2,15 +2,42 @@
 #define FILE_MONITOR_H
 
 #include "hips_core.h"
+#include "file_access_guard.h"
+#include "directory_snapshot.h"
+#include "path_classifier.h"
+#include "process_identity_cache.h"
+#include "notify_decoder.h"
+#include "content_hasher.h"
+#include "baseline_scanner.h"
+#include "inventory_database.h"
+#include "worker_pool.h"
 #include <string>
+#include <string_view>
 #include <vector>
 #include <thread>
 #include <atomic>
+#include <mutex>
+#include <condition_variable>
 #include <functional>
-#include <unordered_set>
+#include <memory>
+#include <chrono>
+
+#ifdef __linux__
+#include "linux_file_watcher.h"
+#endif
 
 namespace HIPS {
 
+// Notification health of one watch root
+struct WatchRootStats {
+    std::string path;
+    uint64_t overflows = 0;                 // Notification batches lost
+    uint64_t rescans = 0;                   // Snapshot diffs run after overflows
+    uint64_t reconstructed_changes = 0;     // Changes recovered by those diffs
+    size_t buffer_bytes = 0;                // Current notification buffer
+    size_t snapshot_entries = 0;            // Entries in the cached snapshot
+};
+
 class FileSystemMonitor {
 public:
     FileSystemMonitor();
@@ -27,10 +54,54 @@ public:
     void SetScanDepth(int depth);
     void SetExcludedExtensions(const std::vector<std::string>& extensions);
     void SetIncludedExtensions(const std::vector<std::string>& extensions);
+    // Extensions, system paths and critical directories; defaults from
+    // PathClassifierConfig::Defaults()
+    void SetPathClassifierConfig(const PathClassifierConfig& config);
+    // Threads dispatching change notifications; set before Start()
+    void SetWorkerThreads(size_t count);
+    // Source of process paths for events; the shared cache by default
+    void SetProcessIdentityCache(std::shared_ptr<ProcessIdentityCache> cache);
+    // Events for added and modified files are delivered once the content
+    // hashes are attached ("sha256", "xxh64"); off by default
+    void SetContentHashing(bool enable) { content_hashing_ = enable; }
+    void SetContentHasher(std::shared_ptr<ContentHasher> hasher);
+    // Inventory the watch roots (to the scan depth) in the background on
+    // Start(); off by default
+    void SetBaselineScanOnStart(bool enable) { baseline_on_start_ = enable; }
+    // Throttle for baseline scans in bytes per second (0 = unthrottled)
+    void SetBaselineIoBudget(uint64_t bytes_per_second) { baseline_io_budget_ = bytes_per_second; }
+    // Keep the baseline inventory in this file so the next start reports
+    // what changed while the monitor was down; empty (the default) keeps
+    // it in memory only. Set before Start().
+    void SetInventoryDatabase(const std::string& path) { inventory_path_ = path; }
 
     // Callback registration
     void RegisterCallback(std::function<void(const SecurityEvent&)> callback);
 
+    // Hold file opens and executions under the watch paths until decider
+    // allows them (Linux fanotify permission events); set before Start().
+    // Undecided accesses are allowed after deadline. Without permission
+    // events the monitor still starts and only reports changes.
+    void EnableAccessEnforcement(std::function<bool(const SecurityEvent&)> decider,
+                                 std::chrono::milliseconds deadline);
+    void ClearAccessVerdictCache();
+    bool IsAccessEnforcementActive() const;
+    AccessDecisionStats GetAccessDecisionStats() const;
+
+    std::vector<WatchRootStats> GetWatchRootStats() const;
+
+    // Inventory the watch roots now and return when done. Executables
+    // whose events would be reported are evaluated as FILE_ACCESS events
+    // marked "baseline"; files are hashed when content hashing is on. With
+    // an inventory database holding an earlier scan, differences from it
+    // are reported instead, marked "offline". False when not
+    // running or a baseline scan is already in progress.
+    bool RunBaselineScan();
+    BaselineScanStats GetBaselineScanStats() const;
+    // Entries recorded by the last completed baseline scan
+    std::shared_ptr<const std::vector<InventoryEntry>> GetBaselineInventory() const;
+    InventoryDatabaseStats GetInventoryDatabaseStats() const;
+
     // Status
     bool IsRunning() const { return running_.load(); }
     bool IsInitialized() const { return initialized_.load(); }
@@ -41,33 +112,94 @@ private:
         HANDLE handle;
         OVERLAPPED overlapped;
         std::vector<BYTE> buffer;
-        bool active;
+        NotifyBufferDecoder decoder;    // Owned with the buffer by the completing worker
+        std::atomic<bool> active;   // A read is outstanding
+        std::atomic<size_t> buffer_bytes;
+        size_t shard;               // Linux watcher covering it
+
+        // Overflow recovery: lost changes are rebuilt by diffing a fresh
+        // snapshot of scan_root against the cached one
+        std::string scan_root;      // Canonical path; empty when missing
+        std::shared_ptr<const DirectorySnapshot> snapshot;
+        mutable std::mutex snapshot_mutex;
+        std::atomic<size_t> rescan_requests;
+        std::atomic<uint64_t> overflow_count;
+        std::atomic<uint64_t> rescan_count;
+        std::atomic<uint64_t> reconstructed_count;
     };
 
     std::atomic<bool> running_;
     std::atomic<bool> initialized_;
-    std::vector<WatchDirectory> watch_dirs_;
-    std::thread monitor_thread_;
+    // Completions carry the WatchDirectory itself, so entries stay put
+    std::vector<std::unique_ptr<WatchDirectory>> watch_dirs_;
+    // Removed while running; freed once their cancelled reads are drained
+    std::vector<std::unique_ptr<WatchDirectory>> retired_dirs_;
+    std::vector<std::thread> monitor_threads_;
+    size_t worker_threads_;
+
+    // Snapshot captures and rescans run on the shared pool, one at a time
+    // per watch; Stop() waits for them and for outstanding hash requests
+    std::shared_ptr<WorkerPool> rescan_pool_;
+    size_t tasks_in_flight_;
+    std::mutex tasks_mutex_;
+    std::condition_variable tasks_cv_;
+    std::shared_ptr<ContentHasher> content_hasher_;
+    std::atomic<bool> content_hashing_;
+
+    // Baseline inventory; Stop() cancels a scan in progress
+    std::atomic<bool> baseline_on_start_;
+    std::atomic<uint64_t> baseline_io_budget_;
+    std::atomic<bool> baseline_scanning_;
+    std::shared_ptr<BaselineScanner> baseline_scanner_;
+    std::shared_ptr<const std::vector<InventoryEntry>> baseline_inventory_;
+    BaselineScanStats baseline_stats_;
+    mutable std::mutex baseline_mutex_;
+    // Updated by the baseline scan in progress; the first scan after
+    // Start() reports differences from the database
+    std::string inventory_path_;
+    InventoryDatabase inventory_db_;
+    std::atomic<bool> offline_diff_pending_;
     std::function<void(const SecurityEvent&)> event_callback_;
+#ifdef __linux__
+    // Native backend, one epoll reactor per shard of the watch roots;
+    // Windows shares one completion port across the worker threads
+    std::vector<std::unique_ptr<LinuxFileWatcher>> linux_watchers_;
+    FileAccessGuard access_guard_;
+#else
+    HANDLE completion_port_;
+#endif
+    std::function<bool(const SecurityEvent&)> access_decider_;
+    std::chrono::milliseconds access_deadline_;
     
     // Configuration
     int scan_depth_;
-    std::unordered_set<std::string> excluded_extensions_;
-    std::unordered_set<std::string> included_extensions_;
+    PathClassifierConfig classifier_config_;
+    // Rebuilt whenever the configuration changes; readers take a reference
+    std::shared_ptr<const PathClassifier> classifier_;
+    std::shared_ptr<ProcessIdentityCache> identity_cache_;
     
     // Monitoring methods
-    void MonitoringThreadFunction();
+    void MonitoringThreadFunction(size_t shard);
     bool SetupDirectoryWatch(WatchDirectory& watch_dir);
-    void ProcessFileSystemEvent(const FILE_NOTIFY_INFORMATION* fni, const std::string& directory);
-    SecurityEvent CreateSecurityEvent(const std::string& file_path, DWORD action);
-    ThreatLevel EvaluateThreatLevel(const std::string& file_path, DWORD action);
-    bool IsFileTypeIncluded(const std::string& file_path);
+    bool IssueDirectoryRead(WatchDirectory& watch_dir);
+    void CloseDirectoryWatch(WatchDirectory& watch_dir);
+    void ScheduleRescan(WatchDirectory& watch_dir);
+    void RescanWatch(WatchDirectory& watch_dir);
+    void ProcessFileSystemEvent(WatchDirectory& watch_dir, DWORD bytes);
+    void HandleFileChange(std::string_view full_path, DWORD action, DWORD process_id,
+                          bool reconstructed = false);
+    void DispatchEvent(SecurityEvent event, bool hash_content);
+    void ReportBaselineEntry(const InventoryEntry& entry);
+    void ReportOfflineChange(const InventoryEntry& entry, DWORD action);
+    void UpdateInventoryDatabase(const std::vector<std::string>& roots, const std::vector<InventoryEntry>& inventory,
+                                 bool complete, int depth, const std::vector<bool>& report_roots);
+    void BeginTask();
+    void EndTask();
+    bool DecideFileAccess(const FileAccessRequest& request);
+    SecurityEvent CreateSecurityEvent(const std::string& file_path, const PathClassification& path_class,
+                                      DWORD action, DWORD process_id);
+    ThreatLevel EvaluateThreatLevel(const PathClassification& path_class, DWORD action);
     std::string GetProcessPathFromPID(DWORD pid);
-    
-    // Helper methods
-    std::string GetFileExtension(const std::string& file_path);
-    bool IsSystemFile(const std::string& file_path);
-    bool IsCriticalDirectory(const std::string& directory);
 };
 
 } // namespace HIPS
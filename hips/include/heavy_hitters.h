@@ -0,0 +1,269 @@
+/*
+ * Heavy-Hitter Sketches for HIPS
+ *
+ * Fixed-size summaries of high-rate key streams. CountMinSketch estimates
+ * per-key counts (never under-estimating), SpaceSavingTopK keeps the K
+ * most frequent keys with error bounds, and HyperLogLog estimates the
+ * number of distinct items. Memory does not grow with the number of keys,
+ * so a path touched by thousands of processes, or millions of paths
+ * touched once, cost the same. All three take precomputed 64-bit hashes
+ * and are not thread-safe; the correlation engine keeps one set per shard.
+ */
+
+#ifndef HEAVY_HITTERS_H
+#define HEAVY_HITTERS_H
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+#include <array>
+#include <unordered_map>
+#include <utility>
+#include <functional>
+#include <algorithm>
+#include <iterator>
+
+namespace HIPS {
+
+// Count-Min sketch with conservative update: only the rows holding the
+// current minimum are incremented, which tightens estimates for light keys
+class CountMinSketch {
+public:
+    static constexpr size_t kMaxDepth = 8;
+
+    CountMinSketch(size_t width = 512, size_t depth = 4);
+
+    // Count key and return its new estimate
+    uint32_t Add(uint64_t hash, uint32_t count = 1);
+    uint32_t Estimate(uint64_t hash) const;
+
+    // Halve every counter, ageing out earlier windows
+    void Decay();
+    void Clear();
+
+    size_t MemoryBytes() const { return counters_.size() * sizeof(uint32_t); }
+
+private:
+    size_t width_;
+    size_t depth_;
+    std::vector<uint32_t> counters_;
+
+    void Indexes(uint64_t hash, size_t* indexes) const;
+};
+
+// HyperLogLog with 64 registers (about 13% standard error) and linear
+// counting for small cardinalities, where it is close to exact
+class HyperLogLog {
+public:
+    static constexpr unsigned kPrecision = 6;
+    static constexpr size_t kRegisters = size_t(1) << kPrecision;
+
+    void Add(uint64_t hash);
+    uint64_t Estimate() const;
+    void Merge(const HyperLogLog& other);
+    void Clear() { registers_.fill(0); }
+
+private:
+    std::array<uint8_t, kRegisters> registers_{};
+};
+
+struct SpaceSavingNoPayload {
+    void Reset() {}
+};
+
+// Space-Saving top-K. Entries live in fixed slots and a binary min-heap
+// of slot numbers orders them by count, so counting a monitored key is
+// O(log K) without moving entries, and admitting a new key replaces the
+// least frequent one. A key's true count lies in [count - error, count];
+// every key counted more than N/K times out of N is guaranteed to be
+// monitored.
+template <typename Key, typename Payload = SpaceSavingNoPayload, typename Hash = std::hash<Key>>
+class SpaceSavingTopK {
+public:
+    struct Entry {
+        Key key;
+        uint64_t count = 0;
+        uint64_t error = 0;
+        Payload payload;
+    };
+
+    explicit SpaceSavingTopK(size_t capacity = 0) : capacity_(0) { SetCapacity(capacity); }
+
+    // Changing the capacity drops all monitored keys. Slots are reserved up
+    // front so entries never move.
+    void SetCapacity(size_t capacity) {
+        Clear();
+        capacity_ = capacity;
+        slots_.reserve(capacity);
+        heap_.reserve(capacity);
+        positions_.reserve(capacity);
+    }
+
+    // Change the capacity keeping the most frequent keys that still fit,
+    // with their counts, errors and payloads. Entries may move.
+    void Resize(size_t capacity) {
+        std::vector<Entry> kept(std::make_move_iterator(slots_.begin()), std::make_move_iterator(slots_.end()));
+        std::sort(kept.begin(), kept.end(), [](const Entry& a, const Entry& b) {
+            return a.count > b.count;
+        });
+        if (kept.size() > capacity) {
+            kept.erase(kept.begin() + capacity, kept.end());
+        }
+
+        SetCapacity(capacity);
+        for (auto& entry : kept) {
+            uint32_t slot = static_cast<uint32_t>(slots_.size());
+            index_.emplace(entry.key, slot);
+            slots_.push_back(std::move(entry));
+            heap_.push_back(slot);
+            positions_.push_back(static_cast<uint32_t>(heap_.size() - 1));
+            SiftUp(heap_.size() - 1);
+        }
+    }
+
+    size_t Capacity() const { return capacity_; }
+    size_t Size() const { return slots_.size(); }
+
+    // Count increment occurrences of key and return its entry. A newly
+    // admitted key replaces the minimum and inherits its count as error.
+    // admission_bound is an upper bound on the key's count from another
+    // summary (e.g. a CountMinSketch estimate that already includes this
+    // occurrence); a key whose bound does not exceed the minimum could not
+    // outrank it, so it is not admitted and nullptr is returned, as with
+    // zero capacity. This keeps light keys from churning the table.
+    // Payloads of evicted keys are Reset(). Entries stay at the same
+    // address until their key is evicted.
+    Entry* Offer(const Key& key, uint64_t increment = 1, uint64_t admission_bound = UINT64_MAX) {
+        auto it = index_.find(key);
+        if (it != index_.end()) {
+            Entry& entry = slots_[it->second];
+            entry.count += increment;
+            SiftDown(positions_[it->second]);
+            return &entry;
+        }
+
+        if (capacity_ == 0) {
+            return nullptr;
+        }
+
+        if (slots_.size() < capacity_) {
+            uint32_t slot = static_cast<uint32_t>(slots_.size());
+            slots_.push_back(Entry());
+            slots_.back().key = key;
+            slots_.back().count = increment;
+            index_.emplace(key, slot);
+            heap_.push_back(slot);
+            positions_.push_back(static_cast<uint32_t>(heap_.size() - 1));
+            SiftUp(heap_.size() - 1);
+            return &slots_.back();
+        }
+
+        // Replace the minimum at the heap root
+        uint32_t slot = heap_.front();
+        Entry& entry = slots_[slot];
+        if (admission_bound <= entry.count) {
+            return nullptr;
+        }
+        uint64_t inherited = entry.count;
+
+        // Reuse the index node and the entry's storage
+        auto node = index_.extract(entry.key);
+        node.key() = key;
+        index_.insert(std::move(node));
+        entry.key = key;
+        entry.error = inherited;
+        entry.count = inherited + increment;
+        entry.payload.Reset();
+        SiftDown(0);
+        return &entry;
+    }
+
+    Entry* Find(const Key& key) {
+        auto it = index_.find(key);
+        return it != index_.end() ? &slots_[it->second] : nullptr;
+    }
+
+    const Entry* Find(const Key& key) const {
+        auto it = index_.find(key);
+        return it != index_.end() ? &slots_[it->second] : nullptr;
+    }
+
+    // Halve counts and errors; halving keeps the heap order
+    void Decay() {
+        for (auto& entry : slots_) {
+            entry.count /= 2;
+            entry.error /= 2;
+        }
+    }
+
+    void Clear() {
+        slots_.clear();
+        heap_.clear();
+        positions_.clear();
+        index_.clear();
+    }
+
+    // Visit entries in no particular order
+    template <typename Visitor>
+    void ForEach(Visitor&& visitor) const {
+        for (const auto& entry : slots_) {
+            visitor(entry);
+        }
+    }
+
+    template <typename Visitor>
+    void ForEach(Visitor&& visitor) {
+        for (auto& entry : slots_) {
+            visitor(entry);
+        }
+    }
+
+private:
+    size_t capacity_;
+    std::vector<Entry> slots_;
+    std::vector<uint32_t> heap_;            // Slot numbers, min-heap on count
+    std::vector<uint32_t> positions_;       // Heap position of each slot
+    std::unordered_map<Key, uint32_t, Hash> index_;
+
+    uint64_t CountAt(size_t position) const { return slots_[heap_[position]].count; }
+
+    void Swap(size_t a, size_t b) {
+        std::swap(heap_[a], heap_[b]);
+        positions_[heap_[a]] = static_cast<uint32_t>(a);
+        positions_[heap_[b]] = static_cast<uint32_t>(b);
+    }
+
+    void SiftUp(size_t position) {
+        while (position > 0) {
+            size_t parent = (position - 1) / 2;
+            if (CountAt(parent) <= CountAt(position)) {
+                break;
+            }
+            Swap(parent, position);
+            position = parent;
+        }
+    }
+
+    void SiftDown(size_t position) {
+        for (;;) {
+            size_t smallest = position;
+            size_t left = 2 * position + 1;
+            size_t right = left + 1;
+            if (left < heap_.size() && CountAt(left) < CountAt(smallest)) {
+                smallest = left;
+            }
+            if (right < heap_.size() && CountAt(right) < CountAt(smallest)) {
+                smallest = right;
+            }
+            if (smallest == position) {
+                return;
+            }
+            Swap(position, smallest);
+            position = smallest;
+        }
+    }
+};
+
+} // namespace HIPS
+
+#endif // HEAVY_HITTERS_H
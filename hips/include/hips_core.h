@@ -197,6 +197,8 @@ inline BOOL SetConsoleCtrlHandler(PHANDLER_ROUTINE, BOOL) { return TRUE; }
 #include <thread>
 #include <atomic>
 #include <mutex>
+#include <condition_variable>
+#include <chrono>
 
 namespace HIPS {
 
@@ -211,6 +213,7 @@ class LogManager;
 class AlertManager;
 class SelfProtectionEngine;
 class CorrelationEngine;
+class AggregationAgent;
 
 #ifdef HIPS_KERNEL_DRIVER_SUPPORT
 class DriverInterface;
@@ -296,6 +299,8 @@ public:
     // Event handling
     void RegisterEventHandler(EventType type, std::function<void(const SecurityEvent&)> handler);
     void UnregisterEventHandler(EventType type);
+    // Handle an event from an external sensor as if a monitor reported it
+    bool SubmitEvent(const SecurityEvent& event);
     
     // Status and control
     bool IsRunning() const { return running_.load(); }
@@ -305,9 +310,18 @@ public:
     uint64_t GetEventCount(EventType type) const;
     uint64_t GetTotalEventCount() const;
     
+    // State checkpointing: statistics, alerts and correlation state. Taken
+    // on Stop() and every state_snapshot_interval seconds while running,
+    // and restored once by the first Start() after Initialize().
+    bool SaveStateSnapshot(const std::string& snapshot_path);
+    bool RestoreStateSnapshot(const std::string& snapshot_path);
+    
     // Enterprise features
     bool EnableLearningMode(bool enable);
     bool ExportThreatReport(const std::string& output_path);
+    // Replace the SHA-256 signatures of known-bad content. One signature
+    // per line: 64 hex digits, optionally followed by a name; '#' starts a
+    // comment. Events whose content hash matches become CRITICAL.
     bool UpdateThreatSignatures(const std::string& signature_path);
     
     // Self-protection features
@@ -330,6 +344,9 @@ private:
     std::unique_ptr<SelfProtectionEngine> self_protection_;
     std::unique_ptr<CorrelationEngine> correlation_engine_;
     
+    // Forwards events to a cross-host collector when configured
+    std::unique_ptr<AggregationAgent> aggregation_agent_;
+    
 #ifdef HIPS_KERNEL_DRIVER_SUPPORT
     // Kernel driver interface for enhanced monitoring
     std::unique_ptr<DriverInterface> driver_interface_;
@@ -359,12 +376,38 @@ private:
     mutable std::unordered_map<EventType, uint64_t> event_counts_;
     mutable std::mutex stats_mutex_;
     
+    // Threat signatures by lowercase SHA-256
+    std::unordered_map<std::string, std::string> threat_signatures_;
+    mutable std::mutex signatures_mutex_;
+    
+    // Periodic state snapshots
+    std::string snapshot_path_;
+    std::chrono::seconds snapshot_interval_;
+    bool state_restored_;
+    std::thread snapshot_thread_;
+    std::condition_variable snapshot_cv_;
+    std::mutex snapshot_mutex_;
+    bool snapshot_stop_;
+    
     // Internal methods
     void ProcessSecurityEvent(const SecurityEvent& event);
+    bool MatchThreatSignature(const SecurityEvent& event, SecurityEvent& matched) const;
     ActionType EvaluateEvent(const SecurityEvent& event);
     bool ApplyAction(const SecurityEvent& event, ActionType action);
     void UpdateStatistics(const SecurityEvent& event);
     void LoadDefaultRules();
+    void LoadSnapshotSettings();
+    void StartSnapshotThread();
+    void StopSnapshotThread();
+    void SnapshotLoop();
+    void StartAggregationAgent();
+    void ConfigureAccessEnforcement();
+    void ConfigureContentHashing();
+    void ConfigureBaselineScan();
+    void LogAccessDecisionStats();
+    void LogProcessIdentityStats();
+    void LogContentHashStats();
+    void LogBaselineScanStats();
     
     // Component initialization
     bool InitializeComponents();
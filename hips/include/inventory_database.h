@@ -0,0 +1,114 @@
+/*
+ * File Inventory Database for HIPS
+ *
+ * Keeps the baseline inventory across restarts so changes made while the
+ * service was down can be reported. The file is a compacted region of
+ * records (path hash, size, mtime, attributes, content hashes and the
+ * path) followed by an open-addressing directory from path hash to record
+ * offset, and then a log of records appended since the last compaction;
+ * removals are appended as tombstones. Marker records at the start of the
+ * compacted region (or in the log) name the roots whose last baseline scan
+ * completed, and to what depth; only those are fit to diff against.
+ * Opening maps the file for random
+ * access and reads only the header and the log, which go into an
+ * in-memory table that takes precedence over the directory, so load time
+ * depends on the pages touched rather than the number of files. Lookups
+ * probe the mapped directory and read one record. Compact() rewrites the
+ * file without the log, through a temporary file and a rename. Values are
+ * in host byte order, as in state snapshots.
+ */
+
+#ifndef INVENTORY_DATABASE_H
+#define INVENTORY_DATABASE_H
+
+#include "baseline_scanner.h"
+#include "state_snapshot.h"
+#include <string>
+#include <unordered_map>
+#include <functional>
+#include <cstdint>
+
+namespace HIPS {
+
+constexpr uint32_t kInventoryVersion = 2;
+
+struct InventoryDatabaseStats {
+    size_t entries = 0;             // Live paths
+    size_t compacted_records = 0;   // Reachable through the mapped directory
+    size_t log_records = 0;         // Appended since the last compaction
+    size_t pending_records = 0;     // Not yet flushed
+    uint64_t file_bytes = 0;
+};
+
+class InventoryDatabase {
+public:
+    InventoryDatabase();
+    ~InventoryDatabase();
+
+    InventoryDatabase(const InventoryDatabase&) = delete;
+    InventoryDatabase& operator=(const InventoryDatabase&) = delete;
+
+    // Map the database at path; a missing file opens empty and is created
+    // by the first Flush(). False for a damaged file or another version.
+    bool Open(const std::string& path);
+    void Close();
+    bool IsOpen() const { return !path_.empty(); }
+
+    // Lookups may run concurrently with each other, not with updates
+    bool Lookup(const std::string& path, InventoryEntry& entry) const;
+    void ForEach(const std::function<void(const InventoryEntry& entry)>& callback) const;
+    size_t Size() const { return entries_; }
+
+    void Put(const InventoryEntry& entry);
+    void Remove(const std::string& path);
+
+    // Record that a baseline scan covered root to depth levels completely
+    void MarkRootComplete(const std::string& root, int depth);
+    // Whether a completed scan covered root at least to depth levels
+    bool IsRootComplete(const std::string& root, int depth) const;
+
+    // Append pending records to the log
+    bool Flush();
+    // Rewrite the file with every live entry in the compacted region
+    bool Compact();
+
+    InventoryDatabaseStats GetStats() const;
+
+    static uint64_t HashPath(const std::string& path);
+
+private:
+    struct LogEntry {
+        InventoryEntry entry;
+        bool removed;
+    };
+
+    std::string path_;
+    MappedFile mapping_;
+    // Parsed from the mapped header
+    uint64_t records_end_;
+    uint64_t directory_offset_;
+    uint64_t directory_slots_;
+    uint64_t log_offset_;
+    uint64_t valid_end_;            // End of the last complete log record
+    size_t compacted_records_;
+    size_t log_records_;
+
+    // Log records by path; the latest one wins over the directory
+    std::unordered_map<std::string, LogEntry> log_;
+    // Completed roots and their depth; the log's markers win
+    std::unordered_map<std::string, int> compacted_roots_;
+    std::unordered_map<std::string, int> log_roots_;
+    std::string pending_;           // Serialized records awaiting Flush()
+    size_t pending_records_;
+    size_t entries_;
+
+    bool MapFile();
+    bool ReadLog();
+    bool FindCompacted(const std::string& path, uint64_t hash, InventoryEntry* entry) const;
+    bool ReadRecord(uint64_t offset, InventoryEntry& entry, uint16_t& flags, uint64_t& next) const;
+    void Append(const InventoryEntry& entry, bool removed);
+};
+
+} // namespace HIPS
+
+#endif // INVENTORY_DATABASE_H
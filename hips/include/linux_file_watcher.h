@@ -0,0 +1,149 @@
+/*
+ * Linux File System Watcher for HIPS
+ *
+ * Native backend of FileSystemMonitor on Linux. Where the process may use
+ * fanotify, each watch root's filesystem is marked once and every create,
+ * delete, modify and rename on it is reported with the acting process id.
+ * Otherwise directory trees are watched with recursive inotify watches,
+ * which are added incrementally as directories are created or moved in.
+ * Either notification descriptor is drained through one epoll loop with a
+ * read buffer that grows under bursts. Changes are reported with the Windows FILE_ACTION_*
+ * codes so the monitor builds the same SecurityEvents on both platforms.
+ */
+
+#ifndef LINUX_FILE_WATCHER_H
+#define LINUX_FILE_WATCHER_H
+
+#include "hips_core.h"
+#include <string>
+#include <vector>
+#include <unordered_map>
+#include <functional>
+#include <atomic>
+
+namespace HIPS {
+
+class LinuxFileWatcher {
+public:
+    // A change under a watch root
+    struct Change {
+        std::string path;
+        DWORD action = 0;           // FILE_ACTION_*
+        DWORD process_id = 0;       // Acting process; 0 when not reported (inotify)
+    };
+    using ChangeCallback = std::function<void(const Change&)>;
+    // Notifications were lost; called on the Run() thread
+    using OverflowCallback = std::function<void()>;
+
+    enum class Backend {
+        NONE,
+        FANOTIFY,
+        INOTIFY
+    };
+
+    LinuxFileWatcher();
+    ~LinuxFileWatcher();
+
+    LinuxFileWatcher(const LinuxFileWatcher&) = delete;
+    LinuxFileWatcher& operator=(const LinuxFileWatcher&) = delete;
+
+    // Watch roots and their subdirectories up to max_depth levels below
+    // them. Missing roots are skipped; fails if no root can be watched.
+    bool Open(const std::vector<std::string>& roots, int max_depth, ChangeCallback callback);
+
+    // Dispatch changes on the calling thread until Stop()
+    void Run();
+
+    // Make Run() return; safe from any thread
+    void Stop();
+
+    void Close();
+
+    // Try fanotify before inotify (default: true); set before Open()
+    void SetFanotifyEnabled(bool enabled) { fanotify_enabled_ = enabled; }
+    void SetOverflowCallback(OverflowCallback callback) { overflow_callback_ = std::move(callback); }
+
+    // Canonical existing directories among roots, without duplicates
+    static std::vector<std::string> CanonicalRoots(const std::vector<std::string>& roots);
+
+    // Split canonical roots into at most shard_count groups for separate
+    // watchers. Roots on one filesystem stay together: a fanotify mark
+    // reports the whole filesystem, so splitting them would deliver each
+    // change to several watchers.
+    static std::vector<std::vector<std::string>> PartitionRoots(const std::vector<std::string>& roots,
+                                                                size_t shard_count);
+
+    // Whether a directory lies under one of the roots, at most max_depth
+    // levels below it
+    static bool IsUnderRoots(const std::vector<std::string>& roots, int max_depth,
+                             const std::string& directory);
+
+    // Status
+    Backend GetBackend() const { return backend_; }
+    size_t GetWatchCount() const { return watch_count_.load(); }
+    uint64_t GetOverflowCount() const { return overflow_count_.load(); }
+    uint64_t GetRescanCount() const { return rescan_count_.load(); }
+    uint64_t GetFailedWatchCount() const { return failed_watch_count_.load(); }
+    size_t GetBufferSize() const { return buffer_size_.load(); }
+
+private:
+    struct WatchedDirectory {
+        std::string path;
+        int depth;              // Levels below its root
+    };
+
+    // Filesystems marked for fanotify; handles are opened relative to mount_fd
+    struct MarkedFilesystem {
+        uint64_t fsid;
+        int mount_fd;
+    };
+
+    std::vector<std::string> roots_;
+    int max_depth_;
+    ChangeCallback callback_;
+    OverflowCallback overflow_callback_;
+    bool fanotify_enabled_;
+    Backend backend_;
+
+    int notify_fd_;
+    int epoll_fd_;
+    int stop_fd_;
+    std::vector<char> buffer_;      // Grows while reads come back more than half full
+
+    // inotify
+    std::unordered_map<int, WatchedDirectory> watches_;
+    std::unordered_map<std::string, int> watch_by_path_;
+
+    // fanotify
+    std::vector<MarkedFilesystem> filesystems_;
+
+    std::atomic<size_t> watch_count_;
+    std::atomic<uint64_t> overflow_count_;
+    std::atomic<uint64_t> rescan_count_;
+    std::atomic<uint64_t> failed_watch_count_;
+    std::atomic<size_t> buffer_size_;
+
+    bool OpenFanotify();
+    bool OpenInotify();
+
+    // Drain the notification descriptor
+    void ReadFanotifyEvents();
+    void ReadInotifyEvents();
+
+    // inotify watch set; report_entries emits FILE_ACTION_ADDED for what a
+    // new directory already holds, since it changed before it was watched
+    void AddWatchTree(const std::string& path, int depth, bool report_entries);
+    void RemoveWatchTree(const std::string& path);
+    void Rescan();
+    void HandleOverflow();
+    void GrowBuffer(size_t bytes_read);
+
+    // fanotify helpers
+    std::string ResolveDirectory(uint64_t fsid, void* handle) const;
+
+    void Emit(const std::string& path, DWORD action, DWORD process_id);
+};
+
+} // namespace HIPS
+
+#endif // LINUX_FILE_WATCHER_H
@@ -2,6 +2,8 @@
 #define NETWORK_MONITOR_H
 
 #include "hips_core.h"
+#include "clock.h"
+#include "process_identity_cache.h"
 #ifdef _WIN32
 #include <winsock2.h>
 #include <ws2tcpip.h>
@@ -41,6 +43,10 @@ public:
     bool Shutdown();
 
     void RegisterCallback(std::function<void(const SecurityEvent&)> callback);
+    // Clock for scan intervals; SystemClock by default
+    void SetClock(std::shared_ptr<Clock> clock);
+    // Source of process names for connections; the shared cache by default
+    void SetProcessIdentityCache(std::shared_ptr<ProcessIdentityCache> cache);
     
     bool IsRunning() const { return running_.load(); }
     bool IsInitialized() const { return initialized_.load(); }
@@ -50,6 +56,8 @@ private:
     std::atomic<bool> initialized_;
     std::thread monitor_thread_;
     std::function<void(const SecurityEvent&)> event_callback_;
+    std::shared_ptr<Clock> clock_;
+    std::shared_ptr<ProcessIdentityCache> identity_cache_;
     
     void MonitoringThreadFunction();
     void ScanNetworkConnections();
@@ -0,0 +1,58 @@
+/*
+ * Change Notification Decoding for HIPS
+ *
+ * Decodes the FILE_NOTIFY_INFORMATION records of a ReadDirectoryChangesW
+ * buffer into full paths without allocating per record. Each watch owns a
+ * decoder whose scratch buffer holds the watched directory followed by the
+ * current file name; names are transcoded from UTF-16 to UTF-8 in a single
+ * pass straight after the directory prefix, and the callback receives a
+ * view of the scratch buffer. The scratch buffer only grows, so once it
+ * fits the longest name seen, decoding allocates nothing; callers copy a
+ * path only for the events they keep.
+ */
+
+#ifndef NOTIFY_DECODER_H
+#define NOTIFY_DECODER_H
+
+#include "hips_core.h"
+#include <string>
+#include <string_view>
+#include <functional>
+#include <cstddef>
+#include <cstdint>
+
+namespace HIPS {
+
+// Upper bound of UTF-8 bytes per UTF-16 code unit
+constexpr size_t kUtf8BytesPerUtf16Unit = 3;
+
+// Transcode count UTF-16LE code units read from units (which need not be
+// aligned) into out, which must hold count * kUtf8BytesPerUtf16Unit bytes.
+// Unpaired surrogates become U+FFFD. Returns the bytes written.
+size_t TranscodeUtf16ToUtf8(const BYTE* units, size_t count, char* out);
+
+class NotifyBufferDecoder {
+public:
+    // path is valid until the callback returns
+    using RecordCallback = std::function<void(std::string_view path, DWORD action)>;
+
+    explicit NotifyBufferDecoder(const std::string& directory = std::string());
+
+    // Directory the names are relative to; joined with '\'
+    void SetDirectory(const std::string& directory);
+
+    // Decode the records in the first bytes of buffer, in order. Decoding
+    // stops at a record that does not fit in bytes. Returns the number of
+    // records passed to the callback.
+    size_t Decode(const BYTE* buffer, size_t bytes, const RecordCallback& callback);
+
+    size_t GetScratchCapacity() const { return scratch_.size(); }
+
+private:
+    std::string scratch_;       // Directory prefix, then the current name
+    size_t prefix_length_;
+};
+
+} // namespace HIPS
+
+#endif // NOTIFY_DECODER_H
@@ -0,0 +1,101 @@
+/*
+ * Path Classifier for HIPS
+ *
+ * Classifies file paths for the file system monitor in one pass without
+ * allocating: the extension class (executable, included, excluded), whether
+ * the path is a system file, and whether it lies in a critical directory.
+ * The classifier is compiled once from a configuration. Extensions of up
+ * to eight characters are packed into a 64-bit key and looked up in a
+ * perfect hash table; directory prefixes and system file names are walked
+ * in case-insensitive tries as the path is scanned. '\' and '/' are
+ * treated as the same separator.
+ */
+
+#ifndef PATH_CLASSIFIER_H
+#define PATH_CLASSIFIER_H
+
+#include <string>
+#include <vector>
+#include <cstddef>
+#include <cstdint>
+
+namespace HIPS {
+
+// Extension class bits
+enum ExtensionClass : uint8_t {
+    EXTENSION_EXECUTABLE = 1 << 0,
+    EXTENSION_INCLUDED = 1 << 1,
+    EXTENSION_EXCLUDED = 1 << 2
+};
+
+struct PathClassifierConfig {
+    // Extensions with or without the leading dot, any case
+    std::vector<std::string> executable_extensions;
+    std::vector<std::string> included_extensions;   // When set, only these are reported
+    std::vector<std::string> excluded_extensions;
+
+    // Path prefixes; files below system directories are system files
+    std::vector<std::string> system_directories;
+    std::vector<std::string> critical_directories;
+    std::vector<std::string> system_file_names;
+
+    static PathClassifierConfig Defaults();
+};
+
+struct PathClassification {
+    uint8_t extension_class = 0;            // ExtensionClass bits
+    bool system_file = false;
+    bool critical_directory = false;
+    size_t extension_offset = std::string::npos;    // Extension (with the dot) within the path
+    size_t extension_length = 0;
+};
+
+class PathClassifier {
+public:
+    explicit PathClassifier(const PathClassifierConfig& config = PathClassifierConfig::Defaults());
+
+    PathClassification Classify(const char* path, size_t length) const;
+    PathClassification Classify(const std::string& path) const { return Classify(path.data(), path.size()); }
+
+    // Whether events for the path are reported under the extension filters
+    bool IsReported(const PathClassification& classification) const;
+
+private:
+    // Extensions of at most eight characters, lowercased, packed
+    // little-endian; longer ones never match
+    struct ExtensionSlot {
+        uint64_t key;
+        uint8_t flags;
+    };
+
+    // First-child / next-sibling trie over case-folded characters
+    struct TrieNode {
+        uint32_t first_child;
+        uint32_t next_sibling;
+        char label;
+        uint8_t flags;
+    };
+
+    // Trie node flags
+    static constexpr uint8_t kCriticalDirectory = 1 << 0;
+    static constexpr uint8_t kSystemDirectory = 1 << 1;
+    static constexpr uint8_t kSystemFileName = 1 << 2;
+
+    std::vector<ExtensionSlot> extension_slots_;
+    uint64_t extension_multiplier_;
+    unsigned extension_shift_;
+    bool has_included_;
+
+    std::vector<TrieNode> prefix_trie_;     // Node 0 is the root
+    std::vector<TrieNode> name_trie_;
+
+    void BuildExtensionTable(const PathClassifierConfig& config);
+    uint8_t LookupExtension(uint64_t key) const;
+
+    static void InsertTrie(std::vector<TrieNode>& trie, const std::string& key, uint8_t flags);
+    static uint32_t FindChild(const std::vector<TrieNode>& trie, uint32_t node, char label);
+};
+
+} // namespace HIPS
+
+#endif // PATH_CLASSIFIER_H
@@ -0,0 +1,120 @@
+/*
+ * Process Identity Cache for HIPS
+ *
+ * Image paths of processes, shared by the monitors so that events do not
+ * open the process and query its image every time. Entries carry the
+ * process start time: ProcessMonitor inserts confirmed entries from its
+ * creation scans and invalidates them on termination, and an exact lookup
+ * by (pid, start time) never returns a previous process that had the same
+ * pid. Lookups take a shared lock on one shard of the table and make no
+ * system calls. Misses are resolved from the OS once; such entries expire
+ * after a few seconds unless ProcessMonitor confirms them, which bounds
+ * how long a reused pid can be misattributed when ProcessMonitor is not
+ * running.
+ */
+
+#ifndef PROCESS_IDENTITY_CACHE_H
+#define PROCESS_IDENTITY_CACHE_H
+
+#include "hips_core.h"
+#include <string>
+#include <vector>
+#include <unordered_map>
+#include <memory>
+#include <functional>
+#include <shared_mutex>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+
+namespace HIPS {
+
+struct ProcessIdentity {
+    uint64_t start_time = 0;    // OS-specific; only compared for equality
+    std::string path;
+};
+
+struct ProcessIdentityStats {
+    uint64_t hits = 0;
+    uint64_t misses = 0;
+    uint64_t stale = 0;             // Expired, or another process under the pid
+    uint64_t resolutions = 0;       // Identities queried from the OS
+    uint64_t invalidations = 0;
+    size_t entries = 0;
+
+    double HitRate() const {
+        uint64_t lookups = hits + misses;
+        return lookups ? static_cast<double>(hits) / lookups : 0.0;
+    }
+};
+
+class ProcessIdentityCache {
+public:
+    // Query a live process; false when it cannot be inspected
+    using Resolver = std::function<bool(DWORD pid, ProcessIdentity& identity)>;
+
+    ProcessIdentityCache();
+
+    ProcessIdentityCache(const ProcessIdentityCache&) = delete;
+    ProcessIdentityCache& operator=(const ProcessIdentityCache&) = delete;
+
+    // Confirmed identity of a running process (ProcessMonitor)
+    void Insert(DWORD pid, const ProcessIdentity& identity);
+    // Drop the entry for pid; start_time 0 matches any process
+    void Invalidate(DWORD pid, uint64_t start_time = 0);
+
+    // Cached path of pid, without system calls; false on a miss
+    bool Lookup(DWORD pid, std::string& path);
+    // As above, but only for the process that started at start_time
+    bool Lookup(DWORD pid, uint64_t start_time, std::string& path);
+
+    // Query the OS and cache the answer as confirmed
+    bool Refresh(DWORD pid, ProcessIdentity& identity);
+
+    // Cached path, resolving a miss from the OS; "Unknown" if the process
+    // cannot be inspected
+    std::string Resolve(DWORD pid);
+
+    // Replace the OS query (tests); nullptr restores QueryProcess
+    void SetResolver(Resolver resolver);
+    void Clear();
+
+    ProcessIdentityStats GetStats() const;
+
+    // Image path and start time from the OS
+    static bool QueryProcess(DWORD pid, ProcessIdentity& identity);
+
+    // Process-wide cache used by the monitors unless one is injected
+    static std::shared_ptr<ProcessIdentityCache> Shared();
+
+private:
+    struct Entry {
+        ProcessIdentity identity;
+        // Resolved entries expire; confirmed ones stay until invalidated
+        std::chrono::steady_clock::time_point expires;
+        bool confirmed;
+    };
+
+    struct Shard {
+        mutable std::shared_mutex mutex;
+        std::unordered_map<DWORD, Entry> entries;
+    };
+
+    std::vector<Shard> shards_;
+    Resolver resolver_;
+    mutable std::shared_mutex resolver_mutex_;
+
+    std::atomic<uint64_t> hits_;
+    std::atomic<uint64_t> misses_;
+    std::atomic<uint64_t> stale_;
+    std::atomic<uint64_t> resolutions_;
+    std::atomic<uint64_t> invalidations_;
+
+    Shard& ShardFor(DWORD pid) { return shards_[pid % shards_.size()]; }
+    void Store(DWORD pid, const ProcessIdentity& identity, bool confirmed);
+    bool Query(DWORD pid, ProcessIdentity& identity);
+};
+
+} // namespace HIPS
+
+#endif // PROCESS_IDENTITY_CACHE_H
@@ -0,0 +1,83 @@
+/*
+ * Process Lineage Table for HIPS
+ *
+ * Incrementally maintained parent/child table built from process creation
+ * events. Ancestor lookups walk parent links and cost O(depth). Exited
+ * processes are kept for a bounded time so late events from a child can
+ * still be attributed to its ancestors.
+ */
+
+#ifndef PROCESS_LINEAGE_H
+#define PROCESS_LINEAGE_H
+
+#include "hips_core.h"
+#include "state_snapshot.h"
+#include <vector>
+#include <deque>
+#include <unordered_map>
+#include <chrono>
+
+namespace HIPS {
+
+// Not thread-safe; callers serialize access.
+class ProcessLineageTable {
+public:
+    using TimePoint = std::chrono::system_clock::time_point;
+
+    ProcessLineageTable();
+    ~ProcessLineageTable();
+
+    // max_exited_processes bounds the exited-process history; max_depth
+    // bounds ancestor walks (and breaks cycles caused by pid reuse)
+    void Configure(size_t max_exited_processes, size_t max_depth);
+
+    // Record a new process. A reused pid replaces the earlier entry. An
+    // unknown parent is added as a root so its own events can be grouped
+    // with its children's.
+    void RecordProcessStart(DWORD pid, DWORD parent_pid, TimePoint now);
+
+    // Mark a process exited; appends pids dropped from the history to evicted
+    void RecordProcessExit(DWORD pid, TimePoint now, std::vector<DWORD>& evicted);
+
+    // Ancestors of pid, nearest first, up to max_depth
+    void GetAncestors(DWORD pid, std::vector<DWORD>& ancestors) const;
+    bool IsAncestor(DWORD ancestor, DWORD pid) const;
+    DWORD GetParent(DWORD pid) const;
+    bool Contains(DWORD pid) const;
+
+    void Clear();
+
+    // Checkpoint the table; Load replaces the current contents and leaves
+    // the table empty if the data is malformed
+    void Save(SnapshotWriter& writer) const;
+    bool Load(SnapshotReader& reader);
+
+    // Statistics
+    size_t GetProcessCount() const { return entries_.size(); }
+    size_t GetExitedProcessCount() const { return exited_order_.size(); }
+
+    // Parses the "parent_pid" metadata emitted by ProcessMonitor (0 if absent)
+    static DWORD ParentPidFromEvent(const SecurityEvent& event);
+
+private:
+    struct Entry {
+        DWORD parent_pid;
+        TimePoint start_time;
+        uint64_t generation;
+        bool exited;
+    };
+
+    std::unordered_map<DWORD, Entry> entries_;
+    std::deque<std::pair<DWORD, uint64_t>> exited_order_;  // (pid, generation), oldest first
+    uint64_t next_generation_;
+    size_t max_exited_processes_;
+    size_t max_depth_;
+
+    // Follows the parent link, rejecting parents whose pid was reused by a
+    // process started after the child
+    const Entry* ParentOf(const Entry& entry) const;
+};
+
+} // namespace HIPS
+
+#endif // PROCESS_LINEAGE_H
@@ -2,12 +2,17 @@
 #define PROCESS_MONITOR_H
 
 #include "hips_core.h"
+#include "clock.h"
+#include "process_identity_cache.h"
+#include "content_hasher.h"
 #include <string>
 #include <thread>
 #include <atomic>
 #include <functional>
 #include <unordered_map>
 #include <vector>
+#include <mutex>
+#include <condition_variable>
 
 namespace HIPS {
 
@@ -18,6 +23,7 @@ struct ProcessInfo {
     std::string command_line;
     DWORD parent_pid;
     SYSTEMTIME creation_time;
+    uint64_t start_time;        // ProcessIdentity start time; tells reused pids apart
     DWORD thread_count;
     SIZE_T memory_usage;
     bool is_system_process;
@@ -39,6 +45,14 @@ public:
     void AddSuspiciousProcess(const std::string& process_name);
     void RemoveSuspiciousProcess(const std::string& process_name);
     void SetMemoryThreshold(SIZE_T threshold);
+    // Clock for scan intervals; SystemClock by default
+    void SetClock(std::shared_ptr<Clock> clock);
+    // Cache fed with created and terminated processes; the shared one by default
+    void SetProcessIdentityCache(std::shared_ptr<ProcessIdentityCache> cache);
+    // Creation events are delivered once the image hashes are attached
+    // ("sha256", "xxh64"); off by default
+    void SetContentHashing(bool enable) { content_hashing_ = enable; }
+    void SetContentHasher(std::shared_ptr<ContentHasher> hasher);
 
     // Callback registration
     void RegisterCallback(std::function<void(const SecurityEvent&)> callback);
@@ -61,6 +75,14 @@ private:
     std::atomic<bool> initialized_;
     std::thread monitor_thread_;
     std::function<void(const SecurityEvent&)> event_callback_;
+    std::shared_ptr<Clock> clock_;
+    std::shared_ptr<ProcessIdentityCache> identity_cache_;
+    std::shared_ptr<ContentHasher> content_hasher_;
+    std::atomic<bool> content_hashing_;
+    // Hash requests whose events are not delivered yet; Stop() waits
+    size_t hashes_in_flight_;
+    std::mutex hash_mutex_;
+    std::condition_variable hash_cv_;
     
     // Configuration
     DWORD scan_interval_;
@@ -85,6 +107,8 @@ private:
     
     // Event creation
     SecurityEvent CreateProcessEvent(const ProcessInfo& process, EventType type);
+    void DispatchCreationEvent(SecurityEvent event);
+    void FinishHashRequest();
     
     // Helper methods
     std::string GetProcessName(DWORD pid);
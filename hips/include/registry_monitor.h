@@ -2,6 +2,7 @@
 #define REGISTRY_MONITOR_H
 
 #include "hips_core.h"
+#include "clock.h"
 #include <string>
 #include <thread>
 #include <atomic>
@@ -21,6 +22,8 @@ public:
     bool Shutdown();
 
     void RegisterCallback(std::function<void(const SecurityEvent&)> callback);
+    // Clock for scan intervals; SystemClock by default
+    void SetClock(std::shared_ptr<Clock> clock);
     
     bool IsRunning() const { return running_.load(); }
     bool IsInitialized() const { return initialized_.load(); }
@@ -30,6 +33,7 @@ private:
     std::atomic<bool> initialized_;
     std::thread monitor_thread_;
     std::function<void(const SecurityEvent&)> event_callback_;
+    std::shared_ptr<Clock> clock_;
     
     std::vector<HKEY> monitored_keys_;
     
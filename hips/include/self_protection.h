@@ -163,6 +163,8 @@ public:
     bool CheckThreadIntegrity();
     bool CheckHandleIntegrity();
     bool CheckCriticalSectionIntegrity();
+    // Whether the file's SHA-256 digest is expected_hash (hex, either case)
+    bool VerifyFileHash(const std::string& file_path, const std::string& expected_hash);
 
     // BSOD-proof enhanced protection
     bool SafeTerminateProcess(DWORD pid);
@@ -219,7 +221,6 @@ private:
     
     // Integrity verification
     bool VerifyCodeSignature(const std::string& file_path);
-    bool VerifyFileHash(const std::string& file_path, const std::string& expected_hash);
     
     // BSOD-proof API wrappers
     template<typename T>
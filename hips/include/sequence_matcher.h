@@ -0,0 +1,183 @@
+/*
+ * Sequence Matcher for HIPS
+ *
+ * Compiles declarative attack patterns (ordered steps with per-step
+ * predicates) into a small NFA and advances per-process partial matches
+ * as events arrive. Each event only touches the partial matches that are
+ * waiting on its process, so adding patterns does not multiply the
+ * per-event cost.
+ */
+
+#ifndef SEQUENCE_MATCHER_H
+#define SEQUENCE_MATCHER_H
+
+#include "hips_core.h"
+#include "event_refs.h"
+#include <string>
+#include <vector>
+#include <unordered_map>
+#include <functional>
+#include <chrono>
+
+namespace HIPS {
+
+// Number of values in EventType, used to size per-type lookup tables
+constexpr size_t kEventTypeCount = static_cast<size_t>(EventType::EXPLOIT_ATTEMPT) + 1;
+
+// Which processes may contribute the steps of a single pattern match
+enum class PatternScope {
+    ANY_PROCESS,    // Steps may come from any process
+    SAME_PROCESS,   // All steps from the process that matched the first step
+    SAME_LINEAGE    // Steps from the first process or any of its descendants
+};
+
+// A single step of an attack pattern
+struct AttackPatternStep {
+    // Event types accepted by this step (any of)
+    std::vector<EventType> event_types;
+
+    // Minimum threat level of the event
+    ThreatLevel min_threat_level = ThreatLevel::LOW;
+
+    // Case-insensitive substring of the event target path (empty = any)
+    std::string target_pattern;
+
+    // Maximum time since the previous step (0 = pattern duration)
+    int max_gap_seconds = 0;
+
+    // Optional additional predicate
+    std::function<bool(const SecurityEvent&)> custom_condition;
+};
+
+// Declarative attack chain definition
+struct AttackPattern {
+    std::string name;
+    std::string description;
+    std::vector<AttackPatternStep> steps;
+    PatternScope scope = PatternScope::SAME_LINEAGE;
+
+    // Maximum time between first and last step (0 = correlation time window)
+    int max_duration_seconds = 0;
+
+    ThreatLevel threat_level = ThreatLevel::CRITICAL;
+    double score = 0.9;
+    bool enabled = true;
+};
+
+// A completed pattern match
+struct SequenceMatch {
+    std::string pattern_name;
+    std::string description;
+    PatternScope scope;
+    ThreatLevel threat_level;
+    double score;
+    DWORD root_process_id;
+    EventRefs events;
+};
+
+// Built-in attack chains used when no patterns are configured
+std::vector<AttackPattern> DefaultAttackPatterns();
+
+std::string PatternScopeToString(PatternScope scope);
+
+// Not thread-safe; callers serialize access.
+class SequenceMatcher {
+public:
+    using TimePoint = std::chrono::system_clock::time_point;
+
+    SequenceMatcher();
+    ~SequenceMatcher();
+
+    // Compile patterns, discarding all partial matches
+    void Compile(const std::vector<AttackPattern>& patterns,
+                 int default_window_seconds,
+                 size_t max_partial_matches);
+
+    // Advance partial matches with the event and append any completed
+    // matches; completed matches share the event rather than copy it
+    void ProcessEvent(const EventRef& event, TimePoint now,
+                      std::vector<SequenceMatch>& completed);
+    void ProcessEvent(const SecurityEvent& event, TimePoint now,
+                      std::vector<SequenceMatch>& completed);
+
+    // Drop partial matches whose gap or duration limit has passed
+    void ExpireMatches(TimePoint now);
+
+    void Clear();
+
+    // Statistics
+    size_t GetPatternCount() const { return patterns_.size(); }
+    size_t GetActiveMatchCount() const { return active_count_; }
+    uint64_t GetDroppedMatchCount() const { return dropped_count_; }
+
+private:
+    struct CompiledStep {
+        uint32_t type_mask;
+        ThreatLevel min_threat_level;
+        std::string target_pattern;     // Upper-cased
+        std::chrono::seconds max_gap;
+        std::function<bool(const SecurityEvent&)> custom_condition;
+
+        bool Accepts(const SecurityEvent& event) const;
+    };
+
+    struct CompiledPattern {
+        std::string name;
+        std::string description;
+        PatternScope scope;
+        std::chrono::seconds max_duration;
+        ThreatLevel threat_level;
+        double score;
+        std::vector<CompiledStep> steps;
+    };
+
+    struct PartialMatch {
+        uint32_t pattern;
+        uint32_t next_step;
+        uint32_t generation;
+        bool alive;
+        DWORD partition;                // Root pid, or 0 for ANY_PROCESS
+        TimePoint start_time;
+        TimePoint last_time;
+        EventRefs events;
+        std::vector<DWORD> lineage;     // Pids adopted into a SAME_LINEAGE match
+    };
+
+    // Generation-checked reference so index entries can be dropped lazily
+    struct SlotRef {
+        uint32_t slot;
+        uint32_t generation;
+    };
+
+    std::vector<CompiledPattern> patterns_;
+    std::vector<std::vector<uint32_t>> start_index_;    // EventType -> patterns starting with it
+
+    std::vector<PartialMatch> slots_;
+    std::vector<uint32_t> free_slots_;
+    std::unordered_map<DWORD, std::vector<SlotRef>> pid_index_;
+    std::vector<SlotRef> global_index_;
+    std::unordered_map<uint64_t, uint32_t> state_index_; // (pattern, step, partition) -> slot
+
+    std::vector<uint32_t> scratch_;
+    size_t max_partial_matches_;
+    size_t active_count_;
+    uint64_t dropped_count_;
+
+    void CollectCandidates(std::vector<SlotRef>& refs);
+    void AdoptChildProcess(DWORD parent_pid, DWORD child_pid, TimePoint now);
+    void StartMatch(uint32_t pattern, const EventRef& event, TimePoint now);
+    void AdvanceMatch(uint32_t slot, const EventRef& event, TimePoint now,
+                      std::vector<SequenceMatch>& completed);
+    void EmitMatch(const CompiledPattern& pattern, DWORD root_pid,
+                   EventRefs&& events,
+                   std::vector<SequenceMatch>& completed);
+    void ReleaseSlot(uint32_t slot);
+    uint32_t AllocateSlot();
+    bool IsExpired(const PartialMatch& match, TimePoint now) const;
+    bool IsLive(const SlotRef& ref) const;
+    static uint64_t StateKey(uint32_t pattern, uint32_t step, DWORD partition);
+};
+
+} // namespace HIPS
+
+#endif // SEQUENCE_MATCHER_H
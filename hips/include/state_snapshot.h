@@ -0,0 +1,178 @@
+/*
+ * State Snapshots for HIPS
+ *
+ * Compact, versioned binary format used to checkpoint engine state so a
+ * restart resumes with warm correlation windows, statistics and alerts.
+ * A snapshot is a header (magic, format version) followed by tagged,
+ * length-prefixed sections; readers skip sections they do not know and
+ * reject files from another format version. Values are fixed-width in host
+ * byte order (the version word doubles as a byte-order check) and strings
+ * are length-prefixed. Files are written under a temporary name and
+ * renamed into place, and are loaded through a read-only memory mapping.
+ */
+
+#ifndef STATE_SNAPSHOT_H
+#define STATE_SNAPSHOT_H
+
+#include "hips_core.h"
+#include "event_refs.h"
+#include <string>
+#include <vector>
+#include <unordered_map>
+#include <mutex>
+#include <cstdint>
+#include <chrono>
+
+namespace HIPS {
+
+constexpr uint32_t kSnapshotVersion = 1;
+
+enum class SnapshotSection : uint32_t {
+    ENGINE_STATISTICS = 1,
+    ALERTS = 2,
+    CORRELATION_STATE = 3
+};
+
+class SnapshotWriter {
+public:
+    using TimePoint = std::chrono::system_clock::time_point;
+
+    // Starts the buffer with the snapshot header; pass false to build a
+    // headerless fragment that is later appended with WriteRaw()
+    explicit SnapshotWriter(bool with_header = true);
+
+    // Sections do not nest
+    void BeginSection(SnapshotSection section);
+    void EndSection();
+
+    void WriteU8(uint8_t value);
+    void WriteU16(uint16_t value);
+    void WriteU32(uint32_t value);
+    void WriteU64(uint64_t value);
+    void WriteDouble(double value);
+    void WriteString(const std::string& value);
+    void WriteTimePoint(const TimePoint& value);
+    void WriteSystemTime(const SYSTEMTIME& value);
+    void WriteEvent(const SecurityEvent& event);
+    void WriteRaw(const std::string& bytes);
+    void WriteRaw(const char* data, size_t size);
+
+    const std::string& Data() const { return buffer_; }
+    size_t Size() const { return buffer_.size(); }
+
+    // Write to path via a temporary file and rename
+    bool WriteToFile(const std::string& path) const;
+
+private:
+    std::string buffer_;
+    size_t section_start_;
+
+    void Append(const void* data, size_t size);
+};
+
+// Bounds-checked reader over a snapshot or one of its sections. The first
+// failed read marks the reader failed and every later read returns false.
+class SnapshotReader {
+public:
+    using TimePoint = std::chrono::system_clock::time_point;
+
+    SnapshotReader();
+    SnapshotReader(const char* data, size_t size);
+
+    // Validate the header of a whole snapshot
+    bool ValidateHeader() const;
+
+    // Locate a section of a whole snapshot; body reads only that section
+    bool FindSection(SnapshotSection section, SnapshotReader& body) const;
+
+    bool ReadU8(uint8_t& value);
+    bool ReadU16(uint16_t& value);
+    bool ReadU32(uint32_t& value);
+    bool ReadU64(uint64_t& value);
+    bool ReadDouble(double& value);
+    bool ReadString(std::string& value);
+    bool ReadTimePoint(TimePoint& value);
+    bool ReadSystemTime(SYSTEMTIME& value);
+    bool ReadEvent(SecurityEvent& event);
+    // Validate an event as ReadEvent() would, keeping only its threat level
+    // and process id
+    bool SkipEvent(ThreatLevel& threat_level, DWORD& process_id);
+
+    // Reject counts that cannot fit in the remaining bytes
+    bool ReadCount(uint32_t& count, size_t min_element_size);
+
+    bool Failed() const { return failed_; }
+    bool AtEnd() const { return offset_ == size_; }
+    const char* Position() const { return data_ + offset_; }
+
+private:
+    const char* data_;
+    size_t size_;
+    size_t offset_;
+    bool failed_;
+
+    bool Take(void* out, size_t size);
+    bool SkipString();
+};
+
+// A table of events kept in their snapshot encoding and decoded on first
+// use, so a restore only pays for the events that are read again. Each
+// event decodes once; later calls share the same reference.
+class ArchivedEvents {
+public:
+    // Validate count events from reader and copy their encoding
+    bool Load(SnapshotReader& reader, uint32_t count);
+
+    size_t Size() const { return process_ids_.size(); }
+    ThreatLevel GetThreatLevel(uint32_t index) const { return threat_levels_[index]; }
+    DWORD GetProcessId(uint32_t index) const { return process_ids_[index]; }
+    size_t GetEncodedSize(uint32_t index) const { return offsets_[index + 1] - offsets_[index]; }
+    // Mean encoded size, for memory estimates that must not touch the table
+    size_t GetAverageEncodedSize() const { return Size() > 0 ? data_.size() / Size() : 0; }
+
+    // Safe to call from any thread
+    EventRef Get(uint32_t index) const;
+    // Append the encoding unchanged
+    void WriteEvent(uint32_t index, SnapshotWriter& writer) const;
+
+private:
+    std::string data_;
+    std::vector<size_t> offsets_;   // One past the last event as well
+    std::vector<ThreatLevel> threat_levels_;
+    std::vector<DWORD> process_ids_;
+
+    mutable std::mutex mutex_;
+    mutable std::unordered_map<uint32_t, EventRef> decoded_;
+};
+
+// Read-only memory mapping of a whole file
+class MappedFile {
+public:
+    MappedFile();
+    ~MappedFile();
+
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+
+    // sequential hints read-ahead for one front-to-back pass; pass false
+    // for lookups that jump around the file
+    bool Open(const std::string& path, bool sequential = true);
+    void Close();
+
+    const char* Data() const { return data_; }
+    size_t Size() const { return size_; }
+
+private:
+    const char* data_;
+    size_t size_;
+#ifdef _WIN32
+    HANDLE file_;
+    HANDLE mapping_;
+#else
+    int fd_;
+#endif
+};
+
+} // namespace HIPS
+
+#endif // STATE_SNAPSHOT_H
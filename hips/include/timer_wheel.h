@@ -0,0 +1,170 @@
+/*
+ * Hierarchical Timer Wheel for HIPS
+ *
+ * Schedules intrusive timer nodes on a four-level wheel of 64 slots per
+ * level. Scheduling and cancelling are O(1); advancing the wheel costs
+ * O(1) per elapsed tick plus the number of expired or cascaded timers.
+ * Used to expire idle tracking state without scanning every key.
+ */
+
+#ifndef TIMER_WHEEL_H
+#define TIMER_WHEEL_H
+
+#include <cstddef>
+#include <cstdint>
+
+namespace HIPS {
+
+template <typename T>
+class TimerWheel {
+public:
+    // Embedded in the owning object; must not move while scheduled
+    struct Node {
+        Node* prev = nullptr;
+        Node* next = nullptr;
+        uint64_t expiry_tick = 0;
+        T* owner = nullptr;
+
+        bool IsScheduled() const { return prev != nullptr; }
+    };
+
+    static constexpr unsigned kSlotBits = 6;
+    static constexpr size_t kSlotsPerLevel = size_t(1) << kSlotBits;
+    static constexpr size_t kLevels = 4;
+
+    TimerWheel() : current_tick_(0), size_(0) {
+        for (auto& level : slots_) {
+            for (auto& slot : level) {
+                slot.prev = &slot;
+                slot.next = &slot;
+            }
+        }
+    }
+
+    TimerWheel(const TimerWheel&) = delete;
+    TimerWheel& operator=(const TimerWheel&) = delete;
+
+    // Schedule (or reschedule) node to fire once the wheel reaches
+    // expiry_tick. Ticks are absolute, so Advance() the wheel to the current
+    // tick before scheduling the first timer.
+    void Schedule(Node& node, uint64_t expiry_tick) {
+        if (node.IsScheduled()) {
+            Unlink(node);
+        }
+        node.expiry_tick = expiry_tick;
+        Link(node);
+        size_++;
+    }
+
+    void Cancel(Node& node) {
+        if (node.IsScheduled()) {
+            Unlink(node);
+        }
+    }
+
+    // Advance to now_tick, invoking on_expired(T&) for every timer that is
+    // due. The node is unscheduled before the call, so the callback may
+    // reschedule it or destroy its owner.
+    template <typename Callback>
+    void Advance(uint64_t now_tick, Callback&& on_expired) {
+        if (size_ == 0 || now_tick < current_tick_) {
+            if (now_tick > current_tick_) {
+                current_tick_ = now_tick;
+            }
+            return;
+        }
+
+        while (current_tick_ < now_tick && size_ > 0) {
+            current_tick_++;
+
+            // Pull timers from coarser levels down as their range begins
+            for (size_t level = 1; level < kLevels; ++level) {
+                if ((current_tick_ & LevelMask(level - 1)) != 0) {
+                    break;
+                }
+                Cascade(level, SlotIndex(current_tick_, level));
+            }
+
+            Node& slot = slots_[0][SlotIndex(current_tick_, 0)];
+            while (slot.next != &slot) {
+                Node& node = *slot.next;
+                Unlink(node);
+                on_expired(*node.owner);
+            }
+        }
+
+        if (current_tick_ < now_tick) {
+            current_tick_ = now_tick;
+        }
+    }
+
+    void Clear() {
+        for (auto& level : slots_) {
+            for (auto& slot : level) {
+                while (slot.next != &slot) {
+                    Unlink(*slot.next);
+                }
+            }
+        }
+    }
+
+    uint64_t GetCurrentTick() const { return current_tick_; }
+    size_t Size() const { return size_; }
+
+private:
+    Node slots_[kLevels][kSlotsPerLevel];
+    uint64_t current_tick_;
+    size_t size_;
+
+    static uint64_t LevelMask(size_t level) {
+        return (uint64_t(1) << (kSlotBits * (level + 1))) - 1;
+    }
+
+    static size_t SlotIndex(uint64_t tick, size_t level) {
+        return static_cast<size_t>((tick >> (kSlotBits * level)) & (kSlotsPerLevel - 1));
+    }
+
+    void Link(Node& node) {
+        // Already-due timers fire on the next tick
+        uint64_t expiry = node.expiry_tick > current_tick_ ? node.expiry_tick : current_tick_ + 1;
+        uint64_t delta = expiry - current_tick_;
+
+        size_t level = 0;
+        while (level + 1 < kLevels && delta > LevelMask(level)) {
+            level++;
+        }
+
+        // Clamp timers beyond the wheel's range to its last slot
+        if (delta > LevelMask(kLevels - 1)) {
+            expiry = current_tick_ + LevelMask(kLevels - 1);
+        }
+
+        Node& slot = slots_[level][SlotIndex(expiry, level)];
+        node.prev = slot.prev;
+        node.next = &slot;
+        slot.prev->next = &node;
+        slot.prev = &node;
+    }
+
+    void Unlink(Node& node) {
+        node.prev->next = node.next;
+        node.next->prev = node.prev;
+        node.prev = nullptr;
+        node.next = nullptr;
+        size_--;
+    }
+
+    void Cascade(size_t level, size_t index) {
+        Node& slot = slots_[level][index];
+        while (slot.next != &slot) {
+            Node& node = *slot.next;
+            Unlink(node);
+            size_++;
+            Link(node);
+        }
+    }
+};
+
+} // namespace HIPS
+
+#endif // TIMER_WHEEL_H
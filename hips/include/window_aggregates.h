@@ -0,0 +1,84 @@
+/*
+ * Multi-Resolution Window Aggregates for HIPS
+ *
+ * Threat-level counts over long sliding windows in constant space. Recent
+ * events are counted in fine one-second buckets; as fine buckets age out
+ * of their ring they are rolled up into one-minute coarse buckets. A key
+ * covers about an hour in a few kilobytes instead of retaining every raw
+ * event. Counts are exact to bucket granularity: a bucket straddling the
+ * start of a window counts in full.
+ */
+
+#ifndef WINDOW_AGGREGATES_H
+#define WINDOW_AGGREGATES_H
+
+#include "hips_core.h"
+#include <array>
+#include <chrono>
+#include <cstdint>
+
+namespace HIPS {
+
+// Events per threat level in a candidate group. Correlation scores and
+// combined threat levels depend only on these counts.
+struct ThreatCounts {
+    std::array<uint32_t, 4> levels{};
+    uint32_t total = 0;
+
+    void Add(ThreatLevel level) {
+        levels[static_cast<size_t>(level)]++;
+        total++;
+    }
+    void Remove(ThreatLevel level) {
+        levels[static_cast<size_t>(level)]--;
+        total--;
+    }
+    void Merge(const ThreatCounts& other) {
+        for (size_t i = 0; i < levels.size(); ++i) {
+            levels[i] += other.levels[i];
+        }
+        total += other.total;
+    }
+    uint32_t Count(ThreatLevel level) const { return levels[static_cast<size_t>(level)]; }
+    uint32_t HighThreat() const { return Count(ThreatLevel::HIGH) + Count(ThreatLevel::CRITICAL); }
+};
+
+class MultiResolutionWindow {
+public:
+    using time_point = std::chrono::system_clock::time_point;
+
+    static constexpr size_t kFineBuckets = 64;
+    static constexpr int64_t kFineBucketMs = 1000;
+    static constexpr size_t kCoarseBuckets = 64;
+    static constexpr int64_t kCoarseBucketMs = 60 * 1000;
+
+    // Longest window that can be answered
+    static constexpr int64_t kHorizonMs = kCoarseBucketMs * static_cast<int64_t>(kCoarseBuckets);
+
+    // Count an event. Events may arrive out of order; events older than
+    // the horizon are ignored.
+    void Add(const time_point& time, ThreatLevel level);
+
+    // Events in [now - window, now], up to bucket granularity
+    ThreatCounts Count(const time_point& now, std::chrono::milliseconds window) const;
+
+    void Clear();
+
+    static constexpr size_t MemoryBytes() { return sizeof(MultiResolutionWindow); }
+
+private:
+    struct Bucket {
+        int64_t index = INT64_MIN;      // Bucket number since the epoch
+        ThreatCounts counts;
+    };
+
+    std::array<Bucket, kFineBuckets> fine_;
+    std::array<Bucket, kCoarseBuckets> coarse_;
+    int64_t newest_fine_ = INT64_MIN;
+
+    void AddCoarse(int64_t index, const ThreatCounts& counts);
+};
+
+} // namespace HIPS
+
+#endif // WINDOW_AGGREGATES_H
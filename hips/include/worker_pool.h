@@ -0,0 +1,58 @@
+/*
+ * Worker Pool for HIPS
+ *
+ * A fixed set of threads running queued tasks, shared by components that
+ * fan work out in parallel (correlation detection, scans) so they do not
+ * each start their own threads. RunAll() runs a batch of tasks and waits
+ * for them; the calling thread claims tasks too, so a batch always makes
+ * progress even when every worker is busy or RunAll() is called from a
+ * worker.
+ */
+
+#ifndef WORKER_POOL_H
+#define WORKER_POOL_H
+
+#include <cstddef>
+#include <vector>
+#include <deque>
+#include <memory>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <functional>
+
+namespace HIPS {
+
+class WorkerPool {
+public:
+    // thread_count 0 uses one thread per hardware thread
+    explicit WorkerPool(size_t thread_count = 0);
+    ~WorkerPool();
+
+    WorkerPool(const WorkerPool&) = delete;
+    WorkerPool& operator=(const WorkerPool&) = delete;
+
+    size_t GetThreadCount() const { return threads_.size(); }
+
+    // Queue a task to run on a worker
+    void Submit(std::function<void()> task);
+
+    // Run tasks concurrently and return once all of them have finished
+    void RunAll(const std::vector<std::function<void()>>& tasks);
+
+    // Process-wide pool sized to the hardware, created on first use
+    static std::shared_ptr<WorkerPool> Shared();
+
+private:
+    std::vector<std::thread> threads_;
+    std::deque<std::function<void()>> queue_;
+    std::mutex mutex_;
+    std::condition_variable queue_cv_;
+    bool stopping_;
+
+    void WorkerThreadFunction();
+};
+
+} // namespace HIPS
+
+#endif // WORKER_POOL_H
@@ -55,6 +55,45 @@ void AlertManager::ClearAlerts() {
     alerts_.clear();
 }
 
+void AlertManager::SaveState(SnapshotWriter& writer) {
+    std::lock_guard<std::mutex> lock(alerts_mutex_);
+    
+    writer.BeginSection(SnapshotSection::ALERTS);
+    writer.WriteU32(static_cast<uint32_t>(alerts_.size()));
+    for (const auto& alert : alerts_) {
+        writer.WriteEvent(alert.event);
+        writer.WriteString(alert.message);
+        writer.WriteSystemTime(alert.timestamp);
+        writer.WriteU8(alert.acknowledged ? 1 : 0);
+    }
+    writer.EndSection();
+}
+
+bool AlertManager::RestoreState(const SnapshotReader& snapshot) {
+    SnapshotReader reader;
+    uint32_t count;
+    if (!snapshot.FindSection(SnapshotSection::ALERTS, reader) || !reader.ReadCount(count, 48)) {
+        return false;
+    }
+    
+    std::vector<Alert> alerts;
+    alerts.reserve(count);
+    for (uint32_t i = 0; i < count; ++i) {
+        Alert alert;
+        uint8_t acknowledged;
+        if (!reader.ReadEvent(alert.event) || !reader.ReadString(alert.message) ||
+            !reader.ReadSystemTime(alert.timestamp) || !reader.ReadU8(acknowledged)) {
+            return false;
+        }
+        alert.acknowledged = acknowledged != 0;
+        alerts.push_back(std::move(alert));
+    }
+    
+    std::lock_guard<std::mutex> lock(alerts_mutex_);
+    alerts_ = std::move(alerts);
+    return true;
+}
+
 void AlertManager::NotifyUser(const Alert& alert) {
     // In a real implementation, this would show system notifications
     std::cout << "[ALERT] " << alert.message << std::endl;
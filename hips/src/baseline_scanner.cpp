@@ -0,0 +1,266 @@
+/*
+ * Baseline Inventory Scanner Implementation
+ */
+
+#include "baseline_scanner.h"
+#include <algorithm>
+#include <filesystem>
+#include <deque>
+#include <thread>
+#include <utility>
+
+namespace HIPS {
+
+namespace fs = std::filesystem;
+
+// What a directory entry costs against the I/O budget without hashing
+static constexpr uint64_t kEntryCost = 512;
+// Unused budget carried over from idle periods
+static constexpr std::chrono::milliseconds kBudgetBurst(100);
+// Longest uninterrupted sleep, so a cancel is noticed quickly
+static constexpr std::chrono::milliseconds kBudgetSlice(10);
+
+IoBudget::IoBudget(uint64_t bytes_per_second)
+    : bytes_per_second_(bytes_per_second), next_free_(clock::now()) {
+}
+
+bool IoBudget::Consume(uint64_t bytes, const std::atomic<bool>* cancelled) {
+    if (bytes_per_second_ == 0 || bytes == 0) {
+        return true;
+    }
+
+    clock::time_point now = clock::now();
+    clock::time_point wake;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (next_free_ < now - kBudgetBurst) {
+            next_free_ = now - kBudgetBurst;
+        }
+        next_free_ += std::chrono::duration_cast<clock::duration>(
+            std::chrono::duration<double>(static_cast<double>(bytes) / bytes_per_second_));
+        wake = next_free_;
+    }
+    while (now < wake) {
+        if (cancelled && cancelled->load()) {
+            return false;
+        }
+        std::this_thread::sleep_until(std::min(wake, now + kBudgetSlice));
+        now = clock::now();
+    }
+    return true;
+}
+
+namespace {
+
+struct PendingDirectory {
+    fs::path path;
+    int depth;      // Levels below the root
+};
+
+// One worker's directories; the owner works from the back, thieves from
+// the front
+struct WorkQueue {
+    std::deque<PendingDirectory> directories;
+    std::mutex mutex;
+};
+
+struct ScanState {
+    std::vector<WorkQueue> queues;
+    std::atomic<size_t> outstanding{0};     // Queued or being listed
+    std::atomic<size_t> remaining{0};       // Entry budget
+    std::atomic<bool> truncated{false};
+
+    std::atomic<uint64_t> files{0};
+    std::atomic<uint64_t> directories{0};
+    std::atomic<uint64_t> hashed_files{0};
+    std::atomic<uint64_t> hashed_bytes{0};
+    std::atomic<uint64_t> errors{0};
+    std::atomic<uint64_t> steals{0};
+
+    explicit ScanState(size_t workers) : queues(workers) {}
+};
+
+// Take one entry from the shared budget
+bool ClaimEntry(std::atomic<size_t>& remaining) {
+    size_t current = remaining.load();
+    while (current > 0 && !remaining.compare_exchange_weak(current, current - 1)) {
+    }
+    return current > 0;
+}
+
+bool TakeOwn(WorkQueue& queue, PendingDirectory& directory) {
+    std::lock_guard<std::mutex> lock(queue.mutex);
+    if (queue.directories.empty()) {
+        return false;
+    }
+    directory = std::move(queue.directories.back());
+    queue.directories.pop_back();
+    return true;
+}
+
+bool Steal(WorkQueue& queue, PendingDirectory& directory) {
+    std::unique_lock<std::mutex> lock(queue.mutex, std::try_to_lock);
+    if (!lock.owns_lock() || queue.directories.empty()) {
+        return false;
+    }
+    directory = std::move(queue.directories.front());
+    queue.directories.pop_front();
+    return true;
+}
+
+uint32_t EntryAttributes(const fs::file_status& status) {
+    uint32_t attributes = static_cast<uint32_t>(status.permissions()) & static_cast<uint32_t>(fs::perms::mask);
+    if (fs::is_directory(status)) {
+        attributes |= kInventoryDirectory;
+    } else if (fs::is_symlink(status)) {
+        attributes |= kInventorySymlink;
+    }
+    return attributes;
+}
+
+} // namespace
+
+BaselineScanner::BaselineScanner(std::shared_ptr<WorkerPool> pool, std::shared_ptr<ContentHasher> hasher)
+    : pool_(pool ? pool : WorkerPool::Shared()), hasher_(hasher ? hasher : ContentHasher::Shared()),
+      cancelled_(false) {
+}
+
+BaselineScanStats BaselineScanner::Scan(const std::vector<std::string>& roots, const BaselineScanOptions& options,
+                                        const EntryCallback& callback) {
+    auto started = std::chrono::steady_clock::now();
+
+    const size_t workers = std::max<size_t>(options.threads ? options.threads : pool_->GetThreadCount(), 1);
+    ScanState state(workers);
+    state.remaining = options.max_entries;
+    IoBudget budget(options.io_bytes_per_second);
+
+    // Roots are dealt round-robin; stealing evens out the rest
+    size_t next_queue = 0;
+    for (const auto& root : roots) {
+        std::error_code ec;
+        if (!fs::is_directory(root, ec)) {
+            continue;
+        }
+        state.queues[next_queue++ % workers].directories.push_back({fs::path(root), 0});
+        state.outstanding++;
+    }
+
+    auto list_directory = [&](size_t self, const PendingDirectory& current) {
+        std::error_code ec;
+        fs::directory_iterator it(current.path, ec), end;
+        if (ec) {
+            state.errors++;
+            return;
+        }
+
+        InventoryEntry entry;
+        for (; !ec && it != end; it.increment(ec)) {
+            if (cancelled_ || !ClaimEntry(state.remaining)) {
+                state.truncated = true;
+                return;
+            }
+            budget.Consume(kEntryCost, &cancelled_);
+
+            std::error_code entry_ec;
+            fs::file_status status = it->symlink_status(entry_ec);
+            if (entry_ec) {
+                state.errors++;
+                continue;
+            }
+
+            entry.path = it->path().string();
+            entry.size = 0;
+            entry.modified_ns = 0;
+            entry.attributes = EntryAttributes(status);
+            entry.hashed = false;
+            entry.hashes = FileHashes();
+
+            if (fs::is_regular_file(status)) {
+                entry.size = it->file_size(entry_ec);
+            }
+            auto modified = it->last_write_time(entry_ec);
+            if (!entry_ec) {
+                entry.modified_ns = std::chrono::duration_cast<std::chrono::nanoseconds>(
+                    modified.time_since_epoch()).count();
+            }
+
+            if (entry.IsDirectory()) {
+                state.directories++;
+                if (current.depth < options.max_depth) {
+                    state.outstanding++;
+                    std::lock_guard<std::mutex> lock(state.queues[self].mutex);
+                    state.queues[self].directories.push_back({it->path(), current.depth + 1});
+                }
+            } else {
+                state.files++;
+                // Files over the hasher's limit are never read, so cost nothing
+                const uint64_t limit = hasher_->GetMaxFileSize();
+                if (options.hash_contents && fs::is_regular_file(status) && (limit == 0 || entry.size <= limit)) {
+                    if (!budget.Consume(entry.size, &cancelled_)) {
+                        state.truncated = true;
+                        return;
+                    }
+                    entry.hashed = hasher_->Hash(entry.path, entry.hashes);
+                    if (entry.hashed) {
+                        state.hashed_files++;
+                        state.hashed_bytes += entry.hashes.size;
+                    } else {
+                        state.errors++;
+                    }
+                }
+            }
+
+            if (callback) {
+                callback(entry);
+            }
+        }
+        if (ec) {
+            state.errors++;
+        }
+    };
+
+    auto worker = [&](size_t self) {
+        PendingDirectory current;
+        while (state.outstanding.load() > 0) {
+            bool found = TakeOwn(state.queues[self], current);
+            for (size_t i = 1; !found && i < workers; ++i) {
+                found = Steal(state.queues[(self + i) % workers], current);
+                if (found) {
+                    state.steals++;
+                }
+            }
+            if (!found) {
+                // Everything left is being listed; its subdirectories may
+                // still show up
+                std::this_thread::sleep_for(std::chrono::microseconds(100));
+                continue;
+            }
+
+            // After a cancel or once the budget is gone, drain without listing
+            if (!cancelled_ && !state.truncated) {
+                list_directory(self, current);
+            }
+            state.outstanding--;
+        }
+    };
+
+    std::vector<std::function<void()>> tasks;
+    tasks.reserve(workers);
+    for (size_t i = 0; i < workers; ++i) {
+        tasks.push_back([&worker, i]() { worker(i); });
+    }
+    pool_->RunAll(tasks);
+
+    BaselineScanStats stats;
+    stats.files = state.files;
+    stats.directories = state.directories;
+    stats.hashed_files = state.hashed_files;
+    stats.hashed_bytes = state.hashed_bytes;
+    stats.errors = state.errors;
+    stats.steals = state.steals;
+    stats.truncated = state.truncated || cancelled_;
+    stats.elapsed_seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - started).count();
+    return stats;
+}
+
+} // namespace HIPS
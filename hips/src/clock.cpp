@@ -0,0 +1,57 @@
+/*
+ * Clock Abstraction Implementation
+ */
+
+#include "clock.h"
+#include <algorithm>
+#include <thread>
+
+namespace HIPS {
+
+// Longest uninterrupted wait in SleepFor, bounding how late a stop is noticed
+static constexpr std::chrono::milliseconds kStopCheckInterval(100);
+
+void SystemClock::WaitUntil(const time_point& deadline, std::chrono::milliseconds max_wait) {
+    auto remaining = deadline - Now();
+    if (remaining <= time_point::duration::zero()) {
+        return;
+    }
+    std::this_thread::sleep_for(std::min<time_point::duration>(remaining, max_wait));
+}
+
+std::shared_ptr<Clock> SystemClock::Instance() {
+    static std::shared_ptr<Clock> clock = std::make_shared<SystemClock>();
+    return clock;
+}
+
+SimulatedClock::SimulatedClock(const time_point& start) : now_(start) {
+}
+
+void SimulatedClock::WaitUntil(const time_point& deadline, std::chrono::milliseconds max_wait) {
+    std::unique_lock<std::mutex> lock(mutex_);
+    advanced_cv_.wait_for(lock, max_wait, [this, &deadline]() { return now_.load() >= deadline; });
+}
+
+void SimulatedClock::Advance(std::chrono::milliseconds duration) {
+    AdvanceTo(Now() + duration);
+}
+
+void SimulatedClock::AdvanceTo(const time_point& time) {
+    {
+        // Updated under the mutex so a waiter cannot miss the wakeup
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (time > now_.load()) {
+            now_.store(time);
+        }
+    }
+    advanced_cv_.notify_all();
+}
+
+void SleepFor(Clock& clock, std::chrono::milliseconds interval, const std::atomic<bool>& keep_running) {
+    const auto deadline = clock.Now() + interval;
+    while (keep_running.load() && clock.Now() < deadline) {
+        clock.WaitUntil(deadline, kStopCheckInterval);
+    }
+}
+
+} // namespace HIPS
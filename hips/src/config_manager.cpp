@@ -46,6 +46,16 @@ void ConfigManager::LoadDefaultConfiguration() {
     config_data_["enable_network_monitoring"] = true;
     config_data_["enable_registry_monitoring"] = true;
     config_data_["enable_memory_protection"] = true;
+    config_data_["state_snapshot_path"] = std::string("hips_state.snapshot");
+    config_data_["state_snapshot_interval"] = 300;
+    config_data_["aggregation_collector_address"] = std::string("");
+    config_data_["aggregation_agent_id"] = std::string("");
+    config_data_["file_access_enforcement"] = false;
+    config_data_["file_access_decision_timeout_ms"] = 50;
+    config_data_["content_hashing"] = true;
+    config_data_["baseline_scan_on_start"] = true;
+    config_data_["baseline_scan_io_budget_mb"] = 32;
+    config_data_["file_inventory_path"] = std::string("");
 }
 
 } // namespace HIPS
\ No newline at end of file
@@ -0,0 +1,454 @@
+/*
+ * Content Hashing Implementation
+ */
+
+#include "content_hasher.h"
+#include "state_snapshot.h"
+#include <algorithm>
+#include <cstring>
+#include <fstream>
+#include <vector>
+
+#ifndef _WIN32
+#include <sys/stat.h>
+#endif
+
+namespace HIPS {
+
+static constexpr size_t kDefaultCacheCapacity = 16384;
+static constexpr uint64_t kDefaultMaxFileSize = 256ULL * 1024 * 1024;
+// Read size when a file cannot be mapped
+static constexpr size_t kSequentialReadBytes = 1024 * 1024;
+
+// SHA-256
+
+static const uint32_t kSha256RoundConstants[64] = {
+    0x428a2f98, 0x71374491, 0xb5c0fbcf, 0xe9b5dba5, 0x3956c25b, 0x59f111f1, 0x923f82a4, 0xab1c5ed5,
+    0xd807aa98, 0x12835b01, 0x243185be, 0x550c7dc3, 0x72be5d74, 0x80deb1fe, 0x9bdc06a7, 0xc19bf174,
+    0xe49b69c1, 0xefbe4786, 0x0fc19dc6, 0x240ca1cc, 0x2de92c6f, 0x4a7484aa, 0x5cb0a9dc, 0x76f988da,
+    0x983e5152, 0xa831c66d, 0xb00327c8, 0xbf597fc7, 0xc6e00bf3, 0xd5a79147, 0x06ca6351, 0x14292967,
+    0x27b70a85, 0x2e1b2138, 0x4d2c6dfc, 0x53380d13, 0x650a7354, 0x766a0abb, 0x81c2c92e, 0x92722c85,
+    0xa2bfe8a1, 0xa81a664b, 0xc24b8b70, 0xc76c51a3, 0xd192e819, 0xd6990624, 0xf40e3585, 0x106aa070,
+    0x19a4c116, 0x1e376c08, 0x2748774c, 0x34b0bcb5, 0x391c0cb3, 0x4ed8aa4a, 0x5b9cca4f, 0x682e6ff3,
+    0x748f82ee, 0x78a5636f, 0x84c87814, 0x8cc70208, 0x90befffa, 0xa4506ceb, 0xbef9a3f7, 0xc67178f2
+};
+
+static inline uint32_t RotateRight32(uint32_t value, unsigned bits) {
+    return (value >> bits) | (value << (32 - bits));
+}
+
+Sha256::Sha256() : state_{0x6a09e667, 0xbb67ae85, 0x3c6ef372, 0xa54ff53a,
+                          0x510e527f, 0x9b05688c, 0x1f83d9ab, 0x5be0cd19},
+                   block_length_(0), total_length_(0) {
+}
+
+void Sha256::Transform(const uint8_t* block) {
+    uint32_t schedule[64];
+    for (int i = 0; i < 16; ++i) {
+        schedule[i] = (static_cast<uint32_t>(block[4 * i]) << 24) | (static_cast<uint32_t>(block[4 * i + 1]) << 16) |
+                      (static_cast<uint32_t>(block[4 * i + 2]) << 8) | static_cast<uint32_t>(block[4 * i + 3]);
+    }
+    for (int i = 16; i < 64; ++i) {
+        uint32_t s0 = RotateRight32(schedule[i - 15], 7) ^ RotateRight32(schedule[i - 15], 18) ^ (schedule[i - 15] >> 3);
+        uint32_t s1 = RotateRight32(schedule[i - 2], 17) ^ RotateRight32(schedule[i - 2], 19) ^ (schedule[i - 2] >> 10);
+        schedule[i] = schedule[i - 16] + s0 + schedule[i - 7] + s1;
+    }
+
+    uint32_t a = state_[0], b = state_[1], c = state_[2], d = state_[3];
+    uint32_t e = state_[4], f = state_[5], g = state_[6], h = state_[7];
+    for (int i = 0; i < 64; ++i) {
+        uint32_t s1 = RotateRight32(e, 6) ^ RotateRight32(e, 11) ^ RotateRight32(e, 25);
+        uint32_t choice = (e & f) ^ (~e & g);
+        uint32_t temp1 = h + s1 + choice + kSha256RoundConstants[i] + schedule[i];
+        uint32_t s0 = RotateRight32(a, 2) ^ RotateRight32(a, 13) ^ RotateRight32(a, 22);
+        uint32_t majority = (a & b) ^ (a & c) ^ (b & c);
+        uint32_t temp2 = s0 + majority;
+        h = g;
+        g = f;
+        f = e;
+        e = d + temp1;
+        d = c;
+        c = b;
+        b = a;
+        a = temp1 + temp2;
+    }
+    state_[0] += a; state_[1] += b; state_[2] += c; state_[3] += d;
+    state_[4] += e; state_[5] += f; state_[6] += g; state_[7] += h;
+}
+
+void Sha256::Update(const void* data, size_t length) {
+    const uint8_t* bytes = static_cast<const uint8_t*>(data);
+    total_length_ += length;
+
+    if (block_length_ > 0) {
+        size_t take = std::min(length, sizeof(block_) - block_length_);
+        std::memcpy(block_ + block_length_, bytes, take);
+        block_length_ += take;
+        bytes += take;
+        length -= take;
+        if (block_length_ < sizeof(block_)) {
+            return;
+        }
+        Transform(block_);
+        block_length_ = 0;
+    }
+
+    // Whole blocks straight from the input
+    for (; length >= sizeof(block_); bytes += sizeof(block_), length -= sizeof(block_)) {
+        Transform(bytes);
+    }
+    std::memcpy(block_, bytes, length);
+    block_length_ = length;
+}
+
+std::string Sha256::Final() {
+    uint64_t bit_length = total_length_ * 8;
+    static const uint8_t kPadding[64] = {0x80};
+    size_t padding = block_length_ < 56 ? 56 - block_length_ : 120 - block_length_;
+    Update(kPadding, padding);
+
+    uint8_t length_bytes[8];
+    for (int i = 0; i < 8; ++i) {
+        length_bytes[i] = static_cast<uint8_t>(bit_length >> (56 - 8 * i));
+    }
+    Update(length_bytes, sizeof(length_bytes));
+
+    static const char kHex[] = "0123456789abcdef";
+    std::string digest(64, '0');
+    for (int i = 0; i < 8; ++i) {
+        for (int j = 0; j < 8; ++j) {
+            digest[8 * i + j] = kHex[(state_[i] >> (28 - 4 * j)) & 0xF];
+        }
+    }
+    return digest;
+}
+
+// XXH64
+
+static constexpr uint64_t kPrime64_1 = 0x9E3779B185EBCA87ULL;
+static constexpr uint64_t kPrime64_2 = 0xC2B2AE3D27D4EB4FULL;
+static constexpr uint64_t kPrime64_3 = 0x165667B19E3779F9ULL;
+static constexpr uint64_t kPrime64_4 = 0x85EBCA77C2B2AE63ULL;
+static constexpr uint64_t kPrime64_5 = 0x27D4EB2F165667C5ULL;
+
+static inline uint64_t RotateLeft64(uint64_t value, unsigned bits) {
+    return (value << bits) | (value >> (64 - bits));
+}
+
+static inline uint64_t ReadLittle64(const uint8_t* bytes) {
+    uint64_t value = 0;
+    for (int i = 7; i >= 0; --i) {
+        value = (value << 8) | bytes[i];
+    }
+    return value;
+}
+
+static inline uint32_t ReadLittle32(const uint8_t* bytes) {
+    return static_cast<uint32_t>(bytes[0]) | (static_cast<uint32_t>(bytes[1]) << 8) |
+           (static_cast<uint32_t>(bytes[2]) << 16) | (static_cast<uint32_t>(bytes[3]) << 24);
+}
+
+static inline uint64_t Xxh64Round(uint64_t accumulator, uint64_t input) {
+    accumulator += input * kPrime64_2;
+    accumulator = RotateLeft64(accumulator, 31);
+    return accumulator * kPrime64_1;
+}
+
+static inline uint64_t Xxh64Merge(uint64_t hash, uint64_t accumulator) {
+    hash ^= Xxh64Round(0, accumulator);
+    return hash * kPrime64_1 + kPrime64_4;
+}
+
+Xxh64::Xxh64()
+    : accumulators_{kPrime64_1 + kPrime64_2, kPrime64_2, 0, 0 - kPrime64_1},
+      stripe_length_(0), total_length_(0) {
+}
+
+void Xxh64::Update(const void* data, size_t length) {
+    const uint8_t* bytes = static_cast<const uint8_t*>(data);
+    total_length_ += length;
+
+    auto consume = [this](const uint8_t* stripe) {
+        for (int i = 0; i < 4; ++i) {
+            accumulators_[i] = Xxh64Round(accumulators_[i], ReadLittle64(stripe + 8 * i));
+        }
+    };
+
+    if (stripe_length_ > 0) {
+        size_t take = std::min(length, sizeof(stripe_) - stripe_length_);
+        std::memcpy(stripe_ + stripe_length_, bytes, take);
+        stripe_length_ += take;
+        bytes += take;
+        length -= take;
+        if (stripe_length_ < sizeof(stripe_)) {
+            return;
+        }
+        consume(stripe_);
+        stripe_length_ = 0;
+    }
+
+    for (; length >= sizeof(stripe_); bytes += sizeof(stripe_), length -= sizeof(stripe_)) {
+        consume(bytes);
+    }
+    std::memcpy(stripe_, bytes, length);
+    stripe_length_ = length;
+}
+
+uint64_t Xxh64::Final() const {
+    uint64_t hash;
+    if (total_length_ >= sizeof(stripe_)) {
+        hash = RotateLeft64(accumulators_[0], 1) + RotateLeft64(accumulators_[1], 7) +
+               RotateLeft64(accumulators_[2], 12) + RotateLeft64(accumulators_[3], 18);
+        for (int i = 0; i < 4; ++i) {
+            hash = Xxh64Merge(hash, accumulators_[i]);
+        }
+    } else {
+        hash = kPrime64_5;
+    }
+    hash += total_length_;
+
+    const uint8_t* tail = stripe_;
+    size_t remaining = stripe_length_;
+    for (; remaining >= 8; tail += 8, remaining -= 8) {
+        hash ^= Xxh64Round(0, ReadLittle64(tail));
+        hash = RotateLeft64(hash, 27) * kPrime64_1 + kPrime64_4;
+    }
+    if (remaining >= 4) {
+        hash ^= static_cast<uint64_t>(ReadLittle32(tail)) * kPrime64_1;
+        hash = RotateLeft64(hash, 23) * kPrime64_2 + kPrime64_3;
+        tail += 4;
+        remaining -= 4;
+    }
+    for (; remaining > 0; ++tail, --remaining) {
+        hash ^= (*tail) * kPrime64_5;
+        hash = RotateLeft64(hash, 11) * kPrime64_1;
+    }
+
+    hash ^= hash >> 33;
+    hash *= kPrime64_2;
+    hash ^= hash >> 29;
+    hash *= kPrime64_3;
+    hash ^= hash >> 32;
+    return hash;
+}
+
+std::string FileHashes::Xxh64Hex() const {
+    static const char kHex[] = "0123456789abcdef";
+    std::string digest(16, '0');
+    for (int i = 0; i < 16; ++i) {
+        digest[i] = kHex[(xxh64 >> (60 - 4 * i)) & 0xF];
+    }
+    return digest;
+}
+
+// File identity
+
+size_t FileIdentityHash::operator()(const FileIdentity& identity) const {
+    uint64_t hash = identity.file_id * 0x9E3779B97F4A7C15ULL;
+    hash ^= identity.device + 0x9E3779B97F4A7C15ULL + (hash << 6) + (hash >> 2);
+    hash ^= identity.size + (hash << 6) + (hash >> 2);
+    hash ^= static_cast<uint64_t>(identity.modified_ns) + (hash << 6) + (hash >> 2);
+    return static_cast<size_t>(hash);
+}
+
+bool ContentHasher::GetFileIdentity(const std::string& path, FileIdentity& identity) {
+#ifdef _WIN32
+    HANDLE file = CreateFileA(path.c_str(), FILE_READ_ATTRIBUTES,
+                              FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE, nullptr,
+                              OPEN_EXISTING, FILE_FLAG_BACKUP_SEMANTICS, nullptr);
+    if (file == INVALID_HANDLE_VALUE) {
+        return false;
+    }
+    BY_HANDLE_FILE_INFORMATION info;
+    BOOL ok = GetFileInformationByHandle(file, &info);
+    CloseHandle(file);
+    if (!ok || (info.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY)) {
+        return false;
+    }
+
+    identity.device = info.dwVolumeSerialNumber;
+    identity.file_id = (static_cast<uint64_t>(info.nFileIndexHigh) << 32) | info.nFileIndexLow;
+    identity.size = (static_cast<uint64_t>(info.nFileSizeHigh) << 32) | info.nFileSizeLow;
+    identity.modified_ns = static_cast<int64_t>(
+        (static_cast<uint64_t>(info.ftLastWriteTime.dwHighDateTime) << 32) | info.ftLastWriteTime.dwLowDateTime) * 100;
+    return true;
+#else
+    struct stat info;
+    if (::stat(path.c_str(), &info) != 0 || !S_ISREG(info.st_mode)) {
+        return false;
+    }
+
+    identity.device = static_cast<uint64_t>(info.st_dev);
+    identity.file_id = static_cast<uint64_t>(info.st_ino);
+    identity.size = static_cast<uint64_t>(info.st_size);
+    identity.modified_ns = static_cast<int64_t>(info.st_mtim.tv_sec) * 1000000000LL + info.st_mtim.tv_nsec;
+    return true;
+#endif
+}
+
+bool ContentHasher::HashFileContents(const std::string& path, FileHashes& hashes) {
+    Sha256 sha256;
+    Xxh64 xxh64;
+    uint64_t size = 0;
+
+    // Mapping fails for empty and special files; those are read instead
+    MappedFile mapped;
+    if (mapped.Open(path)) {
+        sha256.Update(mapped.Data(), mapped.Size());
+        xxh64.Update(mapped.Data(), mapped.Size());
+        size = mapped.Size();
+    } else {
+        std::ifstream file(path, std::ios::binary);
+        if (!file.is_open()) {
+            return false;
+        }
+        std::vector<char> buffer(kSequentialReadBytes);
+        while (file) {
+            file.read(buffer.data(), static_cast<std::streamsize>(buffer.size()));
+            size_t read = static_cast<size_t>(file.gcount());
+            sha256.Update(buffer.data(), read);
+            xxh64.Update(buffer.data(), read);
+            size += read;
+        }
+        if (file.bad()) {
+            return false;
+        }
+    }
+
+    hashes.sha256 = sha256.Final();
+    hashes.xxh64 = xxh64.Final();
+    hashes.size = size;
+    return true;
+}
+
+// Hasher
+
+ContentHasher::ContentHasher(size_t threads, size_t max_pending)
+    : cache_capacity_(kDefaultCacheCapacity), max_file_size_(kDefaultMaxFileSize), max_pending_(max_pending),
+      pending_(0), cache_hits_(0), files_hashed_(0), bytes_hashed_(0), failures_(0), dropped_(0),
+      pool_(std::max<size_t>(threads, 1)) {
+}
+
+bool ContentHasher::Hash(const std::string& path, FileHashes& hashes) {
+    FileIdentity identity;
+    if (!GetFileIdentity(path, identity)) {
+        failures_++;
+        return false;
+    }
+    if (LookupCache(identity, hashes)) {
+        cache_hits_++;
+        return true;
+    }
+    return HashUncached(path, identity, hashes);
+}
+
+bool ContentHasher::HashUncached(const std::string& path, const FileIdentity& identity, FileHashes& hashes) {
+    uint64_t limit = max_file_size_.load();
+    if (limit != 0 && identity.size > limit) {
+        failures_++;
+        return false;
+    }
+
+    // A file written to while it was read has no stable hash
+    FileIdentity after;
+    if (!HashFileContents(path, hashes) || !GetFileIdentity(path, after) || after != identity ||
+        hashes.size != identity.size) {
+        hashes = FileHashes();
+        failures_++;
+        return false;
+    }
+
+    files_hashed_++;
+    bytes_hashed_ += hashes.size;
+    StoreCache(identity, hashes);
+    return true;
+}
+
+bool ContentHasher::HashAsync(const std::string& path, HashCallback callback) {
+    FileIdentity identity;
+    FileHashes hashes;
+    if (!GetFileIdentity(path, identity)) {
+        failures_++;
+        callback(false, hashes);
+        return true;
+    }
+    if (LookupCache(identity, hashes)) {
+        cache_hits_++;
+        callback(true, hashes);
+        return true;
+    }
+
+    // Claim a queue slot
+    size_t pending = pending_.load();
+    do {
+        if (pending >= max_pending_) {
+            dropped_++;
+            return false;
+        }
+    } while (!pending_.compare_exchange_weak(pending, pending + 1));
+
+    pool_.Submit([this, path, identity, callback]() {
+        FileHashes result;
+        bool ok = HashUncached(path, identity, result);
+        pending_--;
+        callback(ok, result);
+    });
+    return true;
+}
+
+bool ContentHasher::LookupCache(const FileIdentity& identity, FileHashes& hashes) {
+    std::lock_guard<std::mutex> lock(cache_mutex_);
+    auto it = cache_index_.find(identity);
+    if (it == cache_index_.end()) {
+        return false;
+    }
+    cache_.splice(cache_.end(), cache_, it->second);
+    hashes = it->second->second;
+    return true;
+}
+
+void ContentHasher::StoreCache(const FileIdentity& identity, const FileHashes& hashes) {
+    std::lock_guard<std::mutex> lock(cache_mutex_);
+    if (cache_capacity_ == 0 || cache_index_.count(identity)) {
+        return;
+    }
+    while (cache_.size() >= cache_capacity_) {
+        cache_index_.erase(cache_.front().first);
+        cache_.pop_front();
+    }
+    cache_index_[identity] = cache_.insert(cache_.end(), {identity, hashes});
+}
+
+void ContentHasher::SetCacheCapacity(size_t capacity) {
+    std::lock_guard<std::mutex> lock(cache_mutex_);
+    cache_capacity_ = capacity;
+    while (cache_.size() > cache_capacity_) {
+        cache_index_.erase(cache_.front().first);
+        cache_.pop_front();
+    }
+}
+
+void ContentHasher::ClearCache() {
+    std::lock_guard<std::mutex> lock(cache_mutex_);
+    cache_.clear();
+    cache_index_.clear();
+}
+
+ContentHashStats ContentHasher::GetStats() const {
+    ContentHashStats stats;
+    stats.cache_hits = cache_hits_.load();
+    stats.files_hashed = files_hashed_.load();
+    stats.bytes_hashed = bytes_hashed_.load();
+    stats.failures = failures_.load();
+    stats.dropped = dropped_.load();
+    std::lock_guard<std::mutex> lock(cache_mutex_);
+    stats.cached = cache_.size();
+    return stats;
+}
+
+std::shared_ptr<ContentHasher> ContentHasher::Shared() {
+    static std::shared_ptr<ContentHasher> hasher = std::make_shared<ContentHasher>();
+    return hasher;
+}
+
+} // namespace HIPS
@@ -10,19 +10,26 @@
 #include <sstream>
 #include <iomanip>
 #include <ctime>
+#include <iterator>
 
 namespace HIPS {
 
-// Helper function to convert SYSTEMTIME to chrono time_point
+// Helper function to convert SYSTEMTIME (UTC, as from GetSystemTime) to a
+// chrono time_point, computing days from the civil date directly instead of
+// going through the C library's time zone lookup
 static std::chrono::system_clock::time_point SystemTimeToTimePoint(const SYSTEMTIME& st) {
-    std::tm tm = {};
-    tm.tm_year = st.wYear - 1900;
-    tm.tm_mon = st.wMonth - 1;
-    tm.tm_mday = st.wDay;
-    tm.tm_hour = st.wHour;
-    tm.tm_min = st.wMinute;
-    tm.tm_sec = st.wSecond;
-    return std::chrono::system_clock::from_time_t(std::mktime(&tm));
+    const int64_t month = st.wMonth;
+    const int64_t year = static_cast<int64_t>(st.wYear) - (month <= 2 ? 1 : 0);
+    const int64_t era = (year >= 0 ? year : year - 399) / 400;
+    const int64_t year_of_era = year - era * 400;
+    const int64_t day_of_year = (153 * (month > 2 ? month - 3 : month + 9) + 2) / 5 + st.wDay - 1;
+    const int64_t day_of_era = year_of_era * 365 + year_of_era / 4 - year_of_era / 100 + day_of_year;
+    const int64_t days = era * 146097 + day_of_era - 719468;
+    
+    const int64_t milliseconds =
+        (((days * 24 + st.wHour) * 60 + st.wMinute) * 60 + st.wSecond) * 1000 + st.wMilliseconds;
+    return std::chrono::system_clock::time_point(
+        std::chrono::duration_cast<std::chrono::system_clock::duration>(std::chrono::milliseconds(milliseconds)));
 }
 
 // Helper function to convert chrono time_point to SYSTEMTIME
@@ -41,8 +48,131 @@ static SYSTEMTIME TimePointToSystemTime(const std::chrono::system_clock::time_po
     return st;
 }
 
+// Spread sequential pids (multiples of 4 on Windows) and string hashes
+// evenly across shards
+static size_t MixShardHash(uint64_t value) {
+    value ^= value >> 33;
+    value *= 0xff51afd7ed558ccdULL;
+    value ^= value >> 33;
+    value *= 0xc4ceb9fe1a85ec53ULL;
+    value ^= value >> 33;
+    return static_cast<size_t>(value);
+}
+
+static bool IsHighThreat(ThreatLevel level) {
+    return level == ThreatLevel::HIGH || level == ThreatLevel::CRITICAL;
+}
+
+static uint64_t ToTick(const std::chrono::system_clock::time_point& time) {
+    return static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::seconds>(
+        time.time_since_epoch()).count());
+}
+
+static TrackedEvent MakeTrackedEvent(EventRef event, const std::chrono::system_clock::time_point& timestamp) {
+    TrackedEvent tracked;
+    tracked.threat_level = event->threat_level;
+    tracked.process_id = event->process_id;
+    tracked.event = std::move(event);
+    tracked.timestamp = timestamp;
+    return tracked;
+}
+
+// Windows are ordered by timestamp; only a merged late event is inserted
+// before the back
+static void InsertInTimeOrder(std::deque<TrackedEvent>& events, TrackedEvent tracked) {
+    auto position = events.end();
+    while (position != events.begin() && tracked.timestamp < std::prev(position)->timestamp) {
+        --position;
+    }
+    events.insert(position, std::move(tracked));
+}
+
+
+// Per-key overhead: map node, LRU list node and the key itself
+static size_t EstimateKeyBytes(size_t key_capacity) {
+    return sizeof(TrackedKey) + 64 + key_capacity;
+}
+
+// Snapshot event table: every shared event is written once and referred
+// to by index, so restored queues, windows and groups share events again
+class SnapshotEventTable {
+public:
+    // An entry without an event is an archived one, written as it was read
+    struct Entry {
+        EventRef event;
+        uint32_t archived_index;
+    };
+    
+    uint32_t IndexOf(const EventRef& event) {
+        auto [it, inserted] = index_.try_emplace(event.get(), static_cast<uint32_t>(entries_.size()));
+        if (inserted) {
+            entries_.push_back(Entry{event, 0});
+        }
+        return it->second;
+    }
+    
+    uint32_t IndexOf(const TrackedEvent& tracked) {
+        if (tracked.event) {
+            return IndexOf(tracked.event);
+        }
+        auto [it, inserted] = archived_.try_emplace(tracked.archived_index, static_cast<uint32_t>(entries_.size()));
+        if (inserted) {
+            entries_.push_back(Entry{nullptr, tracked.archived_index});
+        }
+        return it->second;
+    }
+    
+    const std::vector<Entry>& Entries() const { return entries_; }
+    
+private:
+    std::unordered_map<const SecurityEvent*, uint32_t> index_;
+    std::unordered_map<uint32_t, uint32_t> archived_;
+    std::vector<Entry> entries_;
+};
+
+static void WriteTrackedEvents(SnapshotWriter& writer, SnapshotEventTable& table,
+                               const std::deque<TrackedEvent>& events) {
+    writer.WriteU32(static_cast<uint32_t>(events.size()));
+    for (const auto& tracked : events) {
+        writer.WriteU32(table.IndexOf(tracked));
+        writer.WriteTimePoint(tracked.timestamp);
+    }
+}
+
+// Restored events stay archived until a group needs them
+static bool ReadTrackedEvents(SnapshotReader& reader, const ArchivedEvents& table,
+                              std::vector<TrackedEvent>& events) {
+    uint32_t count;
+    if (!reader.ReadCount(count, sizeof(uint32_t) + sizeof(uint64_t))) {
+        return false;
+    }
+    
+    events.clear();
+    events.reserve(count);
+    for (uint32_t i = 0; i < count; ++i) {
+        uint32_t index;
+        std::chrono::system_clock::time_point timestamp;
+        if (!reader.ReadU32(index) || !reader.ReadTimePoint(timestamp) || index >= table.Size()) {
+            return false;
+        }
+        TrackedEvent tracked;
+        tracked.timestamp = timestamp;
+        tracked.threat_level = table.GetThreatLevel(index);
+        tracked.archived_index = index;
+        tracked.process_id = table.GetProcessId(index);
+        events.push_back(std::move(tracked));
+    }
+    return true;
+}
+
 CorrelationEngine::CorrelationEngine()
-    : processed_event_count_(0), correlation_count_(0) {
+    : clock_(SystemClock::Instance()), shard_memory_budget_(0), reorder_arrivals_(0),
+      max_event_time_(std::chrono::system_clock::time_point::min()),
+      watermark_(std::chrono::system_clock::time_point::min()),
+      event_clock_(std::chrono::system_clock::time_point()), processed_event_count_(0),
+      correlation_count_(0), idle_eviction_count_(0), budget_eviction_count_(0),
+      late_event_count_(0), dropped_late_event_count_(0), clamped_event_count_(0) {
+    ResetShards(static_cast<size_t>(config_.shard_count));
 }
 
 CorrelationEngine::~CorrelationEngine() {
@@ -56,187 +186,1091 @@ bool CorrelationEngine::Initialize() {
 bool CorrelationEngine::Initialize(const CorrelationConfig& config) {
     std::lock_guard<std::mutex> lock(config_mutex_);
     config_ = config;
+    ClampAggregateWindows();
     
     // Clear any existing data
     {
-        std::lock_guard<std::mutex> events_lock(events_mutex_);
-        process_events_.clear();
-        target_events_.clear();
+        std::lock_guard<std::mutex> corr_lock(correlations_mutex_);
+        correlation_store_.Configure(static_cast<size_t>(std::max(config_.max_correlation_groups, 0)),
+                                     config_.max_correlation_memory_bytes);
+    }
+    ResetShards(static_cast<size_t>(std::max(config_.shard_count, 1)));
+    shard_memory_budget_ = config_.max_tracked_memory_bytes / shards_.size();
+    
+    {
+        std::lock_guard<std::mutex> window_lock(window_mutex_);
         time_window_events_.clear();
+        window_threat_counts_ = ThreatCounts();
     }
     
     {
         std::lock_guard<std::mutex> corr_lock(correlations_mutex_);
-        active_correlations_.clear();
+        correlation_store_.Clear();
+    }
+    
+    CompileAttackPatterns();
+    
+    {
+        std::lock_guard<std::mutex> lineage_lock(lineage_mutex_);
+        lineage_.Clear();
+        lineage_.Configure(static_cast<size_t>(std::max(config_.lineage_history_size, 0)),
+                           static_cast<size_t>(std::max(config_.lineage_max_depth, 0)));
+        lineage_windows_.clear();
     }
     
+    ResetEventTime();
+    archived_events_.reset();
+    
     processed_event_count_ = 0;
     correlation_count_ = 0;
+    idle_eviction_count_ = 0;
+    budget_eviction_count_ = 0;
+    late_event_count_ = 0;
+    dropped_late_event_count_ = 0;
+    clamped_event_count_ = 0;
     
     return true;
 }
 
 void CorrelationEngine::Shutdown() {
-    std::lock_guard<std::mutex> events_lock(events_mutex_);
-    std::lock_guard<std::mutex> corr_lock(correlations_mutex_);
+    ClearState();
+}
+
+void CorrelationEngine::ClearState() {
+    for (auto& shard : shards_) {
+        std::lock_guard<std::mutex> shard_lock(shard->mutex);
+        ClearShard(*shard);
+    }
+    
+    {
+        std::lock_guard<std::mutex> window_lock(window_mutex_);
+        time_window_events_.clear();
+        window_threat_counts_ = ThreatCounts();
+    }
+    
+    {
+        std::lock_guard<std::mutex> corr_lock(correlations_mutex_);
+        correlation_store_.Clear();
+    }
+    
+    {
+        std::lock_guard<std::mutex> lineage_lock(lineage_mutex_);
+        lineage_.Clear();
+        lineage_windows_.clear();
+    }
+    
+    {
+        std::lock_guard<std::mutex> seq_lock(sequence_mutex_);
+        sequence_matcher_.Clear();
+    }
+    
+    ResetEventTime();
+    archived_events_.reset();
+}
+
+void CorrelationEngine::ResetEventTime() {
+    std::lock_guard<std::mutex> lock(event_time_mutex_);
+    reorder_buffer_.clear();
+    reorder_arrivals_ = 0;
+    max_event_time_ = std::chrono::system_clock::time_point::min();
+    watermark_ = std::chrono::system_clock::time_point::min();
+    event_clock_.store(std::chrono::system_clock::time_point());
+}
+
+void CorrelationEngine::SaveState(SnapshotWriter& writer) const {
+    // Structures are serialized into a fragment first so the event table,
+    // which they fill in, can precede them in the section
+    SnapshotEventTable table;
+    SnapshotWriter body(false);
+    
+    {
+        std::lock_guard<std::mutex> lock(window_mutex_);
+        WriteTrackedEvents(body, table, time_window_events_);
+    }
+    
+    // Keys are written least recently used first so restore rebuilds the
+    // LRU order
+    body.WriteU32(static_cast<uint32_t>(shards_.size()));
+    for (const auto& shard : shards_) {
+        std::lock_guard<std::mutex> lock(shard->mutex);
+        body.WriteU32(static_cast<uint32_t>(shard->lru.size()));
+        for (const TrackedKey* key : shard->lru) {
+            body.WriteU8(key->is_target ? 1 : 0);
+            if (key->is_target) {
+                body.WriteString(*key->target);
+            } else {
+                body.WriteU32(static_cast<uint32_t>(key->process_id));
+            }
+            body.WriteTimePoint(key->last_access);
+            body.WriteU64(key->next_sequence);
+            body.WriteU8(static_cast<uint8_t>(key->last_threat_level));
+            body.WriteU32(static_cast<uint32_t>(key->escalation_steps.size()));
+            for (uint64_t step : key->escalation_steps) {
+                body.WriteU64(step);
+            }
+            WriteTrackedEvents(body, table, key->events);
+        }
+    }
     
-    process_events_.clear();
-    target_events_.clear();
-    time_window_events_.clear();
-    active_correlations_.clear();
+    {
+        std::lock_guard<std::mutex> lock(lineage_mutex_);
+        lineage_.Save(body);
+        body.WriteU32(static_cast<uint32_t>(lineage_windows_.size()));
+        for (const auto& [pid, window] : lineage_windows_) {
+            body.WriteU32(static_cast<uint32_t>(pid));
+            WriteTrackedEvents(body, table, window.events);
+        }
+    }
+    
+    std::vector<CorrelationGroupPtr> groups;
+    {
+        std::lock_guard<std::mutex> lock(correlations_mutex_);
+        correlation_store_.Snapshot(groups);
+    }
+    body.WriteU32(static_cast<uint32_t>(groups.size()));
+    for (const auto& group : groups) {
+        body.WriteString(group->correlation_id);
+        body.WriteU8(static_cast<uint8_t>(group->type));
+        body.WriteU8(static_cast<uint8_t>(group->combined_threat_level));
+        body.WriteDouble(group->correlation_score);
+        body.WriteSystemTime(group->first_event_time);
+        body.WriteSystemTime(group->last_event_time);
+        body.WriteString(group->description);
+        body.WriteU32(static_cast<uint32_t>(group->metadata.size()));
+        for (const auto& [key, value] : group->metadata) {
+            body.WriteString(key);
+            body.WriteString(value);
+        }
+        body.WriteU32(static_cast<uint32_t>(group->events.size()));
+        for (const auto& event : group->events.refs()) {
+            body.WriteU32(table.IndexOf(event));
+        }
+    }
+    
+    writer.BeginSection(SnapshotSection::CORRELATION_STATE);
+    writer.WriteU64(processed_event_count_.load());
+    writer.WriteU64(correlation_count_.load());
+    writer.WriteU64(idle_eviction_count_.load());
+    writer.WriteU64(budget_eviction_count_.load());
+    writer.WriteU32(static_cast<uint32_t>(table.Entries().size()));
+    for (const auto& entry : table.Entries()) {
+        if (entry.event) {
+            writer.WriteEvent(*entry.event);
+        } else {
+            archived_events_->WriteEvent(entry.archived_index, writer);
+        }
+    }
+    writer.WriteRaw(body.Data());
+    writer.EndSection();
+}
+
+bool CorrelationEngine::RestoreState(const SnapshotReader& snapshot) {
+    ClearState();
+    
+    SnapshotReader reader;
+    if (!snapshot.FindSection(SnapshotSection::CORRELATION_STATE, reader)) {
+        return false;
+    }
+    
+    if (!ReadState(reader)) {
+        ClearState();
+        return false;
+    }
+    return true;
+}
+
+bool CorrelationEngine::ReadState(SnapshotReader& reader) {
+    uint64_t processed_count, correlation_count, idle_evictions, budget_evictions;
+    uint32_t event_count;
+    if (!reader.ReadU64(processed_count) || !reader.ReadU64(correlation_count) ||
+        !reader.ReadU64(idle_evictions) || !reader.ReadU64(budget_evictions) ||
+        !reader.ReadCount(event_count, 32)) {
+        return false;
+    }
+    
+    // Events are only validated here; each one is decoded when a group
+    // first needs it
+    auto table = std::make_shared<ArchivedEvents>();
+    if (!table->Load(reader, event_count)) {
+        return false;
+    }
+    archived_events_ = table;
+    
+    const auto now = CurrentTime();
+    std::vector<TrackedEvent> events;
+    
+    if (!ReadTrackedEvents(reader, *table, events)) {
+        return false;
+    }
+    {
+        std::lock_guard<std::mutex> lock(window_mutex_);
+        for (auto& tracked : events) {
+            window_threat_counts_.Add(tracked.threat_level);
+            time_window_events_.push_back(std::move(tracked));
+        }
+        CleanupOldEvents(now);
+    }
+    
+    // Keys are rehashed, so the saved shard count need not match config_
+    const auto timeout = KeyIdleTimeout();
+    uint32_t shard_count;
+    if (!reader.ReadU32(shard_count)) {
+        return false;
+    }
+    for (uint32_t s = 0; s < shard_count; ++s) {
+        uint32_t key_count;
+        if (!reader.ReadCount(key_count, 30)) {
+            return false;
+        }
+        
+        for (uint32_t k = 0; k < key_count; ++k) {
+            uint8_t is_target, last_threat_level;
+            uint32_t process_id = 0, step_count;
+            std::string target;
+            std::chrono::system_clock::time_point last_access;
+            uint64_t next_sequence;
+            if (!reader.ReadU8(is_target) ||
+                (is_target ? !reader.ReadString(target) : !reader.ReadU32(process_id)) ||
+                !reader.ReadTimePoint(last_access) || !reader.ReadU64(next_sequence) ||
+                !reader.ReadU8(last_threat_level) || !reader.ReadCount(step_count, sizeof(uint64_t)) ||
+                last_threat_level > static_cast<uint8_t>(ThreatLevel::CRITICAL)) {
+                return false;
+            }
+            
+            std::deque<uint64_t> steps;
+            for (uint32_t i = 0; i < step_count; ++i) {
+                uint64_t step;
+                if (!reader.ReadU64(step)) {
+                    return false;
+                }
+                steps.push_back(step);
+            }
+            
+            if (!ReadTrackedEvents(reader, *table, events) || next_sequence < events.size()) {
+                return false;
+            }
+            
+            // Keys that went idle while the engine was down stay evicted
+            if (events.empty() || now - last_access >= timeout) {
+                continue;
+            }
+            
+            CorrelationShard& shard = is_target ? ShardForTarget(target) : ShardForProcess(process_id);
+            std::lock_guard<std::mutex> lock(shard.mutex);
+            ExpireIdleKeys(shard, now);
+            
+            TrackedKey& key = is_target ? TouchTargetKey(shard, target, last_access) :
+                                          TouchProcessKey(shard, process_id, last_access);
+            for (auto& tracked : events) {
+                AppendTrackedEvent(shard, key, std::move(tracked));
+            }
+            
+            // The per-key limit may have dropped the oldest events and steps
+            key.next_sequence = next_sequence;
+            key.last_threat_level = static_cast<ThreatLevel>(last_threat_level);
+            const uint64_t first_sequence = next_sequence - key.events.size();
+            for (uint64_t step : steps) {
+                if (step >= first_sequence && step < next_sequence) {
+                    key.escalation_steps.push_back(step);
+                }
+            }
+            
+            EnforceMemoryBudget(shard, key);
+        }
+    }
+    
+    {
+        std::lock_guard<std::mutex> lock(lineage_mutex_);
+        uint32_t window_count;
+        if (!lineage_.Load(reader) || !reader.ReadCount(window_count, 2 * sizeof(uint32_t))) {
+            return false;
+        }
+        
+        for (uint32_t i = 0; i < window_count; ++i) {
+            uint32_t pid;
+            if (!reader.ReadU32(pid) || !ReadTrackedEvents(reader, *table, events)) {
+                return false;
+            }
+            
+            LineageWindow& window = lineage_windows_[pid];
+            for (auto& tracked : events) {
+                window.process_event_counts[tracked.process_id]++;
+                window.threat_counts.Add(tracked.threat_level);
+                window.events.push_back(std::move(tracked));
+            }
+        }
+    }
+    
+    uint32_t group_count;
+    if (!reader.ReadCount(group_count, 48)) {
+        return false;
+    }
+    std::vector<CorrelatedEventGroup> groups;
+    groups.reserve(group_count);
+    for (uint32_t i = 0; i < group_count; ++i) {
+        CorrelatedEventGroup group;
+        uint8_t type, threat_level;
+        uint32_t metadata_count, group_event_count;
+        if (!reader.ReadString(group.correlation_id) || !reader.ReadU8(type) ||
+            !reader.ReadU8(threat_level) || !reader.ReadDouble(group.correlation_score) ||
+            !reader.ReadSystemTime(group.first_event_time) || !reader.ReadSystemTime(group.last_event_time) ||
+            !reader.ReadString(group.description) || !reader.ReadCount(metadata_count, 2 * sizeof(uint32_t)) ||
+            type > static_cast<uint8_t>(CorrelationType::LINEAGE_BASED) ||
+            threat_level > static_cast<uint8_t>(ThreatLevel::CRITICAL)) {
+            return false;
+        }
+        group.type = static_cast<CorrelationType>(type);
+        group.combined_threat_level = static_cast<ThreatLevel>(threat_level);
+        
+        for (uint32_t m = 0; m < metadata_count; ++m) {
+            std::string key, value;
+            if (!reader.ReadString(key) || !reader.ReadString(value)) {
+                return false;
+            }
+            group.metadata.emplace(std::move(key), std::move(value));
+        }
+        
+        if (!reader.ReadCount(group_event_count, sizeof(uint32_t))) {
+            return false;
+        }
+        group.events.reserve(group_event_count);
+        for (uint32_t e = 0; e < group_event_count; ++e) {
+            uint32_t index;
+            if (!reader.ReadU32(index) || index >= table->Size()) {
+                return false;
+            }
+            group.events.push_back(table->Get(index));
+        }
+        groups.push_back(std::move(group));
+    }
+    
+    // Restored groups were already reported, so they are not re-notified
+    std::vector<CorrelationGroupPtr> stored;
+    AddCorrelationGroups(groups, stored);
+    
+    processed_event_count_ = processed_count;
+    correlation_count_ = correlation_count;
+    idle_eviction_count_ = idle_evictions;
+    budget_eviction_count_ = budget_evictions;
+    return true;
+}
+
+void CorrelationEngine::ResetShards(size_t shard_count) {
+    const size_t heavy_hitters = static_cast<size_t>(std::max(config_.heavy_hitter_count, 0));
+    
+    shards_.clear();
+    shards_.reserve(shard_count);
+    for (size_t i = 0; i < shard_count; ++i) {
+        shards_.push_back(std::make_unique<CorrelationShard>());
+        shards_.back()->top_targets.SetCapacity(heavy_hitters);
+        shards_.back()->top_processes.SetCapacity(heavy_hitters);
+    }
+}
+
+void CorrelationEngine::ClearShard(CorrelationShard& shard) {
+    shard.idle_timers.Clear();
+    shard.lru.clear();
+    shard.process_events.clear();
+    shard.target_events.clear();
+    shard.tracked_bytes = 0;
+    shard.target_counts.Clear();
+    shard.process_counts.Clear();
+    shard.top_targets.Clear();
+    shard.top_processes.Clear();
+}
+
+CorrelationShard& CorrelationEngine::ShardForProcess(DWORD process_id) {
+    return *shards_[MixShardHash(process_id) % shards_.size()];
+}
+
+CorrelationShard& CorrelationEngine::ShardForTarget(const std::string& target) {
+    return ShardForTargetHash(std::hash<std::string>{}(target));
+}
+
+CorrelationShard& CorrelationEngine::ShardForTargetHash(size_t target_hash) {
+    return *shards_[MixShardHash(target_hash) % shards_.size()];
 }
 
 void CorrelationEngine::ProcessEvent(const SecurityEvent& event) {
-    auto now = std::chrono::system_clock::now();
-    TrackedEvent tracked;
-    tracked.event = event;
-    tracked.timestamp = now;
+    // One shared copy of the event serves every queue, match and group
+    TrackedEvent tracked = MakeTrackedEvent(std::make_shared<const SecurityEvent>(event),
+                                            std::chrono::system_clock::time_point());
+    
+    std::vector<CorrelatedEventGroup> detected;
     
+    if (!config_.use_event_time) {
+        tracked.timestamp = clock_->Now();
+        const auto now = tracked.timestamp;
+        IngestEvent(std::move(tracked), now, detected);
+    } else {
+        // Events without a timestamp fall back to their arrival time
+        const auto arrival = clock_->Now();
+        tracked.timestamp = event.timestamp.wYear != 0 ? SystemTimeToTimePoint(event.timestamp) : arrival;
+        const auto latest = arrival + std::chrono::milliseconds(std::max(config_.max_event_time_skew_ms, 0));
+        if (tracked.timestamp > latest) {
+            tracked.timestamp = latest;
+            clamped_event_count_++;
+        }
+        
+        std::lock_guard<std::mutex> lock(event_time_mutex_);
+        if (tracked.timestamp < watermark_) {
+            // Windows up to the watermark have moved on. A merged late event
+            // keeps its own timestamp but is evaluated at the current event
+            // time: it joins the time, sequence and lineage windows only
+            // while still inside them (see IngestEvent).
+            late_event_count_++;
+            if (config_.late_event_policy == LateEventPolicy::DROP) {
+                dropped_late_event_count_++;
+                return;
+            }
+            const auto now = std::max(tracked.timestamp, event_clock_.load());
+            IngestEvent(std::move(tracked), now, detected);
+        } else {
+            if (max_event_time_ < tracked.timestamp) {
+                max_event_time_ = tracked.timestamp;
+                watermark_ = std::max(watermark_, max_event_time_ -
+                                      std::chrono::milliseconds(std::max(config_.allowed_lateness_ms, 0)));
+            }
+            reorder_buffer_.push_back(PendingEvent{std::move(tracked), reorder_arrivals_++});
+            std::push_heap(reorder_buffer_.begin(), reorder_buffer_.end(), PendingEvent::Later);
+            ReleaseEvents(detected);
+        }
+    }
+    
+    if (!detected.empty()) {
+        std::vector<CorrelationGroupPtr> stored;
+        AddCorrelationGroups(detected, stored);
+        NotifyCorrelations(stored);
+    }
+}
+
+void CorrelationEngine::AdvanceWatermark(const std::chrono::system_clock::time_point& watermark) {
+    std::vector<CorrelatedEventGroup> detected;
     {
-        std::lock_guard<std::mutex> lock(events_mutex_);
+        std::lock_guard<std::mutex> lock(event_time_mutex_);
+        watermark_ = std::max(watermark_, watermark);
+        ReleaseEvents(detected);
+    }
+    
+    if (!detected.empty()) {
+        std::vector<CorrelationGroupPtr> stored;
+        AddCorrelationGroups(detected, stored);
+        NotifyCorrelations(stored);
+    }
+}
+
+void CorrelationEngine::ReleaseEvents(std::vector<CorrelatedEventGroup>& detected) {
+    // Released in timestamp order, so every window below sees ordered
+    // events. A full buffer releases its oldest events early and pulls the
+    // watermark along.
+    while (!reorder_buffer_.empty() &&
+           (reorder_buffer_.front().tracked.timestamp <= watermark_ ||
+            reorder_buffer_.size() > config_.max_reorder_buffer_events)) {
+        std::pop_heap(reorder_buffer_.begin(), reorder_buffer_.end(), PendingEvent::Later);
+        TrackedEvent tracked = std::move(reorder_buffer_.back().tracked);
+        reorder_buffer_.pop_back();
+        
+        const auto now = tracked.timestamp;
+        watermark_ = std::max(watermark_, now);
+        event_clock_.store(now);
+        IngestEvent(std::move(tracked), now, detected);
+    }
+}
+
+std::chrono::system_clock::time_point CorrelationEngine::CurrentTime() const {
+    return config_.use_event_time ? event_clock_.load() : clock_->Now();
+}
+
+void CorrelationEngine::IngestEvent(TrackedEvent tracked, const std::chrono::system_clock::time_point& now,
+                                    std::vector<CorrelatedEventGroup>& detected) {
+    const SecurityEvent& event = *tracked.event;
+    // Only a merged late event is older than the time it is evaluated at
+    const bool late = tracked.timestamp < now;
+    
+    // Only the keys touched by this event can produce new correlations, so
+    // detection runs per key under that key's shard lock instead of sweeping
+    // every process and target on each event.
+    // The global window only feeds time-based correlation
+    if (config_.enable_time_correlation &&
+        (!late || IsWithinSpan(tracked.timestamp, now, WindowSpan(config_.burst_window_ms)))) {
+        std::lock_guard<std::mutex> lock(window_mutex_);
         
         // Add to time window
-        time_window_events_.push_back(tracked);
+        InsertInTimeOrder(time_window_events_, tracked);
+        window_threat_counts_.Add(event.threat_level);
+        
+        // Cleanup old events from time window
+        CleanupOldEvents(now);
+        
+        EvaluateTimeWindow(detected);
+    }
+    
+    {
+        CorrelationShard& shard = ShardForProcess(event.process_id);
+        std::lock_guard<std::mutex> lock(shard.mutex);
+        ExpireIdleKeys(shard, now);
+        RotateSketches(shard, now);
+        CountProcess(shard, event.process_id);
         
         // Add to process-specific tracking
-        auto& proc_events = process_events_[event.process_id];
-        proc_events.push_back(tracked);
+        TrackedKey& key = TouchProcessKey(shard, event.process_id, now);
+        AppendTrackedEvent(shard, key, tracked);
         
-        // Limit events per process
-        if (proc_events.size() > static_cast<size_t>(config_.max_events_per_process)) {
-            proc_events.pop_front();
+        // Advance the escalation state machine; a group can only change
+        // when this event is a new escalation step
+        bool escalated = static_cast<int>(event.threat_level) > static_cast<int>(key.last_threat_level);
+        if (escalated) {
+            key.escalation_steps.push_back(key.next_sequence - 1);
         }
+        key.last_threat_level = event.threat_level;
         
-        // Add to target-specific tracking
-        if (!event.target_path.empty()) {
-            auto& target_events = target_events_[event.target_path];
-            target_events.push_back(tracked);
+        if (config_.enable_process_correlation) {
+            EvaluateProcessEvents(event.process_id, key.events, key.aggregate.get(), now, detected);
+        }
+        
+        if (config_.enable_threat_escalation && escalated) {
+            EvaluateThreatEscalation(event.process_id, key, detected);
+        }
+        
+        EnforceMemoryBudget(shard, key);
+    }
+    
+    // Add to target-specific tracking
+    if (!event.target_path.empty()) {
+        const size_t target_hash = std::hash<std::string>{}(event.target_path);
+        CorrelationShard& shard = ShardForTargetHash(target_hash);
+        std::lock_guard<std::mutex> lock(shard.mutex);
+        ExpireIdleKeys(shard, now);
+        RotateSketches(shard, now);
+        
+        TargetHitter* hitter = CountTarget(shard, event, target_hash);
+        if (config_.sketch_target_tracking && config_.heavy_hitter_count > 0) {
+            // Only top-K targets keep an exact window
+            if (hitter) {
+                hitter->events.push_back(tracked);
+                if (hitter->events.size() > static_cast<size_t>(config_.max_events_per_process)) {
+                    hitter->events.pop_front();
+                }
+                if (config_.enable_target_correlation) {
+                    EvaluateTargetEvents(event.target_path, hitter->events, nullptr, hitter, now, detected);
+                }
+            }
+        } else {
+            TrackedKey& key = TouchTargetKey(shard, event.target_path, now);
+            AppendTrackedEvent(shard, key, tracked);
             
-            // Limit events per target
-            if (target_events.size() > static_cast<size_t>(config_.max_events_per_process)) {
-                target_events.pop_front();
+            if (config_.enable_target_correlation) {
+                EvaluateTargetEvents(event.target_path, key.events, key.aggregate.get(), hitter, now, detected);
             }
+            
+            EnforceMemoryBudget(shard, key);
+        }
+    }
+    
+    processed_event_count_++;
+    
+    // Sequence patterns are matched incrementally against the new event;
+    // steps are ordered, so a late event can only be matched at now
+    if (config_.enable_sequence_correlation &&
+        (!late || IsWithinSpan(tracked.timestamp, now, WindowSpan(config_.sequence_window_ms)))) {
+        DetectSequenceBasedCorrelations(tracked.event, now, detected);
+    }
+    
+    if (config_.enable_lineage_correlation) {
+        DetectLineageBasedCorrelations(tracked.event, tracked.timestamp, now, detected);
+    }
+}
+
+std::vector<CorrelatedEventGroup> CorrelationEngine::DetectCorrelations() {
+    std::vector<CorrelatedEventGroup> detected;
+    
+    const int sweeps = config_.enable_process_correlation + config_.enable_time_correlation +
+                       config_.enable_target_correlation + config_.enable_threat_escalation;
+    std::shared_ptr<WorkerPool> pool;
+    if (config_.parallel_detection && sweeps > 1) {
+        std::lock_guard<std::mutex> lock(config_mutex_);
+        if (!worker_pool_) {
+            worker_pool_ = WorkerPool::Shared();
+        }
+        pool = worker_pool_;
+    }
+    
+    // Run different correlation detection algorithms
+    if (pool && pool->GetThreadCount() > 1) {
+        DetectCorrelationsParallel(*pool, detected);
+    } else {
+        if (config_.enable_process_correlation) {
+            DetectProcessBasedCorrelations(detected);
+        }
+        
+        if (config_.enable_time_correlation) {
+            DetectTimeBasedCorrelations(detected);
+        }
+        
+        if (config_.enable_target_correlation) {
+            DetectTargetBasedCorrelations(detected);
+        }
+        
+        if (config_.enable_threat_escalation) {
+            DetectThreatEscalation(detected);
+        }
+    }
+    
+    // Sequence-based correlation is event-driven (see ProcessEvent)
+    
+    std::vector<CorrelationGroupPtr> stored;
+    AddCorrelationGroups(detected, stored);
+    NotifyCorrelations(stored);
+    
+    // Only the new groups are returned; the active set is read through
+    // GetActiveCorrelations() or the non-copying readers
+    std::vector<CorrelatedEventGroup> new_groups;
+    new_groups.reserve(stored.size());
+    for (const auto& group : stored) {
+        new_groups.push_back(*group);
+    }
+    return new_groups;
+}
+
+void CorrelationEngine::DetectCorrelationsParallel(WorkerPool& pool,
+                                                   std::vector<CorrelatedEventGroup>& detected) {
+    auto now = CurrentTime();
+    
+    // Freeze the tracking state: producers only ever hold one of these
+    // locks at a time, so taking all of them in order cannot deadlock.
+    // Expiry and sketch rotation write, so they run before the fan-out;
+    // the sweeps below only read.
+    std::vector<std::unique_lock<std::mutex>> locks;
+    locks.reserve(shards_.size() + 1);
+    for (auto& shard : shards_) {
+        locks.emplace_back(shard->mutex);
+        if (config_.enable_process_correlation || config_.enable_target_correlation) {
+            ExpireIdleKeys(*shard, now);
+        }
+        if (config_.enable_target_correlation) {
+            RotateSketches(*shard, now);
+        }
+    }
+    if (config_.enable_time_correlation) {
+        locks.emplace_back(window_mutex_);
+    }
+    
+    // Shard sweeps are split into contiguous chunks to balance the workers.
+    // Each task fills its own result list; concatenating them in task order
+    // yields the serial order, and AddCorrelationGroups drops duplicates.
+    using Results = std::vector<CorrelatedEventGroup>;
+    using ShardSweep = std::function<void(const CorrelationShard&, Results&)>;
+    const size_t chunk_count = std::min(shards_.size(), pool.GetThreadCount());
+    std::vector<std::function<void(Results&)>> sweeps;
+    auto add_shard_sweeps = [&](ShardSweep sweep) {
+        for (size_t chunk = 0; chunk < chunk_count; ++chunk) {
+            const size_t begin = chunk * shards_.size() / chunk_count;
+            const size_t end = (chunk + 1) * shards_.size() / chunk_count;
+            sweeps.push_back([this, sweep, begin, end](Results& results) {
+                for (size_t i = begin; i < end; ++i) {
+                    sweep(*shards_[i], results);
+                }
+            });
+        }
+    };
+    
+    if (config_.enable_process_correlation) {
+        add_shard_sweeps([this, now](const CorrelationShard& shard, Results& results) {
+            SweepProcessEvents(shard, now, results);
+        });
+    }
+    if (config_.enable_time_correlation) {
+        sweeps.push_back([this](Results& results) {
+            EvaluateTimeWindow(results);
+        });
+    }
+    if (config_.enable_target_correlation) {
+        add_shard_sweeps([this, now](const CorrelationShard& shard, Results& results) {
+            SweepTargetEvents(shard, now, results);
+        });
+    }
+    if (config_.enable_threat_escalation) {
+        add_shard_sweeps([this](const CorrelationShard& shard, Results& results) {
+            SweepThreatEscalation(shard, results);
+        });
+    }
+    
+    std::vector<Results> results(sweeps.size());
+    std::vector<std::function<void()>> tasks;
+    tasks.reserve(sweeps.size());
+    for (size_t i = 0; i < sweeps.size(); ++i) {
+        tasks.push_back([&sweeps, &results, i]() { sweeps[i](results[i]); });
+    }
+    pool.RunAll(tasks);
+    locks.clear();
+    
+    for (auto& result : results) {
+        std::move(result.begin(), result.end(), std::back_inserter(detected));
+    }
+}
+
+void CorrelationEngine::DetectProcessBasedCorrelations(std::vector<CorrelatedEventGroup>& detected) {
+    auto now = CurrentTime();
+    
+    for (auto& shard : shards_) {
+        std::lock_guard<std::mutex> lock(shard->mutex);
+        ExpireIdleKeys(*shard, now);
+        SweepProcessEvents(*shard, now, detected);
+    }
+}
+
+void CorrelationEngine::SweepProcessEvents(const CorrelationShard& shard,
+                                           const std::chrono::system_clock::time_point& now,
+                                           std::vector<CorrelatedEventGroup>& detected) {
+    for (const auto& [process_id, key] : shard.process_events) {
+        EvaluateProcessEvents(process_id, key.events, key.aggregate.get(), now, detected);
+    }
+}
+
+void CorrelationEngine::DetectTimeBasedCorrelations(std::vector<CorrelatedEventGroup>& detected) {
+    std::lock_guard<std::mutex> lock(window_mutex_);
+    EvaluateTimeWindow(detected);
+}
+
+void CorrelationEngine::DetectTargetBasedCorrelations(std::vector<CorrelatedEventGroup>& detected) {
+    auto now = CurrentTime();
+    
+    for (auto& shard : shards_) {
+        std::lock_guard<std::mutex> lock(shard->mutex);
+        ExpireIdleKeys(*shard, now);
+        RotateSketches(*shard, now);
+        SweepTargetEvents(*shard, now, detected);
+    }
+}
+
+void CorrelationEngine::SweepTargetEvents(const CorrelationShard& shard,
+                                          const std::chrono::system_clock::time_point& now,
+                                          std::vector<CorrelatedEventGroup>& detected) {
+    for (const auto& [target, key] : shard.target_events) {
+        const auto* entry = shard.top_targets.Find(target);
+        EvaluateTargetEvents(target, key.events, key.aggregate.get(), entry ? &entry->payload : nullptr,
+                             now, detected);
+    }
+    if (config_.sketch_target_tracking) {
+        shard.top_targets.ForEach([&](const SpaceSavingTopK<std::string, TargetHitter>::Entry& entry) {
+            EvaluateTargetEvents(entry.key, entry.payload.events, nullptr, &entry.payload, now, detected);
+        });
+    }
+}
+
+void CorrelationEngine::DetectThreatEscalation(std::vector<CorrelatedEventGroup>& detected) {
+    for (auto& shard : shards_) {
+        std::lock_guard<std::mutex> lock(shard->mutex);
+        SweepThreatEscalation(*shard, detected);
+    }
+}
+
+void CorrelationEngine::SweepThreatEscalation(const CorrelationShard& shard,
+                                              std::vector<CorrelatedEventGroup>& detected) {
+    for (const auto& [process_id, key] : shard.process_events) {
+        EvaluateThreatEscalation(process_id, key, detected);
+    }
+}
+
+TrackedKey& CorrelationEngine::TouchProcessKey(CorrelationShard& shard, DWORD process_id,
+                                              const std::chrono::system_clock::time_point& now) {
+    auto [it, inserted] = shard.process_events.try_emplace(process_id);
+    TrackedKey& key = it->second;
+    
+    if (inserted) {
+        key.process_id = process_id;
+        key.idle_timer.owner = &key;
+        key.tracked_bytes = EstimateKeyBytes(0);
+        shard.tracked_bytes += key.tracked_bytes;
+        key.lru_position = shard.lru.insert(shard.lru.end(), &key);
+        shard.idle_timers.Schedule(key.idle_timer, ToTick(now + KeyIdleTimeout()) + 1);
+    } else {
+        shard.lru.splice(shard.lru.end(), shard.lru, key.lru_position);
+    }
+    
+    // The idle timer is not moved on access; when it fires it is re-armed
+    // from last_access if the key has been used since
+    key.last_access = now;
+    return key;
+}
+
+TrackedKey& CorrelationEngine::TouchTargetKey(CorrelationShard& shard, const std::string& target,
+                                             const std::chrono::system_clock::time_point& now) {
+    auto [it, inserted] = shard.target_events.try_emplace(target);
+    TrackedKey& key = it->second;
+    
+    if (inserted) {
+        key.is_target = true;
+        key.target = &it->first;
+        key.idle_timer.owner = &key;
+        key.tracked_bytes = EstimateKeyBytes(it->first.capacity());
+        shard.tracked_bytes += key.tracked_bytes;
+        key.lru_position = shard.lru.insert(shard.lru.end(), &key);
+        shard.idle_timers.Schedule(key.idle_timer, ToTick(now + KeyIdleTimeout()) + 1);
+    } else {
+        shard.lru.splice(shard.lru.end(), shard.lru, key.lru_position);
+    }
+    
+    key.last_access = now;
+    return key;
+}
+
+EventRef CorrelationEngine::EventOf(const TrackedEvent& tracked) const {
+    if (tracked.event) {
+        return tracked.event;
+    }
+    return archived_events_->Get(tracked.archived_index);
+}
+
+// Rough heap footprint of a tracked event, used for the memory budget. The
+// shared event is counted in full by every key that refers to it, so the
+// budget errs on the conservative side; an archived event counts an
+// average encoding in place of the strings it decodes to.
+size_t CorrelationEngine::EstimateTrackedBytes(const TrackedEvent& tracked) const {
+    if (tracked.event) {
+        return sizeof(TrackedEvent) + ApproximateEventBytes(*tracked.event);
+    }
+    return sizeof(TrackedEvent) + sizeof(SecurityEvent) +
+           archived_events_->GetAverageEncodedSize();
+}
+
+void CorrelationEngine::AppendTrackedEvent(CorrelationShard& shard, TrackedKey& key,
+                                           TrackedEvent tracked) {
+    // Long windows are counted in a fixed-size aggregate, which also sees
+    // the events the per-key limit drops below
+    if (UsesAggregate(WindowSpan(key.is_target ? config_.target_window_ms : config_.process_window_ms))) {
+        if (!key.aggregate) {
+            key.aggregate = std::make_unique<MultiResolutionWindow>();
+            key.tracked_bytes += MultiResolutionWindow::MemoryBytes();
+            shard.tracked_bytes += MultiResolutionWindow::MemoryBytes();
         }
-        
-        // Cleanup old events from time window
-        CleanupOldEvents();
+        key.aggregate->Add(tracked.timestamp, tracked.threat_level);
     }
     
-    processed_event_count_++;
+    key.events.push_back(std::move(tracked));
+    key.next_sequence++;
+    size_t bytes = EstimateTrackedBytes(key.events.back());
+    key.tracked_bytes += bytes;
+    shard.tracked_bytes += bytes;
     
-    // Detect correlations after each event
-    // Note: This is called synchronously for real-time detection. In high-volume
-    // environments, consider implementing asynchronous batch processing or
-    // periodic detection in a background thread. The current approach ensures
-    // immediate correlation detection which is critical for security monitoring.
-    // Performance impact: O(n*m) where n is tracked events per type and m is number
-    // of active processes/targets. Typically <100 events * <50 processes = ~5000
-    // operations, resulting in minimal overhead (~1-5ms on modern hardware).
-    DetectCorrelations();
+    // Limit events per key
+    if (key.events.size() > static_cast<size_t>(config_.max_events_per_process)) {
+        uint64_t dropped_sequence = key.next_sequence - key.events.size();
+        if (!key.escalation_steps.empty() && key.escalation_steps.front() == dropped_sequence) {
+            key.escalation_steps.pop_front();
+        }
+        
+        bytes = EstimateTrackedBytes(key.events.front());
+        key.events.pop_front();
+        key.tracked_bytes -= bytes;
+        shard.tracked_bytes -= bytes;
+    }
 }
 
-std::vector<CorrelatedEventGroup> CorrelationEngine::DetectCorrelations() {
-    std::vector<CorrelatedEventGroup> new_correlations;
+void CorrelationEngine::ExpireIdleKeys(CorrelationShard& shard,
+                                       const std::chrono::system_clock::time_point& now) {
+    const auto timeout = KeyIdleTimeout();
     
-    // Run different correlation detection algorithms
-    if (config_.enable_process_correlation) {
-        DetectProcessBasedCorrelations();
+    shard.idle_timers.Advance(ToTick(now), [&](TrackedKey& key) {
+        if (now - key.last_access >= timeout) {
+            EraseTrackedKey(shard, key);
+            idle_eviction_count_++;
+        } else {
+            shard.idle_timers.Schedule(key.idle_timer, ToTick(key.last_access + timeout) + 1);
+        }
+    });
+}
+
+void CorrelationEngine::EnforceMemoryBudget(CorrelationShard& shard, const TrackedKey& keep) {
+    if (shard_memory_budget_ == 0) {
+        return;
     }
     
-    if (config_.enable_time_correlation) {
-        DetectTimeBasedCorrelations();
+    while (shard.tracked_bytes > shard_memory_budget_ && shard.lru.front() != &keep) {
+        EraseTrackedKey(shard, *shard.lru.front());
+        budget_eviction_count_++;
     }
+}
+
+void CorrelationEngine::EraseTrackedKey(CorrelationShard& shard, TrackedKey& key) {
+    shard.idle_timers.Cancel(key.idle_timer);
+    shard.lru.erase(key.lru_position);
+    shard.tracked_bytes -= key.tracked_bytes;
     
-    if (config_.enable_target_correlation) {
-        DetectTargetBasedCorrelations();
+    if (key.is_target) {
+        shard.target_events.erase(shard.target_events.find(*key.target));
+    } else {
+        shard.process_events.erase(key.process_id);
+    }
+}
+
+std::chrono::seconds CorrelationEngine::KeyIdleTimeout() const {
+    if (config_.key_idle_timeout_seconds > 0) {
+        return std::chrono::seconds(config_.key_idle_timeout_seconds);
     }
     
-    if (config_.enable_sequence_correlation) {
-        DetectSequenceBasedCorrelations();
+    // Keys outlive the longest window they are evaluated over
+    auto longest = std::max({std::chrono::milliseconds(std::chrono::seconds(config_.time_window_seconds)),
+                             WindowSpan(config_.process_window_ms), WindowSpan(config_.target_window_ms)});
+    auto seconds = std::chrono::duration_cast<std::chrono::seconds>(longest);
+    return std::max(seconds, std::chrono::seconds(1));
+}
+
+uint64_t CorrelationEngine::SketchWindowsElapsed(const CorrelationShard& shard,
+                                                const std::chrono::system_clock::time_point& now) const {
+    const uint64_t window = ToTick(now) / static_cast<uint64_t>(std::max(config_.time_window_seconds, 1));
+    // A late event (or a clock step back) stays in the current window
+    return window > shard.sketch_window ? window - shard.sketch_window : 0;
+}
+
+void CorrelationEngine::RotateSketches(CorrelationShard& shard,
+                                       const std::chrono::system_clock::time_point& now) const {
+    const uint64_t elapsed = SketchWindowsElapsed(shard, now);
+    if (elapsed == 0) {
+        return;
     }
     
-    if (config_.enable_threat_escalation) {
-        DetectThreatEscalation();
+    // Every elapsed window halves the counts; distinct-process estimates
+    // cover the current and the previous window only
+    shard.sketch_window += elapsed;
+    
+    if (elapsed > 32) {
+        shard.target_counts.Clear();
+        shard.process_counts.Clear();
+        shard.top_targets.ForEach([](SpaceSavingTopK<std::string, TargetHitter>::Entry& entry) {
+            entry.count = 0;
+            entry.error = 0;
+        });
+        shard.top_processes.ForEach([](SpaceSavingTopK<DWORD>::Entry& entry) {
+            entry.count = 0;
+            entry.error = 0;
+        });
+    } else {
+        for (uint64_t i = 0; i < elapsed; ++i) {
+            shard.target_counts.Decay();
+            shard.process_counts.Decay();
+            shard.top_targets.Decay();
+            shard.top_processes.Decay();
+        }
     }
     
-    // Return new correlations
-    {
-        std::lock_guard<std::mutex> lock(correlations_mutex_);
-        new_correlations = active_correlations_;
+    shard.top_targets.ForEach([elapsed](SpaceSavingTopK<std::string, TargetHitter>::Entry& entry) {
+        if (elapsed == 1) {
+            entry.payload.previous_processes = entry.payload.processes;
+        } else {
+            entry.payload.previous_processes.Clear();
+        }
+        entry.payload.processes.Clear();
+    });
+}
+
+TargetHitter* CorrelationEngine::CountTarget(CorrelationShard& shard, const SecurityEvent& event,
+                                             size_t target_hash) {
+    if (shard.top_targets.Capacity() == 0) {
+        return nullptr;
     }
     
-    return new_correlations;
+    uint32_t estimate = shard.target_counts.Add(target_hash);
+    auto* entry = shard.top_targets.Offer(event.target_path, 1, estimate);
+    if (!entry) {
+        return nullptr;
+    }
+    entry->payload.processes.Add(event.process_id);
+    return &entry->payload;
 }
 
-void CorrelationEngine::DetectProcessBasedCorrelations() {
-    std::lock_guard<std::mutex> lock(events_mutex_);
+void CorrelationEngine::CountProcess(CorrelationShard& shard, DWORD process_id) {
+    if (shard.top_processes.Capacity() == 0) {
+        return;
+    }
     
-    for (auto& [process_id, events] : process_events_) {
-        if (events.size() < static_cast<size_t>(config_.min_events_for_correlation)) {
-            continue;
-        }
-        
-        // Extract recent events within time window
-        auto now = std::chrono::system_clock::now();
-        std::vector<SecurityEvent> recent_events;
-        
+    uint32_t estimate = shard.process_counts.Add(process_id);
+    shard.top_processes.Offer(process_id, 1, estimate);
+}
+
+void CorrelationEngine::EvaluateProcessEvents(DWORD process_id, const std::deque<TrackedEvent>& events,
+                                              const MultiResolutionWindow* aggregate,
+                                              const std::chrono::system_clock::time_point& now,
+                                              std::vector<CorrelatedEventGroup>& detected) {
+    if (!aggregate && events.size() < static_cast<size_t>(config_.min_events_for_correlation)) {
+        return;
+    }
+    
+    // Score the recent events from the window entries first; events are
+    // only collected for a significant group
+    const auto span = WindowSpan(config_.process_window_ms);
+    ThreatCounts counts = CountRecentEvents(events, aggregate, span, now);
+    if (counts.total < static_cast<uint32_t>(config_.min_events_for_correlation)) {
+        return;
+    }
+    double score = CalculateCorrelationScore(counts, CorrelationType::PROCESS_BASED);
+    
+    if (IsCorrelationSignificant(score)) {
+        // Extract recent events within time window; with an aggregate these
+        // are the retained part of a longer window
+        EventRefs recent_events;
+        recent_events.reserve(std::min<size_t>(counts.total, events.size()));
         for (const auto& tracked : events) {
-            if (IsWithinTimeWindow(tracked.timestamp, now)) {
-                recent_events.push_back(tracked.event);
+            if (IsWithinSpan(tracked.timestamp, now, span)) {
+                recent_events.push_back(EventOf(tracked));
             }
         }
+        if (recent_events.empty()) {
+            return;
+        }
         
-        if (recent_events.size() >= static_cast<size_t>(config_.min_events_for_correlation) &&
-            IsCorrelationSignificant(recent_events, CorrelationType::PROCESS_BASED)) {
-            
-            CorrelatedEventGroup group;
-            group.correlation_id = GenerateCorrelationId();
-            group.type = CorrelationType::PROCESS_BASED;
-            group.events = recent_events;
-            group.combined_threat_level = CalculateCombinedThreatLevel(recent_events);
-            group.correlation_score = CalculateCorrelationScore(recent_events, CorrelationType::PROCESS_BASED);
-            group.first_event_time = recent_events.front().timestamp;
-            group.last_event_time = recent_events.back().timestamp;
-            
-            std::ostringstream desc;
-            desc << "Multiple correlated events (" << recent_events.size() 
-                 << ") detected from process " << process_id;
-            group.description = desc.str();
-            
-            group.metadata["process_id"] = std::to_string(process_id);
-            group.metadata["event_count"] = std::to_string(recent_events.size());
-            
-            AddCorrelationGroup(group);
+        CorrelatedEventGroup group;
+        group.correlation_id = GenerateCorrelationId();
+        group.type = CorrelationType::PROCESS_BASED;
+        group.combined_threat_level = CalculateCombinedThreatLevel(counts);
+        group.correlation_score = score;
+        group.first_event_time = recent_events.front().timestamp;
+        group.last_event_time = recent_events.back().timestamp;
+        
+        std::ostringstream desc;
+        desc << "Multiple correlated events (" << counts.total 
+             << ") detected from process " << process_id;
+        group.description = desc.str();
+        
+        group.metadata["process_id"] = std::to_string(process_id);
+        group.metadata["event_count"] = std::to_string(recent_events.size());
+        group.metadata["window_ms"] = std::to_string((span - std::chrono::milliseconds(1)).count());
+        if (aggregate) {
+            group.metadata["window_event_count"] = std::to_string(counts.total);
         }
+        
+        group.events = std::move(recent_events);
+        detected.push_back(std::move(group));
     }
 }
 
-void CorrelationEngine::DetectTimeBasedCorrelations() {
-    std::lock_guard<std::mutex> lock(events_mutex_);
-    
-    if (time_window_events_.size() < static_cast<size_t>(config_.min_events_for_correlation)) {
+void CorrelationEngine::EvaluateTimeWindow(std::vector<CorrelatedEventGroup>& detected) {
+    // The running counts score a burst without scanning the window; the
+    // window is only read once a burst is significant
+    ThreatCounts counts;
+    counts.levels[static_cast<size_t>(ThreatLevel::HIGH)] = window_threat_counts_.Count(ThreatLevel::HIGH);
+    counts.levels[static_cast<size_t>(ThreatLevel::CRITICAL)] = window_threat_counts_.Count(ThreatLevel::CRITICAL);
+    counts.total = window_threat_counts_.HighThreat();
+    if (counts.total < static_cast<uint32_t>(config_.min_events_for_correlation)) {
         return;
     }
+    double score = CalculateCorrelationScore(counts, CorrelationType::TIME_BASED);
     
-    // Look for bursts of high-threat events
-    std::vector<SecurityEvent> high_threat_events;
-    
-    for (const auto& tracked : time_window_events_) {
-        if (tracked.event.threat_level == ThreatLevel::HIGH || 
-            tracked.event.threat_level == ThreatLevel::CRITICAL) {
-            high_threat_events.push_back(tracked.event);
+    if (IsCorrelationSignificant(score)) {
+        // Look for bursts of high-threat events
+        EventRefs high_threat_events;
+        high_threat_events.reserve(counts.total);
+        for (const auto& tracked : time_window_events_) {
+            if (IsHighThreat(tracked.threat_level)) {
+                high_threat_events.push_back(EventOf(tracked));
+            }
         }
-    }
-    
-    if (high_threat_events.size() >= static_cast<size_t>(config_.min_events_for_correlation) &&
-        IsCorrelationSignificant(high_threat_events, CorrelationType::TIME_BASED)) {
         
         CorrelatedEventGroup group;
         group.correlation_id = GenerateCorrelationId();
         group.type = CorrelationType::TIME_BASED;
-        group.events = high_threat_events;
-        group.combined_threat_level = CalculateCombinedThreatLevel(high_threat_events);
-        group.correlation_score = CalculateCorrelationScore(high_threat_events, CorrelationType::TIME_BASED);
+        group.combined_threat_level = CalculateCombinedThreatLevel(counts);
+        group.correlation_score = score;
         group.first_event_time = high_threat_events.front().timestamp;
         group.last_event_time = high_threat_events.back().timestamp;
         
@@ -247,149 +1281,269 @@ void CorrelationEngine::DetectTimeBasedCorrelations() {
         
         group.metadata["event_count"] = std::to_string(high_threat_events.size());
         group.metadata["time_window"] = std::to_string(config_.time_window_seconds);
+        group.metadata["window_ms"] = std::to_string(
+            (WindowSpan(config_.burst_window_ms) - std::chrono::milliseconds(1)).count());
         
-        AddCorrelationGroup(group);
+        group.events = std::move(high_threat_events);
+        detected.push_back(std::move(group));
     }
 }
 
-void CorrelationEngine::DetectTargetBasedCorrelations() {
-    std::lock_guard<std::mutex> lock(events_mutex_);
+void CorrelationEngine::EvaluateTargetEvents(const std::string& target, const std::deque<TrackedEvent>& events,
+                                             const MultiResolutionWindow* aggregate,
+                                             const TargetHitter* hitter,
+                                             const std::chrono::system_clock::time_point& now,
+                                             std::vector<CorrelatedEventGroup>& detected) {
+    if (!aggregate && events.size() < static_cast<size_t>(config_.min_events_for_correlation)) {
+        return;
+    }
     
-    for (auto& [target, events] : target_events_) {
-        if (events.size() < static_cast<size_t>(config_.min_events_for_correlation)) {
-            continue;
-        }
-        
+    const auto span = WindowSpan(config_.target_window_ms);
+    ThreatCounts counts = CountRecentEvents(events, aggregate, span, now);
+    if (counts.total < static_cast<uint32_t>(config_.min_events_for_correlation)) {
+        return;
+    }
+    double score = CalculateCorrelationScore(counts, CorrelationType::TARGET_BASED);
+    
+    if (IsCorrelationSignificant(score)) {
         // Extract recent events within time window
-        auto now = std::chrono::system_clock::now();
-        std::vector<SecurityEvent> recent_events;
-        
+        EventRefs recent_events;
+        recent_events.reserve(std::min<size_t>(counts.total, events.size()));
         for (const auto& tracked : events) {
-            if (IsWithinTimeWindow(tracked.timestamp, now)) {
-                recent_events.push_back(tracked.event);
+            if (IsWithinSpan(tracked.timestamp, now, span)) {
+                recent_events.push_back(EventOf(tracked));
             }
         }
+        if (recent_events.empty()) {
+            return;
+        }
         
-        if (recent_events.size() >= static_cast<size_t>(config_.min_events_for_correlation) &&
-            IsCorrelationSignificant(recent_events, CorrelationType::TARGET_BASED)) {
-            
-            CorrelatedEventGroup group;
-            group.correlation_id = GenerateCorrelationId();
-            group.type = CorrelationType::TARGET_BASED;
-            group.events = recent_events;
-            group.combined_threat_level = CalculateCombinedThreatLevel(recent_events);
-            group.correlation_score = CalculateCorrelationScore(recent_events, CorrelationType::TARGET_BASED);
-            group.first_event_time = recent_events.front().timestamp;
-            group.last_event_time = recent_events.back().timestamp;
-            
-            std::ostringstream desc;
-            desc << "Multiple processes (" << recent_events.size() 
-                 << " events) targeting same file/registry: " << target;
-            group.description = desc.str();
-            
-            group.metadata["target"] = target;
-            group.metadata["event_count"] = std::to_string(recent_events.size());
-            
-            AddCorrelationGroup(group);
+        CorrelatedEventGroup group;
+        group.correlation_id = GenerateCorrelationId();
+        group.type = CorrelationType::TARGET_BASED;
+        group.combined_threat_level = CalculateCombinedThreatLevel(counts);
+        group.correlation_score = score;
+        group.first_event_time = recent_events.front().timestamp;
+        group.last_event_time = recent_events.back().timestamp;
+        
+        std::ostringstream desc;
+        desc << "Multiple processes (" << counts.total 
+             << " events) targeting same file/registry: " << target;
+        group.description = desc.str();
+        
+        group.metadata["target"] = target;
+        group.metadata["event_count"] = std::to_string(recent_events.size());
+        group.metadata["window_ms"] = std::to_string((span - std::chrono::milliseconds(1)).count());
+        if (aggregate) {
+            group.metadata["window_event_count"] = std::to_string(counts.total);
+        }
+        if (hitter) {
+            HyperLogLog processes = hitter->processes;
+            processes.Merge(hitter->previous_processes);
+            group.metadata["distinct_processes"] = std::to_string(processes.Estimate());
         }
+        
+        group.events = std::move(recent_events);
+        detected.push_back(std::move(group));
     }
 }
 
-void CorrelationEngine::DetectSequenceBasedCorrelations() {
-    std::lock_guard<std::mutex> lock(events_mutex_);
-    
-    // Check time window events for known attack patterns
-    if (time_window_events_.size() < static_cast<size_t>(config_.min_events_for_correlation)) {
-        return;
-    }
+void CorrelationEngine::DetectSequenceBasedCorrelations(const EventRef& event,
+                                                         const std::chrono::system_clock::time_point& now,
+                                                         std::vector<CorrelatedEventGroup>& detected) {
+    std::vector<SequenceMatch> matches;
     
-    std::vector<SecurityEvent> events;
-    for (const auto& tracked : time_window_events_) {
-        events.push_back(tracked.event);
+    {
+        std::lock_guard<std::mutex> lock(sequence_mutex_);
+        
+        // Expired partial matches are dropped lazily when touched; sweep the
+        // rest at most once per second so idle pids do not accumulate
+        if (now - last_sequence_sweep_ >= std::chrono::seconds(1)) {
+            sequence_matcher_.ExpireMatches(now);
+            last_sequence_sweep_ = now;
+        }
+        
+        sequence_matcher_.ProcessEvent(event, now, matches);
     }
     
-    if (MatchesAttackPattern(events)) {
+    for (auto& match : matches) {
         CorrelatedEventGroup group;
         group.correlation_id = GenerateCorrelationId();
         group.type = CorrelationType::SEQUENCE_BASED;
-        group.events = events;
-        group.combined_threat_level = ThreatLevel::CRITICAL;
-        group.correlation_score = 0.9; // High score for pattern matches
-        group.first_event_time = events.front().timestamp;
-        group.last_event_time = events.back().timestamp;
-        group.description = DescribeAttackPattern(events);
+        group.combined_threat_level = match.threat_level;
+        group.correlation_score = match.score;
+        group.first_event_time = match.events.front().timestamp;
+        group.last_event_time = match.events.back().timestamp;
+        group.description = "Known attack pattern detected: " + match.description;
         
         group.metadata["pattern_type"] = "known_attack_sequence";
-        group.metadata["event_count"] = std::to_string(events.size());
+        group.metadata["pattern_name"] = match.pattern_name;
+        group.metadata["pattern_scope"] = PatternScopeToString(match.scope);
+        group.metadata["process_id"] = std::to_string(match.root_process_id);
+        group.metadata["event_count"] = std::to_string(match.events.size());
         
-        AddCorrelationGroup(group);
+        group.events = std::move(match.events);
+        detected.push_back(std::move(group));
     }
 }
 
-void CorrelationEngine::DetectThreatEscalation() {
-    std::lock_guard<std::mutex> lock(events_mutex_);
+void CorrelationEngine::DetectLineageBasedCorrelations(const EventRef& event_ref,
+                                                        const std::chrono::system_clock::time_point& timestamp,
+                                                        const std::chrono::system_clock::time_point& now,
+                                                        std::vector<CorrelatedEventGroup>& detected) {
+    const SecurityEvent& event = *event_ref;
+    std::lock_guard<std::mutex> lock(lineage_mutex_);
+    
+    // Keep the lineage table current
+    if (event.type == EventType::PROCESS_CREATION) {
+        DWORD parent_pid = ProcessLineageTable::ParentPidFromEvent(event);
+        if (parent_pid != 0) {
+            lineage_.RecordProcessStart(event.process_id, parent_pid, now);
+            lineage_windows_.erase(event.process_id);
+        }
+    } else if (event.type == EventType::PROCESS_TERMINATION) {
+        lineage_scratch_.clear();
+        lineage_.RecordProcessExit(event.process_id, now, lineage_scratch_);
+        for (DWORD evicted : lineage_scratch_) {
+            lineage_windows_.erase(evicted);
+        }
+    }
+    
+    // A late event outside the lineage window still updates the table
+    if (!lineage_.Contains(event.process_id) ||
+        !IsWithinSpan(timestamp, now, WindowSpan(config_.lineage_window_ms))) {
+        return;
+    }
+    
+    // The event belongs to the subtree of its own process and every ancestor
+    lineage_scratch_.clear();
+    lineage_scratch_.push_back(event.process_id);
+    lineage_.GetAncestors(event.process_id, lineage_scratch_);
+    
+    for (DWORD pid : lineage_scratch_) {
+        AppendLineageEvent(lineage_windows_[pid], event_ref, timestamp, now);
+    }
     
-    for (auto& [process_id, events] : process_events_) {
-        if (events.size() < 2) {
+    // Report the nearest ancestor whose subtree shows correlated activity
+    // across processes; wider subtrees would only repeat the same events
+    for (DWORD root_pid : lineage_scratch_) {
+        const LineageWindow& window = lineage_windows_[root_pid];
+        
+        if (window.process_event_counts.size() < 2 ||
+            window.events.size() < static_cast<size_t>(config_.min_events_for_correlation)) {
             continue;
         }
         
-        // Check if threat level is increasing
-        bool escalating = false;
-        ThreatLevel prev_level = ThreatLevel::LOW;
-        std::vector<SecurityEvent> escalation_events;
+        double score = CalculateCorrelationScore(window.threat_counts, CorrelationType::LINEAGE_BASED);
+        if (!IsCorrelationSignificant(score)) {
+            continue;
+        }
         
-        for (const auto& tracked : events) {
-            if (static_cast<int>(tracked.event.threat_level) > static_cast<int>(prev_level)) {
-                escalating = true;
-                escalation_events.push_back(tracked.event);
-            }
-            prev_level = tracked.event.threat_level;
-        }
-        
-        if (escalating && escalation_events.size() >= static_cast<size_t>(config_.min_events_for_correlation)) {
-            CorrelatedEventGroup group;
-            group.correlation_id = GenerateCorrelationId();
-            group.type = CorrelationType::THREAT_ESCALATION;
-            group.events = escalation_events;
-            group.combined_threat_level = CalculateCombinedThreatLevel(escalation_events);
-            group.correlation_score = 0.85; // High score for escalation
-            group.first_event_time = escalation_events.front().timestamp;
-            group.last_event_time = escalation_events.back().timestamp;
-            
-            std::ostringstream desc;
-            desc << "Threat escalation detected from process " << process_id 
-                 << " with " << escalation_events.size() << " escalating events";
-            group.description = desc.str();
-            
-            group.metadata["process_id"] = std::to_string(process_id);
-            group.metadata["escalation_type"] = "threat_level_increase";
-            
-            AddCorrelationGroup(group);
+        EventRefs subtree_events;
+        subtree_events.reserve(window.events.size());
+        for (const auto& tracked : window.events) {
+            subtree_events.push_back(EventOf(tracked));
+        }
+        
+        CorrelatedEventGroup group;
+        group.correlation_id = GenerateCorrelationId();
+        group.type = CorrelationType::LINEAGE_BASED;
+        group.combined_threat_level = CalculateCombinedThreatLevel(window.threat_counts);
+        group.correlation_score = score;
+        group.first_event_time = subtree_events.front().timestamp;
+        group.last_event_time = subtree_events.back().timestamp;
+        
+        std::ostringstream desc;
+        desc << "Correlated events (" << subtree_events.size() << ") from process "
+             << root_pid << " and " << (window.process_event_counts.size() - 1)
+             << " descendant process(es)";
+        group.description = desc.str();
+        
+        group.metadata["root_process_id"] = std::to_string(root_pid);
+        group.metadata["process_count"] = std::to_string(window.process_event_counts.size());
+        group.metadata["event_count"] = std::to_string(subtree_events.size());
+        
+        group.events = std::move(subtree_events);
+        detected.push_back(std::move(group));
+        break;
+    }
+}
+
+void CorrelationEngine::AppendLineageEvent(LineageWindow& window, const EventRef& event,
+                                           const std::chrono::system_clock::time_point& timestamp,
+                                           const std::chrono::system_clock::time_point& now) {
+    InsertInTimeOrder(window.events, MakeTrackedEvent(event, timestamp));
+    window.process_event_counts[event->process_id]++;
+    window.threat_counts.Add(event->threat_level);
+    
+    // Drop events outside the lineage window or beyond the per-key limit
+    const auto span = WindowSpan(config_.lineage_window_ms);
+    while (!window.events.empty() &&
+           (window.events.size() > static_cast<size_t>(config_.max_events_per_process) ||
+            !IsWithinSpan(window.events.front().timestamp, now, span))) {
+        const TrackedEvent& oldest = window.events.front();
+        auto count_it = window.process_event_counts.find(oldest.process_id);
+        if (--count_it->second == 0) {
+            window.process_event_counts.erase(count_it);
         }
+        window.threat_counts.Remove(oldest.threat_level);
+        window.events.pop_front();
+    }
+}
+
+void CorrelationEngine::EvaluateThreatEscalation(DWORD process_id, const TrackedKey& key,
+                                                 std::vector<CorrelatedEventGroup>& detected) {
+    // The state machine already holds the escalating events; only they are
+    // read back, never the rest of the history
+    if (key.escalation_steps.size() < static_cast<size_t>(config_.min_events_for_correlation)) {
+        return;
+    }
+    
+    const uint64_t first_sequence = key.next_sequence - key.events.size();
+    EventRefs escalation_events;
+    ThreatCounts counts;
+    escalation_events.reserve(key.escalation_steps.size());
+    for (uint64_t sequence : key.escalation_steps) {
+        const TrackedEvent& tracked = key.events[static_cast<size_t>(sequence - first_sequence)];
+        escalation_events.push_back(EventOf(tracked));
+        counts.Add(tracked.threat_level);
     }
+    
+    CorrelatedEventGroup group;
+    group.correlation_id = GenerateCorrelationId();
+    group.type = CorrelationType::THREAT_ESCALATION;
+    group.combined_threat_level = CalculateCombinedThreatLevel(counts);
+    group.correlation_score = 0.85; // High score for escalation
+    group.first_event_time = escalation_events.front().timestamp;
+    group.last_event_time = escalation_events.back().timestamp;
+    
+    std::ostringstream desc;
+    desc << "Threat escalation detected from process " << process_id 
+         << " with " << escalation_events.size() << " escalating events";
+    group.description = desc.str();
+    
+    group.metadata["process_id"] = std::to_string(process_id);
+    group.metadata["escalation_type"] = "threat_level_increase";
+    group.metadata["escalation_steps"] = std::to_string(escalation_events.size());
+    group.metadata["current_threat_level"] = std::to_string(static_cast<int>(key.last_threat_level));
+    
+    group.events = std::move(escalation_events);
+    detected.push_back(std::move(group));
 }
 
-double CorrelationEngine::CalculateCorrelationScore(const std::vector<SecurityEvent>& events, 
-                                                     CorrelationType type) {
-    if (events.empty()) {
+double CorrelationEngine::CalculateCorrelationScore(const ThreatCounts& counts,
+                                                     CorrelationType type) const {
+    if (counts.total == 0) {
         return 0.0;
     }
     
     double score = 0.0;
     
     // Base score on event count
-    score += std::min(static_cast<double>(events.size()) / 10.0, 0.3);
+    score += std::min(static_cast<double>(counts.total) / 10.0, 0.3);
     
     // Add score for threat level
-    int high_threat_count = 0;
-    for (const auto& event : events) {
-        if (event.threat_level == ThreatLevel::HIGH || 
-            event.threat_level == ThreatLevel::CRITICAL) {
-            high_threat_count++;
-        }
-    }
-    score += (static_cast<double>(high_threat_count) / events.size()) * 0.4;
+    score += (static_cast<double>(counts.HighThreat()) / counts.total) * 0.4;
     
     // Add score based on correlation type
     switch (type) {
@@ -399,6 +1553,9 @@ double CorrelationEngine::CalculateCorrelationScore(const std::vector<SecurityEv
         case CorrelationType::TARGET_BASED:
             score += 0.25; // Same target is very significant
             break;
+        case CorrelationType::LINEAGE_BASED:
+            score += 0.25; // Parent and descendants acting together is very significant
+            break;
         case CorrelationType::SEQUENCE_BASED:
             score += 0.3; // Pattern match is highly significant
             break;
@@ -413,28 +1570,22 @@ double CorrelationEngine::CalculateCorrelationScore(const std::vector<SecurityEv
     return std::min(score, 1.0);
 }
 
-ThreatLevel CorrelationEngine::CalculateCombinedThreatLevel(const std::vector<SecurityEvent>& events) {
-    if (events.empty()) {
+ThreatLevel CorrelationEngine::CalculateCombinedThreatLevel(const ThreatCounts& counts) const {
+    if (counts.total == 0) {
         return ThreatLevel::LOW;
     }
     
     // Find the highest threat level
     ThreatLevel max_level = ThreatLevel::LOW;
-    int critical_count = 0;
-    int high_count = 0;
-    
-    for (const auto& event : events) {
-        if (static_cast<int>(event.threat_level) > static_cast<int>(max_level)) {
-            max_level = event.threat_level;
-        }
-        
-        if (event.threat_level == ThreatLevel::CRITICAL) {
-            critical_count++;
-        } else if (event.threat_level == ThreatLevel::HIGH) {
-            high_count++;
+    for (ThreatLevel level : {ThreatLevel::MEDIUM, ThreatLevel::HIGH, ThreatLevel::CRITICAL}) {
+        if (counts.Count(level) > 0) {
+            max_level = level;
         }
     }
     
+    const uint32_t critical_count = counts.Count(ThreatLevel::CRITICAL);
+    const uint32_t high_count = counts.Count(ThreatLevel::HIGH);
+    
     // If multiple high/critical threats, escalate
     if (critical_count >= 2 || (critical_count >= 1 && high_count >= 2)) {
         return ThreatLevel::CRITICAL;
@@ -445,72 +1596,91 @@ ThreatLevel CorrelationEngine::CalculateCombinedThreatLevel(const std::vector<Se
     }
     
     // Escalate by one level if many events
-    if (events.size() >= 5 && max_level != ThreatLevel::CRITICAL) {
+    if (counts.total >= 5 && max_level != ThreatLevel::CRITICAL) {
         return static_cast<ThreatLevel>(static_cast<int>(max_level) + 1);
     }
     
     return max_level;
 }
 
-bool CorrelationEngine::IsCorrelationSignificant(const std::vector<SecurityEvent>& events, 
-                                                  CorrelationType type) {
-    double score = CalculateCorrelationScore(events, type);
+bool CorrelationEngine::IsCorrelationSignificant(double score) const {
     return score >= config_.min_correlation_score;
 }
 
-void CorrelationEngine::AddCorrelationGroup(const CorrelatedEventGroup& group) {
-    std::lock_guard<std::mutex> lock(correlations_mutex_);
+ThreatCounts CorrelationEngine::CountRecentEvents(const std::deque<TrackedEvent>& events,
+                                                  const MultiResolutionWindow* aggregate,
+                                                  std::chrono::milliseconds span,
+                                                  const std::chrono::system_clock::time_point& now) const {
+    if (aggregate) {
+        return aggregate->Count(now, span);
+    }
     
-    // Check if similar correlation already exists
-    // Note: This uses linear search which is O(n) where n is active correlations.
-    // For most use cases with <1000 active correlations, this is acceptable.
-    // For high-volume scenarios, consider using a hash-based index on
-    // (type, process_id) for O(1) duplicate detection.
-    bool duplicate = false;
-    for (const auto& existing : active_correlations_) {
-        if (existing.type == group.type && 
-            existing.events.size() == group.events.size() &&
-            !existing.events.empty() && !group.events.empty() &&
-            existing.events.front().process_id == group.events.front().process_id) {
-            duplicate = true;
-            break;
+    // IsWithinSpan as two comparisons
+    const auto earliest = now - span;
+    const auto latest = now + span;
+    
+    ThreatCounts counts;
+    for (const auto& tracked : events) {
+        if (tracked.timestamp > earliest && tracked.timestamp < latest) {
+            counts.Add(tracked.threat_level);
         }
     }
+    return counts;
+}
+
+void CorrelationEngine::AddCorrelationGroups(std::vector<CorrelatedEventGroup>& groups,
+                                             std::vector<CorrelationGroupPtr>& stored) {
+    // Summaries are computed outside the lock; the store indexes them for
+    // O(1) duplicate detection
+    for (auto& group : groups) {
+        group.summary = SummarizeEvents(group.events);
+    }
     
-    if (!duplicate) {
-        active_correlations_.push_back(group);
-        correlation_count_++;
-        
-        // Limit number of correlations
-        if (active_correlations_.size() > static_cast<size_t>(config_.max_correlation_groups)) {
-            active_correlations_.erase(active_correlations_.begin());
-        }
-        
-        // Notify callback if registered
-        {
-            std::lock_guard<std::mutex> cb_lock(callback_mutex_);
-            if (correlation_callback_) {
-                correlation_callback_(group);
-            }
+    std::lock_guard<std::mutex> lock(correlations_mutex_);
+    for (auto& group : groups) {
+        CorrelationGroupPtr added = correlation_store_.Add(std::move(group));
+        if (added) {
+            correlation_count_++;
+            stored.push_back(std::move(added));
         }
     }
 }
 
-void CorrelationEngine::CleanupOldEvents() {
-    auto now = std::chrono::system_clock::now();
+void CorrelationEngine::NotifyCorrelations(const std::vector<CorrelationGroupPtr>& groups) {
+    if (groups.empty()) {
+        return;
+    }
+    
+    // Copy the callback so user code never runs under callback_mutex_ and
+    // may safely call back into the engine
+    CorrelationCallback callback;
+    {
+        std::lock_guard<std::mutex> lock(callback_mutex_);
+        callback = correlation_callback_;
+    }
     
+    if (callback) {
+        for (const auto& group : groups) {
+            callback(*group);
+        }
+    }
+}
+
+void CorrelationEngine::CleanupOldEvents(const std::chrono::system_clock::time_point& now) {
     // Clean up time window events
+    const auto span = WindowSpan(config_.burst_window_ms);
     while (!time_window_events_.empty()) {
-        if (IsWithinTimeWindow(time_window_events_.front().timestamp, now)) {
+        if (IsWithinSpan(time_window_events_.front().timestamp, now, span)) {
             break;
         }
+        window_threat_counts_.Remove(time_window_events_.front().threat_level);
         time_window_events_.pop_front();
     }
 }
 
 std::string CorrelationEngine::GenerateCorrelationId() {
     static std::atomic<uint64_t> counter{0};
-    auto now = std::chrono::system_clock::now();
+    auto now = clock_->Now();
     auto timestamp = std::chrono::duration_cast<std::chrono::milliseconds>(
         now.time_since_epoch()).count();
     
@@ -519,103 +1689,112 @@ std::string CorrelationEngine::GenerateCorrelationId() {
     return oss.str();
 }
 
-bool CorrelationEngine::IsWithinTimeWindow(const std::chrono::system_clock::time_point& time1,
-                                            const std::chrono::system_clock::time_point& time2) const {
-    auto diff = std::chrono::duration_cast<std::chrono::seconds>(
-        time2 > time1 ? time2 - time1 : time1 - time2);
-    return diff.count() <= config_.time_window_seconds;
+std::chrono::milliseconds CorrelationEngine::WindowSpan(int window_ms) const {
+    if (window_ms > 0) {
+        return std::chrono::milliseconds(window_ms + 1);
+    }
+    return std::chrono::seconds(config_.time_window_seconds + 1);
 }
 
-bool CorrelationEngine::MatchesAttackPattern(const std::vector<SecurityEvent>& events) {
-    if (events.size() < 3) {
-        return false;
-    }
-    
-    // Pattern 1: Process creation -> File modification -> Registry modification
-    bool has_process_creation = false;
-    bool has_file_mod = false;
-    bool has_registry_mod = false;
-    
-    for (const auto& event : events) {
-        if (event.type == EventType::PROCESS_CREATION) {
-            has_process_creation = true;
-        } else if (event.type == EventType::FILE_MODIFICATION || 
-                   event.type == EventType::FILE_DELETION) {
-            has_file_mod = true;
-        } else if (event.type == EventType::REGISTRY_MODIFICATION) {
-            has_registry_mod = true;
+bool CorrelationEngine::UsesAggregate(std::chrono::milliseconds span) const {
+    return config_.max_raw_window_seconds > 0 && span > std::chrono::seconds(config_.max_raw_window_seconds + 1);
+}
+
+void CorrelationEngine::ClampAggregateWindows() {
+    // An aggregate answers nothing older than its horizon, so a longer
+    // window would silently count less than it claims
+    const std::chrono::milliseconds horizon(MultiResolutionWindow::kHorizonMs);
+    for (int* window_ms : {&config_.process_window_ms, &config_.target_window_ms}) {
+        const auto span = WindowSpan(*window_ms);
+        if (UsesAggregate(span) && span > horizon + std::chrono::milliseconds(1)) {
+            *window_ms = static_cast<int>(horizon.count());
         }
     }
-    
-    if (has_process_creation && has_file_mod && has_registry_mod) {
-        return true;
-    }
-    
-    // Pattern 2: Memory injection followed by file/registry changes
-    bool has_memory_injection = false;
-    for (const auto& event : events) {
-        if (event.type == EventType::MEMORY_INJECTION) {
-            has_memory_injection = true;
-            break;
-        }
+}
+
+bool CorrelationEngine::IsWithinSpan(const std::chrono::system_clock::time_point& time1,
+                                     const std::chrono::system_clock::time_point& time2,
+                                     std::chrono::milliseconds span) {
+    return (time2 > time1 ? time2 - time1 : time1 - time2) < span;
+}
+
+void CorrelationEngine::CompileAttackPatterns() {
+    std::lock_guard<std::mutex> lock(sequence_mutex_);
+    // The matcher works in whole seconds; sub-second windows round up
+    int window_seconds = config_.sequence_window_ms > 0 ?
+        (config_.sequence_window_ms + 999) / 1000 : config_.time_window_seconds;
+    sequence_matcher_.Compile(config_.attack_patterns,
+                              window_seconds,
+                              static_cast<size_t>(std::max(config_.max_partial_matches, 0)));
+    last_sequence_sweep_ = std::chrono::system_clock::time_point();
+}
+
+std::vector<CorrelatedEventGroup> CorrelationEngine::GetActiveCorrelations() const {
+    std::vector<CorrelationGroupPtr> groups;
+    {
+        std::lock_guard<std::mutex> lock(correlations_mutex_);
+        correlation_store_.Snapshot(groups);
     }
     
-    if (has_memory_injection && (has_file_mod || has_registry_mod)) {
-        return true;
+    // Copies group headers; events are shared references
+    std::vector<CorrelatedEventGroup> result;
+    result.reserve(groups.size());
+    for (const auto& group : groups) {
+        result.push_back(*group);
     }
-    
-    return false;
+    return result;
 }
 
-std::string CorrelationEngine::DescribeAttackPattern(const std::vector<SecurityEvent>& events) {
-    std::ostringstream desc;
-    desc << "Known attack pattern detected: ";
-    
-    // Analyze the pattern
-    bool has_process_creation = false;
-    bool has_file_mod = false;
-    bool has_registry_mod = false;
-    bool has_memory_injection = false;
-    
-    for (const auto& event : events) {
-        switch (event.type) {
-            case EventType::PROCESS_CREATION:
-                has_process_creation = true;
-                break;
-            case EventType::FILE_MODIFICATION:
-            case EventType::FILE_DELETION:
-                has_file_mod = true;
-                break;
-            case EventType::REGISTRY_MODIFICATION:
-                has_registry_mod = true;
-                break;
-            case EventType::MEMORY_INJECTION:
-                has_memory_injection = true;
-                break;
-            default:
-                break;
-        }
-    }
-    
-    if (has_memory_injection) {
-        desc << "Memory injection attack chain";
-    } else if (has_process_creation && has_file_mod && has_registry_mod) {
-        desc << "Multi-stage persistence attack";
-    } else {
-        desc << "Suspicious event sequence";
+void CorrelationEngine::ForEachActiveCorrelation(
+    const std::function<void(const CorrelatedEventGroup&)>& visitor) const {
+    std::vector<CorrelationGroupPtr> groups;
+    {
+        std::lock_guard<std::mutex> lock(correlations_mutex_);
+        correlation_store_.Snapshot(groups);
     }
     
-    return desc.str();
+    for (const auto& group : groups) {
+        visitor(*group);
+    }
 }
 
-std::vector<CorrelatedEventGroup> CorrelationEngine::GetActiveCorrelations() const {
+size_t CorrelationEngine::ReadCorrelations(uint64_t& cursor, size_t max_groups,
+                                           std::vector<CorrelationGroupPtr>& groups) const {
     std::lock_guard<std::mutex> lock(correlations_mutex_);
-    return active_correlations_;
+    return correlation_store_.Read(cursor, max_groups, groups);
 }
 
 void CorrelationEngine::SetConfiguration(const CorrelationConfig& config) {
     std::lock_guard<std::mutex> lock(config_mutex_);
     config_ = config;
+    ClampAggregateWindows();
+    shard_memory_budget_ = config_.max_tracked_memory_bytes / shards_.size();
+    
+    // Summaries keep their most frequent keys across a resize
+    const size_t heavy_hitters = static_cast<size_t>(std::max(config_.heavy_hitter_count, 0));
+    for (auto& shard : shards_) {
+        std::lock_guard<std::mutex> shard_lock(shard->mutex);
+        if (shard->top_targets.Capacity() != heavy_hitters) {
+            shard->top_targets.Resize(heavy_hitters);
+            shard->top_processes.Resize(heavy_hitters);
+        }
+    }
+    {
+        std::lock_guard<std::mutex> corr_lock(correlations_mutex_);
+        correlation_store_.Configure(static_cast<size_t>(std::max(config_.max_correlation_groups, 0)),
+                                     config_.max_correlation_memory_bytes);
+    }
+    CompileAttackPatterns();
+}
+
+void CorrelationEngine::SetWorkerPool(std::shared_ptr<WorkerPool> pool) {
+    std::lock_guard<std::mutex> lock(config_mutex_);
+    worker_pool_ = std::move(pool);
+}
+
+void CorrelationEngine::SetClock(std::shared_ptr<Clock> clock) {
+    std::lock_guard<std::mutex> lock(config_mutex_);
+    clock_ = clock ? std::move(clock) : SystemClock::Instance();
 }
 
 CorrelationConfig CorrelationEngine::GetConfiguration() const {
@@ -633,7 +1812,150 @@ uint64_t CorrelationEngine::GetCorrelationCount() const {
 
 uint64_t CorrelationEngine::GetActiveCorrelationCount() const {
     std::lock_guard<std::mutex> lock(correlations_mutex_);
-    return active_correlations_.size();
+    return correlation_store_.Size();
+}
+
+uint64_t CorrelationEngine::GetCorrelationMemoryBytes() const {
+    std::lock_guard<std::mutex> lock(correlations_mutex_);
+    return correlation_store_.GetMemoryBytes();
+}
+
+uint64_t CorrelationEngine::GetEvictedCorrelationCount() const {
+    std::lock_guard<std::mutex> lock(correlations_mutex_);
+    return correlation_store_.GetEvictedCount();
+}
+
+uint64_t CorrelationEngine::GetPartialMatchCount() const {
+    std::lock_guard<std::mutex> lock(sequence_mutex_);
+    return sequence_matcher_.GetActiveMatchCount();
+}
+
+uint64_t CorrelationEngine::GetLineageProcessCount() const {
+    std::lock_guard<std::mutex> lock(lineage_mutex_);
+    return lineage_.GetProcessCount();
+}
+
+uint64_t CorrelationEngine::GetTrackedKeyCount() const {
+    uint64_t count = 0;
+    for (const auto& shard : shards_) {
+        std::lock_guard<std::mutex> lock(shard->mutex);
+        count += shard->process_events.size() + shard->target_events.size();
+    }
+    return count;
+}
+
+uint64_t CorrelationEngine::GetTrackedMemoryBytes() const {
+    uint64_t bytes = 0;
+    for (const auto& shard : shards_) {
+        std::lock_guard<std::mutex> lock(shard->mutex);
+        bytes += shard->tracked_bytes;
+    }
+    return bytes;
+}
+
+uint64_t CorrelationEngine::GetIdleEvictionCount() const {
+    return idle_eviction_count_.load();
+}
+
+uint64_t CorrelationEngine::GetBudgetEvictionCount() const {
+    return budget_eviction_count_.load();
+}
+
+std::chrono::system_clock::time_point CorrelationEngine::GetWatermark() const {
+    std::lock_guard<std::mutex> lock(event_time_mutex_);
+    return watermark_;
+}
+
+uint64_t CorrelationEngine::GetBufferedEventCount() const {
+    std::lock_guard<std::mutex> lock(event_time_mutex_);
+    return reorder_buffer_.size();
+}
+
+uint64_t CorrelationEngine::GetLateEventCount() const {
+    return late_event_count_.load();
+}
+
+uint64_t CorrelationEngine::GetDroppedLateEventCount() const {
+    return dropped_late_event_count_.load();
+}
+
+uint64_t CorrelationEngine::GetClampedEventCount() const {
+    return clamped_event_count_.load();
+}
+
+// A sketch count as RotateSketches() would leave it after elapsed windows
+static uint64_t AgedSketchCount(uint64_t count, uint64_t elapsed) {
+    return elapsed > 32 ? 0 : count >> elapsed;
+}
+
+std::vector<HeavyHitter> CorrelationEngine::GetTopTargets(size_t k) const {
+    const auto now = CurrentTime();
+    std::vector<HeavyHitter> top;
+    
+    for (const auto& shard : shards_) {
+        std::lock_guard<std::mutex> lock(shard->mutex);
+        const uint64_t elapsed = SketchWindowsElapsed(*shard, now);
+        shard->top_targets.ForEach([&](const SpaceSavingTopK<std::string, TargetHitter>::Entry& entry) {
+            const uint64_t count = AgedSketchCount(entry.count, elapsed);
+            if (count == 0) {
+                return;
+            }
+            HeavyHitter hitter;
+            hitter.target = entry.key;
+            hitter.estimated_events = count;
+            hitter.guaranteed_events = count - AgedSketchCount(entry.error, elapsed);
+            // The current window's processes become the previous window's
+            // on the next rotation; both are gone after two
+            HyperLogLog processes;
+            if (elapsed == 0) {
+                processes = entry.payload.processes;
+                processes.Merge(entry.payload.previous_processes);
+            } else if (elapsed == 1) {
+                processes = entry.payload.processes;
+            }
+            hitter.distinct_processes = processes.Estimate();
+            top.push_back(std::move(hitter));
+        });
+    }
+    
+    // Keys are partitioned across shards, so the union of the shard top-K
+    // lists holds the global top-K
+    std::sort(top.begin(), top.end(), [](const HeavyHitter& a, const HeavyHitter& b) {
+        return a.estimated_events > b.estimated_events;
+    });
+    if (top.size() > k) {
+        top.resize(k);
+    }
+    return top;
+}
+
+std::vector<HeavyHitter> CorrelationEngine::GetTopProcesses(size_t k) const {
+    const auto now = CurrentTime();
+    std::vector<HeavyHitter> top;
+    
+    for (const auto& shard : shards_) {
+        std::lock_guard<std::mutex> lock(shard->mutex);
+        const uint64_t elapsed = SketchWindowsElapsed(*shard, now);
+        shard->top_processes.ForEach([&](const SpaceSavingTopK<DWORD>::Entry& entry) {
+            const uint64_t count = AgedSketchCount(entry.count, elapsed);
+            if (count == 0) {
+                return;
+            }
+            HeavyHitter hitter;
+            hitter.process_id = entry.key;
+            hitter.estimated_events = count;
+            hitter.guaranteed_events = count - AgedSketchCount(entry.error, elapsed);
+            top.push_back(hitter);
+        });
+    }
+    
+    std::sort(top.begin(), top.end(), [](const HeavyHitter& a, const HeavyHitter& b) {
+        return a.estimated_events > b.estimated_events;
+    });
+    if (top.size() > k) {
+        top.resize(k);
+    }
+    return top;
 }
 
 void CorrelationEngine::RegisterCorrelationCallback(CorrelationCallback callback) {
@@ -645,12 +1967,7 @@ void CorrelationEngine::ClearOldCorrelations() {
     std::lock_guard<std::mutex> lock(correlations_mutex_);
     
     // Keep only recent correlations (last 100)
-    if (active_correlations_.size() > 100) {
-        active_correlations_.erase(
-            active_correlations_.begin(), 
-            active_correlations_.begin() + (active_correlations_.size() - 100)
-        );
-    }
+    correlation_store_.TrimTo(100);
 }
 
 } // namespace HIPS
@@ -0,0 +1,144 @@
+/*
+ * Correlation Group Store Implementation
+ */
+
+#include "correlation_store.h"
+#include <algorithm>
+
+namespace HIPS {
+
+CorrelationSummary SummarizeEvents(const EventRefs& events) {
+    CorrelationSummary summary;
+    summary.event_count = events.size();
+    if (events.empty()) {
+        return summary;
+    }
+
+    std::unordered_set<DWORD> processes;
+    for (const auto& event : events) {
+        processes.insert(event.process_id);
+        if (event.threat_level == ThreatLevel::HIGH || event.threat_level == ThreatLevel::CRITICAL) {
+            summary.high_threat_count++;
+        }
+        if (static_cast<int>(event.threat_level) > static_cast<int>(summary.max_threat_level)) {
+            summary.max_threat_level = event.threat_level;
+        }
+    }
+
+    summary.process_count = processes.size();
+    summary.first_process_id = events.front().process_id;
+    summary.last_process_id = events.back().process_id;
+    return summary;
+}
+
+CorrelationGroupStore::CorrelationGroupStore()
+    : first_sequence_(0), next_sequence_(0), max_groups_(0), max_bytes_(0),
+      memory_bytes_(0), evicted_count_(0) {
+}
+
+CorrelationGroupStore::~CorrelationGroupStore() {
+}
+
+void CorrelationGroupStore::Configure(size_t max_groups, size_t max_bytes) {
+    max_groups_ = max_groups;
+    max_bytes_ = max_bytes;
+}
+
+size_t CorrelationGroupStore::DedupKeyHash::operator()(const DedupKey& key) const {
+    size_t hash = std::hash<std::string>{}(key.pattern_name);
+    hash ^= static_cast<size_t>(key.type) + 0x9e3779b97f4a7c15ULL + (hash << 6) + (hash >> 2);
+    hash ^= key.event_count + 0x9e3779b97f4a7c15ULL + (hash << 6) + (hash >> 2);
+    hash ^= static_cast<size_t>(key.first_process_id) + 0x9e3779b97f4a7c15ULL + (hash << 6) + (hash >> 2);
+    return hash;
+}
+
+CorrelationGroupStore::DedupKey CorrelationGroupStore::KeyFor(const CorrelatedEventGroup& group) {
+    DedupKey key{group.type, group.summary.event_count, group.summary.first_process_id, std::string()};
+    if (group.type == CorrelationType::SEQUENCE_BASED) {
+        auto it = group.metadata.find("pattern_name");
+        if (it != group.metadata.end()) {
+            key.pattern_name = it->second;
+        }
+    }
+    return key;
+}
+
+size_t CorrelationGroupStore::ApproximateGroupBytes(const CorrelatedEventGroup& group) {
+    // Events may also be referenced by tracking state; counting them here
+    // keeps the budget conservative once tracking lets them go
+    size_t bytes = sizeof(CorrelatedEventGroup) + 64 + group.correlation_id.capacity() +
+                   group.description.capacity() + group.events.ApproximateBytes();
+    for (const auto& [key, value] : group.metadata) {
+        bytes += 64 + key.capacity() + value.capacity();
+    }
+    return bytes;
+}
+
+CorrelationGroupPtr CorrelationGroupStore::Add(CorrelatedEventGroup&& group) {
+    DedupKey key = KeyFor(group);
+    if (dedup_index_.find(key) != dedup_index_.end()) {
+        return nullptr;
+    }
+
+    StoredGroup stored;
+    stored.bytes = ApproximateGroupBytes(group);
+    stored.group = std::make_shared<const CorrelatedEventGroup>(std::move(group));
+
+    groups_.push_back(stored);
+    dedup_index_.insert(std::move(key));
+    memory_bytes_ += stored.bytes;
+    next_sequence_++;
+
+    // Keep the new group even if it alone exceeds the byte budget
+    while (groups_.size() > 1 &&
+           ((max_groups_ != 0 && groups_.size() > max_groups_) ||
+            (max_bytes_ != 0 && memory_bytes_ > max_bytes_))) {
+        PopOldest();
+        evicted_count_++;
+    }
+
+    return stored.group;
+}
+
+void CorrelationGroupStore::PopOldest() {
+    const StoredGroup& oldest = groups_.front();
+    dedup_index_.erase(KeyFor(*oldest.group));
+    memory_bytes_ -= oldest.bytes;
+    groups_.pop_front();
+    first_sequence_++;
+}
+
+size_t CorrelationGroupStore::Read(uint64_t& cursor, size_t max_groups,
+                                   std::vector<CorrelationGroupPtr>& groups) const {
+    uint64_t sequence = std::max(cursor, first_sequence_);
+    size_t count = 0;
+    while (sequence < next_sequence_ && count < max_groups) {
+        groups.push_back(groups_[static_cast<size_t>(sequence - first_sequence_)].group);
+        sequence++;
+        count++;
+    }
+    cursor = sequence;
+    return count;
+}
+
+void CorrelationGroupStore::Snapshot(std::vector<CorrelationGroupPtr>& groups) const {
+    groups.reserve(groups.size() + groups_.size());
+    for (const auto& stored : groups_) {
+        groups.push_back(stored.group);
+    }
+}
+
+void CorrelationGroupStore::TrimTo(size_t keep_count) {
+    while (groups_.size() > keep_count) {
+        PopOldest();
+    }
+}
+
+void CorrelationGroupStore::Clear() {
+    groups_.clear();
+    dedup_index_.clear();
+    first_sequence_ = next_sequence_;
+    memory_bytes_ = 0;
+}
+
+} // namespace HIPS
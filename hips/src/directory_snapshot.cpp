@@ -0,0 +1,149 @@
+/*
+ * Directory Snapshot Implementation
+ */
+
+#include "directory_snapshot.h"
+#include "worker_pool.h"
+#include <filesystem>
+#include <atomic>
+#include <chrono>
+#include <vector>
+#include <utility>
+
+namespace HIPS {
+
+namespace fs = std::filesystem;
+
+using EntryList = std::vector<std::pair<std::string, SnapshotEntry>>;
+
+// Take one entry from the shared budget
+static bool ClaimEntry(std::atomic<size_t>& remaining) {
+    size_t current = remaining.load();
+    while (current > 0 && !remaining.compare_exchange_weak(current, current - 1)) {
+    }
+    return current > 0;
+}
+
+// List directory (depth levels below the root) and, below max_depth, its
+// subdirectories. Returns false once the budget runs out.
+static bool ScanTree(const fs::path& directory, int depth, int max_depth, std::atomic<size_t>& remaining,
+                     EntryList& entries) {
+    std::vector<std::pair<fs::path, int>> pending = {{directory, depth}};
+
+    while (!pending.empty()) {
+        auto current = std::move(pending.back());
+        pending.pop_back();
+
+        std::error_code ec;
+        for (fs::directory_iterator it(current.first, ec), end; !ec && it != end; it.increment(ec)) {
+            if (!ClaimEntry(remaining)) {
+                return false;
+            }
+
+            std::error_code entry_ec;
+            fs::file_status status = it->symlink_status(entry_ec);
+            SnapshotEntry entry;
+            entry.directory = fs::is_directory(status);
+            if (fs::is_regular_file(status)) {
+                entry.size = it->file_size(entry_ec);
+            }
+            auto modified = it->last_write_time(entry_ec);
+            if (!entry_ec) {
+                entry.modified_ns = std::chrono::duration_cast<std::chrono::nanoseconds>(
+                    modified.time_since_epoch()).count();
+            }
+            entries.emplace_back(it->path().string(), entry);
+
+            if (entry.directory && current.second < max_depth) {
+                pending.emplace_back(it->path(), current.second + 1);
+            }
+        }
+    }
+    return true;
+}
+
+DirectorySnapshot::DirectorySnapshot() : truncated_(false) {
+}
+
+DirectorySnapshot DirectorySnapshot::Capture(const std::string& root, int max_depth, size_t max_entries,
+                                             WorkerPool* pool) {
+    DirectorySnapshot snapshot;
+    snapshot.root_ = root;
+    std::atomic<size_t> remaining(max_entries);
+
+    // The root's own entries first; each subdirectory is then its own task
+    EntryList top;
+    bool complete = ScanTree(root, 0, 0, remaining, top);
+
+    std::vector<EntryList> subtrees;
+    std::vector<std::function<void()>> tasks;
+    std::atomic<bool> subtrees_complete(true);
+    if (complete && max_depth > 0) {
+        for (const auto& pair : top) {
+            if (pair.second.directory) {
+                subtrees.emplace_back();
+            }
+        }
+        size_t index = 0;
+        for (const auto& pair : top) {
+            if (!pair.second.directory) {
+                continue;
+            }
+            EntryList* output = &subtrees[index++];
+            const std::string directory = pair.first;
+            tasks.push_back([directory, max_depth, output, &remaining, &subtrees_complete]() {
+                if (!ScanTree(directory, 1, max_depth, remaining, *output)) {
+                    subtrees_complete = false;
+                }
+            });
+        }
+    }
+
+    if (pool) {
+        pool->RunAll(tasks);
+    } else {
+        for (const auto& task : tasks) {
+            task();
+        }
+    }
+
+    snapshot.truncated_ = !complete || !subtrees_complete.load();
+    snapshot.entries_.reserve(max_entries - remaining.load());
+    snapshot.entries_.insert(top.begin(), top.end());
+    for (const auto& subtree : subtrees) {
+        snapshot.entries_.insert(subtree.begin(), subtree.end());
+    }
+    return snapshot;
+}
+
+void DirectorySnapshot::Diff(const DirectorySnapshot& older, const ChangeCallback& callback) const {
+    // An entry missing from a truncated older capture may just not have
+    // been scanned
+    for (const auto& pair : entries_) {
+        auto it = older.entries_.find(pair.first);
+        if (it == older.entries_.end()) {
+            if (!older.truncated_) {
+                callback(pair.first, FILE_ACTION_ADDED);
+            }
+        } else if (!pair.second.directory && pair.second != it->second) {
+            callback(pair.first, FILE_ACTION_MODIFIED);
+        }
+    }
+
+    // A truncated capture cannot tell a removed entry from an unscanned one
+    if (truncated_) {
+        return;
+    }
+    for (const auto& pair : older.entries_) {
+        if (entries_.find(pair.first) == entries_.end()) {
+            callback(pair.first, FILE_ACTION_REMOVED);
+        }
+    }
+}
+
+const SnapshotEntry* DirectorySnapshot::Find(const std::string& path) const {
+    auto it = entries_.find(path);
+    return it != entries_.end() ? &it->second : nullptr;
+}
+
+} // namespace HIPS
@@ -0,0 +1,952 @@
+/*
+ * Multi-Agent Event Aggregation Implementation
+ *
+ * Wire format: every frame is a u32 payload length followed by the payload,
+ * whose first byte is the frame type.
+ *   HELLO   (agent)      u32 protocol version, agent id, u64 session id
+ *   WELCOME (collector)  u64 last sequence processed for this session
+ *   EVENTS  (agent)      u64 first sequence, u32 count, encoded events
+ *   ACK     (collector)  u64 last sequence processed
+ * A new session id (agent restart) restarts the sequence at 1.
+ */
+
+#include "event_aggregation.h"
+#include "state_snapshot.h"
+#include <algorithm>
+#include <cstring>
+
+#ifndef _WIN32
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <netdb.h>
+#include <poll.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <cerrno>
+#endif
+
+namespace HIPS {
+
+namespace {
+
+enum class FrameType : uint8_t {
+    HELLO = 1,
+    WELCOME = 2,
+    EVENTS = 3,
+    ACK = 4
+};
+
+enum class FrameStatus {
+    FRAME,
+    TIMEOUT,
+    CLOSED
+};
+
+const uint32_t kMaxFrameBytes = 64 * 1024 * 1024;
+const int kHandshakeTimeoutMs = 5000;
+const int kConnectTimeoutMs = 2000;
+const int kPollIntervalMs = 100;
+
+#ifdef _WIN32
+const AggregationSocket kInvalidSocket = INVALID_SOCKET;
+const int kSendFlags = 0;
+using SocketLength = int;
+
+void CloseSocket(AggregationSocket socket) { closesocket(socket); }
+void ShutdownSocket(AggregationSocket socket) { shutdown(socket, SD_BOTH); }
+
+int PollSocket(AggregationSocket socket, short events, int timeout_ms) {
+    WSAPOLLFD descriptor = {};
+    descriptor.fd = socket;
+    descriptor.events = events;
+    return WSAPoll(&descriptor, 1, timeout_ms);
+}
+
+void SetBlocking(AggregationSocket socket, bool blocking) {
+    u_long mode = blocking ? 0 : 1;
+    ioctlsocket(socket, FIONBIO, &mode);
+}
+
+bool ConnectInProgress() { return WSAGetLastError() == WSAEWOULDBLOCK; }
+#else
+const AggregationSocket kInvalidSocket = -1;
+const int kSendFlags = MSG_NOSIGNAL;
+using SocketLength = socklen_t;
+
+void CloseSocket(AggregationSocket socket) { ::close(socket); }
+void ShutdownSocket(AggregationSocket socket) { ::shutdown(socket, SHUT_RDWR); }
+
+int PollSocket(AggregationSocket socket, short events, int timeout_ms) {
+    pollfd descriptor = {};
+    descriptor.fd = socket;
+    descriptor.events = events;
+    int result;
+    do {
+        result = ::poll(&descriptor, 1, timeout_ms);
+    } while (result < 0 && errno == EINTR);
+    return result;
+}
+
+void SetBlocking(AggregationSocket socket, bool blocking) {
+    int flags = ::fcntl(socket, F_GETFL, 0);
+    ::fcntl(socket, F_SETFL, blocking ? (flags & ~O_NONBLOCK) : (flags | O_NONBLOCK));
+}
+
+bool ConnectInProgress() { return errno == EINPROGRESS; }
+#endif
+
+// Resolves "host:port" or "unix:/path"
+bool ParseAddress(const std::string& address, sockaddr_storage& storage, SocketLength& length) {
+    std::memset(&storage, 0, sizeof(storage));
+
+    if (address.compare(0, 5, "unix:") == 0) {
+#ifdef _WIN32
+        return false;
+#else
+        const std::string path = address.substr(5);
+        sockaddr_un* local = reinterpret_cast<sockaddr_un*>(&storage);
+        if (path.empty() || path.size() >= sizeof(local->sun_path)) {
+            return false;
+        }
+        local->sun_family = AF_UNIX;
+        std::memcpy(local->sun_path, path.c_str(), path.size() + 1);
+        length = static_cast<SocketLength>(sizeof(sockaddr_un));
+        return true;
+#endif
+    }
+
+    size_t colon = address.rfind(':');
+    if (colon == std::string::npos || colon == 0) {
+        return false;
+    }
+
+    addrinfo hints = {};
+    hints.ai_family = AF_UNSPEC;
+    hints.ai_socktype = SOCK_STREAM;
+    addrinfo* result = nullptr;
+    if (getaddrinfo(address.substr(0, colon).c_str(), address.substr(colon + 1).c_str(),
+                    &hints, &result) != 0 || result == nullptr) {
+        return false;
+    }
+
+    std::memcpy(&storage, result->ai_addr, result->ai_addrlen);
+    length = static_cast<SocketLength>(result->ai_addrlen);
+    freeaddrinfo(result);
+    return true;
+}
+
+bool SendAll(AggregationSocket socket, const std::string& data) {
+    size_t offset = 0;
+    while (offset < data.size()) {
+        int sent = ::send(socket, data.data() + offset,
+                          static_cast<int>(std::min<size_t>(data.size() - offset, 1 << 20)), kSendFlags);
+        if (sent <= 0) {
+            return false;
+        }
+        offset += static_cast<size_t>(sent);
+    }
+    return true;
+}
+
+// Prefix a payload with its length
+std::string MakeFrame(const SnapshotWriter& payload) {
+    uint32_t length = static_cast<uint32_t>(payload.Size());
+    std::string frame(reinterpret_cast<const char*>(&length), sizeof(length));
+    frame += payload.Data();
+    return frame;
+}
+
+// Extract the next frame into payload, reading more data while the
+// buffered bytes do not hold a complete frame
+FrameStatus ReceiveFrame(AggregationSocket socket, std::string& buffer, std::string& payload, int timeout_ms) {
+    const auto deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(timeout_ms);
+
+    for (;;) {
+        if (buffer.size() >= sizeof(uint32_t)) {
+            uint32_t length;
+            std::memcpy(&length, buffer.data(), sizeof(length));
+            if (length == 0 || length > kMaxFrameBytes) {
+                return FrameStatus::CLOSED;
+            }
+            if (buffer.size() - sizeof(length) >= length) {
+                payload.assign(buffer, sizeof(length), length);
+                buffer.erase(0, sizeof(length) + length);
+                return FrameStatus::FRAME;
+            }
+        }
+
+        auto remaining = std::chrono::duration_cast<std::chrono::milliseconds>(
+            deadline - std::chrono::steady_clock::now()).count();
+        int ready = PollSocket(socket, POLLIN, static_cast<int>(std::max<long long>(remaining, 0)));
+        if (ready < 0) {
+            return FrameStatus::CLOSED;
+        }
+        if (ready == 0) {
+            return FrameStatus::TIMEOUT;
+        }
+
+        char chunk[64 * 1024];
+        int received = ::recv(socket, chunk, sizeof(chunk), 0);
+        if (received <= 0) {
+            return FrameStatus::CLOSED;
+        }
+        buffer.append(chunk, static_cast<size_t>(received));
+    }
+}
+
+bool SendSequenceFrame(AggregationSocket socket, FrameType type, uint64_t sequence) {
+    SnapshotWriter payload(false);
+    payload.WriteU8(static_cast<uint8_t>(type));
+    payload.WriteU64(sequence);
+    return SendAll(socket, MakeFrame(payload));
+}
+
+const char* CorrelationTypeName(CorrelationType type) {
+    switch (type) {
+        case CorrelationType::PROCESS_BASED:     return "PROCESS_BASED";
+        case CorrelationType::TIME_BASED:        return "TIME_BASED";
+        case CorrelationType::TARGET_BASED:      return "TARGET_BASED";
+        case CorrelationType::SEQUENCE_BASED:    return "SEQUENCE_BASED";
+        case CorrelationType::THREAT_ESCALATION: return "THREAT_ESCALATION";
+        case CorrelationType::LINEAGE_BASED:     return "LINEAGE_BASED";
+    }
+    return "UNKNOWN";
+}
+
+bool InitializeSockets() {
+#ifdef _WIN32
+    WSADATA wsa_data;
+    return WSAStartup(MAKEWORD(2, 2), &wsa_data) == 0;
+#else
+    return true;
+#endif
+}
+
+void CleanupSockets() {
+#ifdef _WIN32
+    WSACleanup();
+#endif
+}
+
+} // namespace
+
+// Agent
+
+AggregationAgent::AggregationAgent()
+    : session_id_(0), socket_(kInvalidSocket), next_sequence_(1), running_(false),
+      connected_(false), initialized_(false), sent_event_count_(0), acked_event_count_(0),
+      dropped_event_count_(0), reconnect_count_(0) {
+}
+
+AggregationAgent::~AggregationAgent() {
+    Stop();
+    if (initialized_) {
+        CleanupSockets();
+    }
+}
+
+bool AggregationAgent::Initialize(const AggregationAgentConfig& config) {
+    if (running_.load() || config.collector_address.empty()) {
+        return false;
+    }
+    if (!initialized_ && !InitializeSockets()) {
+        return false;
+    }
+    initialized_ = true;
+
+    config_ = config;
+    config_.max_batch_events = std::max<size_t>(config_.max_batch_events, 1);
+    config_.max_unacked_batches = std::max<size_t>(config_.max_unacked_batches, 1);
+    if (config_.agent_id.empty()) {
+        char host[256] = {};
+        config_.agent_id = gethostname(host, sizeof(host) - 1) == 0 ? host : "hips-agent";
+    }
+
+    // Lets the collector tell a restarted agent from a reconnecting one
+    session_id_ = static_cast<uint64_t>(std::chrono::system_clock::now().time_since_epoch().count()) ^
+                  (static_cast<uint64_t>(GetCurrentProcessId()) << 48);
+    next_sequence_ = 1;
+    unacked_.clear();
+    return true;
+}
+
+bool AggregationAgent::Start() {
+    if (!initialized_) {
+        return false;
+    }
+    if (running_.load()) {
+        return true;
+    }
+
+    running_.store(true);
+    sender_thread_ = std::thread(&AggregationAgent::SenderThreadFunction, this);
+    return true;
+}
+
+bool AggregationAgent::Stop() {
+    if (!running_.load()) {
+        return true;
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(queue_mutex_);
+        running_.store(false);
+    }
+    queue_cv_.notify_all();
+
+    if (sender_thread_.joinable()) {
+        sender_thread_.join();
+    }
+    return true;
+}
+
+bool AggregationAgent::Submit(const SecurityEvent& event) {
+    {
+        std::lock_guard<std::mutex> lock(queue_mutex_);
+        if (queue_.size() >= config_.max_queued_events) {
+            dropped_event_count_++;
+            return false;
+        }
+        if (queue_.empty()) {
+            oldest_queued_ = std::chrono::steady_clock::now();
+        }
+        queue_.push_back(event);
+        if (queue_.size() < config_.max_batch_events) {
+            return true;
+        }
+    }
+    queue_cv_.notify_one();
+    return true;
+}
+
+uint64_t AggregationAgent::GetQueuedEventCount() const {
+    std::lock_guard<std::mutex> lock(queue_mutex_);
+    return queue_.size();
+}
+
+void AggregationAgent::SenderThreadFunction() {
+    bool connected_before = false;
+
+    while (running_.load()) {
+        if (!connected_.load()) {
+            if (!Connect()) {
+                std::unique_lock<std::mutex> lock(queue_mutex_);
+                queue_cv_.wait_for(lock, std::chrono::milliseconds(config_.reconnect_delay_ms),
+                                   [this] { return !running_.load(); });
+                continue;
+            }
+            if (connected_before) {
+                reconnect_count_++;
+            }
+            connected_before = true;
+        }
+
+        // Backpressure: with the window full, wait for the collector to
+        // catch up instead of taking more events off the queue
+        if (unacked_.size() >= config_.max_unacked_batches) {
+            if (!ReceiveAcks(kPollIntervalMs)) {
+                Disconnect();
+            }
+            continue;
+        }
+
+        if (!SendNextBatch() || !ReceiveAcks(0)) {
+            Disconnect();
+        }
+    }
+
+    FlushRemaining();
+    Disconnect();
+}
+
+void AggregationAgent::FlushRemaining() {
+    const auto deadline = std::chrono::steady_clock::now() +
+                          std::chrono::milliseconds(std::max(config_.stop_flush_timeout_ms, 0));
+
+    // With running_ cleared SendNextBatch() takes whatever is queued at once
+    while (std::chrono::steady_clock::now() < deadline) {
+        bool queued;
+        {
+            std::lock_guard<std::mutex> lock(queue_mutex_);
+            queued = !queue_.empty();
+        }
+        if (!queued && unacked_.empty()) {
+            return;
+        }
+        if (!connected_.load() && !Connect()) {
+            return;
+        }
+
+        bool ok;
+        if (queued && unacked_.size() < config_.max_unacked_batches) {
+            ok = SendNextBatch() && ReceiveAcks(0);
+        } else {
+            auto remaining = std::chrono::duration_cast<std::chrono::milliseconds>(
+                deadline - std::chrono::steady_clock::now());
+            ok = ReceiveAcks(static_cast<int>(std::clamp<int64_t>(remaining.count(), 0, kPollIntervalMs)));
+        }
+        if (!ok) {
+            Disconnect();
+        }
+    }
+}
+
+bool AggregationAgent::Connect() {
+    sockaddr_storage address;
+    SocketLength address_length = 0;
+    if (!ParseAddress(config_.collector_address, address, address_length)) {
+        return false;
+    }
+
+    socket_ = ::socket(address.ss_family, SOCK_STREAM, 0);
+    if (socket_ == kInvalidSocket) {
+        return false;
+    }
+
+    // Connect without blocking so Stop() is never held up by an
+    // unreachable collector
+    SetBlocking(socket_, false);
+    if (::connect(socket_, reinterpret_cast<sockaddr*>(&address), address_length) != 0) {
+        if (!ConnectInProgress() || PollSocket(socket_, POLLOUT, kConnectTimeoutMs) <= 0) {
+            Disconnect();
+            return false;
+        }
+        int error = 0;
+        SocketLength error_length = sizeof(error);
+        getsockopt(socket_, SOL_SOCKET, SO_ERROR, reinterpret_cast<char*>(&error), &error_length);
+        if (error != 0) {
+            Disconnect();
+            return false;
+        }
+    }
+    SetBlocking(socket_, true);
+
+    if (address.ss_family != AF_UNIX) {
+        int no_delay = 1;
+        setsockopt(socket_, IPPROTO_TCP, TCP_NODELAY, reinterpret_cast<const char*>(&no_delay), sizeof(no_delay));
+    }
+
+    // Bounded sends let the thread notice Stop() while the collector stalls
+#ifdef _WIN32
+    DWORD send_timeout = 1000;
+#else
+    timeval send_timeout = {1, 0};
+#endif
+    setsockopt(socket_, SOL_SOCKET, SO_SNDTIMEO, reinterpret_cast<const char*>(&send_timeout), sizeof(send_timeout));
+
+    SnapshotWriter hello(false);
+    hello.WriteU8(static_cast<uint8_t>(FrameType::HELLO));
+    hello.WriteU32(kAggregationProtocolVersion);
+    hello.WriteString(config_.agent_id);
+    hello.WriteU64(session_id_);
+
+    std::string payload;
+    receive_buffer_.clear();
+    if (!SendAll(socket_, MakeFrame(hello)) ||
+        ReceiveFrame(socket_, receive_buffer_, payload, kHandshakeTimeoutMs) != FrameStatus::FRAME) {
+        Disconnect();
+        return false;
+    }
+
+    SnapshotReader welcome(payload.data(), payload.size());
+    uint8_t type;
+    uint64_t last_sequence;
+    if (!welcome.ReadU8(type) || type != static_cast<uint8_t>(FrameType::WELCOME) ||
+        !welcome.ReadU64(last_sequence)) {
+        Disconnect();
+        return false;
+    }
+
+    // Resend whatever the collector did not process before the disconnect
+    HandleAck(last_sequence);
+    for (const auto& batch : unacked_) {
+        if (!SendAll(socket_, batch.frame)) {
+            Disconnect();
+            return false;
+        }
+    }
+
+    connected_.store(true);
+    return true;
+}
+
+void AggregationAgent::Disconnect() {
+    if (socket_ != kInvalidSocket) {
+        CloseSocket(socket_);
+        socket_ = kInvalidSocket;
+    }
+    connected_.store(false);
+}
+
+bool AggregationAgent::SendNextBatch() {
+    std::vector<SecurityEvent> batch;
+
+    {
+        std::unique_lock<std::mutex> lock(queue_mutex_);
+
+        // Wait for a full batch or for the oldest event to reach the batch
+        // delay, checking for acks at least every poll interval
+        auto ready = [this] { return !running_.load() || queue_.size() >= config_.max_batch_events; };
+        if (queue_.empty()) {
+            queue_cv_.wait_for(lock, std::chrono::milliseconds(kPollIntervalMs),
+                               [this] { return !running_.load() || !queue_.empty(); });
+        }
+        if (!queue_.empty() && !ready()) {
+            auto flush_time = oldest_queued_ + std::chrono::milliseconds(config_.max_batch_delay_ms);
+            queue_cv_.wait_until(lock, std::min(flush_time, std::chrono::steady_clock::now() +
+                                                std::chrono::milliseconds(kPollIntervalMs)), ready);
+            if (!ready() && std::chrono::steady_clock::now() < flush_time) {
+                return true;
+            }
+        }
+
+        size_t count = std::min(queue_.size(), config_.max_batch_events);
+        batch.reserve(count);
+        for (size_t i = 0; i < count; ++i) {
+            batch.push_back(std::move(queue_.front()));
+            queue_.pop_front();
+        }
+        if (!queue_.empty()) {
+            oldest_queued_ = std::chrono::steady_clock::now();
+        }
+    }
+
+    if (batch.empty()) {
+        return true;
+    }
+
+    SnapshotWriter payload(false);
+    payload.WriteU8(static_cast<uint8_t>(FrameType::EVENTS));
+    payload.WriteU64(next_sequence_);
+    payload.WriteU32(static_cast<uint32_t>(batch.size()));
+    for (const auto& event : batch) {
+        payload.WriteEvent(event);
+    }
+
+    next_sequence_ += batch.size();
+    unacked_.push_back(PendingBatch{next_sequence_ - 1, batch.size(), MakeFrame(payload)});
+    sent_event_count_ += batch.size();
+
+    // On failure the batch stays unacknowledged and is resent on reconnect
+    return SendAll(socket_, unacked_.back().frame);
+}
+
+bool AggregationAgent::ReceiveAcks(int timeout_ms) {
+    std::string payload;
+    for (;;) {
+        FrameStatus status = ReceiveFrame(socket_, receive_buffer_, payload, timeout_ms);
+        if (status == FrameStatus::TIMEOUT) {
+            return true;
+        }
+        if (status == FrameStatus::CLOSED) {
+            return false;
+        }
+
+        SnapshotReader reader(payload.data(), payload.size());
+        uint8_t type;
+        uint64_t sequence;
+        if (!reader.ReadU8(type) || type != static_cast<uint8_t>(FrameType::ACK) || !reader.ReadU64(sequence)) {
+            return false;
+        }
+        HandleAck(sequence);
+        timeout_ms = 0;     // Drain whatever else has arrived
+    }
+}
+
+void AggregationAgent::HandleAck(uint64_t sequence) {
+    while (!unacked_.empty() && unacked_.front().last_sequence <= sequence) {
+        acked_event_count_ += unacked_.front().event_count;
+        unacked_.pop_front();
+    }
+}
+
+// Collector
+
+AggregationCollector::AggregationCollector()
+    : listen_socket_(kInvalidSocket), port_(0), next_connection_id_(0), running_(false), initialized_(false),
+      received_event_count_(0), cross_host_count_(0) {
+}
+
+AggregationCollector::~AggregationCollector() {
+    Stop();
+    if (initialized_) {
+        CleanupSockets();
+    }
+}
+
+bool AggregationCollector::Initialize(const AggregationCollectorConfig& config) {
+    if (running_.load()) {
+        return false;
+    }
+    if (!initialized_ && !InitializeSockets()) {
+        return false;
+    }
+    initialized_ = true;
+    config_ = config;
+
+    std::lock_guard<std::mutex> lock(agents_mutex_);
+    agents_.clear();
+    return true;
+}
+
+bool AggregationCollector::Start() {
+    if (!initialized_) {
+        return false;
+    }
+    if (running_.load()) {
+        return true;
+    }
+
+    sockaddr_storage address;
+    SocketLength address_length = 0;
+    if (!ParseAddress(config_.listen_address, address, address_length)) {
+        return false;
+    }
+
+    listen_socket_ = ::socket(address.ss_family, SOCK_STREAM, 0);
+    if (listen_socket_ == kInvalidSocket) {
+        return false;
+    }
+
+    if (address.ss_family == AF_UNIX) {
+        unix_path_ = config_.listen_address.substr(5);
+#ifndef _WIN32
+        ::unlink(unix_path_.c_str());
+#endif
+    } else {
+        int reuse = 1;
+        setsockopt(listen_socket_, SOL_SOCKET, SO_REUSEADDR, reinterpret_cast<const char*>(&reuse), sizeof(reuse));
+    }
+
+    if (::bind(listen_socket_, reinterpret_cast<sockaddr*>(&address), address_length) != 0 ||
+        ::listen(listen_socket_, 64) != 0) {
+        CloseSocket(listen_socket_);
+        listen_socket_ = kInvalidSocket;
+        return false;
+    }
+
+    port_ = 0;
+    if (address.ss_family != AF_UNIX) {
+        sockaddr_storage bound;
+        SocketLength bound_length = sizeof(bound);
+        if (getsockname(listen_socket_, reinterpret_cast<sockaddr*>(&bound), &bound_length) == 0) {
+            port_ = ntohs(bound.ss_family == AF_INET6 ?
+                          reinterpret_cast<sockaddr_in6*>(&bound)->sin6_port :
+                          reinterpret_cast<sockaddr_in*>(&bound)->sin_port);
+        }
+    }
+
+    running_.store(true);
+    accept_thread_ = std::thread(&AggregationCollector::AcceptThreadFunction, this);
+    return true;
+}
+
+bool AggregationCollector::Stop() {
+    if (!running_.load()) {
+        return true;
+    }
+    running_.store(false);
+
+    if (accept_thread_.joinable()) {
+        accept_thread_.join();
+    }
+    CloseSocket(listen_socket_);
+    listen_socket_ = kInvalidSocket;
+
+    std::vector<std::unique_ptr<Connection>> connections;
+    {
+        std::lock_guard<std::mutex> lock(connections_mutex_);
+        connections.swap(connections_);
+    }
+    for (auto& connection : connections) {
+        ShutdownSocket(connection->socket);
+        if (connection->thread.joinable()) {
+            connection->thread.join();
+        }
+        CloseSocket(connection->socket);
+    }
+
+#ifndef _WIN32
+    if (!unix_path_.empty()) {
+        ::unlink(unix_path_.c_str());
+        unix_path_.clear();
+    }
+#endif
+    return true;
+}
+
+void AggregationCollector::AcceptThreadFunction() {
+    while (running_.load()) {
+        ReapFinishedConnections();
+
+        if (PollSocket(listen_socket_, POLLIN, kPollIntervalMs) <= 0) {
+            continue;
+        }
+
+        AggregationSocket socket = ::accept(listen_socket_, nullptr, nullptr);
+        if (socket == kInvalidSocket) {
+            continue;
+        }
+
+        std::lock_guard<std::mutex> lock(connections_mutex_);
+        if (connections_.size() >= config_.max_agents) {
+            CloseSocket(socket);
+            continue;
+        }
+
+        auto connection = std::make_unique<Connection>();
+        connection->id = ++next_connection_id_;
+        connection->socket = socket;
+        Connection& ref = *connection;
+        connection->thread = std::thread(&AggregationCollector::ConnectionThreadFunction, this, std::ref(ref));
+        connections_.push_back(std::move(connection));
+    }
+}
+
+void AggregationCollector::ReapFinishedConnections() {
+    std::lock_guard<std::mutex> lock(connections_mutex_);
+    auto it = connections_.begin();
+    while (it != connections_.end()) {
+        if ((*it)->finished.load()) {
+            (*it)->thread.join();
+            CloseSocket((*it)->socket);
+            it = connections_.erase(it);
+        } else {
+            ++it;
+        }
+    }
+}
+
+void AggregationCollector::ConnectionThreadFunction(Connection& connection) {
+    std::string buffer, payload;
+    std::string agent_id;
+    uint64_t session_id = 0, last_sequence = 0;
+    uint32_t version = 0;
+    uint8_t type = 0;
+
+    // Handshake
+    if (ReceiveFrame(connection.socket, buffer, payload, kHandshakeTimeoutMs) != FrameStatus::FRAME) {
+        connection.finished.store(true);
+        return;
+    }
+    SnapshotReader hello(payload.data(), payload.size());
+    if (!hello.ReadU8(type) || type != static_cast<uint8_t>(FrameType::HELLO) ||
+        !hello.ReadU32(version) || version != kAggregationProtocolVersion ||
+        !hello.ReadString(agent_id) || agent_id.empty() || !hello.ReadU64(session_id)) {
+        connection.finished.store(true);
+        return;
+    }
+
+    std::shared_ptr<CorrelationEngine> engine = RegisterAgent(agent_id, session_id, connection.id, last_sequence);
+    if (!engine || !SendSequenceFrame(connection.socket, FrameType::WELCOME, last_sequence)) {
+        connection.finished.store(true);
+        return;
+    }
+
+    std::vector<SecurityEvent> events;
+    while (running_.load()) {
+        FrameStatus status = ReceiveFrame(connection.socket, buffer, payload, kPollIntervalMs);
+        if (status == FrameStatus::TIMEOUT) {
+            continue;
+        }
+        if (status == FrameStatus::CLOSED) {
+            break;
+        }
+
+        SnapshotReader reader(payload.data(), payload.size());
+        uint64_t first_sequence;
+        uint32_t count;
+        if (!reader.ReadU8(type) || type != static_cast<uint8_t>(FrameType::EVENTS) ||
+            !reader.ReadU64(first_sequence) || first_sequence == 0 || !reader.ReadCount(count, 32)) {
+            break;
+        }
+
+        events.resize(count);
+        bool valid = true;
+        for (uint32_t i = 0; i < count && valid; ++i) {
+            valid = reader.ReadEvent(events[i]);
+        }
+        if (!valid) {
+            break;
+        }
+
+        // Sequence accounting is per agent, not per connection, so a
+        // reconnect racing the old connection cannot double-process events
+        size_t first_new = 0;
+        {
+            std::lock_guard<std::mutex> lock(agents_mutex_);
+            CollectorAgentStats& stats = agents_[agent_id].stats;
+            uint64_t last_in_batch = first_sequence + count - 1;
+
+            if (count == 0 || last_in_batch <= stats.last_sequence) {
+                stats.duplicate_events += count;
+                first_new = count;
+            } else {
+                if (first_sequence <= stats.last_sequence) {
+                    first_new = static_cast<size_t>(stats.last_sequence - first_sequence + 1);
+                    stats.duplicate_events += first_new;
+                } else {
+                    stats.missing_events += first_sequence - stats.last_sequence - 1;
+                }
+                stats.last_sequence = last_in_batch;
+                stats.received_events += count - first_new;
+            }
+            last_sequence = stats.last_sequence;
+        }
+
+        for (size_t i = first_new; i < count; ++i) {
+            events[i].metadata["agent_id"] = agent_id;
+            engine->ProcessEvent(events[i]);
+        }
+        received_event_count_ += count - first_new;
+
+        // Acknowledge only after processing so a stalled engine holds back
+        // the agent
+        if (!SendSequenceFrame(connection.socket, FrameType::ACK, last_sequence)) {
+            break;
+        }
+    }
+
+    // A reconnect may have replaced this connection while it was timing out
+    {
+        std::lock_guard<std::mutex> lock(agents_mutex_);
+        AgentState& agent = agents_[agent_id];
+        if (agent.connection_id == connection.id) {
+            agent.stats.connected = false;
+        }
+    }
+    connection.finished.store(true);
+}
+
+std::shared_ptr<CorrelationEngine> AggregationCollector::RegisterAgent(const std::string& agent_id,
+                                                                      uint64_t session_id,
+                                                                      uint64_t connection_id,
+                                                                      uint64_t& last_sequence) {
+    std::lock_guard<std::mutex> lock(agents_mutex_);
+
+    auto it = agents_.find(agent_id);
+    if (it == agents_.end()) {
+        if (agents_.size() >= config_.max_agents) {
+            return nullptr;
+        }
+        it = agents_.emplace(agent_id, AgentState()).first;
+        it->second.stats.agent_id = agent_id;
+    }
+
+    AgentState& agent = it->second;
+    if (agent.session_id != session_id) {
+        // A restarted agent numbers its events from 1 again
+        agent.session_id = session_id;
+        agent.stats.last_sequence = 0;
+    }
+    agent.connection_id = connection_id;
+    agent.stats.connected = true;
+
+    if (!agent.engine) {
+        agent.engine = std::make_shared<CorrelationEngine>();
+        agent.engine->Initialize(config_.engine_config);
+        agent.engine->RegisterCorrelationCallback([this, agent_id](const CorrelatedEventGroup& group) {
+            OnAgentCorrelation(agent_id, group);
+        });
+    }
+
+    last_sequence = agent.stats.last_sequence;
+    return agent.engine;
+}
+
+void AggregationCollector::OnAgentCorrelation(const std::string& agent_id, const CorrelatedEventGroup& group) {
+    AgentCorrelationCallback correlation_callback;
+    CrossHostCallback cross_host_callback;
+    {
+        std::lock_guard<std::mutex> lock(callback_mutex_);
+        correlation_callback = correlation_callback_;
+        cross_host_callback = cross_host_callback_;
+    }
+
+    if (correlation_callback) {
+        correlation_callback(agent_id, group);
+    }
+
+    if (static_cast<int>(group.combined_threat_level) < static_cast<int>(config_.cross_host_min_threat_level)) {
+        return;
+    }
+
+    std::string signature = CorrelationTypeName(group.type);
+    auto pattern = group.metadata.find("pattern_name");
+    if (pattern != group.metadata.end()) {
+        signature += ":" + pattern->second;
+    }
+
+    const auto now = std::chrono::system_clock::now();
+    const auto window = std::chrono::seconds(config_.cross_host_window_seconds);
+    CrossHostCorrelation report;
+    bool reported = false;
+
+    {
+        std::lock_guard<std::mutex> lock(cross_host_mutex_);
+        CrossHostState& state = cross_host_[signature];
+
+        for (auto it = state.agents.begin(); it != state.agents.end();) {
+            if (now - it->second.time > window) {
+                it = state.agents.erase(it);
+            } else {
+                ++it;
+            }
+        }
+        state.agents[agent_id] = CrossHostState::Sighting{now, std::make_shared<const CorrelatedEventGroup>(group)};
+        state.reported_agents = std::min(state.reported_agents, state.agents.size() - 1);
+
+        // Report when the spread first reaches the threshold and again each
+        // time it widens to another agent
+        if (state.agents.size() >= static_cast<size_t>(std::max(config_.cross_host_min_agents, 1)) &&
+            state.agents.size() > state.reported_agents) {
+            state.reported_agents = state.agents.size();
+            report.signature = signature;
+            report.first_seen = now;
+            report.last_seen = now;
+            for (const auto& [id, sighting] : state.agents) {
+                report.agent_ids.push_back(id);
+                report.groups.push_back(sighting.group);
+                report.first_seen = std::min(report.first_seen, sighting.time);
+            }
+            reported = true;
+        }
+    }
+
+    if (reported) {
+        cross_host_count_++;
+        if (cross_host_callback) {
+            cross_host_callback(report);
+        }
+    }
+}
+
+std::vector<CollectorAgentStats> AggregationCollector::GetAgentStats() const {
+    std::lock_guard<std::mutex> lock(agents_mutex_);
+    std::vector<CollectorAgentStats> stats;
+    stats.reserve(agents_.size());
+    for (const auto& [id, agent] : agents_) {
+        stats.push_back(agent.stats);
+    }
+    return stats;
+}
+
+std::shared_ptr<CorrelationEngine> AggregationCollector::GetAgentEngine(const std::string& agent_id) const {
+    std::lock_guard<std::mutex> lock(agents_mutex_);
+    auto it = agents_.find(agent_id);
+    return it != agents_.end() ? it->second.engine : nullptr;
+}
+
+void AggregationCollector::RegisterCorrelationCallback(AgentCorrelationCallback callback) {
+    std::lock_guard<std::mutex> lock(callback_mutex_);
+    correlation_callback_ = std::move(callback);
+}
+
+void AggregationCollector::RegisterCrossHostCallback(CrossHostCallback callback) {
+    std::lock_guard<std::mutex> lock(callback_mutex_);
+    cross_host_callback_ = std::move(callback);
+}
+
+} // namespace HIPS
@@ -0,0 +1,523 @@
+/*
+ * File Access Guard Implementation (fanotify permission events)
+ */
+
+#include "file_access_guard.h"
+#include "linux_file_watcher.h"
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/fanotify.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <climits>
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <algorithm>
+
+namespace HIPS {
+
+// Latency samples kept for the percentiles
+static constexpr size_t kLatencySamples = 4096;
+static constexpr size_t kDefaultVerdictCapacity = 4096;
+
+#ifdef FAN_OPEN_EXEC_PERM
+static constexpr uint64_t kPermissionMask = FAN_OPEN_PERM | FAN_OPEN_EXEC_PERM;
+#else
+static constexpr uint64_t kPermissionMask = FAN_OPEN_PERM;
+#endif
+
+// With FAN_REPORT_TID events name the opening thread, which lets the
+// guard wave through its own decision thread
+#ifdef FAN_REPORT_TID
+static constexpr unsigned int kReportTid = FAN_REPORT_TID;
+#else
+static constexpr unsigned int kReportTid = 0;
+#endif
+
+static std::string ReadLink(const std::string& link) {
+    char target[PATH_MAX];
+    ssize_t length = readlink(link.c_str(), target, sizeof(target) - 1);
+    return length > 0 ? std::string(target, static_cast<size_t>(length)) : std::string();
+}
+
+static void WriteResponse(int fanotify_fd, int fd, bool allow) {
+    struct fanotify_response response;
+    response.fd = fd;
+    response.response = allow ? FAN_ALLOW : FAN_DENY;
+    ssize_t ignored = write(fanotify_fd, &response, sizeof(response));
+    (void)ignored;
+    close(fd);
+}
+
+// Thread group (process) id of a thread
+static DWORD ThreadGroupOf(DWORD thread_id) {
+    std::ifstream status("/proc/" + std::to_string(thread_id) + "/status");
+    std::string line;
+    while (std::getline(status, line)) {
+        if (line.compare(0, 5, "Tgid:") == 0) {
+            return static_cast<DWORD>(std::strtoul(line.c_str() + 5, nullptr, 10));
+        }
+    }
+    return thread_id;
+}
+
+bool FileAccessGuard::VerdictKey::operator==(const VerdictKey& other) const {
+    return file_device == other.file_device && file_inode == other.file_inode &&
+           file_change_ns == other.file_change_ns && program_device == other.program_device &&
+           program_inode == other.program_inode;
+}
+
+size_t FileAccessGuard::VerdictKeyHash::operator()(const VerdictKey& key) const {
+    uint64_t hash = key.file_inode * 0x9E3779B97F4A7C15ULL;
+    hash ^= key.file_device + 0x9E3779B97F4A7C15ULL + (hash << 6) + (hash >> 2);
+    hash ^= static_cast<uint64_t>(key.file_change_ns) + (hash << 6) + (hash >> 2);
+    hash ^= key.program_inode * 0xC2B2AE3D27D4EB4FULL + (hash << 6) + (hash >> 2);
+    hash ^= key.program_device + (hash << 6) + (hash >> 2);
+    return static_cast<size_t>(hash);
+}
+
+FileAccessGuard::FileAccessGuard()
+    : max_depth_(0), deadline_(50), running_(false), enforcing_(false), fanotify_fd_(-1), epoll_fd_(-1), stop_fd_(-1),
+      decision_thread_id_(0), next_id_(0), stop_decisions_(false),
+      verdict_capacity_(kDefaultVerdictCapacity), verdict_generation_(0), decisions_(0), denied_(0), timed_out_(0),
+      cache_hits_(0), latency_next_(0) {
+}
+
+FileAccessGuard::~FileAccessGuard() {
+    Stop();
+}
+
+bool FileAccessGuard::Start(const std::vector<std::string>& roots, int max_depth, FileAccessDecider decider,
+                            std::chrono::milliseconds deadline) {
+    if (running_.load() || !decider) {
+        return false;
+    }
+
+    roots_ = LinuxFileWatcher::CanonicalRoots(roots);
+    if (roots_.empty()) {
+        return false;
+    }
+    max_depth_ = std::max(max_depth, 0);
+    decider_ = std::move(decider);
+    deadline_ = std::max(deadline, std::chrono::milliseconds(1));
+
+    fanotify_fd_ = fanotify_init(FAN_CLASS_CONTENT | FAN_CLOEXEC | FAN_NONBLOCK | kReportTid,
+                                 O_RDONLY | O_LARGEFILE);
+    epoll_fd_ = epoll_create1(EPOLL_CLOEXEC);
+    stop_fd_ = eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK);
+    bool ready = fanotify_fd_ >= 0 && epoll_fd_ >= 0 && stop_fd_ >= 0;
+
+    // Permission events need mount marks; opens elsewhere on the mount are
+    // allowed straight from the event thread
+    for (const auto& root : roots_) {
+        if (!ready) {
+            break;
+        }
+        ready = fanotify_mark(fanotify_fd_, FAN_MARK_ADD | FAN_MARK_MOUNT, kPermissionMask, AT_FDCWD,
+                              root.c_str()) == 0;
+    }
+    for (int fd : {fanotify_fd_, stop_fd_}) {
+        if (!ready) {
+            break;
+        }
+        struct epoll_event event = {};
+        event.events = EPOLLIN;
+        event.data.fd = fd;
+        ready = epoll_ctl(epoll_fd_, EPOLL_CTL_ADD, fd, &event) == 0;
+    }
+
+    if (!ready) {
+        for (int* fd : {&fanotify_fd_, &epoll_fd_, &stop_fd_}) {
+            if (*fd >= 0) {
+                close(*fd);
+                *fd = -1;
+            }
+        }
+        return false;
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(latency_mutex_);
+        latency_us_.assign(kLatencySamples, 0);
+        latency_next_ = 0;
+    }
+    stop_decisions_ = false;
+    running_.store(true);
+    enforcing_.store(true);
+    decision_thread_ = std::thread(&FileAccessGuard::DecisionLoop, this);
+    event_thread_ = std::thread(&FileAccessGuard::EventLoop, this);
+    return true;
+}
+
+void FileAccessGuard::Stop() {
+    if (!running_.exchange(false)) {
+        return;
+    }
+    enforcing_.store(false);
+
+    // No new accesses are taken once the event thread is gone
+    uint64_t value = 1;
+    ssize_t ignored = write(stop_fd_, &value, sizeof(value));
+    (void)ignored;
+    if (event_thread_.joinable()) {
+        event_thread_.join();
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(pending_mutex_);
+        stop_decisions_ = true;
+    }
+    decision_cv_.notify_all();
+    if (decision_thread_.joinable()) {
+        decision_thread_.join();
+    }
+
+    ReleasePending();
+
+    for (int* fd : {&fanotify_fd_, &epoll_fd_, &stop_fd_}) {
+        close(*fd);
+        *fd = -1;
+    }
+}
+
+void FileAccessGuard::EventLoop() {
+    struct epoll_event events[2];
+
+    while (true) {
+        // Sleep no longer than the oldest undecided access may wait
+        int timeout_ms = -1;
+        {
+            std::lock_guard<std::mutex> lock(pending_mutex_);
+            if (!expiry_order_.empty()) {
+                auto wait = expiry_order_.front().second - std::chrono::steady_clock::now();
+                auto wait_us = std::chrono::duration_cast<std::chrono::microseconds>(wait).count();
+                timeout_ms = static_cast<int>(std::max<long long>((wait_us + 999) / 1000, 0));
+            }
+        }
+
+        int count = epoll_wait(epoll_fd_, events, 2, timeout_ms);
+        if (count < 0 && errno != EINTR) {
+            return;
+        }
+
+        for (int i = 0; i < count; ++i) {
+            if (events[i].data.fd == stop_fd_ || !ReadPermissionEvents()) {
+                return;
+            }
+        }
+
+        ExpireDecisions(std::chrono::steady_clock::now());
+    }
+}
+
+bool FileAccessGuard::ReadPermissionEvents() {
+    alignas(struct fanotify_event_metadata) char buffer[8192];
+    const long own_decisions = decision_thread_id_.load();
+
+    while (true) {
+        ssize_t length = read(fanotify_fd_, buffer, sizeof(buffer));
+        if (length <= 0) {
+            return true;
+        }
+
+        auto* metadata = reinterpret_cast<struct fanotify_event_metadata*>(buffer);
+        for (; FAN_EVENT_OK(metadata, length); metadata = FAN_EVENT_NEXT(metadata, length)) {
+            // Nothing past this point can be parsed; fail open for good
+            if (metadata->vers != FANOTIFY_METADATA_VERSION) {
+                AllowEvents(fanotify_fd_, reinterpret_cast<const char*>(metadata), static_cast<size_t>(length));
+                StopEnforcing();
+                return false;
+            }
+            if (metadata->fd < 0) {
+                continue;
+            }
+            const auto received = std::chrono::steady_clock::now();
+
+            // The decision thread's own opens must never wait on itself
+            if (kReportTid != 0 && metadata->pid == own_decisions) {
+                Answer(metadata->fd, true);
+                continue;
+            }
+
+            std::string path = ReadLink("/proc/self/fd/" + std::to_string(metadata->fd));
+            size_t slash = path.find_last_of('/');
+            std::string directory = slash == 0 ? "/" : path.substr(0, slash);
+            if (path.empty() || slash == std::string::npos ||
+                !LinuxFileWatcher::IsUnderRoots(roots_, max_depth_, directory)) {
+                Answer(metadata->fd, true);
+                continue;
+            }
+            decisions_++;
+
+            VerdictKey key = {};
+            struct stat file_info;
+            if (fstat(metadata->fd, &file_info) == 0) {
+                key.file_device = file_info.st_dev;
+                key.file_inode = file_info.st_ino;
+                key.file_change_ns = static_cast<int64_t>(file_info.st_ctim.tv_sec) * 1000000000LL +
+                                     file_info.st_ctim.tv_nsec;
+            }
+            struct stat program_info;
+            if (stat(("/proc/" + std::to_string(metadata->pid) + "/exe").c_str(), &program_info) == 0) {
+                key.program_device = program_info.st_dev;
+                key.program_inode = program_info.st_ino;
+            }
+
+            bool allow;
+            if (key.file_inode != 0 && key.program_inode != 0 && LookupVerdict(key, allow)) {
+                cache_hits_++;
+                if (!allow) {
+                    denied_++;
+                }
+                Answer(metadata->fd, allow);
+                RecordLatency(received);
+                continue;
+            }
+
+            PendingDecision pending;
+            pending.fd = metadata->fd;
+            pending.key = key;
+            pending.request.path = std::move(path);
+            pending.request.process_id = static_cast<DWORD>(metadata->pid);
+#ifdef FAN_OPEN_EXEC_PERM
+            pending.request.execute = (metadata->mask & FAN_OPEN_EXEC_PERM) != 0;
+#endif
+            pending.received = received;
+            pending.deadline = received + deadline_;
+            {
+                std::lock_guard<std::mutex> lock(pending_mutex_);
+                pending.id = next_id_++;
+                expiry_order_.emplace_back(pending.id, pending.deadline);
+                decision_queue_.push_back(pending.id);
+                pending_.emplace(pending.id, std::move(pending));
+            }
+            decision_cv_.notify_one();
+        }
+    }
+}
+
+void FileAccessGuard::StopEnforcing() {
+    enforcing_.store(false);
+
+    // No new permission events once the marks are gone; allow the ones
+    // already queued, then everything still waiting for a decision
+    fanotify_mark(fanotify_fd_, FAN_MARK_FLUSH | FAN_MARK_MOUNT, 0, AT_FDCWD, nullptr);
+    alignas(struct fanotify_event_metadata) char buffer[8192];
+    ssize_t length;
+    while ((length = read(fanotify_fd_, buffer, sizeof(buffer))) > 0) {
+        AllowEvents(fanotify_fd_, buffer, static_cast<size_t>(length));
+    }
+    ReleasePending();
+}
+
+void FileAccessGuard::ReleasePending() {
+    std::vector<uint64_t> remaining;
+    {
+        std::lock_guard<std::mutex> lock(pending_mutex_);
+        for (const auto& pair : pending_) {
+            remaining.push_back(pair.first);
+        }
+    }
+    for (uint64_t id : remaining) {
+        Respond(id, true, false);
+    }
+    {
+        std::lock_guard<std::mutex> lock(pending_mutex_);
+        expiry_order_.clear();
+        decision_queue_.clear();
+    }
+}
+
+size_t FileAccessGuard::AllowEvents(int fanotify_fd, const char* buffer, size_t length) {
+    size_t allowed = 0;
+    auto remaining = static_cast<ssize_t>(length);
+    auto* metadata = reinterpret_cast<const struct fanotify_event_metadata*>(buffer);
+    for (; FAN_EVENT_OK(metadata, remaining); metadata = FAN_EVENT_NEXT(metadata, remaining)) {
+        if (metadata->fd >= 0) {
+            WriteResponse(fanotify_fd, metadata->fd, true);
+            allowed++;
+        }
+    }
+    return allowed;
+}
+
+void FileAccessGuard::DecisionLoop() {
+    decision_thread_id_.store(static_cast<long>(syscall(SYS_gettid)));
+
+    while (true) {
+        FileAccessRequest request;
+        VerdictKey key;
+        uint64_t id;
+        {
+            std::unique_lock<std::mutex> lock(pending_mutex_);
+            decision_cv_.wait(lock, [this] { return stop_decisions_ || !decision_queue_.empty(); });
+            if (stop_decisions_) {
+                return;
+            }
+            id = decision_queue_.front();
+            decision_queue_.pop_front();
+
+            // Already allowed by the deadline
+            auto it = pending_.find(id);
+            if (it == pending_.end()) {
+                continue;
+            }
+            request = it->second.request;
+            key = it->second.key;
+        }
+
+        // Events name the opening thread; the decider sees its process
+        const DWORD thread_id = request.process_id;
+        request.process_path = ReadLink("/proc/" + std::to_string(thread_id) + "/exe");
+        if (kReportTid != 0) {
+            request.process_id = ThreadGroupOf(thread_id);
+        }
+
+        // A rule change while the decider runs makes its verdict stale
+        const uint64_t generation = verdict_generation_.load();
+        bool allow = decider_(request);
+        if (key.file_inode != 0 && key.program_inode != 0) {
+            StoreVerdict(key, allow, generation);
+        }
+        Respond(id, allow, false);
+    }
+}
+
+void FileAccessGuard::ExpireDecisions(const std::chrono::steady_clock::time_point& now) {
+    std::vector<uint64_t> expired;
+    {
+        std::lock_guard<std::mutex> lock(pending_mutex_);
+        while (!expiry_order_.empty() && expiry_order_.front().second <= now) {
+            expired.push_back(expiry_order_.front().first);
+            expiry_order_.pop_front();
+        }
+    }
+
+    // Fail open; decided accesses are skipped by Respond()
+    for (uint64_t id : expired) {
+        Respond(id, true, true);
+    }
+}
+
+bool FileAccessGuard::Respond(uint64_t id, bool allow, bool timed_out) {
+    int fd;
+    std::chrono::steady_clock::time_point received;
+    {
+        std::lock_guard<std::mutex> lock(pending_mutex_);
+        auto it = pending_.find(id);
+        if (it == pending_.end()) {
+            return false;
+        }
+        fd = it->second.fd;
+        received = it->second.received;
+        pending_.erase(it);
+    }
+
+    Answer(fd, allow);
+    if (timed_out) {
+        timed_out_++;
+    }
+    if (!allow) {
+        denied_++;
+    }
+    RecordLatency(received);
+    return true;
+}
+
+void FileAccessGuard::Answer(int fd, bool allow) {
+    WriteResponse(fanotify_fd_, fd, allow);
+}
+
+bool FileAccessGuard::LookupVerdict(const VerdictKey& key, bool& allow) {
+    std::lock_guard<std::mutex> lock(verdict_mutex_);
+    auto it = verdict_index_.find(key);
+    if (it == verdict_index_.end()) {
+        return false;
+    }
+    verdicts_.splice(verdicts_.end(), verdicts_, it->second);
+    allow = it->second->second;
+    return true;
+}
+
+void FileAccessGuard::StoreVerdict(const VerdictKey& key, bool allow, uint64_t generation) {
+    std::lock_guard<std::mutex> lock(verdict_mutex_);
+    if (verdict_capacity_ == 0 || generation != verdict_generation_.load()) {
+        return;
+    }
+
+    auto it = verdict_index_.find(key);
+    if (it != verdict_index_.end()) {
+        it->second->second = allow;
+        verdicts_.splice(verdicts_.end(), verdicts_, it->second);
+        return;
+    }
+
+    while (verdicts_.size() >= verdict_capacity_) {
+        verdict_index_.erase(verdicts_.front().first);
+        verdicts_.pop_front();
+    }
+    verdict_index_[key] = verdicts_.insert(verdicts_.end(), {key, allow});
+}
+
+void FileAccessGuard::ClearVerdictCache() {
+    std::lock_guard<std::mutex> lock(verdict_mutex_);
+    verdicts_.clear();
+    verdict_index_.clear();
+    verdict_generation_++;
+}
+
+void FileAccessGuard::SetVerdictCacheCapacity(size_t capacity) {
+    std::lock_guard<std::mutex> lock(verdict_mutex_);
+    verdict_capacity_ = capacity;
+    while (verdicts_.size() > verdict_capacity_) {
+        verdict_index_.erase(verdicts_.front().first);
+        verdicts_.pop_front();
+    }
+}
+
+void FileAccessGuard::RecordLatency(const std::chrono::steady_clock::time_point& received) {
+    auto elapsed = std::chrono::duration_cast<std::chrono::microseconds>(
+        std::chrono::steady_clock::now() - received).count();
+
+    std::lock_guard<std::mutex> lock(latency_mutex_);
+    if (latency_us_.empty()) {
+        return;
+    }
+    latency_us_[latency_next_ % latency_us_.size()] =
+        static_cast<uint32_t>(std::min<long long>(elapsed, UINT32_MAX));
+    latency_next_++;
+}
+
+AccessDecisionStats FileAccessGuard::GetStats() const {
+    AccessDecisionStats stats;
+    stats.decisions = decisions_.load();
+    stats.denied = denied_.load();
+    stats.timed_out = timed_out_.load();
+    stats.cache_hits = cache_hits_.load();
+
+    std::vector<uint32_t> samples;
+    {
+        std::lock_guard<std::mutex> lock(latency_mutex_);
+        samples.assign(latency_us_.begin(),
+                       latency_us_.begin() + std::min(latency_next_, latency_us_.size()));
+    }
+    if (samples.empty()) {
+        return stats;
+    }
+
+    std::sort(samples.begin(), samples.end());
+    auto percentile = [&samples](double p) {
+        return static_cast<double>(samples[static_cast<size_t>(p / 100.0 * (samples.size() - 1))]);
+    };
+    stats.p50_us = percentile(50);
+    stats.p90_us = percentile(90);
+    stats.p99_us = percentile(99);
+    stats.max_us = samples.back();
+    return stats;
+}
+
+} // namespace HIPS
@@ -6,18 +6,73 @@
 #endif
 #include <algorithm>
 #include <cctype>
+#include <cstdint>
+#include <cstdio>
+#include <filesystem>
+#include <unordered_set>
 
 namespace HIPS {
 
+// Notification buffers start at the size network shares accept and grow
+// on overflow
+static constexpr size_t kInitialWatchBuffer = 64 * 1024;
+static constexpr size_t kMaxWatchBuffer = 1024 * 1024;
+
+// Bound on the cached snapshot of one watch root
+static constexpr size_t kMaxSnapshotEntries = 100000;
+
+// Baseline scans read at most this much per second unless configured
+static constexpr uint64_t kDefaultBaselineIoBudget = 32ULL * 1024 * 1024;
+
+// Whether live differs from what the inventory recorded; content hashes
+// are compared when both have them, so a rewrite that restores the size
+// and mtime is still caught
+static bool InventoryChanged(const InventoryEntry& known, const InventoryEntry& live) {
+    if (known.size != live.size || known.modified_ns != live.modified_ns || known.attributes != live.attributes) {
+        return true;
+    }
+    return known.hashed && live.hashed && known.hashes.sha256 != live.hashes.sha256;
+}
+
+// Executables by extension and, outside Windows, any regular file with an
+// execute bit, since ELF binaries and scripts rarely have one
+static bool IsInventoryExecutable(const InventoryEntry& entry, const PathClassification& path_class) {
+    if (path_class.extension_class & EXTENSION_EXECUTABLE) {
+        return true;
+    }
+#ifdef _WIN32
+    return false;
+#else
+    return !(entry.attributes & (kInventoryDirectory | kInventorySymlink)) && (entry.attributes & 0111) != 0;
+#endif
+}
+
+// Index of the root path lies under, or -1
+static int RootIndex(const std::string& path, const std::vector<std::string>& roots) {
+    for (size_t i = 0; i < roots.size(); ++i) {
+        const std::string& root = roots[i];
+        if (root.empty() || path.size() <= root.size() || path.compare(0, root.size(), root) != 0) {
+            continue;
+        }
+        char next = root.back() == '/' || root.back() == '\\' ? root.back() : path[root.size()];
+        if (next == '/' || next == '\\') {
+            return static_cast<int>(i);
+        }
+    }
+    return -1;
+}
+
 FileSystemMonitor::FileSystemMonitor() 
-    : running_(false), initialized_(false), scan_depth_(5) {
-    
-    // Default excluded extensions (typically safe files)
-    excluded_extensions_ = {
-        ".log", ".tmp", ".temp", ".bak", ".cache", ".txt", ".doc", ".docx",
-        ".pdf", ".jpg", ".jpeg", ".png", ".gif", ".bmp", ".mp3", ".mp4", 
-        ".avi", ".mov", ".wav"
-    };
+    : running_(false), initialized_(false),
+      worker_threads_(std::min<size_t>(std::max(std::thread::hardware_concurrency(), 1u), 4)),
+      tasks_in_flight_(0), content_hasher_(ContentHasher::Shared()), content_hashing_(false),
+      baseline_on_start_(false), baseline_io_budget_(kDefaultBaselineIoBudget), baseline_scanning_(false),
+      offline_diff_pending_(false), access_deadline_(50), scan_depth_(5), classifier_config_(PathClassifierConfig::Defaults()),
+      classifier_(std::make_shared<const PathClassifier>(classifier_config_)),
+      identity_cache_(ProcessIdentityCache::Shared()) {
+#ifndef __linux__
+    completion_port_ = NULL;
+#endif
 }
 
 FileSystemMonitor::~FileSystemMonitor() {
@@ -36,11 +91,18 @@ bool FileSystemMonitor::Initialize() {
 
     try {
         // Add default watch paths
+#ifdef __linux__
+        AddWatchPath("/etc");
+        AddWatchPath("/usr/bin");
+        AddWatchPath("/usr/sbin");
+        AddWatchPath("/usr/local/bin");
+#else
         AddWatchPath("C:\\Windows\\System32");
         AddWatchPath("C:\\Windows\\SysWOW64");
         AddWatchPath("C:\\Program Files");
         AddWatchPath("C:\\Program Files (x86)");
         AddWatchPath("C:\\Users");
+#endif
         
         initialized_.store(true);
         return true;
@@ -55,15 +117,106 @@ bool FileSystemMonitor::Start() {
     }
 
     try {
-        // Setup directory watches
+        // Roots that cannot be watched are skipped; at least one must work
+        size_t shard_count = 0;
+        rescan_pool_ = WorkerPool::Shared();
+        for (auto& watch_dir : watch_dirs_) {
+            watch_dir->scan_root.clear();
+            watch_dir->shard = SIZE_MAX;
+            std::lock_guard<std::mutex> lock(watch_dir->snapshot_mutex);
+            watch_dir->snapshot.reset();
+        }
+#ifdef __linux__
+        std::vector<std::string> roots;
         for (auto& watch_dir : watch_dirs_) {
-            if (!SetupDirectoryWatch(watch_dir)) {
-                return false;
+            roots.push_back(watch_dir->path);
+            auto canonical = LinuxFileWatcher::CanonicalRoots({watch_dir->path});
+            if (!canonical.empty()) {
+                watch_dir->scan_root = canonical.front();
             }
         }
 
+        // One watcher and reactor thread per shard of the roots
+        auto on_change = [this](const LinuxFileWatcher::Change& change) {
+            // inotify does not report the acting process
+            HandleFileChange(change.path, change.action,
+                             change.process_id ? change.process_id : GetCurrentProcessId());
+        };
+        for (const auto& shard_roots : LinuxFileWatcher::PartitionRoots(roots, worker_threads_)) {
+            // An overflow loses changes for every root of the shard
+            std::vector<WatchDirectory*> shard_dirs;
+            for (auto& watch_dir : watch_dirs_) {
+                if (std::find(shard_roots.begin(), shard_roots.end(), watch_dir->scan_root) != shard_roots.end()) {
+                    shard_dirs.push_back(watch_dir.get());
+                }
+            }
+
+            auto watcher = std::make_unique<LinuxFileWatcher>();
+            watcher->SetOverflowCallback([this, shard_dirs]() {
+                for (auto* watch_dir : shard_dirs) {
+                    watch_dir->overflow_count++;
+                    ScheduleRescan(*watch_dir);
+                }
+            });
+            if (watcher->Open(shard_roots, scan_depth_, on_change)) {
+                for (auto* watch_dir : shard_dirs) {
+                    watch_dir->shard = linux_watchers_.size();
+                }
+                linux_watchers_.push_back(std::move(watcher));
+            }
+        }
+        if (linux_watchers_.empty()) {
+            return false;
+        }
+        shard_count = linux_watchers_.size();
+
+        // Enforcement is best effort; without permission events the
+        // monitor keeps reporting changes
+        if (access_decider_) {
+            access_guard_.Start(roots, scan_depth_, [this](const FileAccessRequest& request) {
+                return DecideFileAccess(request);
+            }, access_deadline_);
+        }
+#else
+        // Every directory read completes on one port; workers pick up
+        // whichever completes next, keyed by its WatchDirectory
+        completion_port_ = CreateIoCompletionPort(INVALID_HANDLE_VALUE, NULL, 0,
+                                                  static_cast<DWORD>(worker_threads_));
+        if (completion_port_ == NULL) {
+            return false;
+        }
+        size_t active_dirs = 0;
+        for (auto& watch_dir : watch_dirs_) {
+            if (SetupDirectoryWatch(*watch_dir)) {
+                watch_dir->scan_root = watch_dir->path;
+                active_dirs++;
+            }
+        }
+        if (active_dirs == 0) {
+            CloseHandle(completion_port_);
+            completion_port_ = NULL;
+            return false;
+        }
+        shard_count = worker_threads_;
+#endif
+
         running_.store(true);
-        monitor_thread_ = std::thread(&FileSystemMonitor::MonitoringThreadFunction, this);
+        for (size_t shard = 0; shard < shard_count; ++shard) {
+            monitor_threads_.emplace_back(&FileSystemMonitor::MonitoringThreadFunction, this, shard);
+        }
+
+        // Baseline snapshots for overflow recovery, captured in the background
+        for (auto& watch_dir : watch_dirs_) {
+            ScheduleRescan(*watch_dir);
+        }
+        offline_diff_pending_ = true;
+        if (baseline_on_start_.load()) {
+            BeginTask();
+            rescan_pool_->Submit([this]() {
+                RunBaselineScan();
+                EndTask();
+            });
+        }
         return true;
     } catch (const std::exception& e) {
         return false;
@@ -76,20 +229,51 @@ bool FileSystemMonitor::Stop() {
     }
 
     running_.store(false);
+    {
+        std::lock_guard<std::mutex> lock(baseline_mutex_);
+        if (baseline_scanner_) {
+            baseline_scanner_->Cancel();
+        }
+    }
     
-    // Close all directory handles
-    for (auto& watch_dir : watch_dirs_) {
-        if (watch_dir.handle != INVALID_HANDLE_VALUE) {
-            CancelIo(watch_dir.handle);
-            CloseHandle(watch_dir.handle);
-            watch_dir.handle = INVALID_HANDLE_VALUE;
+#ifdef __linux__
+    // Release held accesses before anything else shuts down
+    access_guard_.Stop();
+    for (auto& watcher : linux_watchers_) {
+        watcher->Stop();
+    }
+#else
+    // A null completion key tells one worker to exit
+    for (size_t i = 0; i < monitor_threads_.size(); ++i) {
+        PostQueuedCompletionStatus(completion_port_, 0, 0, NULL);
+    }
+#endif
+
+    for (auto& thread : monitor_threads_) {
+        if (thread.joinable()) {
+            thread.join();
         }
     }
+    monitor_threads_.clear();
 
-    if (monitor_thread_.joinable()) {
-        monitor_thread_.join();
+    // No new rescans can be requested now; the last ones may still
+    // request hashes
+    {
+        std::unique_lock<std::mutex> lock(tasks_mutex_);
+        tasks_cv_.wait(lock, [this] { return tasks_in_flight_ == 0; });
     }
 
+#ifdef __linux__
+    linux_watchers_.clear();
+#else
+    for (auto& watch_dir : watch_dirs_) {
+        CloseDirectoryWatch(*watch_dir);
+    }
+    retired_dirs_.clear();
+    CloseHandle(completion_port_);
+    completion_port_ = NULL;
+#endif
+
     return true;
 }
 
@@ -104,28 +288,37 @@ bool FileSystemMonitor::Shutdown() {
 }
 
 void FileSystemMonitor::AddWatchPath(const std::string& path) {
-    WatchDirectory watch_dir;
-    watch_dir.path = path;
-    watch_dir.handle = INVALID_HANDLE_VALUE;
-    watch_dir.active = false;
-    watch_dir.buffer.resize(64 * 1024); // 64KB buffer
-    ZeroMemory(&watch_dir.overlapped, sizeof(OVERLAPPED));
+    auto watch_dir = std::make_unique<WatchDirectory>();
+    watch_dir->path = path;
+    watch_dir->decoder.SetDirectory(path);
+    watch_dir->handle = INVALID_HANDLE_VALUE;
+    watch_dir->active = false;
+    watch_dir->buffer.resize(kInitialWatchBuffer);
+    watch_dir->buffer_bytes = watch_dir->buffer.size();
+    watch_dir->shard = SIZE_MAX;
+    watch_dir->rescan_requests = 0;
+    watch_dir->overflow_count = 0;
+    watch_dir->rescan_count = 0;
+    watch_dir->reconstructed_count = 0;
+    ZeroMemory(&watch_dir->overlapped, sizeof(OVERLAPPED));
     
-    watch_dirs_.push_back(watch_dir);
+    watch_dirs_.push_back(std::move(watch_dir));
 }
 
 void FileSystemMonitor::RemoveWatchPath(const std::string& path) {
-    auto it = std::remove_if(watch_dirs_.begin(), watch_dirs_.end(),
-        [&path](const WatchDirectory& wd) {
-            return wd.path == path;
+    auto it = std::stable_partition(watch_dirs_.begin(), watch_dirs_.end(),
+        [&path](const std::unique_ptr<WatchDirectory>& wd) {
+            return wd->path != path;
         });
     
-    if (it != watch_dirs_.end()) {
-        if (it->handle != INVALID_HANDLE_VALUE) {
-            CloseHandle(it->handle);
+    for (auto removed = it; removed != watch_dirs_.end(); ++removed) {
+        CloseDirectoryWatch(**removed);
+        // A worker may still dequeue the cancelled read
+        if (running_.load()) {
+            retired_dirs_.push_back(std::move(*removed));
         }
-        watch_dirs_.erase(it, watch_dirs_.end());
     }
+    watch_dirs_.erase(it, watch_dirs_.end());
 }
 
 bool FileSystemMonitor::SetupDirectoryWatch(WatchDirectory& watch_dir) {
@@ -143,13 +336,27 @@ bool FileSystemMonitor::SetupDirectoryWatch(WatchDirectory& watch_dir) {
         return false;
     }
 
-    watch_dir.overlapped.hEvent = CreateEvent(NULL, TRUE, FALSE, NULL);
-    if (watch_dir.overlapped.hEvent == NULL) {
+#ifndef __linux__
+    // The completion key is the watch itself, never a position in watch_dirs_
+    if (CreateIoCompletionPort(watch_dir.handle, completion_port_,
+                               reinterpret_cast<ULONG_PTR>(&watch_dir), 0) == NULL) {
         CloseHandle(watch_dir.handle);
         watch_dir.handle = INVALID_HANDLE_VALUE;
         return false;
     }
+#endif
 
+    if (!IssueDirectoryRead(watch_dir)) {
+        CloseHandle(watch_dir.handle);
+        watch_dir.handle = INVALID_HANDLE_VALUE;
+        return false;
+    }
+    return true;
+}
+
+bool FileSystemMonitor::IssueDirectoryRead(WatchDirectory& watch_dir) {
+    ZeroMemory(&watch_dir.overlapped, sizeof(OVERLAPPED));
+    
     DWORD bytes_returned;
     BOOL result = ReadDirectoryChangesW(
         watch_dir.handle,
@@ -164,103 +371,380 @@ bool FileSystemMonitor::SetupDirectoryWatch(WatchDirectory& watch_dir) {
         NULL
     );
 
-    if (!result && GetLastError() != ERROR_IO_PENDING) {
-        CloseHandle(watch_dir.overlapped.hEvent);
-        CloseHandle(watch_dir.handle);
-        watch_dir.handle = INVALID_HANDLE_VALUE;
-        return false;
+    watch_dir.active = result || GetLastError() == ERROR_IO_PENDING;
+    return watch_dir.active;
+}
+
+void FileSystemMonitor::CloseDirectoryWatch(WatchDirectory& watch_dir) {
+    if (watch_dir.handle == INVALID_HANDLE_VALUE) {
+        return;
     }
 
-    watch_dir.active = true;
-    return true;
+#ifndef __linux__
+    // The outstanding read owns the buffer until it completes
+    if (watch_dir.active.exchange(false) && CancelIoEx(watch_dir.handle, &watch_dir.overlapped)) {
+        DWORD bytes_transferred;
+        GetOverlappedResult(watch_dir.handle, &watch_dir.overlapped, &bytes_transferred, TRUE);
+    }
+#endif
+    CloseHandle(watch_dir.handle);
+    watch_dir.handle = INVALID_HANDLE_VALUE;
+    watch_dir.active = false;
 }
 
-void FileSystemMonitor::MonitoringThreadFunction() {
-    std::vector<HANDLE> events;
-    
-    // Collect all event handles
-    for (const auto& watch_dir : watch_dirs_) {
-        if (watch_dir.active && watch_dir.overlapped.hEvent) {
-            events.push_back(watch_dir.overlapped.hEvent);
+void FileSystemMonitor::MonitoringThreadFunction(size_t shard) {
+#ifdef __linux__
+    // The shard's epoll loop returns once Stop() wakes it
+    linux_watchers_[shard]->Run();
+#else
+    (void)shard;
+
+    while (true) {
+        DWORD bytes_transferred = 0;
+        ULONG_PTR key = 0;
+        LPOVERLAPPED overlapped = NULL;
+        BOOL ok = GetQueuedCompletionStatus(completion_port_, &bytes_transferred, &key, &overlapped, INFINITE);
+        if (key == 0) {
+            break;
         }
-    }
 
-    while (running_.load()) {
-        if (events.empty()) {
-            Sleep(100);
+        // Cancelled or failed reads are not reissued
+        auto* watch_dir = reinterpret_cast<WatchDirectory*>(key);
+        if (!ok || !watch_dir->active.load()) {
+            watch_dir->active = false;
             continue;
         }
 
-        DWORD wait_result = WaitForMultipleObjects(
-            static_cast<DWORD>(events.size()),
-            events.data(),
-            FALSE,
-            100 // 100ms timeout
-        );
-
-        if (wait_result >= WAIT_OBJECT_0 && wait_result < WAIT_OBJECT_0 + events.size()) {
-            size_t index = wait_result - WAIT_OBJECT_0;
-            if (index < watch_dirs_.size()) {
-                auto& watch_dir = watch_dirs_[index];
-                
-                DWORD bytes_transferred;
-                if (GetOverlappedResult(watch_dir.handle, &watch_dir.overlapped, &bytes_transferred, FALSE)) {
-                    // Process the file system events
-                    auto* fni = reinterpret_cast<FILE_NOTIFY_INFORMATION*>(watch_dir.buffer.data());
-                    ProcessFileSystemEvent(fni, watch_dir.path);
-                }
+        // Only this worker owns the buffer until the next read is issued
+        if (bytes_transferred > 0) {
+            ProcessFileSystemEvent(*watch_dir, bytes_transferred);
+        } else {
+            // The changes did not fit and were dropped: grow the buffer for
+            // the next burst and rebuild what was lost from a snapshot
+            watch_dir->overflow_count++;
+            if (watch_dir->buffer.size() < kMaxWatchBuffer) {
+                watch_dir->buffer.resize(std::min(watch_dir->buffer.size() * 2, kMaxWatchBuffer));
+            }
+            ScheduleRescan(*watch_dir);
+        }
+
+        // Network shares refuse reads above 64 KB
+        if (!IssueDirectoryRead(*watch_dir) && watch_dir->buffer.size() > kInitialWatchBuffer &&
+            GetLastError() == ERROR_INVALID_PARAMETER) {
+            watch_dir->buffer.resize(kInitialWatchBuffer);
+            IssueDirectoryRead(*watch_dir);
+        }
+        watch_dir->buffer_bytes = watch_dir->buffer.size();
+    }
+#endif
+}
+
+void FileSystemMonitor::ProcessFileSystemEvent(WatchDirectory& watch_dir, DWORD bytes) {
+    // This should be enhanced to get actual process
+    const DWORD process_id = GetCurrentProcessId();
+    watch_dir.decoder.Decode(watch_dir.buffer.data(), std::min<size_t>(bytes, watch_dir.buffer.size()),
+                             [this, process_id](std::string_view path, DWORD action) {
+                                 HandleFileChange(path, action, process_id);
+                             });
+}
+
+void FileSystemMonitor::ScheduleRescan(WatchDirectory& watch_dir) {
+    if (watch_dir.scan_root.empty() || watch_dir.rescan_requests.fetch_add(1) > 0) {
+        return;     // The pass in progress picks the request up
+    }
+
+    BeginTask();
+    rescan_pool_->Submit([this, &watch_dir]() {
+        // Each pass covers every request made before it started
+        size_t requests;
+        do {
+            requests = watch_dir.rescan_requests.load();
+            RescanWatch(watch_dir);
+        } while (watch_dir.rescan_requests.fetch_sub(requests) != requests);
+        EndTask();
+    });
+}
+
+void FileSystemMonitor::BeginTask() {
+    std::lock_guard<std::mutex> lock(tasks_mutex_);
+    tasks_in_flight_++;
+}
+
+void FileSystemMonitor::EndTask() {
+    {
+        std::lock_guard<std::mutex> lock(tasks_mutex_);
+        tasks_in_flight_--;
+    }
+    tasks_cv_.notify_all();
+}
+
+void FileSystemMonitor::RescanWatch(WatchDirectory& watch_dir) {
+    auto current = std::make_shared<const DirectorySnapshot>(DirectorySnapshot::Capture(
+        watch_dir.scan_root, scan_depth_, kMaxSnapshotEntries, rescan_pool_.get()));
+
+    std::shared_ptr<const DirectorySnapshot> previous;
+    {
+        std::lock_guard<std::mutex> lock(watch_dir.snapshot_mutex);
+        previous = std::move(watch_dir.snapshot);
+        watch_dir.snapshot = current;
+    }
+    if (!previous) {
+        return;     // Baseline
+    }
+
+    // Everything that changed since the previous capture is reported,
+    // including changes whose notifications did arrive
+    watch_dir.rescan_count++;
+    current->Diff(*previous, [this, &watch_dir](const std::string& path, DWORD action) {
+        watch_dir.reconstructed_count++;
+        if (running_.load()) {
+            HandleFileChange(path, action, GetCurrentProcessId(), true);
+        }
+    });
+}
+
+bool FileSystemMonitor::RunBaselineScan() {
+    if (!running_.load() || baseline_scanning_.exchange(true)) {
+        return false;
+    }
+
+    std::vector<std::string> roots;
+    for (const auto& watch_dir : watch_dirs_) {
+        if (!watch_dir->scan_root.empty()) {
+            roots.push_back(watch_dir->scan_root);
+        }
+    }
+    BaselineScanOptions options;
+    options.max_depth = scan_depth_;
+    options.hash_contents = content_hashing_.load();
+    options.io_bytes_per_second = baseline_io_budget_.load();
+
+    // Registered before checking running_ again, so Stop() either sees the
+    // scanner or the scan never starts. A database that cannot be read is
+    // rebuilt. Only roots whose last scan completed to this depth are
+    // diffed; the rest are reported as a first baseline, since an entry
+    // missing from a partial inventory is not an addition.
+    auto scanner = std::make_shared<BaselineScanner>(rescan_pool_, content_hasher_);
+    std::vector<bool> diff_roots(roots.size(), false);
+    {
+        std::lock_guard<std::mutex> lock(baseline_mutex_);
+        baseline_scanner_ = scanner;
+        if (!inventory_path_.empty() && !inventory_db_.IsOpen() && !inventory_db_.Open(inventory_path_)) {
+            std::remove(inventory_path_.c_str());
+            inventory_db_.Open(inventory_path_);
+        }
+        if (offline_diff_pending_.exchange(false) && inventory_db_.IsOpen()) {
+            for (size_t i = 0; i < roots.size(); ++i) {
+                diff_roots[i] = inventory_db_.IsRootComplete(roots[i], options.max_depth);
+            }
+        }
+    }
+    if (!running_.load()) {
+        scanner->Cancel();
+    }
 
-                // Reset the event and start watching again
-                ResetEvent(watch_dir.overlapped.hEvent);
-                DWORD bytes_returned;
-                ReadDirectoryChangesW(
-                    watch_dir.handle,
-                    watch_dir.buffer.data(),
-                    static_cast<DWORD>(watch_dir.buffer.size()),
-                    TRUE,
-                    FILE_NOTIFY_CHANGE_FILE_NAME | FILE_NOTIFY_CHANGE_DIR_NAME |
-                    FILE_NOTIFY_CHANGE_ATTRIBUTES | FILE_NOTIFY_CHANGE_SIZE |
-                    FILE_NOTIFY_CHANGE_LAST_WRITE | FILE_NOTIFY_CHANGE_SECURITY,
-                    &bytes_returned,
-                    &watch_dir.overlapped,
-                    NULL
-                );
+    auto inventory = std::make_shared<std::vector<InventoryEntry>>();
+    std::mutex inventory_mutex;
+    BaselineScanStats stats = scanner->Scan(roots, options, [&](const InventoryEntry& entry) {
+        int root = RootIndex(entry.path, roots);
+        if (root < 0 || !diff_roots[root]) {
+            ReportBaselineEntry(entry);
+        } else {
+            InventoryEntry known;
+            if (!inventory_db_.Lookup(entry.path, known)) {
+                ReportOfflineChange(entry, FILE_ACTION_ADDED);
+            } else if (InventoryChanged(known, entry)) {
+                ReportOfflineChange(entry, FILE_ACTION_MODIFIED);
             }
         }
+        std::lock_guard<std::mutex> lock(inventory_mutex);
+        inventory->push_back(entry);
+    });
+
+    UpdateInventoryDatabase(roots, *inventory, !stats.truncated, options.max_depth, diff_roots);
+    {
+        std::lock_guard<std::mutex> lock(baseline_mutex_);
+        baseline_scanner_.reset();
+        baseline_stats_ = stats;
+        baseline_inventory_ = std::move(inventory);
     }
+    baseline_scanning_ = false;
+    return true;
 }
 
-void FileSystemMonitor::ProcessFileSystemEvent(const FILE_NOTIFY_INFORMATION* fni, const std::string& directory) {
-    const FILE_NOTIFY_INFORMATION* current = fni;
-    
-    while (current != nullptr) {
-        // Convert wide string to narrow string
-        int size_needed = WideCharToMultiByte(CP_UTF8, 0, current->FileName, 
-            current->FileNameLength / sizeof(WCHAR), NULL, 0, NULL, NULL);
-        std::string filename(size_needed, 0);
-        WideCharToMultiByte(CP_UTF8, 0, current->FileName, 
-            current->FileNameLength / sizeof(WCHAR), &filename[0], size_needed, NULL, NULL);
-
-        std::string full_path = directory + "\\" + filename;
-
-        // Check if this file type should be monitored
-        if (IsFileTypeIncluded(full_path)) {
-            SecurityEvent event = CreateSecurityEvent(full_path, current->Action);
-            if (event_callback_) {
-                event_callback_(event);
+void FileSystemMonitor::UpdateInventoryDatabase(const std::vector<std::string>& roots,
+                                                const std::vector<InventoryEntry>& inventory, bool complete,
+                                                int depth, const std::vector<bool>& report_roots) {
+    std::vector<InventoryEntry> removed;
+    {
+        std::lock_guard<std::mutex> lock(baseline_mutex_);
+        if (!inventory_db_.IsOpen()) {
+            return;
+        }
+
+        std::unordered_set<std::string_view> seen;
+        seen.reserve(inventory.size());
+        for (const auto& entry : inventory) {
+            seen.insert(entry.path);
+            InventoryEntry known;
+            if (!inventory_db_.Lookup(entry.path, known) || InventoryChanged(known, entry) ||
+                (entry.hashed && !known.hashed)) {
+                inventory_db_.Put(entry);
             }
         }
 
-        // Move to next notification
-        if (current->NextEntryOffset == 0) {
-            break;
+        // An entry the scan did not see is gone only if it was under a
+        // scanned root and no longer exists; it may just be below the depth.
+        // Removals are reported only against a complete earlier baseline.
+        if (complete) {
+            std::vector<std::string> gone;
+            inventory_db_.ForEach([&](const InventoryEntry& entry) {
+                int root = seen.count(entry.path) != 0 ? -1 : RootIndex(entry.path, roots);
+                std::error_code ec;
+                if (root < 0 ||
+                    std::filesystem::symlink_status(entry.path, ec).type() != std::filesystem::file_type::not_found) {
+                    return;
+                }
+                gone.push_back(entry.path);
+                if (report_roots[root]) {
+                    removed.push_back(entry);
+                }
+            });
+            for (const auto& path : gone) {
+                inventory_db_.Remove(path);
+            }
+            for (const auto& root : roots) {
+                inventory_db_.MarkRootComplete(root, depth);
+            }
+        }
+
+        // The log is folded into the compacted region once it is a quarter
+        // of its size
+        InventoryDatabaseStats stats = inventory_db_.GetStats();
+        if (stats.log_records + stats.pending_records > stats.compacted_records / 4) {
+            inventory_db_.Compact();
+        } else {
+            inventory_db_.Flush();
         }
-        current = reinterpret_cast<const FILE_NOTIFY_INFORMATION*>(
-            reinterpret_cast<const BYTE*>(current) + current->NextEntryOffset);
+    }
+
+    for (const auto& entry : removed) {
+        ReportOfflineChange(entry, FILE_ACTION_REMOVED);
     }
 }
 
-SecurityEvent FileSystemMonitor::CreateSecurityEvent(const std::string& file_path, DWORD action) {
+void FileSystemMonitor::ReportBaselineEntry(const InventoryEntry& entry) {
+    if (entry.IsDirectory() || !running_.load()) {
+        return;
+    }
+
+    // Everything is inventoried, but only reported executables are
+    // evaluated; a dropper planted before startup shows up here
+    auto classifier = std::atomic_load(&classifier_);
+    PathClassification path_class = classifier->Classify(entry.path);
+    if (!classifier->IsReported(path_class) || !IsInventoryExecutable(entry, path_class)) {
+        return;
+    }
+
+    SecurityEvent event = CreateSecurityEvent(entry.path, path_class, 0, GetCurrentProcessId());
+    event.metadata["baseline"] = "true";
+    if (entry.hashed) {
+        event.metadata["sha256"] = entry.hashes.sha256;
+        event.metadata["xxh64"] = entry.hashes.Xxh64Hex();
+    }
+    event.description = "Baseline inventory: " + entry.path;
+    DispatchEvent(std::move(event), false);
+}
+
+void FileSystemMonitor::ReportOfflineChange(const InventoryEntry& entry, DWORD action) {
+    if (entry.IsDirectory() || !running_.load()) {
+        return;
+    }
+
+    auto classifier = std::atomic_load(&classifier_);
+    PathClassification path_class = classifier->Classify(entry.path);
+    if (!classifier->IsReported(path_class)) {
+        return;
+    }
+
+    SecurityEvent event = CreateSecurityEvent(entry.path, path_class, action, GetCurrentProcessId());
+    event.metadata["offline"] = "true";
+    if (entry.hashed && action != FILE_ACTION_REMOVED) {
+        event.metadata["sha256"] = entry.hashes.sha256;
+        event.metadata["xxh64"] = entry.hashes.Xxh64Hex();
+    }
+    DispatchEvent(std::move(event), false);
+}
+
+void FileSystemMonitor::HandleFileChange(std::string_view full_path, DWORD action, DWORD process_id,
+                                         bool reconstructed) {
+    // Check if this file type should be monitored; the path is only copied
+    // for events that are reported
+    auto classifier = std::atomic_load(&classifier_);
+    PathClassification path_class = classifier->Classify(full_path.data(), full_path.size());
+    if (classifier->IsReported(path_class)) {
+        SecurityEvent event = CreateSecurityEvent(std::string(full_path), path_class, action, process_id);
+        if (reconstructed) {
+            event.metadata["reconstructed"] = "true";
+        }
+        bool hash_content = action != FILE_ACTION_REMOVED && action != FILE_ACTION_RENAMED_OLD_NAME;
+        DispatchEvent(std::move(event), hash_content);
+    }
+}
+
+void FileSystemMonitor::DispatchEvent(SecurityEvent event, bool hash_content) {
+    if (!event_callback_) {
+        return;
+    }
+    if (!hash_content || !content_hashing_.load()) {
+        event_callback_(event);
+        return;
+    }
+
+    // The event keeps the timestamp of the change; a cached hash is
+    // attached before this returns
+    BeginTask();
+    std::string path = event.target_path;
+    bool accepted = content_hasher_->HashAsync(path, [this, event](bool ok, const FileHashes& hashes) mutable {
+        if (ok) {
+            event.metadata["sha256"] = hashes.sha256;
+            event.metadata["xxh64"] = hashes.Xxh64Hex();
+        }
+        event_callback_(event);
+        EndTask();
+    });
+    if (!accepted) {
+        EndTask();
+        event_callback_(event);
+    }
+}
+
+bool FileSystemMonitor::DecideFileAccess(const FileAccessRequest& request) {
+    // Excluded file types are not held, as they are not reported
+    auto classifier = std::atomic_load(&classifier_);
+    PathClassification path_class = classifier->Classify(request.path);
+    if (!classifier->IsReported(path_class)) {
+        return true;
+    }
+
+    SecurityEvent event = CreateSecurityEvent(request.path, path_class, 0, request.process_id);
+    if (!request.process_path.empty()) {
+        event.process_path = request.process_path;
+    }
+    event.metadata["access"] = request.execute ? "execute" : "open";
+
+    bool allow = access_decider_(event);
+    if (!allow && event_callback_) {
+        event.metadata["access_denied"] = "true";
+        event.description = "File access denied: " + request.path;
+        event_callback_(event);
+    }
+    return allow;
+}
+
+SecurityEvent FileSystemMonitor::CreateSecurityEvent(const std::string& file_path,
+                                                     const PathClassification& path_class, DWORD action,
+                                                     DWORD process_id) {
     SecurityEvent event;
     
     // Determine event type based on action
@@ -282,8 +766,8 @@ SecurityEvent FileSystemMonitor::CreateSecurityEvent(const std::string& file_pat
     }
 
     event.target_path = file_path;
-    event.threat_level = EvaluateThreatLevel(file_path, action);
-    event.process_id = GetCurrentProcessId(); // This should be enhanced to get actual process
+    event.threat_level = EvaluateThreatLevel(path_class, action);
+    event.process_id = process_id;
     event.thread_id = GetCurrentThreadId();
     event.process_path = GetProcessPathFromPID(event.process_id);
     
@@ -291,31 +775,29 @@ SecurityEvent FileSystemMonitor::CreateSecurityEvent(const std::string& file_pat
     
     // Add metadata
     event.metadata["action"] = std::to_string(action);
-    event.metadata["file_extension"] = GetFileExtension(file_path);
-    event.metadata["is_system_file"] = IsSystemFile(file_path) ? "true" : "false";
+    event.metadata["file_extension"] = path_class.extension_offset != std::string::npos
+        ? file_path.substr(path_class.extension_offset, path_class.extension_length)
+        : std::string();
+    event.metadata["is_system_file"] = path_class.system_file ? "true" : "false";
     
     event.description = "File system activity detected: " + file_path;
     
     return event;
 }
 
-ThreatLevel FileSystemMonitor::EvaluateThreatLevel(const std::string& file_path, DWORD action) {
+ThreatLevel FileSystemMonitor::EvaluateThreatLevel(const PathClassification& path_class, DWORD action) {
     // Critical system files
-    if (IsSystemFile(file_path)) {
+    if (path_class.system_file) {
         return ThreatLevel::CRITICAL;
     }
 
     // Check if it's in a critical directory
-    if (IsCriticalDirectory(file_path)) {
+    if (path_class.critical_directory) {
         return ThreatLevel::HIGH;
     }
 
     // Executable files
-    std::string ext = GetFileExtension(file_path);
-    std::transform(ext.begin(), ext.end(), ext.begin(), ::tolower);
-    
-    if (ext == ".exe" || ext == ".dll" || ext == ".sys" || ext == ".bat" || 
-        ext == ".cmd" || ext == ".ps1" || ext == ".vbs" || ext == ".scr") {
+    if (path_class.extension_class & EXTENSION_EXECUTABLE) {
         return ThreatLevel::HIGH;
     }
 
@@ -327,64 +809,83 @@ ThreatLevel FileSystemMonitor::EvaluateThreatLevel(const std::string& file_path,
     return ThreatLevel::LOW;
 }
 
-bool FileSystemMonitor::IsFileTypeIncluded(const std::string& file_path) {
-    std::string ext = GetFileExtension(file_path);
-    std::transform(ext.begin(), ext.end(), ext.begin(), ::tolower);
+std::string FileSystemMonitor::GetProcessPathFromPID(DWORD pid) {
+    return identity_cache_->Resolve(pid);
+}
 
-    // If included extensions are specified, only monitor those
-    if (!included_extensions_.empty()) {
-        return included_extensions_.find(ext) != included_extensions_.end();
-    }
+void FileSystemMonitor::RegisterCallback(std::function<void(const SecurityEvent&)> callback) {
+    event_callback_ = callback;
+}
 
-    // Otherwise, monitor all except excluded
-    return excluded_extensions_.find(ext) == excluded_extensions_.end();
+void FileSystemMonitor::EnableAccessEnforcement(std::function<bool(const SecurityEvent&)> decider,
+                                                std::chrono::milliseconds deadline) {
+    access_decider_ = decider;
+    access_deadline_ = deadline;
 }
 
-std::string FileSystemMonitor::GetProcessPathFromPID(DWORD pid) {
-    HANDLE process = OpenProcess(PROCESS_QUERY_INFORMATION | PROCESS_VM_READ, FALSE, pid);
-    if (process == NULL) {
-        return "Unknown";
-    }
+void FileSystemMonitor::ClearAccessVerdictCache() {
+#ifdef __linux__
+    access_guard_.ClearVerdictCache();
+#endif
+}
 
-    char path[MAX_PATH];
-    DWORD size = GetModuleFileNameExA(process, NULL, path, MAX_PATH);
-    CloseHandle(process);
+bool FileSystemMonitor::IsAccessEnforcementActive() const {
+#ifdef __linux__
+    return access_guard_.IsRunning();
+#else
+    return false;
+#endif
+}
 
-    if (size > 0) {
-        return std::string(path);
+std::vector<WatchRootStats> FileSystemMonitor::GetWatchRootStats() const {
+    std::vector<WatchRootStats> stats;
+    for (const auto& watch_dir : watch_dirs_) {
+        WatchRootStats root;
+        root.path = watch_dir->path;
+        root.overflows = watch_dir->overflow_count.load();
+        root.rescans = watch_dir->rescan_count.load();
+        root.reconstructed_changes = watch_dir->reconstructed_count.load();
+        root.buffer_bytes = watch_dir->buffer_bytes.load();
+#ifdef __linux__
+        // The shard's watcher reads notifications for all of its roots
+        if (watch_dir->shard < linux_watchers_.size()) {
+            root.buffer_bytes = linux_watchers_[watch_dir->shard]->GetBufferSize();
+        }
+#endif
+        {
+            std::lock_guard<std::mutex> lock(watch_dir->snapshot_mutex);
+            root.snapshot_entries = watch_dir->snapshot ? watch_dir->snapshot->GetEntryCount() : 0;
+        }
+        stats.push_back(root);
     }
-    return "Unknown";
+    return stats;
 }
 
-std::string FileSystemMonitor::GetFileExtension(const std::string& file_path) {
-    size_t dot_pos = file_path.find_last_of('.');
-    if (dot_pos != std::string::npos) {
-        return file_path.substr(dot_pos);
-    }
-    return "";
+BaselineScanStats FileSystemMonitor::GetBaselineScanStats() const {
+    std::lock_guard<std::mutex> lock(baseline_mutex_);
+    return baseline_stats_;
 }
 
-bool FileSystemMonitor::IsSystemFile(const std::string& file_path) {
-    std::string upper_path = file_path;
-    std::transform(upper_path.begin(), upper_path.end(), upper_path.begin(), ::toupper);
-    
-    return upper_path.find("C:\\WINDOWS\\SYSTEM32") != std::string::npos ||
-           upper_path.find("C:\\WINDOWS\\SYSWOW64") != std::string::npos ||
-           upper_path.find("NTOSKRNL.EXE") != std::string::npos ||
-           upper_path.find("KERNEL32.DLL") != std::string::npos ||
-           upper_path.find("NTDLL.DLL") != std::string::npos;
+std::shared_ptr<const std::vector<InventoryEntry>> FileSystemMonitor::GetBaselineInventory() const {
+    std::lock_guard<std::mutex> lock(baseline_mutex_);
+    return baseline_inventory_;
 }
 
-bool FileSystemMonitor::IsCriticalDirectory(const std::string& directory) {
-    std::string upper_dir = directory;
-    std::transform(upper_dir.begin(), upper_dir.end(), upper_dir.begin(), ::toupper);
-    
-    return upper_dir.find("C:\\WINDOWS") != std::string::npos ||
-           upper_dir.find("C:\\PROGRAM FILES") != std::string::npos;
+InventoryDatabaseStats FileSystemMonitor::GetInventoryDatabaseStats() const {
+    std::lock_guard<std::mutex> lock(baseline_mutex_);
+    return inventory_db_.GetStats();
 }
 
-void FileSystemMonitor::RegisterCallback(std::function<void(const SecurityEvent&)> callback) {
-    event_callback_ = callback;
+AccessDecisionStats FileSystemMonitor::GetAccessDecisionStats() const {
+#ifdef __linux__
+    return access_guard_.GetStats();
+#else
+    return AccessDecisionStats();
+#endif
+}
+
+void FileSystemMonitor::SetWorkerThreads(size_t count) {
+    worker_threads_ = std::max<size_t>(count, 1);
 }
 
 void FileSystemMonitor::SetScanDepth(int depth) {
@@ -392,17 +893,26 @@ void FileSystemMonitor::SetScanDepth(int depth) {
 }
 
 void FileSystemMonitor::SetExcludedExtensions(const std::vector<std::string>& extensions) {
-    excluded_extensions_.clear();
-    for (const auto& ext : extensions) {
-        excluded_extensions_.insert(ext);
-    }
+    classifier_config_.excluded_extensions = extensions;
+    std::atomic_store(&classifier_, std::make_shared<const PathClassifier>(classifier_config_));
+}
+
+void FileSystemMonitor::SetProcessIdentityCache(std::shared_ptr<ProcessIdentityCache> cache) {
+    identity_cache_ = cache ? std::move(cache) : ProcessIdentityCache::Shared();
+}
+
+void FileSystemMonitor::SetContentHasher(std::shared_ptr<ContentHasher> hasher) {
+    content_hasher_ = hasher ? std::move(hasher) : ContentHasher::Shared();
 }
 
 void FileSystemMonitor::SetIncludedExtensions(const std::vector<std::string>& extensions) {
-    included_extensions_.clear();
-    for (const auto& ext : extensions) {
-        included_extensions_.insert(ext);
-    }
+    classifier_config_.included_extensions = extensions;
+    std::atomic_store(&classifier_, std::make_shared<const PathClassifier>(classifier_config_));
+}
+
+void FileSystemMonitor::SetPathClassifierConfig(const PathClassifierConfig& config) {
+    classifier_config_ = config;
+    std::atomic_store(&classifier_, std::make_shared<const PathClassifier>(classifier_config_));
 }
 
 } // namespace HIPS
\ No newline at end of file
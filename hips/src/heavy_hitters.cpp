@@ -0,0 +1,113 @@
+/*
+ * Heavy-Hitter Sketches Implementation
+ */
+
+#include "heavy_hitters.h"
+#include <algorithm>
+#include <cmath>
+
+namespace HIPS {
+
+// Finalizer used to derive independent row hashes from one key hash
+static uint64_t MixHash(uint64_t value) {
+    value ^= value >> 33;
+    value *= 0xff51afd7ed558ccdULL;
+    value ^= value >> 33;
+    value *= 0xc4ceb9fe1a85ec53ULL;
+    value ^= value >> 33;
+    return value;
+}
+
+CountMinSketch::CountMinSketch(size_t width, size_t depth)
+    : width_(std::max<size_t>(width, 1)), depth_(std::min(std::max<size_t>(depth, 1), kMaxDepth)),
+      counters_(width_ * depth_, 0) {
+}
+
+void CountMinSketch::Indexes(uint64_t hash, size_t* indexes) const {
+    // Double hashing: row i uses h1 + i * h2
+    uint64_t mixed = MixHash(hash);
+    uint64_t h1 = mixed & 0xffffffffULL;
+    uint64_t h2 = (mixed >> 32) | 1;
+    for (size_t row = 0; row < depth_; ++row) {
+        indexes[row] = row * width_ + static_cast<size_t>((h1 + row * h2) % width_);
+    }
+}
+
+uint32_t CountMinSketch::Add(uint64_t hash, uint32_t count) {
+    size_t indexes[kMaxDepth];
+    Indexes(hash, indexes);
+    
+    uint32_t estimate = UINT32_MAX;
+    for (size_t row = 0; row < depth_; ++row) {
+        estimate = std::min(estimate, counters_[indexes[row]]);
+    }
+    uint32_t target = estimate > UINT32_MAX - count ? UINT32_MAX : estimate + count;
+    
+    // Conservative update: raise only counters below the new estimate
+    for (size_t row = 0; row < depth_; ++row) {
+        counters_[indexes[row]] = std::max(counters_[indexes[row]], target);
+    }
+    return target;
+}
+
+uint32_t CountMinSketch::Estimate(uint64_t hash) const {
+    size_t indexes[kMaxDepth];
+    Indexes(hash, indexes);
+    
+    uint32_t estimate = UINT32_MAX;
+    for (size_t row = 0; row < depth_; ++row) {
+        estimate = std::min(estimate, counters_[indexes[row]]);
+    }
+    return estimate;
+}
+
+void CountMinSketch::Decay() {
+    for (auto& counter : counters_) {
+        counter /= 2;
+    }
+}
+
+void CountMinSketch::Clear() {
+    std::fill(counters_.begin(), counters_.end(), 0);
+}
+
+void HyperLogLog::Add(uint64_t hash) {
+    uint64_t mixed = MixHash(hash);
+    size_t index = static_cast<size_t>(mixed >> (64 - kPrecision));
+    
+    // Rank of the first set bit in the remaining bits
+    uint64_t rest = (mixed << kPrecision) | (uint64_t(1) << (kPrecision - 1));
+    uint8_t rank = 1;
+    while ((rest & (uint64_t(1) << 63)) == 0) {
+        rest <<= 1;
+        rank++;
+    }
+    registers_[index] = std::max(registers_[index], rank);
+}
+
+uint64_t HyperLogLog::Estimate() const {
+    const double m = static_cast<double>(kRegisters);
+    double sum = 0.0;
+    size_t zeros = 0;
+    for (uint8_t value : registers_) {
+        sum += std::ldexp(1.0, -static_cast<int>(value));
+        if (value == 0) {
+            zeros++;
+        }
+    }
+    
+    // alpha_64 bias correction
+    double estimate = 0.709 * m * m / sum;
+    if (estimate <= 2.5 * m && zeros != 0) {
+        estimate = m * std::log(m / static_cast<double>(zeros));
+    }
+    return static_cast<uint64_t>(estimate + 0.5);
+}
+
+void HyperLogLog::Merge(const HyperLogLog& other) {
+    for (size_t i = 0; i < kRegisters; ++i) {
+        registers_[i] = std::max(registers_[i], other.registers_[i]);
+    }
+}
+
+} // namespace HIPS
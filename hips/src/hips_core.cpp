@@ -9,14 +9,20 @@
 #include "alert_manager.h"
 #include "self_protection.h"
 #include "correlation_engine.h"
+#include "state_snapshot.h"
+#include "event_aggregation.h"
+#include "content_hasher.h"
 #include <iostream>
 #include <sstream>
 #include <fstream>
+#include <algorithm>
+#include <cctype>
 
 namespace HIPS {
 
 HIPSEngine::HIPSEngine() 
-    : running_(false), initialized_(false) {
+    : running_(false), initialized_(false), snapshot_interval_(0),
+      state_restored_(false), snapshot_stop_(false) {
 }
 
 HIPSEngine::~HIPSEngine() {
@@ -62,6 +68,7 @@ bool HIPSEngine::Initialize() {
         // Load default rules
         LoadDefaultRules();
         
+        state_restored_ = false;
         initialized_.store(true);
         log_manager_->LogInfo("HIPS Engine initialized successfully");
         return true;
@@ -196,7 +203,18 @@ bool HIPSEngine::Start() {
     }
     
     try {
+        // Resume from the last checkpoint before events start flowing; a
+        // missing snapshot just means a cold start
+        LoadSnapshotSettings();
+        if (!state_restored_ && !snapshot_path_.empty()) {
+            state_restored_ = true;
+            RestoreStateSnapshot(snapshot_path_);
+        }
+        
         // Start all monitoring components
+        ConfigureAccessEnforcement();
+        ConfigureContentHashing();
+        ConfigureBaselineScan();
         if (!fs_monitor_->Start()) return false;
         if (!proc_monitor_->Start()) return false;
         if (!net_monitor_->Start()) return false;
@@ -204,6 +222,8 @@ bool HIPSEngine::Start() {
         if (!mem_protector_->Start()) return false;
         if (!self_protection_->Start()) return false;
         
+        StartSnapshotThread();
+        StartAggregationAgent();
         running_.store(true);
         log_manager_->LogInfo("HIPS Engine started successfully");
         return true;
@@ -228,7 +248,20 @@ bool HIPSEngine::Stop() {
         if (reg_monitor_) reg_monitor_->Stop();
         if (net_monitor_) net_monitor_->Stop();
         if (proc_monitor_) proc_monitor_->Stop();
-        if (fs_monitor_) fs_monitor_->Stop();
+        if (fs_monitor_) {
+            fs_monitor_->Stop();
+            LogAccessDecisionStats();
+            LogBaselineScanStats();
+        }
+        LogProcessIdentityStats();
+        LogContentHashStats();
+        if (aggregation_agent_) aggregation_agent_->Stop();
+        
+        // Final checkpoint once no more events can arrive
+        StopSnapshotThread();
+        if (!snapshot_path_.empty()) {
+            SaveStateSnapshot(snapshot_path_);
+        }
         
         running_.store(false);
         log_manager_->LogInfo("HIPS Engine stopped successfully");
@@ -276,7 +309,11 @@ void HIPSEngine::ShutdownComponents() {
     log_manager_.reset();
 }
 
-void HIPSEngine::ProcessSecurityEvent(const SecurityEvent& event) {
+void HIPSEngine::ProcessSecurityEvent(const SecurityEvent& incoming) {
+    // Known-bad content is critical whatever the monitor assessed
+    SecurityEvent matched;
+    const SecurityEvent& event = MatchThreatSignature(incoming, matched) ? matched : incoming;
+    
     const auto process_name_it = event.metadata.find("process_name");
     const bool has_process_name =
         process_name_it != event.metadata.end() &&
@@ -299,6 +336,10 @@ void HIPSEngine::ProcessSecurityEvent(const SecurityEvent& event) {
         correlation_engine_->ProcessEvent(event);
     }
     
+    if (aggregation_agent_) {
+        aggregation_agent_->Submit(event);
+    }
+    
     // Log the event
     if (log_manager_ && !suppress_process_log) {
         std::ostringstream oss;
@@ -325,6 +366,23 @@ void HIPSEngine::ProcessSecurityEvent(const SecurityEvent& event) {
     }
 }
 
+bool HIPSEngine::MatchThreatSignature(const SecurityEvent& event, SecurityEvent& matched) const {
+    auto hash = event.metadata.find("sha256");
+    if (hash == event.metadata.end()) {
+        return false;
+    }
+    
+    std::lock_guard<std::mutex> lock(signatures_mutex_);
+    auto signature = threat_signatures_.find(hash->second);
+    if (signature == threat_signatures_.end()) {
+        return false;
+    }
+    matched = event;
+    matched.threat_level = ThreatLevel::CRITICAL;
+    matched.metadata["threat_signature"] = signature->second;
+    return true;
+}
+
 ActionType HIPSEngine::EvaluateEvent(const SecurityEvent& event) {
     std::lock_guard<std::mutex> lock(rules_mutex_);
     
@@ -370,7 +428,8 @@ bool HIPSEngine::ApplyAction(const SecurityEvent& event, ActionType action) {
             return true;
             
         case ActionType::DENY:
-            // Block the action
+            // File opens are blocked up front when access enforcement is
+            // on; everything else is reported
             if (alert_manager_) {
                 alert_manager_->SendAlert(event, "Action denied by HIPS rule");
             }
@@ -405,6 +464,286 @@ void HIPSEngine::UpdateStatistics(const SecurityEvent& event) {
     event_counts_[event.type]++;
 }
 
+bool HIPSEngine::SaveStateSnapshot(const std::string& snapshot_path) {
+    SnapshotWriter writer;
+    
+    {
+        std::lock_guard<std::mutex> lock(stats_mutex_);
+        writer.BeginSection(SnapshotSection::ENGINE_STATISTICS);
+        writer.WriteU32(static_cast<uint32_t>(event_counts_.size()));
+        for (const auto& pair : event_counts_) {
+            writer.WriteU8(static_cast<uint8_t>(pair.first));
+            writer.WriteU64(pair.second);
+        }
+        writer.EndSection();
+    }
+    
+    if (alert_manager_) {
+        alert_manager_->SaveState(writer);
+    }
+    if (correlation_engine_) {
+        correlation_engine_->SaveState(writer);
+    }
+    
+    if (!writer.WriteToFile(snapshot_path)) {
+        if (log_manager_) {
+            log_manager_->LogError("Failed to write state snapshot: " + snapshot_path);
+        }
+        return false;
+    }
+    return true;
+}
+
+bool HIPSEngine::RestoreStateSnapshot(const std::string& snapshot_path) {
+    MappedFile file;
+    if (!file.Open(snapshot_path)) {
+        return false;
+    }
+    
+    SnapshotReader snapshot(file.Data(), file.Size());
+    if (!snapshot.ValidateHeader()) {
+        if (log_manager_) {
+            log_manager_->LogWarning("Ignoring incompatible state snapshot: " + snapshot_path);
+        }
+        return false;
+    }
+    
+    SnapshotReader stats;
+    uint32_t count;
+    if (snapshot.FindSection(SnapshotSection::ENGINE_STATISTICS, stats) && stats.ReadCount(count, 9)) {
+        std::unordered_map<EventType, uint64_t> event_counts;
+        for (uint32_t i = 0; i < count; ++i) {
+            uint8_t type;
+            uint64_t value;
+            if (!stats.ReadU8(type) || !stats.ReadU64(value) ||
+                type > static_cast<uint8_t>(EventType::EXPLOIT_ATTEMPT)) {
+                break;
+            }
+            event_counts[static_cast<EventType>(type)] = value;
+        }
+        
+        if (!stats.Failed()) {
+            std::lock_guard<std::mutex> lock(stats_mutex_);
+            event_counts_ = std::move(event_counts);
+        }
+    }
+    
+    bool restored = !stats.Failed();
+    if (alert_manager_ && !alert_manager_->RestoreState(snapshot)) {
+        restored = false;
+    }
+    if (correlation_engine_ && !correlation_engine_->RestoreState(snapshot)) {
+        restored = false;
+    }
+    
+    if (log_manager_) {
+        if (restored) {
+            log_manager_->LogInfo("Restored state snapshot: " + snapshot_path);
+        } else {
+            log_manager_->LogWarning("State snapshot partially restored: " + snapshot_path);
+        }
+    }
+    return restored;
+}
+
+void HIPSEngine::LoadSnapshotSettings() {
+    snapshot_path_.clear();
+    snapshot_interval_ = std::chrono::seconds(0);
+    if (!config_manager_) {
+        return;
+    }
+    
+    ConfigValue path = config_manager_->GetValue("state_snapshot_path");
+    if (const auto* value = std::get_if<std::string>(&path)) {
+        snapshot_path_ = *value;
+    }
+    
+    ConfigValue interval = config_manager_->GetValue("state_snapshot_interval", 0);
+    if (const auto* value = std::get_if<int>(&interval)) {
+        snapshot_interval_ = std::chrono::seconds(std::max(*value, 0));
+    }
+}
+
+void HIPSEngine::StartSnapshotThread() {
+    if (snapshot_path_.empty() || snapshot_interval_.count() == 0 || snapshot_thread_.joinable()) {
+        return;
+    }
+    
+    {
+        std::lock_guard<std::mutex> lock(snapshot_mutex_);
+        snapshot_stop_ = false;
+    }
+    snapshot_thread_ = std::thread(&HIPSEngine::SnapshotLoop, this);
+}
+
+void HIPSEngine::StopSnapshotThread() {
+    {
+        std::lock_guard<std::mutex> lock(snapshot_mutex_);
+        snapshot_stop_ = true;
+    }
+    snapshot_cv_.notify_all();
+    
+    if (snapshot_thread_.joinable()) {
+        snapshot_thread_.join();
+    }
+}
+
+void HIPSEngine::SnapshotLoop() {
+    std::unique_lock<std::mutex> lock(snapshot_mutex_);
+    while (!snapshot_cv_.wait_for(lock, snapshot_interval_, [this] { return snapshot_stop_; })) {
+        lock.unlock();
+        SaveStateSnapshot(snapshot_path_);
+        lock.lock();
+    }
+}
+
+void HIPSEngine::StartAggregationAgent() {
+    if (!config_manager_) {
+        return;
+    }
+    
+    ConfigValue address = config_manager_->GetValue("aggregation_collector_address");
+    const auto* collector_address = std::get_if<std::string>(&address);
+    if (!collector_address || collector_address->empty()) {
+        aggregation_agent_.reset();
+        return;
+    }
+    
+    AggregationAgentConfig config;
+    config.collector_address = *collector_address;
+    ConfigValue agent_id = config_manager_->GetValue("aggregation_agent_id");
+    if (const auto* value = std::get_if<std::string>(&agent_id)) {
+        config.agent_id = *value;
+    }
+    
+    // The agent reconnects in the background, so an unreachable collector
+    // does not hold up startup
+    aggregation_agent_ = std::make_unique<AggregationAgent>();
+    if (!aggregation_agent_->Initialize(config) || !aggregation_agent_->Start()) {
+        log_manager_->LogWarning("Failed to start event aggregation agent for " + config.collector_address);
+        aggregation_agent_.reset();
+        return;
+    }
+    log_manager_->LogInfo("Forwarding events to collector " + config.collector_address +
+                          " as agent " + aggregation_agent_->GetAgentId());
+}
+
+void HIPSEngine::ConfigureAccessEnforcement() {
+    if (!config_manager_) {
+        return;
+    }
+    
+    ConfigValue enabled = config_manager_->GetValue("file_access_enforcement", false);
+    const auto* enforce = std::get_if<bool>(&enabled);
+    if (!enforce || !*enforce) {
+        fs_monitor_->EnableAccessEnforcement(nullptr, std::chrono::milliseconds(0));
+        return;
+    }
+    
+    int timeout_ms = 50;
+    ConfigValue timeout = config_manager_->GetValue("file_access_decision_timeout_ms", timeout_ms);
+    if (const auto* value = std::get_if<int>(&timeout)) {
+        timeout_ms = std::max(*value, 1);
+    }
+    
+    // Accesses the rules would DENY are blocked before they happen; the
+    // denied access itself comes back through the monitor callback
+    fs_monitor_->EnableAccessEnforcement([this](const SecurityEvent& event) {
+        return EvaluateEvent(event) != ActionType::DENY;
+    }, std::chrono::milliseconds(timeout_ms));
+}
+
+void HIPSEngine::LogAccessDecisionStats() {
+    AccessDecisionStats stats = fs_monitor_->GetAccessDecisionStats();
+    if (stats.decisions == 0) {
+        return;
+    }
+    
+    std::ostringstream oss;
+    oss << "File access decisions: " << stats.decisions << " (denied " << stats.denied
+        << ", timed out " << stats.timed_out << ", cached " << stats.cache_hits << "), latency us p50 "
+        << stats.p50_us << " p90 " << stats.p90_us << " p99 " << stats.p99_us << " max " << stats.max_us;
+    log_manager_->LogInfo(oss.str());
+}
+
+void HIPSEngine::ConfigureContentHashing() {
+    bool hashing = true;
+    if (config_manager_) {
+        ConfigValue enabled = config_manager_->GetValue("content_hashing", hashing);
+        if (const auto* value = std::get_if<bool>(&enabled)) {
+            hashing = *value;
+        }
+    }
+    fs_monitor_->SetContentHashing(hashing);
+    proc_monitor_->SetContentHashing(hashing);
+}
+
+void HIPSEngine::ConfigureBaselineScan() {
+    bool on_start = true;
+    int budget_mb = 32;
+    std::string inventory_path;
+    if (config_manager_) {
+        ConfigValue enabled = config_manager_->GetValue("baseline_scan_on_start", on_start);
+        if (const auto* value = std::get_if<bool>(&enabled)) {
+            on_start = *value;
+        }
+        ConfigValue budget = config_manager_->GetValue("baseline_scan_io_budget_mb", budget_mb);
+        if (const auto* value = std::get_if<int>(&budget)) {
+            budget_mb = std::max(*value, 0);
+        }
+        ConfigValue path = config_manager_->GetValue("file_inventory_path", inventory_path);
+        if (const auto* value = std::get_if<std::string>(&path)) {
+            inventory_path = *value;
+        }
+    }
+    fs_monitor_->SetBaselineScanOnStart(on_start);
+    fs_monitor_->SetBaselineIoBudget(static_cast<uint64_t>(budget_mb) * 1024 * 1024);
+    fs_monitor_->SetInventoryDatabase(inventory_path);
+}
+
+void HIPSEngine::LogBaselineScanStats() {
+    BaselineScanStats stats = fs_monitor_->GetBaselineScanStats();
+    if (stats.files + stats.directories == 0) {
+        return;
+    }
+    
+    std::ostringstream oss;
+    oss << "Baseline scan: " << stats.files << " files in " << stats.directories << " directories, "
+        << stats.hashed_files << " hashed, " << stats.errors << " errors, "
+        << static_cast<uint64_t>(stats.FilesPerSecond()) << " files/sec"
+        << (stats.truncated ? " (incomplete)" : "");
+    InventoryDatabaseStats inventory = fs_monitor_->GetInventoryDatabaseStats();
+    if (inventory.file_bytes > 0) {
+        oss << "; inventory database: " << inventory.entries << " entries, " << inventory.file_bytes << " bytes";
+    }
+    log_manager_->LogInfo(oss.str());
+}
+
+void HIPSEngine::LogContentHashStats() {
+    ContentHashStats stats = ContentHasher::Shared()->GetStats();
+    if (stats.files_hashed + stats.cache_hits == 0) {
+        return;
+    }
+    
+    std::ostringstream oss;
+    oss << "Content hashing: " << stats.files_hashed << " files (" << stats.bytes_hashed << " bytes) hashed, "
+        << stats.cache_hits << " cache hits, " << stats.failures << " failed, " << stats.dropped << " dropped";
+    log_manager_->LogInfo(oss.str());
+}
+
+void HIPSEngine::LogProcessIdentityStats() {
+    ProcessIdentityStats stats = ProcessIdentityCache::Shared()->GetStats();
+    if (stats.hits + stats.misses == 0) {
+        return;
+    }
+    
+    std::ostringstream oss;
+    oss << "Process identity cache: hit rate " << static_cast<int>(stats.HitRate() * 100) << "% ("
+        << stats.hits << " hits, " << stats.misses << " misses, " << stats.stale << " stale), "
+        << stats.resolutions << " resolutions, " << stats.entries << " entries";
+    log_manager_->LogInfo(oss.str());
+}
+
 bool HIPSEngine::LoadConfiguration(const std::string& config_path) {
     if (!config_manager_) return false;
     return config_manager_->LoadConfiguration(config_path);
@@ -418,6 +757,7 @@ bool HIPSEngine::SaveConfiguration(const std::string& config_path) {
 bool HIPSEngine::AddRule(const SecurityRule& rule) {
     std::lock_guard<std::mutex> lock(rules_mutex_);
     rules_.push_back(rule);
+    if (fs_monitor_) fs_monitor_->ClearAccessVerdictCache();
     return true;
 }
 
@@ -430,6 +770,7 @@ bool HIPSEngine::RemoveRule(const std::string& rule_name) {
     
     if (it != rules_.end()) {
         rules_.erase(it, rules_.end());
+        if (fs_monitor_) fs_monitor_->ClearAccessVerdictCache();
         return true;
     }
     return false;
@@ -460,6 +801,7 @@ bool HIPSEngine::UpdateRule(const std::string& rule_name, const SecurityRule& ru
     for (auto& r : rules_) {
         if (r.name == rule_name) {
             r = rule;
+            if (fs_monitor_) fs_monitor_->ClearAccessVerdictCache();
             return true;
         }
     }
@@ -476,6 +818,14 @@ void HIPSEngine::UnregisterEventHandler(EventType type) {
     event_handlers_.erase(type);
 }
 
+bool HIPSEngine::SubmitEvent(const SecurityEvent& event) {
+    if (!initialized_.load()) {
+        return false;
+    }
+    ProcessSecurityEvent(event);
+    return true;
+}
+
 bool HIPSEngine::EnableLearningMode(bool enable) {
     (void)enable;
     // Learning mode records observed behavior to auto-generate rules.
@@ -493,10 +843,39 @@ bool HIPSEngine::ExportThreatReport(const std::string& output_path) {
 }
 
 bool HIPSEngine::UpdateThreatSignatures(const std::string& signature_path) {
-    // Load updated threat signatures from file.
-    // Stub: verify file exists and return true.
     std::ifstream sig(signature_path);
-    return sig.is_open();
+    if (!sig.is_open()) return false;
+    
+    std::unordered_map<std::string, std::string> signatures;
+    size_t rejected = 0;
+    std::string line;
+    while (std::getline(sig, line)) {
+        line = line.substr(0, line.find('#'));
+        std::istringstream fields(line);
+        std::string hash;
+        if (!(fields >> hash)) continue;
+        
+        std::transform(hash.begin(), hash.end(), hash.begin(),
+                       [](unsigned char c) { return static_cast<char>(std::tolower(c)); });
+        if (hash.size() != 64 || hash.find_first_not_of("0123456789abcdef") != std::string::npos) {
+            rejected++;
+            continue;
+        }
+        std::string name;
+        std::getline(fields >> std::ws, name);
+        signatures[hash] = name.empty() ? hash : name;
+    }
+    
+    size_t loaded = signatures.size();
+    {
+        std::lock_guard<std::mutex> lock(signatures_mutex_);
+        threat_signatures_ = std::move(signatures);
+    }
+    if (log_manager_) {
+        log_manager_->LogInfo("Loaded " + std::to_string(loaded) + " threat signatures (" +
+                              std::to_string(rejected) + " rejected) from " + signature_path);
+    }
+    return true;
 }
 
 
@@ -0,0 +1,525 @@
+/*
+ * File Inventory Database Implementation
+ */
+
+#include "inventory_database.h"
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <vector>
+
+namespace HIPS {
+
+namespace fs = std::filesystem;
+
+// "HIPSINV\0" read as a little-endian word
+static constexpr uint64_t kInventoryMagic = 0x00564E4953504948ULL;
+
+static constexpr uint16_t kRecordHashed = 1;
+static constexpr uint16_t kRecordRemoved = 2;
+// Root marker; the size field holds the depth the scan covered
+static constexpr uint16_t kRecordRoot = 4;
+
+// Paths longer than a record can describe are not stored
+static constexpr size_t kMaxRecordPath = 0xFFFF;
+
+struct InventoryFileHeader {
+    uint64_t magic;
+    uint32_t version;
+    uint32_t record_header_size;    // Layout check
+    uint64_t records_end;
+    uint64_t directory_offset;
+    uint64_t directory_slots;       // Power of two, or 0 when empty
+    uint64_t record_count;
+    uint64_t log_offset;
+    uint64_t root_count;            // Markers at the start of the records
+};
+
+// Followed by the path, padded to eight bytes
+struct InventoryRecordHeader {
+    uint64_t path_hash;
+    uint64_t size;
+    int64_t modified_ns;
+    uint64_t xxh64;
+    uint8_t sha256[32];
+    uint32_t attributes;
+    uint16_t flags;
+    uint16_t path_length;
+};
+
+struct DirectorySlot {
+    uint64_t path_hash;
+    uint64_t record_offset;         // 0 marks an empty slot
+};
+
+static_assert(sizeof(InventoryFileHeader) == 64, "inventory header layout");
+static_assert(sizeof(InventoryRecordHeader) == 72, "inventory record layout");
+static_assert(sizeof(DirectorySlot) == 16, "inventory directory layout");
+
+static size_t PaddedRecordSize(size_t path_length) {
+    return (sizeof(InventoryRecordHeader) + path_length + 7) & ~size_t(7);
+}
+
+static int HexDigit(char c) {
+    if (c >= '0' && c <= '9') return c - '0';
+    if (c >= 'a' && c <= 'f') return c - 'a' + 10;
+    if (c >= 'A' && c <= 'F') return c - 'A' + 10;
+    return -1;
+}
+
+static void SerializeRecord(std::string& out, const InventoryEntry& entry, bool removed) {
+    InventoryRecordHeader header = {};
+    header.path_hash = InventoryDatabase::HashPath(entry.path);
+    header.path_length = static_cast<uint16_t>(entry.path.size());
+    if (removed) {
+        header.flags = kRecordRemoved;
+    } else {
+        header.size = entry.size;
+        header.modified_ns = entry.modified_ns;
+        header.attributes = entry.attributes;
+        if (entry.hashed && entry.hashes.sha256.size() == 2 * sizeof(header.sha256)) {
+            header.flags = kRecordHashed;
+            header.xxh64 = entry.hashes.xxh64;
+            for (size_t i = 0; i < sizeof(header.sha256); ++i) {
+                int high = HexDigit(entry.hashes.sha256[2 * i]);
+                int low = HexDigit(entry.hashes.sha256[2 * i + 1]);
+                header.sha256[i] = static_cast<uint8_t>(((high & 0xF) << 4) | (low & 0xF));
+            }
+        }
+    }
+
+    size_t start = out.size();
+    out.append(reinterpret_cast<const char*>(&header), sizeof(header));
+    out.append(entry.path);
+    out.resize(start + PaddedRecordSize(entry.path.size()), '\0');
+}
+
+static void SerializeRootMarker(std::string& out, const std::string& root, int depth) {
+    InventoryRecordHeader header = {};
+    header.path_hash = InventoryDatabase::HashPath(root);
+    header.path_length = static_cast<uint16_t>(root.size());
+    header.flags = kRecordRoot;
+    header.size = static_cast<uint64_t>(std::max(depth, 0));
+
+    size_t start = out.size();
+    out.append(reinterpret_cast<const char*>(&header), sizeof(header));
+    out.append(root);
+    out.resize(start + PaddedRecordSize(root.size()), '\0');
+}
+
+InventoryDatabase::InventoryDatabase() {
+    Close();
+}
+
+InventoryDatabase::~InventoryDatabase() {
+    Close();
+}
+
+uint64_t InventoryDatabase::HashPath(const std::string& path) {
+    Xxh64 hasher;
+    hasher.Update(path.data(), path.size());
+    return hasher.Final();
+}
+
+bool InventoryDatabase::Open(const std::string& path) {
+    Close();
+    path_ = path;
+    if (!MapFile() || !ReadLog()) {
+        Close();
+        return false;
+    }
+    return true;
+}
+
+void InventoryDatabase::Close() {
+    mapping_.Close();
+    path_.clear();
+    records_end_ = 0;
+    directory_offset_ = 0;
+    directory_slots_ = 0;
+    log_offset_ = 0;
+    valid_end_ = 0;
+    compacted_records_ = 0;
+    log_records_ = 0;
+    log_.clear();
+    compacted_roots_.clear();
+    log_roots_.clear();
+    pending_.clear();
+    pending_records_ = 0;
+    entries_ = 0;
+}
+
+bool InventoryDatabase::MapFile() {
+    records_end_ = directory_offset_ = directory_slots_ = log_offset_ = 0;
+    compacted_records_ = 0;
+    compacted_roots_.clear();
+
+    std::error_code ec;
+    if (!fs::exists(path_, ec)) {
+        return !ec;     // Created by the first Flush()
+    }
+    if (!mapping_.Open(path_, false) || mapping_.Size() < sizeof(InventoryFileHeader)) {
+        return false;
+    }
+
+    InventoryFileHeader header;
+    std::memcpy(&header, mapping_.Data(), sizeof(header));
+    const uint64_t size = mapping_.Size();
+    if (header.magic != kInventoryMagic || header.version != kInventoryVersion ||
+        header.record_header_size != sizeof(InventoryRecordHeader) ||
+        header.records_end < sizeof(header) || header.directory_offset < header.records_end ||
+        header.directory_offset > size ||
+        (header.directory_slots & (header.directory_slots - 1)) != 0 ||
+        header.directory_slots > (size - header.directory_offset) / sizeof(DirectorySlot) ||
+        header.log_offset != header.directory_offset + header.directory_slots * sizeof(DirectorySlot) ||
+        header.log_offset > size) {
+        mapping_.Close();
+        return false;
+    }
+
+    records_end_ = header.records_end;
+    directory_offset_ = header.directory_offset;
+    directory_slots_ = header.directory_slots;
+    log_offset_ = header.log_offset;
+    compacted_records_ = static_cast<size_t>(header.record_count);
+
+    uint64_t offset = sizeof(header);
+    InventoryEntry marker;
+    for (uint64_t i = 0; i < header.root_count; ++i) {
+        uint16_t flags;
+        uint64_t next;
+        if (!ReadRecord(offset, marker, flags, next) || next > records_end_ || !(flags & kRecordRoot)) {
+            mapping_.Close();
+            return false;
+        }
+        compacted_roots_[marker.path] = static_cast<int>(marker.size);
+        offset = next;
+    }
+    return true;
+}
+
+bool InventoryDatabase::ReadLog() {
+    entries_ = compacted_records_;
+    log_records_ = 0;
+    valid_end_ = log_offset_;
+    if (!mapping_.Data()) {
+        return true;
+    }
+
+    // A record torn by a crash ends the log; Flush() cuts it off
+    uint64_t offset = log_offset_;
+    InventoryEntry entry;
+    InventoryEntry known;
+    while (offset < mapping_.Size()) {
+        uint16_t flags;
+        uint64_t next;
+        if (!ReadRecord(offset, entry, flags, next)) {
+            break;
+        }
+        log_records_++;
+        valid_end_ = offset = next;
+        if (flags & kRecordRoot) {
+            log_roots_[entry.path] = static_cast<int>(entry.size);
+            continue;
+        }
+
+        const bool removed = (flags & kRecordRemoved) != 0;
+        bool existed = Lookup(entry.path, known);
+        log_[entry.path] = LogEntry{entry, removed};
+        if (removed && existed) {
+            entries_--;
+        } else if (!removed && !existed) {
+            entries_++;
+        }
+    }
+    return true;
+}
+
+bool InventoryDatabase::ReadRecord(uint64_t offset, InventoryEntry& entry, uint16_t& flags, uint64_t& next) const {
+    const uint64_t size = mapping_.Size();
+    if (offset < sizeof(InventoryFileHeader) || offset > size || size - offset < sizeof(InventoryRecordHeader)) {
+        return false;
+    }
+    InventoryRecordHeader header;
+    std::memcpy(&header, mapping_.Data() + offset, sizeof(header));
+    if (PaddedRecordSize(header.path_length) > size - offset) {
+        return false;
+    }
+
+    entry.path.assign(mapping_.Data() + offset + sizeof(header), header.path_length);
+    entry.size = header.size;
+    entry.modified_ns = header.modified_ns;
+    entry.attributes = header.attributes;
+    entry.hashed = (header.flags & kRecordHashed) != 0;
+    entry.hashes = FileHashes();
+    if (entry.hashed) {
+        static const char kHex[] = "0123456789abcdef";
+        entry.hashes.sha256.resize(2 * sizeof(header.sha256));
+        for (size_t i = 0; i < sizeof(header.sha256); ++i) {
+            entry.hashes.sha256[2 * i] = kHex[header.sha256[i] >> 4];
+            entry.hashes.sha256[2 * i + 1] = kHex[header.sha256[i] & 0xF];
+        }
+        entry.hashes.xxh64 = header.xxh64;
+        entry.hashes.size = header.size;
+    }
+    flags = header.flags;
+    next = offset + PaddedRecordSize(header.path_length);
+    return true;
+}
+
+bool InventoryDatabase::FindCompacted(const std::string& path, uint64_t hash, InventoryEntry* entry) const {
+    if (directory_slots_ == 0) {
+        return false;
+    }
+
+    const uint64_t mask = directory_slots_ - 1;
+    InventoryEntry candidate;
+    for (uint64_t probe = 0, slot_index = hash & mask; probe < directory_slots_;
+         ++probe, slot_index = (slot_index + 1) & mask) {
+        DirectorySlot slot;
+        std::memcpy(&slot, mapping_.Data() + directory_offset_ + slot_index * sizeof(DirectorySlot), sizeof(slot));
+        if (slot.record_offset == 0) {
+            return false;
+        }
+        if (slot.path_hash != hash || slot.record_offset >= records_end_) {
+            continue;
+        }
+
+        uint16_t flags;
+        uint64_t next;
+        if (ReadRecord(slot.record_offset, candidate, flags, next) && !(flags & kRecordRoot) &&
+            candidate.path == path) {
+            if (entry) {
+                *entry = std::move(candidate);
+            }
+            return !(flags & kRecordRemoved);
+        }
+    }
+    return false;
+}
+
+bool InventoryDatabase::Lookup(const std::string& path, InventoryEntry& entry) const {
+    auto it = log_.find(path);
+    if (it != log_.end()) {
+        if (it->second.removed) {
+            return false;
+        }
+        entry = it->second.entry;
+        return true;
+    }
+    return FindCompacted(path, HashPath(path), &entry);
+}
+
+void InventoryDatabase::ForEach(const std::function<void(const InventoryEntry& entry)>& callback) const {
+    // Compacted records are contiguous; the log overrides them
+    if (mapping_.Data()) {
+        InventoryEntry entry;
+        uint64_t offset = sizeof(InventoryFileHeader);
+        while (offset < records_end_) {
+            uint16_t flags;
+            uint64_t next;
+            if (!ReadRecord(offset, entry, flags, next) || next > records_end_) {
+                break;
+            }
+            if (!(flags & (kRecordRemoved | kRecordRoot)) && log_.find(entry.path) == log_.end()) {
+                callback(entry);
+            }
+            offset = next;
+        }
+    }
+    for (const auto& pair : log_) {
+        if (!pair.second.removed) {
+            callback(pair.second.entry);
+        }
+    }
+}
+
+void InventoryDatabase::Put(const InventoryEntry& entry) {
+    if (!IsOpen() || entry.path.empty() || entry.path.size() > kMaxRecordPath) {
+        return;
+    }
+    InventoryEntry known;
+    if (!Lookup(entry.path, known)) {
+        entries_++;
+    }
+    Append(entry, false);
+}
+
+void InventoryDatabase::Remove(const std::string& path) {
+    InventoryEntry known;
+    if (!IsOpen() || !Lookup(path, known)) {
+        return;
+    }
+    entries_--;
+    Append(known, true);
+}
+
+void InventoryDatabase::MarkRootComplete(const std::string& root, int depth) {
+    if (!IsOpen() || root.empty() || root.size() > kMaxRecordPath) {
+        return;
+    }
+    SerializeRootMarker(pending_, root, depth);
+    pending_records_++;
+    log_roots_[root] = std::max(depth, 0);
+}
+
+bool InventoryDatabase::IsRootComplete(const std::string& root, int depth) const {
+    auto it = log_roots_.find(root);
+    if (it == log_roots_.end()) {
+        it = compacted_roots_.find(root);
+        if (it == compacted_roots_.end()) {
+            return false;
+        }
+    }
+    return it->second >= depth;
+}
+
+void InventoryDatabase::Append(const InventoryEntry& entry, bool removed) {
+    SerializeRecord(pending_, entry, removed);
+    pending_records_++;
+    log_[entry.path] = LogEntry{entry, removed};
+}
+
+bool InventoryDatabase::Flush() {
+    if (!IsOpen()) {
+        return false;
+    }
+    if (pending_.empty()) {
+        return true;
+    }
+    if (!mapping_.Data()) {
+        return Compact();   // No file yet
+    }
+
+    // Unmapped while written so the file can be extended on every platform
+    mapping_.Close();
+    std::error_code ec;
+    if (fs::file_size(path_, ec) != valid_end_ && !ec) {
+        fs::resize_file(path_, valid_end_, ec);
+    }
+    bool written = !ec;
+    if (written) {
+        std::FILE* file = std::fopen(path_.c_str(), "ab");
+        written = file != nullptr;
+        if (file) {
+            written = std::fwrite(pending_.data(), 1, pending_.size(), file) == pending_.size();
+            written = std::fflush(file) == 0 && written;
+            written = std::fclose(file) == 0 && written;
+        }
+    }
+    if (!MapFile()) {
+        return false;
+    }
+    if (!written) {
+        return false;
+    }
+
+    valid_end_ = mapping_.Size();
+    log_records_ += pending_records_;
+    pending_.clear();
+    pending_records_ = 0;
+    return true;
+}
+
+bool InventoryDatabase::Compact() {
+    if (!IsOpen()) {
+        return false;
+    }
+
+    std::vector<InventoryEntry> live;
+    live.reserve(entries_);
+    ForEach([&live](const InventoryEntry& entry) { live.push_back(entry); });
+
+    std::unordered_map<std::string, int> roots = compacted_roots_;
+    for (const auto& pair : log_roots_) {
+        roots[pair.first] = pair.second;
+    }
+
+    uint64_t records_size = 0;
+    for (const auto& pair : roots) {
+        records_size += PaddedRecordSize(pair.first.size());
+    }
+    for (const auto& entry : live) {
+        records_size += PaddedRecordSize(entry.path.size());
+    }
+    uint64_t slots = 0;
+    if (!live.empty()) {
+        slots = 16;
+        while (slots < 2 * live.size()) {
+            slots *= 2;
+        }
+    }
+
+    InventoryFileHeader header = {};
+    header.magic = kInventoryMagic;
+    header.version = kInventoryVersion;
+    header.record_header_size = sizeof(InventoryRecordHeader);
+    header.records_end = sizeof(header) + records_size;
+    header.directory_offset = header.records_end;
+    header.directory_slots = slots;
+    header.record_count = live.size();
+    header.log_offset = header.directory_offset + slots * sizeof(DirectorySlot);
+    header.root_count = roots.size();
+
+    SnapshotWriter writer(false);
+    writer.WriteRaw(std::string(reinterpret_cast<const char*>(&header), sizeof(header)));
+    std::vector<DirectorySlot> directory(slots, DirectorySlot{0, 0});
+    std::string record;
+    uint64_t offset = sizeof(header);
+    for (const auto& pair : roots) {
+        record.clear();
+        SerializeRootMarker(record, pair.first, pair.second);
+        writer.WriteRaw(record);
+        offset += record.size();
+    }
+    for (const auto& entry : live) {
+        record.clear();
+        SerializeRecord(record, entry, false);
+        writer.WriteRaw(record);
+
+        uint64_t hash = HashPath(entry.path);
+        uint64_t slot_index = hash & (slots - 1);
+        while (directory[slot_index].record_offset != 0) {
+            slot_index = (slot_index + 1) & (slots - 1);
+        }
+        directory[slot_index] = DirectorySlot{hash, offset};
+        offset += record.size();
+    }
+    for (const auto& slot : directory) {
+        writer.WriteU64(slot.path_hash);
+        writer.WriteU64(slot.record_offset);
+    }
+
+    // Every live entry has been copied out, so the old file can be
+    // unmapped before it is replaced
+    mapping_.Close();
+    bool written = writer.WriteToFile(path_);
+    if (!MapFile()) {
+        return false;
+    }
+    if (!written) {
+        return false;
+    }
+
+    log_.clear();
+    log_roots_.clear();
+    pending_.clear();
+    pending_records_ = 0;
+    log_records_ = 0;
+    entries_ = compacted_records_;
+    valid_end_ = log_offset_;
+    return true;
+}
+
+InventoryDatabaseStats InventoryDatabase::GetStats() const {
+    InventoryDatabaseStats stats;
+    stats.entries = entries_;
+    stats.compacted_records = compacted_records_;
+    stats.log_records = log_records_;
+    stats.pending_records = pending_records_;
+    stats.file_bytes = mapping_.Size();
+    return stats;
+}
+
+} // namespace HIPS
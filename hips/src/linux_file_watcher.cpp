@@ -0,0 +1,562 @@
+/*
+ * Linux File System Watcher Implementation
+ */
+
+#include "linux_file_watcher.h"
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/fanotify.h>
+#include <sys/inotify.h>
+#include <sys/stat.h>
+#include <sys/statfs.h>
+#include <dirent.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <climits>
+#include <cerrno>
+#include <cstdlib>
+#include <cstring>
+#include <algorithm>
+
+namespace HIPS {
+
+// Read buffer bounds; bursts are drained in fewer, larger reads
+static constexpr size_t kInitialBufferSize = 64 * 1024;
+static constexpr size_t kMaxBufferSize = 1024 * 1024;
+
+static constexpr uint32_t kInotifyMask =
+    IN_CREATE | IN_DELETE | IN_MODIFY | IN_ATTRIB | IN_MOVED_FROM | IN_MOVED_TO |
+    IN_ONLYDIR | IN_EXCL_UNLINK;
+
+#ifdef FAN_REPORT_DFID_NAME
+static constexpr uint64_t kFanotifyMask =
+    FAN_CREATE | FAN_DELETE | FAN_MODIFY | FAN_ATTRIB | FAN_MOVED_FROM | FAN_MOVED_TO | FAN_ONDIR;
+#endif
+
+// Room for a file handle; MAX_HANDLE_SZ is the kernel's limit
+struct FileHandleBuffer {
+    struct file_handle header;
+    unsigned char bytes[MAX_HANDLE_SZ];
+};
+
+static uint64_t FsidOf(const void* fsid) {
+    uint64_t value;
+    std::memcpy(&value, fsid, sizeof(value));
+    return value;
+}
+
+static std::string JoinPath(const std::string& directory, const char* name) {
+    if (directory == "/") {
+        return directory + name;
+    }
+    return directory + "/" + name;
+}
+
+static void CloseDescriptor(int& fd) {
+    if (fd >= 0) {
+        close(fd);
+        fd = -1;
+    }
+}
+
+LinuxFileWatcher::LinuxFileWatcher()
+    : max_depth_(0), fanotify_enabled_(true), backend_(Backend::NONE), notify_fd_(-1),
+      epoll_fd_(-1), stop_fd_(-1), watch_count_(0), overflow_count_(0), rescan_count_(0),
+      failed_watch_count_(0), buffer_size_(0) {
+}
+
+LinuxFileWatcher::~LinuxFileWatcher() {
+    Close();
+}
+
+bool LinuxFileWatcher::Open(const std::vector<std::string>& roots, int max_depth, ChangeCallback callback) {
+    Close();
+
+    // Canonical roots, so they compare equal to paths resolved by the kernel
+    roots_ = CanonicalRoots(roots);
+    if (roots_.empty()) {
+        return false;
+    }
+
+    max_depth_ = std::max(max_depth, 0);
+    callback_ = std::move(callback);
+    buffer_.resize(kInitialBufferSize);
+    buffer_size_.store(buffer_.size());
+
+    epoll_fd_ = epoll_create1(EPOLL_CLOEXEC);
+    stop_fd_ = eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK);
+    if (epoll_fd_ < 0 || stop_fd_ < 0 ||
+        (!(fanotify_enabled_ && OpenFanotify()) && !OpenInotify())) {
+        Close();
+        return false;
+    }
+
+    for (int fd : {notify_fd_, stop_fd_}) {
+        struct epoll_event event = {};
+        event.events = EPOLLIN;
+        event.data.fd = fd;
+        if (epoll_ctl(epoll_fd_, EPOLL_CTL_ADD, fd, &event) != 0) {
+            Close();
+            return false;
+        }
+    }
+    return true;
+}
+
+bool LinuxFileWatcher::OpenFanotify() {
+#ifdef FAN_REPORT_DFID_NAME
+    notify_fd_ = fanotify_init(FAN_CLASS_NOTIF | FAN_REPORT_DFID_NAME | FAN_CLOEXEC | FAN_NONBLOCK,
+                               O_RDONLY | O_LARGEFILE);
+    if (notify_fd_ < 0) {
+        return false;
+    }
+
+    // One mark per filesystem covers every root on it
+    bool marked = true;
+    for (const auto& root : roots_) {
+        int mount_fd = open(root.c_str(), O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+        struct statfs info;
+        if (mount_fd < 0 || fstatfs(mount_fd, &info) != 0) {
+            CloseDescriptor(mount_fd);
+            marked = false;
+            break;
+        }
+
+        const uint64_t fsid = FsidOf(&info.f_fsid);
+        auto it = std::find_if(filesystems_.begin(), filesystems_.end(),
+                               [fsid](const MarkedFilesystem& fs) { return fs.fsid == fsid; });
+        if (it != filesystems_.end()) {
+            close(mount_fd);
+            continue;
+        }
+
+        // Directory handles are resolved with open_by_handle_at, which
+        // needs its own capability; probe it once before relying on it
+        FileHandleBuffer handle;
+        handle.header.handle_bytes = MAX_HANDLE_SZ;
+        int mount_id;
+        int probe = -1;
+        if (name_to_handle_at(mount_fd, "", &handle.header, &mount_id, AT_EMPTY_PATH) == 0) {
+            probe = open_by_handle_at(mount_fd, &handle.header, O_PATH | O_CLOEXEC);
+        }
+        if (probe < 0 ||
+            fanotify_mark(notify_fd_, FAN_MARK_ADD | FAN_MARK_FILESYSTEM, kFanotifyMask, AT_FDCWD,
+                          root.c_str()) != 0) {
+            CloseDescriptor(probe);
+            close(mount_fd);
+            marked = false;
+            break;
+        }
+        close(probe);
+        filesystems_.push_back({fsid, mount_fd});
+    }
+
+    if (!marked) {
+        for (auto& fs : filesystems_) {
+            close(fs.mount_fd);
+        }
+        filesystems_.clear();
+        CloseDescriptor(notify_fd_);
+        return false;
+    }
+
+    backend_ = Backend::FANOTIFY;
+    return true;
+#else
+    return false;
+#endif
+}
+
+bool LinuxFileWatcher::OpenInotify() {
+    notify_fd_ = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+    if (notify_fd_ < 0) {
+        return false;
+    }
+
+    backend_ = Backend::INOTIFY;
+    for (const auto& root : roots_) {
+        AddWatchTree(root, 0, false);
+    }
+    if (watches_.empty()) {
+        CloseDescriptor(notify_fd_);
+        backend_ = Backend::NONE;
+        return false;
+    }
+    return true;
+}
+
+void LinuxFileWatcher::Run() {
+    struct epoll_event events[2];
+
+    while (true) {
+        int count = epoll_wait(epoll_fd_, events, 2, -1);
+        if (count < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            return;
+        }
+
+        for (int i = 0; i < count; ++i) {
+            if (events[i].data.fd == stop_fd_) {
+                uint64_t value;
+                ssize_t ignored = read(stop_fd_, &value, sizeof(value));
+                (void)ignored;
+                return;
+            }
+
+            if (backend_ == Backend::FANOTIFY) {
+                ReadFanotifyEvents();
+            } else {
+                ReadInotifyEvents();
+            }
+        }
+    }
+}
+
+void LinuxFileWatcher::Stop() {
+    if (stop_fd_ >= 0) {
+        uint64_t value = 1;
+        ssize_t ignored = write(stop_fd_, &value, sizeof(value));
+        (void)ignored;
+    }
+}
+
+void LinuxFileWatcher::Close() {
+    for (auto& fs : filesystems_) {
+        close(fs.mount_fd);
+    }
+    filesystems_.clear();
+    watches_.clear();
+    watch_by_path_.clear();
+    watch_count_.store(0);
+
+    CloseDescriptor(notify_fd_);
+    CloseDescriptor(epoll_fd_);
+    CloseDescriptor(stop_fd_);
+    roots_.clear();
+    backend_ = Backend::NONE;
+}
+
+void LinuxFileWatcher::ReadFanotifyEvents() {
+#ifdef FAN_REPORT_DFID_NAME
+    while (true) {
+        ssize_t length = read(notify_fd_, buffer_.data(), buffer_.size());
+        if (length <= 0) {
+            return;
+        }
+        GrowBuffer(static_cast<size_t>(length));
+
+        auto* metadata = reinterpret_cast<struct fanotify_event_metadata*>(buffer_.data());
+        for (; FAN_EVENT_OK(metadata, length); metadata = FAN_EVENT_NEXT(metadata, length)) {
+            if (metadata->vers != FANOTIFY_METADATA_VERSION) {
+                return;
+            }
+            if (metadata->mask & FAN_Q_OVERFLOW) {
+                HandleOverflow();
+                continue;
+            }
+
+            // Find the directory handle and entry name
+            const char* record = reinterpret_cast<const char*>(metadata) + metadata->metadata_len;
+            const char* end = reinterpret_cast<const char*>(metadata) + metadata->event_len;
+            const struct fanotify_event_info_fid* fid = nullptr;
+            while (record + sizeof(struct fanotify_event_info_header) <= end) {
+                auto* header = reinterpret_cast<const struct fanotify_event_info_header*>(record);
+                if (header->len == 0) {
+                    break;
+                }
+                if (header->info_type == FAN_EVENT_INFO_TYPE_DFID_NAME) {
+                    fid = reinterpret_cast<const struct fanotify_event_info_fid*>(record);
+                    break;
+                }
+                record += header->len;
+            }
+            if (!fid) {
+                continue;
+            }
+
+            auto* handle = reinterpret_cast<struct file_handle*>(const_cast<unsigned char*>(fid->handle));
+            const char* name = reinterpret_cast<const char*>(handle->f_handle + handle->handle_bytes);
+
+            std::string directory = ResolveDirectory(FsidOf(&fid->fsid), handle);
+            if (directory.empty() || !IsUnderRoots(roots_, max_depth_, directory)) {
+                continue;
+            }
+            std::string path = std::strcmp(name, ".") == 0 ? directory : JoinPath(directory, name);
+            DWORD process_id = static_cast<DWORD>(metadata->pid);
+
+            // Merged events carry several actions
+            if (metadata->mask & FAN_CREATE) {
+                Emit(path, FILE_ACTION_ADDED, process_id);
+            }
+            if (metadata->mask & FAN_MOVED_FROM) {
+                Emit(path, FILE_ACTION_RENAMED_OLD_NAME, process_id);
+            }
+            if (metadata->mask & FAN_MOVED_TO) {
+                Emit(path, FILE_ACTION_RENAMED_NEW_NAME, process_id);
+            }
+            if (metadata->mask & (FAN_MODIFY | FAN_ATTRIB)) {
+                Emit(path, FILE_ACTION_MODIFIED, process_id);
+            }
+            if (metadata->mask & FAN_DELETE) {
+                Emit(path, FILE_ACTION_REMOVED, process_id);
+            }
+        }
+    }
+#endif
+}
+
+void LinuxFileWatcher::ReadInotifyEvents() {
+    while (true) {
+        ssize_t length = read(notify_fd_, buffer_.data(), buffer_.size());
+        if (length <= 0) {
+            return;
+        }
+        GrowBuffer(static_cast<size_t>(length));
+
+        for (char* cursor = buffer_.data(); cursor < buffer_.data() + length;) {
+            auto* event = reinterpret_cast<struct inotify_event*>(cursor);
+            cursor += sizeof(struct inotify_event) + event->len;
+
+            if (event->mask & IN_Q_OVERFLOW) {
+                // Changes were lost, and with them any directories created
+                // meanwhile; restore the watch set
+                Rescan();
+                HandleOverflow();
+                continue;
+            }
+
+            auto it = watches_.find(event->wd);
+            if (it == watches_.end()) {
+                continue;
+            }
+            if (event->mask & IN_IGNORED) {
+                auto by_path = watch_by_path_.find(it->second.path);
+                if (by_path != watch_by_path_.end() && by_path->second == event->wd) {
+                    watch_by_path_.erase(by_path);
+                }
+                watches_.erase(it);
+                watch_count_.store(watches_.size());
+                continue;
+            }
+            if (event->len == 0) {
+                continue;
+            }
+
+            // The entry may trigger new watches, which can rehash watches_
+            const std::string path = JoinPath(it->second.path, event->name);
+            const int depth = it->second.depth;
+            const bool is_directory = (event->mask & IN_ISDIR) != 0;
+
+            if (event->mask & IN_CREATE) {
+                Emit(path, FILE_ACTION_ADDED, 0);
+                if (is_directory && depth < max_depth_) {
+                    AddWatchTree(path, depth + 1, true);
+                }
+            }
+            if (event->mask & IN_MOVED_FROM) {
+                Emit(path, FILE_ACTION_RENAMED_OLD_NAME, 0);
+                if (is_directory) {
+                    RemoveWatchTree(path);
+                }
+            }
+            if (event->mask & IN_MOVED_TO) {
+                Emit(path, FILE_ACTION_RENAMED_NEW_NAME, 0);
+                if (is_directory && depth < max_depth_) {
+                    AddWatchTree(path, depth + 1, false);
+                }
+            }
+            if (event->mask & (IN_MODIFY | IN_ATTRIB)) {
+                Emit(path, FILE_ACTION_MODIFIED, 0);
+            }
+            if (event->mask & IN_DELETE) {
+                Emit(path, FILE_ACTION_REMOVED, 0);
+            }
+        }
+    }
+}
+
+void LinuxFileWatcher::AddWatchTree(const std::string& path, int depth, bool report_entries) {
+    std::vector<std::pair<std::string, int>> pending = {{path, depth}};
+
+    while (!pending.empty()) {
+        auto [directory, level] = std::move(pending.back());
+        pending.pop_back();
+
+        if (watch_by_path_.find(directory) == watch_by_path_.end()) {
+            int wd = inotify_add_watch(notify_fd_, directory.c_str(), kInotifyMask);
+            if (wd < 0) {
+                // ENOSPC: out of watches (fs.inotify.max_user_watches)
+                if (errno != ENOENT && errno != ENOTDIR) {
+                    failed_watch_count_++;
+                }
+                continue;
+            }
+            watches_[wd] = {directory, level};
+            watch_by_path_[directory] = wd;
+        }
+
+        if (level >= max_depth_ && !report_entries) {
+            continue;
+        }
+
+        DIR* dir = opendir(directory.c_str());
+        if (!dir) {
+            continue;
+        }
+        while (struct dirent* entry = readdir(dir)) {
+            if (std::strcmp(entry->d_name, ".") == 0 || std::strcmp(entry->d_name, "..") == 0) {
+                continue;
+            }
+            std::string child = JoinPath(directory, entry->d_name);
+
+            bool is_directory = entry->d_type == DT_DIR;
+            if (entry->d_type == DT_UNKNOWN) {
+                struct stat info;
+                is_directory = lstat(child.c_str(), &info) == 0 && S_ISDIR(info.st_mode);
+            }
+
+            if (report_entries) {
+                Emit(child, FILE_ACTION_ADDED, 0);
+            }
+            if (is_directory && level < max_depth_) {
+                pending.emplace_back(std::move(child), level + 1);
+            }
+        }
+        closedir(dir);
+    }
+
+    watch_count_.store(watches_.size());
+}
+
+void LinuxFileWatcher::RemoveWatchTree(const std::string& path) {
+    const std::string prefix = path + "/";
+    for (auto it = watches_.begin(); it != watches_.end();) {
+        const std::string& watched = it->second.path;
+        if (watched == path || watched.compare(0, prefix.size(), prefix) == 0) {
+            inotify_rm_watch(notify_fd_, it->first);
+            watch_by_path_.erase(watched);
+            it = watches_.erase(it);
+        } else {
+            ++it;
+        }
+    }
+    watch_count_.store(watches_.size());
+}
+
+void LinuxFileWatcher::HandleOverflow() {
+    // The backlog behind an overflow fills the next reads, which grow the
+    // buffer; it is not resized here while events are parsed from it
+    overflow_count_++;
+    if (overflow_callback_) {
+        overflow_callback_();
+    }
+}
+
+void LinuxFileWatcher::GrowBuffer(size_t bytes_read) {
+    // Contents survive the resize; events are parsed from buffer_ afterwards
+    if (bytes_read > buffer_.size() / 2 && buffer_.size() < kMaxBufferSize) {
+        buffer_.resize(std::min(buffer_.size() * 2, kMaxBufferSize));
+        buffer_size_.store(buffer_.size());
+    }
+}
+
+void LinuxFileWatcher::Rescan() {
+    rescan_count_++;
+    for (const auto& root : roots_) {
+        AddWatchTree(root, 0, false);
+    }
+}
+
+std::string LinuxFileWatcher::ResolveDirectory(uint64_t fsid, void* handle) const {
+    auto it = std::find_if(filesystems_.begin(), filesystems_.end(),
+                           [fsid](const MarkedFilesystem& fs) { return fs.fsid == fsid; });
+    if (it == filesystems_.end()) {
+        return "";
+    }
+
+    int fd = open_by_handle_at(it->mount_fd, static_cast<struct file_handle*>(handle), O_PATH | O_CLOEXEC);
+    if (fd < 0) {
+        return "";     // Already deleted
+    }
+
+    char link[64];
+    char target[PATH_MAX];
+    snprintf(link, sizeof(link), "/proc/self/fd/%d", fd);
+    ssize_t length = readlink(link, target, sizeof(target) - 1);
+    close(fd);
+    if (length <= 0) {
+        return "";
+    }
+    return std::string(target, static_cast<size_t>(length));
+}
+
+std::vector<std::vector<std::string>> LinuxFileWatcher::PartitionRoots(const std::vector<std::string>& roots,
+                                                                      size_t shard_count) {
+    std::vector<std::vector<std::string>> shards(std::max<size_t>(shard_count, 1));
+    std::unordered_map<dev_t, size_t> shard_by_device;
+    size_t next_shard = 0;
+
+    for (const auto& root : CanonicalRoots(roots)) {
+        struct stat info;
+        if (stat(root.c_str(), &info) != 0) {
+            continue;
+        }
+        auto it = shard_by_device.find(info.st_dev);
+        if (it == shard_by_device.end()) {
+            it = shard_by_device.emplace(info.st_dev, next_shard++ % shards.size()).first;
+        }
+        shards[it->second].push_back(root);
+    }
+
+    shards.erase(std::remove_if(shards.begin(), shards.end(),
+                                [](const std::vector<std::string>& shard) { return shard.empty(); }),
+                 shards.end());
+    return shards;
+}
+
+std::vector<std::string> LinuxFileWatcher::CanonicalRoots(const std::vector<std::string>& roots) {
+    std::vector<std::string> canonical;
+    for (const auto& root : roots) {
+        char resolved[PATH_MAX];
+        struct stat info;
+        if (realpath(root.c_str(), resolved) && stat(resolved, &info) == 0 && S_ISDIR(info.st_mode) &&
+            std::find(canonical.begin(), canonical.end(), resolved) == canonical.end()) {
+            canonical.push_back(resolved);
+        }
+    }
+    return canonical;
+}
+
+bool LinuxFileWatcher::IsUnderRoots(const std::vector<std::string>& roots, int max_depth,
+                                    const std::string& directory) {
+    for (const auto& root : roots) {
+        if (directory == root) {
+            return true;
+        }
+
+        const size_t prefix = root == "/" ? 1 : root.size() + 1;
+        if (directory.size() > prefix && directory.compare(0, root.size(), root) == 0 &&
+            directory[prefix - 1] == '/') {
+            // Depth of the directory below the root, as for inotify watches
+            int depth = 1 + static_cast<int>(std::count(directory.begin() + prefix, directory.end(), '/'));
+            if (depth <= max_depth) {
+                return true;
+            }
+        }
+    }
+    return false;
+}
+
+void LinuxFileWatcher::Emit(const std::string& path, DWORD action, DWORD process_id) {
+    if (callback_) {
+        Change change;
+        change.path = path;
+        change.action = action;
+        change.process_id = process_id;
+        callback_(change);
+    }
+}
+
+} // namespace HIPS
@@ -1,4 +1,5 @@
 #include "hips_core.h"
+#include "event_aggregation.h"
 #include <iostream>
 #include <memory>
 #include <thread>
@@ -108,8 +109,78 @@ private:
     }
 };
 
-// Global application instance for signal handling
+// Collector mode: receives events from HIPS agents (configured with
+// aggregation_collector_address) and correlates them across hosts
+class HIPSCollectorApplication {
+public:
+    bool Start(const std::string& listen_address) {
+        AggregationCollectorConfig config;
+        config.listen_address = listen_address;
+        if (!collector_.Initialize(config)) {
+            std::cerr << "Failed to initialize aggregation collector" << std::endl;
+            return false;
+        }
+        
+        collector_.RegisterCorrelationCallback([](const std::string& agent_id, const CorrelatedEventGroup& group) {
+            std::cout << "CORRELATION on " << agent_id << ": " << group.description << std::endl;
+        });
+        collector_.RegisterCrossHostCallback([](const CrossHostCorrelation& report) {
+            std::cout << "CROSS-HOST: " << report.signature << " on " << report.agent_ids.size() << " agents:";
+            for (const auto& agent_id : report.agent_ids) {
+                std::cout << " " << agent_id;
+            }
+            std::cout << std::endl;
+        });
+        
+        if (!collector_.Start()) {
+            std::cerr << "Failed to listen on " << listen_address << std::endl;
+            return false;
+        }
+        std::cout << "Aggregation collector listening on " << listen_address;
+        if (collector_.GetPort() != 0) {
+            std::cout << " (port " << collector_.GetPort() << ")";
+        }
+        std::cout << std::endl;
+        return true;
+    }
+    
+    void Run() {
+        std::cout << "HIPS collector is now running. Press Ctrl+C to stop." << std::endl;
+        
+        int counter = 0;
+        while (collector_.IsRunning()) {
+            std::this_thread::sleep_for(std::chrono::seconds(1));
+            if (++counter % 30 == 0) {
+                PrintStatistics();
+            }
+        }
+    }
+    
+    void Stop() {
+        std::cout << "Stopping HIPS collector..." << std::endl;
+        collector_.Stop();
+        std::cout << "HIPS collector stopped" << std::endl;
+    }
+    
+private:
+    AggregationCollector collector_;
+    
+    void PrintStatistics() {
+        std::cout << "\n--- Collector Statistics ---" << std::endl;
+        std::cout << "Received Events: " << collector_.GetReceivedEventCount() << std::endl;
+        std::cout << "Cross-Host Correlations: " << collector_.GetCrossHostCorrelationCount() << std::endl;
+        for (const auto& agent : collector_.GetAgentStats()) {
+            std::cout << "Agent " << agent.agent_id << ": " << (agent.connected ? "connected" : "disconnected")
+                      << ", " << agent.received_events << " events, " << agent.missing_events << " missing"
+                      << std::endl;
+        }
+        std::cout << "------------------------------------\n" << std::endl;
+    }
+};
+
+// Global application instances for signal handling
 std::unique_ptr<HIPSApplication> g_app;
+std::unique_ptr<HIPSCollectorApplication> g_collector;
 
 BOOL WINAPI ConsoleCtrlHandler(DWORD dwCtrlType) {
     switch (dwCtrlType) {
@@ -119,6 +190,9 @@ BOOL WINAPI ConsoleCtrlHandler(DWORD dwCtrlType) {
             if (g_app) {
                 g_app->Stop();
             }
+            if (g_collector) {
+                g_collector->Stop();
+            }
             return TRUE;
         default:
             return FALSE;
@@ -133,6 +207,17 @@ int main(int argc, char* argv[]) {
     // Set up console control handler
     SetConsoleCtrlHandler(ConsoleCtrlHandler, TRUE);
     
+    // hips --collector [host:port | unix:/path] runs the aggregation collector
+    // instead of the local monitors
+    if (argc > 1 && std::string(argv[1]) == "--collector") {
+        g_collector = std::make_unique<HIPSCollectorApplication>();
+        if (!g_collector->Start(argc > 2 ? argv[2] : "0.0.0.0:7410")) {
+            return 1;
+        }
+        g_collector->Run();
+        return 0;
+    }
+    
     try {
         g_app = std::make_unique<HIPSApplication>();
         
@@ -3,7 +3,8 @@
 
 namespace HIPS {
 
-NetworkMonitor::NetworkMonitor() : running_(false), initialized_(false) {
+NetworkMonitor::NetworkMonitor() : running_(false), initialized_(false), clock_(SystemClock::Instance()),
+      identity_cache_(ProcessIdentityCache::Shared()) {
 }
 
 NetworkMonitor::~NetworkMonitor() {
@@ -51,7 +52,7 @@ bool NetworkMonitor::Shutdown() {
 void NetworkMonitor::MonitoringThreadFunction() {
     while (running_.load()) {
         ScanNetworkConnections();
-        Sleep(5000); // Check every 5 seconds
+        SleepFor(*clock_, std::chrono::milliseconds(5000), running_); // Check every 5 seconds
     }
 }
 
@@ -111,11 +112,21 @@ bool NetworkMonitor::IsSuspiciousConnection(const NetworkConnection& conn) {
 }
 
 std::string NetworkMonitor::GetProcessNameFromPID(DWORD pid) {
-    return "Unknown"; // Simplified implementation
+    std::string path = identity_cache_->Resolve(pid);
+    size_t separator = path.find_last_of("\\/");
+    return separator == std::string::npos ? path : path.substr(separator + 1);
 }
 
 void NetworkMonitor::RegisterCallback(std::function<void(const SecurityEvent&)> callback) {
     event_callback_ = callback;
 }
 
+void NetworkMonitor::SetClock(std::shared_ptr<Clock> clock) {
+    clock_ = clock ? std::move(clock) : SystemClock::Instance();
+}
+
+void NetworkMonitor::SetProcessIdentityCache(std::shared_ptr<ProcessIdentityCache> cache) {
+    identity_cache_ = cache ? std::move(cache) : ProcessIdentityCache::Shared();
+}
+
 } // namespace HIPS
\ No newline at end of file
@@ -0,0 +1,105 @@
+/*
+ * Change Notification Decoding Implementation
+ */
+
+#include "notify_decoder.h"
+#include <cstring>
+
+namespace HIPS {
+
+// Records start with three DWORDs followed by the name
+static constexpr size_t kRecordHeaderBytes = offsetof(FILE_NOTIFY_INFORMATION, FileName);
+
+static inline uint32_t ReadUnit(const BYTE* units, size_t index) {
+    return static_cast<uint32_t>(units[2 * index]) | (static_cast<uint32_t>(units[2 * index + 1]) << 8);
+}
+
+static inline DWORD ReadDword(const BYTE* data) {
+    DWORD value;
+    std::memcpy(&value, data, sizeof(value));
+    return value;
+}
+
+size_t TranscodeUtf16ToUtf8(const BYTE* units, size_t count, char* out) {
+    char* const start = out;
+    size_t i = 0;
+    while (i < count) {
+        uint32_t unit = ReadUnit(units, i++);
+
+        // ASCII runs dominate file names
+        if (unit < 0x80) {
+            *out++ = static_cast<char>(unit);
+            continue;
+        }
+        if (unit < 0x800) {
+            *out++ = static_cast<char>(0xC0 | (unit >> 6));
+            *out++ = static_cast<char>(0x80 | (unit & 0x3F));
+            continue;
+        }
+
+        uint32_t code_point = unit;
+        if (unit >= 0xD800 && unit <= 0xDFFF) {
+            uint32_t low = i < count ? ReadUnit(units, i) : 0;
+            if (unit <= 0xDBFF && low >= 0xDC00 && low <= 0xDFFF) {
+                code_point = 0x10000 + ((unit - 0xD800) << 10) + (low - 0xDC00);
+                i++;
+            } else {
+                code_point = 0xFFFD;
+            }
+        }
+
+        if (code_point < 0x10000) {
+            *out++ = static_cast<char>(0xE0 | (code_point >> 12));
+            *out++ = static_cast<char>(0x80 | ((code_point >> 6) & 0x3F));
+            *out++ = static_cast<char>(0x80 | (code_point & 0x3F));
+        } else {
+            *out++ = static_cast<char>(0xF0 | (code_point >> 18));
+            *out++ = static_cast<char>(0x80 | ((code_point >> 12) & 0x3F));
+            *out++ = static_cast<char>(0x80 | ((code_point >> 6) & 0x3F));
+            *out++ = static_cast<char>(0x80 | (code_point & 0x3F));
+        }
+    }
+    return static_cast<size_t>(out - start);
+}
+
+NotifyBufferDecoder::NotifyBufferDecoder(const std::string& directory) : prefix_length_(0) {
+    SetDirectory(directory);
+}
+
+void NotifyBufferDecoder::SetDirectory(const std::string& directory) {
+    scratch_ = directory;
+    scratch_ += '\\';
+    prefix_length_ = scratch_.size();
+}
+
+size_t NotifyBufferDecoder::Decode(const BYTE* buffer, size_t bytes, const RecordCallback& callback) {
+    size_t records = 0;
+    size_t offset = 0;
+
+    while (offset + kRecordHeaderBytes <= bytes) {
+        const BYTE* record = buffer + offset;
+        DWORD next_entry = ReadDword(record);
+        DWORD action = ReadDword(record + sizeof(DWORD));
+        DWORD name_bytes = ReadDword(record + 2 * sizeof(DWORD));
+        if (name_bytes > bytes - offset - kRecordHeaderBytes) {
+            break;
+        }
+
+        size_t units = name_bytes / 2;
+        size_t needed = prefix_length_ + units * kUtf8BytesPerUtf16Unit;
+        if (scratch_.size() < needed) {
+            scratch_.resize(needed);
+        }
+        size_t written = TranscodeUtf16ToUtf8(record + kRecordHeaderBytes, units, &scratch_[prefix_length_]);
+        callback(std::string_view(scratch_.data(), prefix_length_ + written), action);
+        records++;
+
+        if (next_entry == 0) {
+            break;
+        }
+        offset += next_entry;
+    }
+    return records;
+}
+
+} // namespace HIPS
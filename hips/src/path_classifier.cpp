@@ -0,0 +1,225 @@
+/*
+ * Path Classifier Implementation
+ */
+
+#include "path_classifier.h"
+#include <unordered_map>
+
+namespace HIPS {
+
+static constexpr uint32_t kNoNode = 0xFFFFFFFFu;
+static constexpr size_t kMaxPackedExtension = 8;
+
+// Case and separator folding shared by the build and the scan
+static inline char FoldChar(char c) {
+    if (c >= 'A' && c <= 'Z') {
+        return static_cast<char>(c - 'A' + 'a');
+    }
+    return c == '\\' ? '/' : c;
+}
+
+static inline bool IsSeparator(char c) {
+    return c == '/' || c == '\\';
+}
+
+// Pack a folded extension (without the dot); 0 if it is empty or too long
+static uint64_t PackExtension(const std::string& extension) {
+    size_t start = !extension.empty() && extension[0] == '.' ? 1 : 0;
+    size_t length = extension.size() - start;
+    if (length == 0 || length > kMaxPackedExtension) {
+        return 0;
+    }
+    uint64_t key = 0;
+    for (size_t i = 0; i < length; ++i) {
+        key |= static_cast<uint64_t>(static_cast<unsigned char>(FoldChar(extension[start + i]))) << (8 * i);
+    }
+    return key;
+}
+
+static inline size_t SlotOf(uint64_t key, uint64_t multiplier, unsigned shift) {
+    return static_cast<size_t>((key * multiplier) >> shift);
+}
+
+PathClassifierConfig PathClassifierConfig::Defaults() {
+    PathClassifierConfig config;
+    config.executable_extensions = {".exe", ".dll", ".sys", ".bat", ".cmd", ".ps1", ".vbs", ".scr"};
+    config.excluded_extensions = {
+        ".log", ".tmp", ".temp", ".bak", ".cache", ".txt", ".doc", ".docx",
+        ".pdf", ".jpg", ".jpeg", ".png", ".gif", ".bmp", ".mp3", ".mp4",
+        ".avi", ".mov", ".wav"
+    };
+    config.system_directories = {"C:\\Windows\\System32", "C:\\Windows\\SysWOW64"};
+    config.critical_directories = {"C:\\Windows", "C:\\Program Files"};
+    config.system_file_names = {"ntoskrnl.exe", "kernel32.dll", "ntdll.dll"};
+    return config;
+}
+
+PathClassifier::PathClassifier(const PathClassifierConfig& config)
+    : extension_multiplier_(1), extension_shift_(63), has_included_(!config.included_extensions.empty()) {
+    BuildExtensionTable(config);
+
+    prefix_trie_.push_back({kNoNode, kNoNode, 0, 0});
+    name_trie_.push_back({kNoNode, kNoNode, 0, 0});
+    for (const auto& directory : config.critical_directories) {
+        InsertTrie(prefix_trie_, directory, kCriticalDirectory);
+    }
+    for (const auto& directory : config.system_directories) {
+        InsertTrie(prefix_trie_, directory, kSystemDirectory);
+    }
+    for (const auto& name : config.system_file_names) {
+        InsertTrie(name_trie_, name, kSystemFileName);
+    }
+}
+
+void PathClassifier::BuildExtensionTable(const PathClassifierConfig& config) {
+    std::unordered_map<uint64_t, uint8_t> flags;
+    auto add = [&flags](const std::vector<std::string>& extensions, uint8_t flag) {
+        for (const auto& extension : extensions) {
+            uint64_t key = PackExtension(extension);
+            if (key != 0) {
+                flags[key] |= flag;
+            }
+        }
+    };
+    add(config.executable_extensions, EXTENSION_EXECUTABLE);
+    add(config.included_extensions, EXTENSION_INCLUDED);
+    add(config.excluded_extensions, EXTENSION_EXCLUDED);
+
+    // Search multiplicative hashes until every key has a slot of its own,
+    // doubling the table when a size keeps colliding
+    size_t size = 2;
+    while (size < flags.size() * 2) {
+        size *= 2;
+    }
+    uint64_t seed = 0x9E3779B97F4A7C15ULL;
+    while (true) {
+        unsigned bits = 0;
+        while ((size_t(1) << bits) < size) {
+            bits++;
+        }
+        for (int attempt = 0; attempt < 256; ++attempt) {
+            // splitmix64 step; odd multipliers only
+            seed += 0x9E3779B97F4A7C15ULL;
+            uint64_t multiplier = seed;
+            multiplier = (multiplier ^ (multiplier >> 30)) * 0xBF58476D1CE4E5B9ULL;
+            multiplier = (multiplier ^ (multiplier >> 27)) * 0x94D049BB133111EBULL;
+            multiplier = (multiplier ^ (multiplier >> 31)) | 1;
+
+            std::vector<ExtensionSlot> slots(size, ExtensionSlot{0, 0});
+            bool collision = false;
+            for (const auto& pair : flags) {
+                auto& slot = slots[SlotOf(pair.first, multiplier, 64 - bits)];
+                if (slot.key != 0) {
+                    collision = true;
+                    break;
+                }
+                slot = ExtensionSlot{pair.first, pair.second};
+            }
+            if (!collision) {
+                extension_slots_ = std::move(slots);
+                extension_multiplier_ = multiplier;
+                extension_shift_ = 64 - bits;
+                return;
+            }
+        }
+        size *= 2;
+    }
+}
+
+uint8_t PathClassifier::LookupExtension(uint64_t key) const {
+    const auto& slot = extension_slots_[SlotOf(key, extension_multiplier_, extension_shift_)];
+    return slot.key == key ? slot.flags : 0;
+}
+
+void PathClassifier::InsertTrie(std::vector<TrieNode>& trie, const std::string& key, uint8_t flags) {
+    if (key.empty()) {
+        return;
+    }
+    uint32_t node = 0;
+    for (char c : key) {
+        char label = FoldChar(c);
+        uint32_t child = FindChild(trie, node, label);
+        if (child == kNoNode) {
+            child = static_cast<uint32_t>(trie.size());
+            trie.push_back({kNoNode, trie[node].first_child, label, 0});
+            trie[node].first_child = child;
+        }
+        node = child;
+    }
+    trie[node].flags |= flags;
+}
+
+uint32_t PathClassifier::FindChild(const std::vector<TrieNode>& trie, uint32_t node, char label) {
+    for (uint32_t child = trie[node].first_child; child != kNoNode; child = trie[child].next_sibling) {
+        if (trie[child].label == label) {
+            return child;
+        }
+    }
+    return kNoNode;
+}
+
+PathClassification PathClassifier::Classify(const char* path, size_t length) const {
+    PathClassification result;
+
+    // Prefix walk from the start of the path; it ends at the first mismatch
+    uint32_t prefix_node = 0;
+    uint8_t prefix_flags = 0;
+
+    // Name walk and extension key restart with every path component
+    uint32_t name_node = 0;
+    uint64_t extension_key = 0;
+    size_t extension_chars = 0;
+    size_t extension_start = std::string::npos;
+
+    for (size_t i = 0; i < length; ++i) {
+        const char c = path[i];
+        const char folded = FoldChar(c);
+
+        if (prefix_node != kNoNode) {
+            prefix_node = FindChild(prefix_trie_, prefix_node, folded);
+            if (prefix_node != kNoNode) {
+                prefix_flags |= prefix_trie_[prefix_node].flags;
+            }
+        }
+
+        if (IsSeparator(c)) {
+            name_node = 0;
+            extension_start = std::string::npos;
+            continue;
+        }
+        if (name_node != kNoNode) {
+            name_node = FindChild(name_trie_, name_node, folded);
+        }
+        if (c == '.') {
+            extension_start = i;
+            extension_key = 0;
+            extension_chars = 0;
+        } else if (extension_start != std::string::npos) {
+            if (extension_chars < kMaxPackedExtension) {
+                extension_key |= static_cast<uint64_t>(static_cast<unsigned char>(folded)) << (8 * extension_chars);
+            }
+            extension_chars++;
+        }
+    }
+
+    if (extension_start != std::string::npos) {
+        result.extension_offset = extension_start;
+        result.extension_length = length - extension_start;
+        if (extension_chars > 0 && extension_chars <= kMaxPackedExtension) {
+            result.extension_class = LookupExtension(extension_key);
+        }
+    }
+    result.critical_directory = (prefix_flags & kCriticalDirectory) != 0;
+    result.system_file = (prefix_flags & kSystemDirectory) != 0 ||
+                         (name_node != kNoNode && (name_trie_[name_node].flags & kSystemFileName) != 0);
+    return result;
+}
+
+bool PathClassifier::IsReported(const PathClassification& classification) const {
+    if (has_included_) {
+        return (classification.extension_class & EXTENSION_INCLUDED) != 0;
+    }
+    return (classification.extension_class & EXTENSION_EXCLUDED) == 0;
+}
+
+} // namespace HIPS
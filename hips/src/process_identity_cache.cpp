@@ -0,0 +1,217 @@
+/*
+ * Process Identity Cache Implementation
+ */
+
+#include "process_identity_cache.h"
+#include <mutex>
+
+#ifndef _WIN32
+#include <unistd.h>
+#include <fstream>
+#include <sstream>
+#include <cstdlib>
+#endif
+
+namespace HIPS {
+
+static constexpr size_t kShardCount = 16;
+static constexpr size_t kShardPurgeThreshold = 4096;
+// Lifetime of entries resolved outside ProcessMonitor
+static constexpr std::chrono::seconds kResolvedLifetime(10);
+
+ProcessIdentityCache::ProcessIdentityCache()
+    : shards_(kShardCount), hits_(0), misses_(0), stale_(0), resolutions_(0), invalidations_(0) {
+}
+
+void ProcessIdentityCache::Insert(DWORD pid, const ProcessIdentity& identity) {
+    Store(pid, identity, true);
+}
+
+void ProcessIdentityCache::Store(DWORD pid, const ProcessIdentity& identity, bool confirmed) {
+    auto now = std::chrono::steady_clock::now();
+    Shard& shard = ShardFor(pid);
+    std::unique_lock<std::shared_mutex> lock(shard.mutex);
+
+    // Resolved entries are only dropped lazily; sweep them out of large shards
+    if (shard.entries.size() >= kShardPurgeThreshold) {
+        for (auto it = shard.entries.begin(); it != shard.entries.end();) {
+            if (!it->second.confirmed && it->second.expires <= now) {
+                it = shard.entries.erase(it);
+            } else {
+                ++it;
+            }
+        }
+    }
+
+    auto it = shard.entries.find(pid);
+    // A resolution racing ProcessMonitor must not demote its entry
+    if (!confirmed && it != shard.entries.end() && it->second.confirmed &&
+        it->second.identity.start_time == identity.start_time) {
+        return;
+    }
+    shard.entries[pid] = Entry{identity, now + kResolvedLifetime, confirmed};
+}
+
+void ProcessIdentityCache::Invalidate(DWORD pid, uint64_t start_time) {
+    Shard& shard = ShardFor(pid);
+    std::unique_lock<std::shared_mutex> lock(shard.mutex);
+    auto it = shard.entries.find(pid);
+    if (it != shard.entries.end() && (start_time == 0 || it->second.identity.start_time == start_time)) {
+        shard.entries.erase(it);
+        invalidations_++;
+    }
+}
+
+bool ProcessIdentityCache::Lookup(DWORD pid, std::string& path) {
+    Shard& shard = ShardFor(pid);
+    {
+        std::shared_lock<std::shared_mutex> lock(shard.mutex);
+        auto it = shard.entries.find(pid);
+        if (it != shard.entries.end()) {
+            if (it->second.confirmed || std::chrono::steady_clock::now() < it->second.expires) {
+                path = it->second.identity.path;
+                hits_++;
+                return true;
+            }
+            stale_++;
+        }
+    }
+    misses_++;
+    return false;
+}
+
+bool ProcessIdentityCache::Lookup(DWORD pid, uint64_t start_time, std::string& path) {
+    Shard& shard = ShardFor(pid);
+    {
+        std::shared_lock<std::shared_mutex> lock(shard.mutex);
+        auto it = shard.entries.find(pid);
+        if (it != shard.entries.end()) {
+            if (it->second.identity.start_time == start_time) {
+                path = it->second.identity.path;
+                hits_++;
+                return true;
+            }
+            stale_++;
+        }
+    }
+    misses_++;
+    return false;
+}
+
+bool ProcessIdentityCache::Refresh(DWORD pid, ProcessIdentity& identity) {
+    if (!Query(pid, identity)) {
+        return false;
+    }
+    Store(pid, identity, true);
+    return true;
+}
+
+std::string ProcessIdentityCache::Resolve(DWORD pid) {
+    std::string path;
+    if (Lookup(pid, path)) {
+        return path;
+    }
+
+    ProcessIdentity identity;
+    if (!Query(pid, identity)) {
+        return "Unknown";
+    }
+    Store(pid, identity, false);
+    return identity.path;
+}
+
+bool ProcessIdentityCache::Query(DWORD pid, ProcessIdentity& identity) {
+    resolutions_++;
+    {
+        std::shared_lock<std::shared_mutex> lock(resolver_mutex_);
+        if (resolver_) {
+            return resolver_(pid, identity);
+        }
+    }
+    return QueryProcess(pid, identity);
+}
+
+void ProcessIdentityCache::SetResolver(Resolver resolver) {
+    std::unique_lock<std::shared_mutex> lock(resolver_mutex_);
+    resolver_ = std::move(resolver);
+}
+
+void ProcessIdentityCache::Clear() {
+    for (auto& shard : shards_) {
+        std::unique_lock<std::shared_mutex> lock(shard.mutex);
+        shard.entries.clear();
+    }
+}
+
+ProcessIdentityStats ProcessIdentityCache::GetStats() const {
+    ProcessIdentityStats stats;
+    stats.hits = hits_.load();
+    stats.misses = misses_.load();
+    stats.stale = stale_.load();
+    stats.resolutions = resolutions_.load();
+    stats.invalidations = invalidations_.load();
+    for (const auto& shard : shards_) {
+        std::shared_lock<std::shared_mutex> lock(shard.mutex);
+        stats.entries += shard.entries.size();
+    }
+    return stats;
+}
+
+bool ProcessIdentityCache::QueryProcess(DWORD pid, ProcessIdentity& identity) {
+#ifdef _WIN32
+    HANDLE process = OpenProcess(PROCESS_QUERY_LIMITED_INFORMATION, FALSE, pid);
+    if (process == NULL) {
+        return false;
+    }
+
+    char path[MAX_PATH];
+    DWORD size = MAX_PATH;
+    FILETIME creation, exit, kernel, user;
+    bool resolved = QueryFullProcessImageNameA(process, 0, path, &size) &&
+                    GetProcessTimes(process, &creation, &exit, &kernel, &user);
+    CloseHandle(process);
+    if (!resolved) {
+        return false;
+    }
+
+    identity.path.assign(path, size);
+    identity.start_time = (static_cast<uint64_t>(creation.dwHighDateTime) << 32) | creation.dwLowDateTime;
+    return true;
+#else
+    std::string proc = "/proc/" + std::to_string(pid);
+    char path[4096];
+    ssize_t length = readlink((proc + "/exe").c_str(), path, sizeof(path));
+    if (length <= 0) {
+        return false;
+    }
+
+    // Start time is field 22 of stat; the command name (field 2) may
+    // contain spaces, so fields are counted after its closing parenthesis
+    std::ifstream stat_file(proc + "/stat");
+    std::string stat;
+    if (!std::getline(stat_file, stat)) {
+        return false;
+    }
+    size_t close = stat.rfind(')');
+    if (close == std::string::npos) {
+        return false;
+    }
+    std::istringstream fields(stat.substr(close + 1));
+    std::string field;
+    for (int index = 3; index <= 22 && (fields >> field); ++index) {
+        if (index == 22) {
+            identity.start_time = std::strtoull(field.c_str(), nullptr, 10);
+            identity.path.assign(path, static_cast<size_t>(length));
+            return true;
+        }
+    }
+    return false;
+#endif
+}
+
+std::shared_ptr<ProcessIdentityCache> ProcessIdentityCache::Shared() {
+    static std::shared_ptr<ProcessIdentityCache> cache = std::make_shared<ProcessIdentityCache>();
+    return cache;
+}
+
+} // namespace HIPS
@@ -0,0 +1,197 @@
+/*
+ * Process Lineage Table Implementation
+ *
+ * Entries carry a generation so the exited-process queue can refer to a
+ * pid without being confused by a later process that reused it.
+ */
+
+#include "process_lineage.h"
+#include <cstdlib>
+
+namespace HIPS {
+
+ProcessLineageTable::ProcessLineageTable()
+    : next_generation_(1), max_exited_processes_(4096), max_depth_(16) {
+}
+
+ProcessLineageTable::~ProcessLineageTable() {
+}
+
+void ProcessLineageTable::Configure(size_t max_exited_processes, size_t max_depth) {
+    max_exited_processes_ = max_exited_processes;
+    max_depth_ = max_depth;
+}
+
+void ProcessLineageTable::RecordProcessStart(DWORD pid, DWORD parent_pid, TimePoint now) {
+    if (pid == 0 || pid == parent_pid) {
+        return;
+    }
+
+    // A parent we never saw start is recorded as a root that predates
+    // everything, so it is never mistaken for a reused pid
+    if (parent_pid != 0 && entries_.find(parent_pid) == entries_.end()) {
+        entries_[parent_pid] = Entry{0, TimePoint::min(), next_generation_++, false};
+    }
+
+    // Replaces any exited (or missed) process that used this pid before;
+    // its queued exit record no longer matches the generation
+    entries_[pid] = Entry{parent_pid, now, next_generation_++, false};
+}
+
+void ProcessLineageTable::RecordProcessExit(DWORD pid, TimePoint /*now*/, std::vector<DWORD>& evicted) {
+    auto it = entries_.find(pid);
+    if (it == entries_.end() || it->second.exited) {
+        return;
+    }
+
+    it->second.exited = true;
+    exited_order_.emplace_back(pid, it->second.generation);
+
+    while (exited_order_.size() > max_exited_processes_) {
+        auto [old_pid, generation] = exited_order_.front();
+        exited_order_.pop_front();
+
+        auto old_it = entries_.find(old_pid);
+        if (old_it != entries_.end() && old_it->second.generation == generation) {
+            entries_.erase(old_it);
+            evicted.push_back(old_pid);
+        }
+    }
+}
+
+const ProcessLineageTable::Entry* ProcessLineageTable::ParentOf(const Entry& entry) const {
+    if (entry.parent_pid == 0) {
+        return nullptr;
+    }
+
+    auto it = entries_.find(entry.parent_pid);
+    if (it == entries_.end() || it->second.start_time > entry.start_time) {
+        return nullptr;
+    }
+    return &it->second;
+}
+
+void ProcessLineageTable::GetAncestors(DWORD pid, std::vector<DWORD>& ancestors) const {
+    auto it = entries_.find(pid);
+    if (it == entries_.end()) {
+        return;
+    }
+
+    const Entry* entry = &it->second;
+    for (size_t depth = 0; depth < max_depth_; ++depth) {
+        DWORD parent_pid = entry->parent_pid;
+        entry = ParentOf(*entry);
+        if (entry == nullptr) {
+            break;
+        }
+        ancestors.push_back(parent_pid);
+    }
+}
+
+bool ProcessLineageTable::IsAncestor(DWORD ancestor, DWORD pid) const {
+    auto it = entries_.find(pid);
+    if (it == entries_.end()) {
+        return false;
+    }
+
+    const Entry* entry = &it->second;
+    for (size_t depth = 0; depth < max_depth_; ++depth) {
+        DWORD parent_pid = entry->parent_pid;
+        entry = ParentOf(*entry);
+        if (entry == nullptr) {
+            return false;
+        }
+        if (parent_pid == ancestor) {
+            return true;
+        }
+    }
+    return false;
+}
+
+DWORD ProcessLineageTable::GetParent(DWORD pid) const {
+    auto it = entries_.find(pid);
+    if (it == entries_.end() || ParentOf(it->second) == nullptr) {
+        return 0;
+    }
+    return it->second.parent_pid;
+}
+
+bool ProcessLineageTable::Contains(DWORD pid) const {
+    return entries_.find(pid) != entries_.end();
+}
+
+void ProcessLineageTable::Clear() {
+    entries_.clear();
+    exited_order_.clear();
+}
+
+void ProcessLineageTable::Save(SnapshotWriter& writer) const {
+    writer.WriteU64(next_generation_);
+
+    writer.WriteU32(static_cast<uint32_t>(entries_.size()));
+    for (const auto& [pid, entry] : entries_) {
+        writer.WriteU32(static_cast<uint32_t>(pid));
+        writer.WriteU32(static_cast<uint32_t>(entry.parent_pid));
+        writer.WriteTimePoint(entry.start_time);
+        writer.WriteU64(entry.generation);
+        writer.WriteU8(entry.exited ? 1 : 0);
+    }
+
+    writer.WriteU32(static_cast<uint32_t>(exited_order_.size()));
+    for (const auto& [pid, generation] : exited_order_) {
+        writer.WriteU32(static_cast<uint32_t>(pid));
+        writer.WriteU64(generation);
+    }
+}
+
+bool ProcessLineageTable::Load(SnapshotReader& reader) {
+    Clear();
+
+    uint32_t entry_count;
+    if (!reader.ReadU64(next_generation_) || !reader.ReadCount(entry_count, 25)) {
+        Clear();
+        return false;
+    }
+
+    entries_.reserve(entry_count);
+    for (uint32_t i = 0; i < entry_count; ++i) {
+        uint32_t pid, parent_pid;
+        uint8_t exited;
+        Entry entry;
+        if (!reader.ReadU32(pid) || !reader.ReadU32(parent_pid) ||
+            !reader.ReadTimePoint(entry.start_time) || !reader.ReadU64(entry.generation) ||
+            !reader.ReadU8(exited)) {
+            Clear();
+            return false;
+        }
+        entry.parent_pid = parent_pid;
+        entry.exited = exited != 0;
+        entries_[pid] = entry;
+    }
+
+    uint32_t exited_count;
+    if (!reader.ReadCount(exited_count, 12)) {
+        Clear();
+        return false;
+    }
+    for (uint32_t i = 0; i < exited_count; ++i) {
+        uint32_t pid;
+        uint64_t generation;
+        if (!reader.ReadU32(pid) || !reader.ReadU64(generation)) {
+            Clear();
+            return false;
+        }
+        exited_order_.emplace_back(pid, generation);
+    }
+    return true;
+}
+
+DWORD ProcessLineageTable::ParentPidFromEvent(const SecurityEvent& event) {
+    auto it = event.metadata.find("parent_pid");
+    if (it == event.metadata.end() || it->second.empty()) {
+        return 0;
+    }
+    return static_cast<DWORD>(std::strtoul(it->second.c_str(), nullptr, 10));
+}
+
+} // namespace HIPS
@@ -37,7 +37,9 @@ std::string GetProcessDisplayValue(const ProcessInfo& process, bool prefer_name)
 } // namespace
 
 ProcessMonitor::ProcessMonitor() 
-    : running_(false), initialized_(false), scan_interval_(1000), memory_threshold_(500 * 1024 * 1024) {
+    : running_(false), initialized_(false), clock_(SystemClock::Instance()),
+      identity_cache_(ProcessIdentityCache::Shared()), content_hasher_(ContentHasher::Shared()),
+      content_hashing_(false), hashes_in_flight_(0), scan_interval_(1000), memory_threshold_(500 * 1024 * 1024) {
     
     // Add common suspicious process names
     suspicious_processes_["mimikatz.exe"] = true;
@@ -99,6 +101,12 @@ bool ProcessMonitor::Stop() {
         monitor_thread_.join();
     }
 
+    // Deliver the creation events still waiting for their hashes
+    {
+        std::unique_lock<std::mutex> lock(hash_mutex_);
+        hash_cv_.wait(lock, [this] { return hashes_in_flight_ == 0; });
+    }
+
     return true;
 }
 
@@ -123,10 +131,10 @@ void ProcessMonitor::MonitoringThreadFunction() {
             ScanForTerminatedProcesses();
             CheckProcessBehavior();
             
-            Sleep(scan_interval_);
+            SleepFor(*clock_, std::chrono::milliseconds(scan_interval_), running_);
         } catch (const std::exception& e) {
             // Log error and continue
-            Sleep(scan_interval_);
+            SleepFor(*clock_, std::chrono::milliseconds(scan_interval_), running_);
         }
     }
 }
@@ -150,10 +158,7 @@ void ProcessMonitor::ScanForNewProcesses() {
                 known_processes_[pe32.th32ProcessID] = process;
                 
                 // Generate security event for new process
-                SecurityEvent event = CreateProcessEvent(process, EventType::PROCESS_CREATION);
-                if (event_callback_) {
-                    event_callback_(event);
-                }
+                DispatchCreationEvent(CreateProcessEvent(process, EventType::PROCESS_CREATION));
             }
             
         } while (Process32Next(snapshot, &pe32));
@@ -162,6 +167,43 @@ void ProcessMonitor::ScanForNewProcesses() {
     CloseHandle(snapshot);
 }
 
+void ProcessMonitor::DispatchCreationEvent(SecurityEvent event) {
+    if (!event_callback_) {
+        return;
+    }
+    if (!content_hashing_.load() || IsUnknownProcessValue(event.process_path)) {
+        event_callback_(event);
+        return;
+    }
+
+    // Images seen before are answered from the cache before this returns
+    {
+        std::lock_guard<std::mutex> lock(hash_mutex_);
+        hashes_in_flight_++;
+    }
+    std::string path = event.process_path;
+    bool accepted = content_hasher_->HashAsync(path, [this, event](bool ok, const FileHashes& hashes) mutable {
+        if (ok) {
+            event.metadata["sha256"] = hashes.sha256;
+            event.metadata["xxh64"] = hashes.Xxh64Hex();
+        }
+        event_callback_(event);
+        FinishHashRequest();
+    });
+    if (!accepted) {
+        FinishHashRequest();
+        event_callback_(event);
+    }
+}
+
+void ProcessMonitor::FinishHashRequest() {
+    {
+        std::lock_guard<std::mutex> lock(hash_mutex_);
+        hashes_in_flight_--;
+    }
+    hash_cv_.notify_all();
+}
+
 void ProcessMonitor::ScanForTerminatedProcesses() {
     std::vector<DWORD> terminated_pids;
     
@@ -180,6 +222,7 @@ void ProcessMonitor::ScanForTerminatedProcesses() {
                     event_callback_(event);
                 }
                 
+                identity_cache_->Invalidate(it->first, it->second.start_time);
                 it = known_processes_.erase(it);
             } else {
                 CloseHandle(process);
@@ -236,8 +279,19 @@ ProcessInfo ProcessMonitor::CreateProcessInfo(DWORD pid) {
     ProcessInfo info;
     info.pid = pid;
     info.name = GetProcessName(pid);
-    info.path = GetProcessPath(pid);
-    info.command_line = GetProcessCommandLine(pid);
+
+    // Publish the identity for the other monitors; the path is reused for
+    // the command line fallback instead of being queried again
+    ProcessIdentity identity;
+    if (identity_cache_->Refresh(pid, identity)) {
+        info.path = identity.path;
+        info.start_time = identity.start_time;
+        info.command_line = identity.path;
+    } else {
+        info.path = kUnknownProcessValue;
+        info.start_time = 0;
+        info.command_line = GetProcessCommandLine(pid);
+    }
     info.parent_pid = GetParentProcessId(pid);
     info.thread_count = GetProcessThreadCount(pid);
     info.memory_usage = GetProcessMemoryUsage(pid);
@@ -361,19 +415,7 @@ std::string ProcessMonitor::GetProcessName(DWORD pid) {
 }
 
 std::string ProcessMonitor::GetProcessPath(DWORD pid) {
-    HANDLE process = OpenProcess(PROCESS_QUERY_INFORMATION | PROCESS_VM_READ, FALSE, pid);
-    if (process == NULL) {
-        return kUnknownProcessValue;
-    }
-
-    char path[MAX_PATH];
-    DWORD size = GetModuleFileNameExA(process, NULL, path, MAX_PATH);
-    CloseHandle(process);
-
-    if (size > 0) {
-        return std::string(path);
-    }
-    return kUnknownProcessValue;
+    return identity_cache_->Resolve(pid);
 }
 
 std::string ProcessMonitor::GetProcessCommandLine(DWORD pid) {
@@ -582,6 +624,18 @@ void ProcessMonitor::SetScanInterval(DWORD interval_ms) {
     scan_interval_ = interval_ms;
 }
 
+void ProcessMonitor::SetClock(std::shared_ptr<Clock> clock) {
+    clock_ = clock ? std::move(clock) : SystemClock::Instance();
+}
+
+void ProcessMonitor::SetProcessIdentityCache(std::shared_ptr<ProcessIdentityCache> cache) {
+    identity_cache_ = cache ? std::move(cache) : ProcessIdentityCache::Shared();
+}
+
+void ProcessMonitor::SetContentHasher(std::shared_ptr<ContentHasher> hasher) {
+    content_hasher_ = hasher ? std::move(hasher) : ContentHasher::Shared();
+}
+
 void ProcessMonitor::AddSuspiciousProcess(const std::string& process_name) {
     suspicious_processes_[process_name] = true;
 }
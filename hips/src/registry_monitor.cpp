@@ -2,7 +2,7 @@
 
 namespace HIPS {
 
-RegistryMonitor::RegistryMonitor() : running_(false), initialized_(false) {
+RegistryMonitor::RegistryMonitor() : running_(false), initialized_(false), clock_(SystemClock::Instance()) {
 }
 
 RegistryMonitor::~RegistryMonitor() {
@@ -42,7 +42,7 @@ bool RegistryMonitor::Shutdown() {
 void RegistryMonitor::MonitoringThreadFunction() {
     while (running_.load()) {
         // Simplified registry monitoring
-        Sleep(2000);
+        SleepFor(*clock_, std::chrono::milliseconds(2000), running_);
     }
 }
 
@@ -75,4 +75,8 @@ void RegistryMonitor::RegisterCallback(std::function<void(const SecurityEvent&)>
     event_callback_ = callback;
 }
 
+void RegistryMonitor::SetClock(std::shared_ptr<Clock> clock) {
+    clock_ = clock ? std::move(clock) : SystemClock::Instance();
+}
+
 } // namespace HIPS
\ No newline at end of file
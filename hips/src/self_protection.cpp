@@ -1,8 +1,10 @@
 #include "self_protection.h"
+#include "content_hasher.h"
 #include <iostream>
 #include <sstream>
 #include <fstream>
 #include <algorithm>
+#include <cctype>
 #include <chrono>
 #include <thread>
 
@@ -1130,8 +1132,15 @@ bool SelfProtectionEngine::VerifyCodeSignature(const std::string& file_path) {
 }
 
 bool SelfProtectionEngine::VerifyFileHash(const std::string& file_path, const std::string& expected_hash) {
-    // Placeholder implementation for file hash verification
-    return true;
+    // expected_hash is a SHA-256 digest in hex, either case
+    FileHashes hashes;
+    if (expected_hash.size() != 64 || !ContentHasher::Shared()->Hash(file_path, hashes)) {
+        return false;
+    }
+    return std::equal(expected_hash.begin(), expected_hash.end(), hashes.sha256.begin(),
+                      [](char expected, char actual) {
+                          return std::tolower(static_cast<unsigned char>(expected)) == actual;
+                      });
 }
 
 // Utility functions
@@ -0,0 +1,424 @@
+/*
+ * Sequence Matcher Implementation
+ *
+ * Each partial match is an NFA state (pattern, next step) bound to a
+ * partition: the root process for SAME_PROCESS/SAME_LINEAGE patterns or a
+ * single global partition for ANY_PROCESS. Only one partial match is kept
+ * per (pattern, step, partition); when two paths reach the same state the
+ * one that started later wins, since it dominates on every time limit.
+ */
+
+#include "sequence_matcher.h"
+#include "process_lineage.h"
+#include <algorithm>
+#include <cctype>
+
+namespace HIPS {
+
+namespace {
+
+// Upper bound on processes adopted into a single lineage match
+constexpr size_t kMaxLineagePids = 64;
+
+// Used when neither a step gap nor a pattern duration is configured
+constexpr std::chrono::seconds kUnlimited{std::chrono::hours(24 * 365)};
+
+uint32_t EventTypeBit(EventType type) {
+    return 1u << static_cast<uint32_t>(type);
+}
+
+bool ContainsIgnoreCase(const std::string& haystack, const std::string& upper_needle) {
+    auto it = std::search(haystack.begin(), haystack.end(),
+                          upper_needle.begin(), upper_needle.end(),
+                          [](char a, char b) {
+                              return std::toupper(static_cast<unsigned char>(a)) == b;
+                          });
+    return it != haystack.end();
+}
+
+} // namespace
+
+std::vector<AttackPattern> DefaultAttackPatterns() {
+    std::vector<AttackPattern> patterns;
+
+    // Pattern 1: Process creation -> File modification -> Registry modification
+    AttackPattern persistence;
+    persistence.name = "multi_stage_persistence";
+    persistence.description = "Multi-stage persistence attack";
+    persistence.scope = PatternScope::SAME_LINEAGE;
+    persistence.steps.resize(3);
+    persistence.steps[0].event_types = {EventType::PROCESS_CREATION};
+    persistence.steps[1].event_types = {EventType::FILE_MODIFICATION, EventType::FILE_DELETION};
+    persistence.steps[2].event_types = {EventType::REGISTRY_MODIFICATION};
+    patterns.push_back(persistence);
+
+    // Pattern 2: Memory injection followed by file/registry changes. The
+    // follow-up activity usually comes from the injected process, so the
+    // steps are not tied to the injecting pid.
+    AttackPattern injection;
+    injection.name = "memory_injection_chain";
+    injection.description = "Memory injection attack chain";
+    injection.scope = PatternScope::ANY_PROCESS;
+    injection.steps.resize(2);
+    injection.steps[0].event_types = {EventType::MEMORY_INJECTION};
+    injection.steps[1].event_types = {EventType::FILE_MODIFICATION, EventType::FILE_DELETION,
+                                      EventType::REGISTRY_MODIFICATION};
+    patterns.push_back(injection);
+
+    return patterns;
+}
+
+std::string PatternScopeToString(PatternScope scope) {
+    switch (scope) {
+        case PatternScope::ANY_PROCESS: return "ANY_PROCESS";
+        case PatternScope::SAME_PROCESS: return "SAME_PROCESS";
+        case PatternScope::SAME_LINEAGE: return "SAME_LINEAGE";
+        default: return "UNKNOWN";
+    }
+}
+
+bool SequenceMatcher::CompiledStep::Accepts(const SecurityEvent& event) const {
+    if ((type_mask & EventTypeBit(event.type)) == 0) {
+        return false;
+    }
+    if (static_cast<int>(event.threat_level) < static_cast<int>(min_threat_level)) {
+        return false;
+    }
+    if (!target_pattern.empty() && !ContainsIgnoreCase(event.target_path, target_pattern)) {
+        return false;
+    }
+    if (custom_condition && !custom_condition(event)) {
+        return false;
+    }
+    return true;
+}
+
+SequenceMatcher::SequenceMatcher()
+    : start_index_(kEventTypeCount), max_partial_matches_(0),
+      active_count_(0), dropped_count_(0) {
+}
+
+SequenceMatcher::~SequenceMatcher() {
+}
+
+void SequenceMatcher::Compile(const std::vector<AttackPattern>& patterns,
+                              int default_window_seconds,
+                              size_t max_partial_matches) {
+    Clear();
+    patterns_.clear();
+    start_index_.assign(kEventTypeCount, {});
+    max_partial_matches_ = max_partial_matches;
+
+    const std::chrono::seconds default_window =
+        default_window_seconds > 0 ? std::chrono::seconds(default_window_seconds) : kUnlimited;
+
+    for (const auto& pattern : patterns) {
+        // State keys reserve 16 bits each for pattern and step indices
+        if (!pattern.enabled || pattern.steps.empty() ||
+            pattern.steps.size() > 0xFFFF || patterns_.size() >= 0xFFFF) {
+            continue;
+        }
+
+        CompiledPattern compiled;
+        compiled.name = pattern.name;
+        compiled.description = pattern.description;
+        compiled.scope = pattern.scope;
+        compiled.max_duration = pattern.max_duration_seconds > 0
+            ? std::chrono::seconds(pattern.max_duration_seconds) : default_window;
+        compiled.threat_level = pattern.threat_level;
+        compiled.score = pattern.score;
+
+        for (const auto& step : pattern.steps) {
+            CompiledStep cs;
+            cs.type_mask = 0;
+            for (EventType type : step.event_types) {
+                cs.type_mask |= EventTypeBit(type);
+            }
+            cs.min_threat_level = step.min_threat_level;
+            cs.target_pattern = step.target_pattern;
+            std::transform(cs.target_pattern.begin(), cs.target_pattern.end(),
+                           cs.target_pattern.begin(),
+                           [](unsigned char c) { return static_cast<char>(std::toupper(c)); });
+            cs.max_gap = step.max_gap_seconds > 0
+                ? std::chrono::seconds(step.max_gap_seconds) : compiled.max_duration;
+            cs.custom_condition = step.custom_condition;
+            compiled.steps.push_back(std::move(cs));
+        }
+
+        const uint32_t index = static_cast<uint32_t>(patterns_.size());
+        for (size_t type = 0; type < kEventTypeCount; ++type) {
+            if (compiled.steps.front().type_mask & (1u << type)) {
+                start_index_[type].push_back(index);
+            }
+        }
+        patterns_.push_back(std::move(compiled));
+    }
+}
+
+void SequenceMatcher::Clear() {
+    slots_.clear();
+    free_slots_.clear();
+    pid_index_.clear();
+    global_index_.clear();
+    state_index_.clear();
+    active_count_ = 0;
+}
+
+void SequenceMatcher::ProcessEvent(const SecurityEvent& event, TimePoint now,
+                                   std::vector<SequenceMatch>& completed) {
+    ProcessEvent(std::make_shared<const SecurityEvent>(event), now, completed);
+}
+
+void SequenceMatcher::ProcessEvent(const EventRef& event_ref, TimePoint now,
+                                   std::vector<SequenceMatch>& completed) {
+    if (patterns_.empty()) {
+        return;
+    }
+    const SecurityEvent& event = *event_ref;
+
+    // A new child joins every lineage match its parent belongs to
+    if (event.type == EventType::PROCESS_CREATION) {
+        DWORD parent_pid = ProcessLineageTable::ParentPidFromEvent(event);
+        if (parent_pid != 0 && parent_pid != event.process_id) {
+            AdoptChildProcess(parent_pid, event.process_id, now);
+        }
+    }
+
+    // Advance partial matches waiting on this process or on any process
+    scratch_.clear();
+    auto pid_it = pid_index_.find(event.process_id);
+    if (pid_it != pid_index_.end()) {
+        CollectCandidates(pid_it->second);
+        if (pid_it->second.empty()) {
+            pid_index_.erase(pid_it);
+        }
+    }
+    CollectCandidates(global_index_);
+
+    for (uint32_t slot : scratch_) {
+        PartialMatch& match = slots_[slot];
+        if (!match.alive) {
+            continue;
+        }
+        if (IsExpired(match, now)) {
+            ReleaseSlot(slot);
+            continue;
+        }
+        if (patterns_[match.pattern].steps[match.next_step].Accepts(event)) {
+            AdvanceMatch(slot, event_ref, now, completed);
+        }
+    }
+
+    // Start new partial matches after advancing so one event never counts
+    // as two steps of the same match
+    const size_t type = static_cast<size_t>(event.type);
+    if (type >= start_index_.size()) {
+        return;
+    }
+    for (uint32_t pattern : start_index_[type]) {
+        const CompiledPattern& compiled = patterns_[pattern];
+        if (!compiled.steps.front().Accepts(event)) {
+            continue;
+        }
+        if (compiled.steps.size() == 1) {
+            EventRefs events;
+            events.push_back(event_ref);
+            EmitMatch(compiled, event.process_id, std::move(events), completed);
+            continue;
+        }
+        StartMatch(pattern, event_ref, now);
+    }
+}
+
+void SequenceMatcher::ExpireMatches(TimePoint now) {
+    for (uint32_t slot = 0; slot < slots_.size(); ++slot) {
+        if (slots_[slot].alive && IsExpired(slots_[slot], now)) {
+            ReleaseSlot(slot);
+        }
+    }
+
+    // Compact index lists so pids that never reappear do not accumulate
+    for (auto it = pid_index_.begin(); it != pid_index_.end();) {
+        auto& refs = it->second;
+        refs.erase(std::remove_if(refs.begin(), refs.end(),
+                                  [this](const SlotRef& ref) { return !IsLive(ref); }),
+                   refs.end());
+        if (refs.empty()) {
+            it = pid_index_.erase(it);
+        } else {
+            ++it;
+        }
+    }
+    global_index_.erase(std::remove_if(global_index_.begin(), global_index_.end(),
+                                       [this](const SlotRef& ref) { return !IsLive(ref); }),
+                        global_index_.end());
+}
+
+void SequenceMatcher::CollectCandidates(std::vector<SlotRef>& refs) {
+    size_t keep = 0;
+    for (size_t i = 0; i < refs.size(); ++i) {
+        if (IsLive(refs[i])) {
+            scratch_.push_back(refs[i].slot);
+            refs[keep++] = refs[i];
+        }
+    }
+    refs.resize(keep);
+}
+
+void SequenceMatcher::AdoptChildProcess(DWORD parent_pid, DWORD child_pid, TimePoint now) {
+    auto parent_it = pid_index_.find(parent_pid);
+    if (parent_it == pid_index_.end()) {
+        return;
+    }
+
+    // Copy first: inserting the child's entry may rehash pid_index_
+    std::vector<SlotRef> parent_refs = parent_it->second;
+    for (const SlotRef& ref : parent_refs) {
+        if (!IsLive(ref)) {
+            continue;
+        }
+        PartialMatch& match = slots_[ref.slot];
+        if (patterns_[match.pattern].scope != PatternScope::SAME_LINEAGE ||
+            IsExpired(match, now) || match.lineage.size() >= kMaxLineagePids ||
+            std::find(match.lineage.begin(), match.lineage.end(), child_pid) != match.lineage.end()) {
+            continue;
+        }
+        match.lineage.push_back(child_pid);
+        pid_index_[child_pid].push_back(ref);
+    }
+}
+
+void SequenceMatcher::StartMatch(uint32_t pattern, const EventRef& event_ref, TimePoint now) {
+    const SecurityEvent& event = *event_ref;
+    const CompiledPattern& compiled = patterns_[pattern];
+    const DWORD partition = compiled.scope == PatternScope::ANY_PROCESS ? 0 : event.process_id;
+
+    // A fresh start always dominates an older match waiting on step 1
+    auto existing = state_index_.find(StateKey(pattern, 1, partition));
+    if (existing != state_index_.end()) {
+        ReleaseSlot(existing->second);
+    }
+
+    if (active_count_ >= max_partial_matches_) {
+        dropped_count_++;
+        return;
+    }
+
+    uint32_t slot = AllocateSlot();
+    PartialMatch& match = slots_[slot];
+    match.pattern = pattern;
+    match.next_step = 1;
+    match.partition = partition;
+    match.start_time = now;
+    match.last_time = now;
+    match.events.push_back(event_ref);
+    match.lineage.push_back(event.process_id);
+
+    SlotRef ref{slot, match.generation};
+    if (compiled.scope == PatternScope::ANY_PROCESS) {
+        global_index_.push_back(ref);
+    } else {
+        pid_index_[event.process_id].push_back(ref);
+    }
+    state_index_[StateKey(pattern, 1, partition)] = slot;
+}
+
+void SequenceMatcher::AdvanceMatch(uint32_t slot, const EventRef& event, TimePoint now,
+                                   std::vector<SequenceMatch>& completed) {
+    PartialMatch& match = slots_[slot];
+    const CompiledPattern& compiled = patterns_[match.pattern];
+
+    auto old_key = state_index_.find(StateKey(match.pattern, match.next_step, match.partition));
+    if (old_key != state_index_.end() && old_key->second == slot) {
+        state_index_.erase(old_key);
+    }
+
+    match.events.push_back(event);
+    match.last_time = now;
+    match.next_step++;
+
+    if (match.next_step == compiled.steps.size()) {
+        EmitMatch(compiled, match.partition != 0 ? match.partition : match.events.front().process_id,
+                  std::move(match.events), completed);
+        ReleaseSlot(slot);
+        return;
+    }
+
+    const uint64_t new_key = StateKey(match.pattern, match.next_step, match.partition);
+    auto existing = state_index_.find(new_key);
+    if (existing != state_index_.end()) {
+        if (slots_[existing->second].start_time > match.start_time) {
+            ReleaseSlot(slot);
+            return;
+        }
+        ReleaseSlot(existing->second);
+    }
+    state_index_[new_key] = slot;
+}
+
+void SequenceMatcher::EmitMatch(const CompiledPattern& pattern, DWORD root_pid,
+                                EventRefs&& events,
+                                std::vector<SequenceMatch>& completed) {
+    SequenceMatch result;
+    result.pattern_name = pattern.name;
+    result.description = pattern.description;
+    result.scope = pattern.scope;
+    result.threat_level = pattern.threat_level;
+    result.score = pattern.score;
+    result.root_process_id = root_pid;
+    result.events = std::move(events);
+    completed.push_back(std::move(result));
+}
+
+void SequenceMatcher::ReleaseSlot(uint32_t slot) {
+    PartialMatch& match = slots_[slot];
+    if (!match.alive) {
+        return;
+    }
+
+    auto key = state_index_.find(StateKey(match.pattern, match.next_step, match.partition));
+    if (key != state_index_.end() && key->second == slot) {
+        state_index_.erase(key);
+    }
+
+    match.alive = false;
+    match.generation++;
+    match.events.clear();
+    match.lineage.clear();
+    free_slots_.push_back(slot);
+    active_count_--;
+}
+
+uint32_t SequenceMatcher::AllocateSlot() {
+    uint32_t slot;
+    if (!free_slots_.empty()) {
+        slot = free_slots_.back();
+        free_slots_.pop_back();
+    } else {
+        slot = static_cast<uint32_t>(slots_.size());
+        slots_.emplace_back();
+        slots_.back().generation = 0;
+    }
+    slots_[slot].alive = true;
+    active_count_++;
+    return slot;
+}
+
+bool SequenceMatcher::IsExpired(const PartialMatch& match, TimePoint now) const {
+    const CompiledPattern& compiled = patterns_[match.pattern];
+    return now - match.start_time > compiled.max_duration ||
+           now - match.last_time > compiled.steps[match.next_step].max_gap;
+}
+
+bool SequenceMatcher::IsLive(const SlotRef& ref) const {
+    return ref.slot < slots_.size() && slots_[ref.slot].alive &&
+           slots_[ref.slot].generation == ref.generation;
+}
+
+uint64_t SequenceMatcher::StateKey(uint32_t pattern, uint32_t step, DWORD partition) {
+    return (static_cast<uint64_t>(pattern) << 48) |
+           (static_cast<uint64_t>(step & 0xFFFF) << 32) |
+           (static_cast<uint64_t>(partition) & 0xFFFFFFFFull);
+}
+
+} // namespace HIPS
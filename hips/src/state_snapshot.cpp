@@ -0,0 +1,489 @@
+/*
+ * State Snapshot Implementation
+ */
+
+#include "state_snapshot.h"
+#include <cstring>
+#include <cstdio>
+#include <limits>
+
+#ifndef _WIN32
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace HIPS {
+
+static const char kSnapshotMagic[8] = {'H', 'I', 'P', 'S', 'S', 'N', 'A', 'P'};
+static const size_t kHeaderSize = sizeof(kSnapshotMagic) + sizeof(uint32_t);
+static const size_t kSectionHeaderSize = sizeof(uint32_t) + sizeof(uint64_t);
+
+// Time points are stored as nanoseconds since the epoch; TimePoint::min()
+// (used for "before anything") gets a sentinel because it does not fit
+static const int64_t kMinTimePoint = std::numeric_limits<int64_t>::min();
+
+SnapshotWriter::SnapshotWriter(bool with_header) : section_start_(0) {
+    if (with_header) {
+        Append(kSnapshotMagic, sizeof(kSnapshotMagic));
+        WriteU32(kSnapshotVersion);
+    }
+}
+
+void SnapshotWriter::Append(const void* data, size_t size) {
+    buffer_.append(static_cast<const char*>(data), size);
+}
+
+void SnapshotWriter::BeginSection(SnapshotSection section) {
+    WriteU32(static_cast<uint32_t>(section));
+    section_start_ = buffer_.size();
+    WriteU64(0);    // Patched by EndSection()
+}
+
+void SnapshotWriter::EndSection() {
+    uint64_t length = buffer_.size() - section_start_ - sizeof(uint64_t);
+    std::memcpy(&buffer_[section_start_], &length, sizeof(length));
+}
+
+void SnapshotWriter::WriteU8(uint8_t value) {
+    buffer_.push_back(static_cast<char>(value));
+}
+
+void SnapshotWriter::WriteU16(uint16_t value) {
+    Append(&value, sizeof(value));
+}
+
+void SnapshotWriter::WriteU32(uint32_t value) {
+    Append(&value, sizeof(value));
+}
+
+void SnapshotWriter::WriteU64(uint64_t value) {
+    Append(&value, sizeof(value));
+}
+
+void SnapshotWriter::WriteDouble(double value) {
+    Append(&value, sizeof(value));
+}
+
+void SnapshotWriter::WriteString(const std::string& value) {
+    WriteU32(static_cast<uint32_t>(value.size()));
+    Append(value.data(), value.size());
+}
+
+void SnapshotWriter::WriteTimePoint(const TimePoint& value) {
+    int64_t nanoseconds = value == TimePoint::min() ? kMinTimePoint :
+        static_cast<int64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(
+            value.time_since_epoch()).count());
+    WriteU64(static_cast<uint64_t>(nanoseconds));
+}
+
+void SnapshotWriter::WriteSystemTime(const SYSTEMTIME& value) {
+    WriteU16(value.wYear);
+    WriteU16(value.wMonth);
+    WriteU16(value.wDayOfWeek);
+    WriteU16(value.wDay);
+    WriteU16(value.wHour);
+    WriteU16(value.wMinute);
+    WriteU16(value.wSecond);
+    WriteU16(value.wMilliseconds);
+}
+
+void SnapshotWriter::WriteEvent(const SecurityEvent& event) {
+    WriteU8(static_cast<uint8_t>(event.type));
+    WriteU8(static_cast<uint8_t>(event.threat_level));
+    WriteString(event.process_path);
+    WriteString(event.target_path);
+    WriteString(event.description);
+    WriteU32(static_cast<uint32_t>(event.process_id));
+    WriteU32(static_cast<uint32_t>(event.thread_id));
+    WriteSystemTime(event.timestamp);
+    WriteU32(static_cast<uint32_t>(event.metadata.size()));
+    for (const auto& [key, value] : event.metadata) {
+        WriteString(key);
+        WriteString(value);
+    }
+}
+
+void SnapshotWriter::WriteRaw(const std::string& bytes) {
+    buffer_.append(bytes);
+}
+
+void SnapshotWriter::WriteRaw(const char* data, size_t size) {
+    Append(data, size);
+}
+
+bool SnapshotWriter::WriteToFile(const std::string& path) const {
+    const std::string temp_path = path + ".tmp";
+
+    std::FILE* file = std::fopen(temp_path.c_str(), "wb");
+    if (file == nullptr) {
+        return false;
+    }
+
+    bool written = std::fwrite(buffer_.data(), 1, buffer_.size(), file) == buffer_.size();
+    written = std::fflush(file) == 0 && written;
+    written = std::fclose(file) == 0 && written;
+    if (!written) {
+        std::remove(temp_path.c_str());
+        return false;
+    }
+
+#ifdef _WIN32
+    if (!MoveFileExA(temp_path.c_str(), path.c_str(), MOVEFILE_REPLACE_EXISTING)) {
+#else
+    if (std::rename(temp_path.c_str(), path.c_str()) != 0) {
+#endif
+        std::remove(temp_path.c_str());
+        return false;
+    }
+    return true;
+}
+
+SnapshotReader::SnapshotReader()
+    : data_(nullptr), size_(0), offset_(0), failed_(false) {
+}
+
+SnapshotReader::SnapshotReader(const char* data, size_t size)
+    : data_(data), size_(size), offset_(0), failed_(false) {
+}
+
+bool SnapshotReader::Take(void* out, size_t size) {
+    if (failed_ || size > size_ - offset_) {
+        failed_ = true;
+        return false;
+    }
+    std::memcpy(out, data_ + offset_, size);
+    offset_ += size;
+    return true;
+}
+
+bool SnapshotReader::ValidateHeader() const {
+    if (size_ < kHeaderSize || std::memcmp(data_, kSnapshotMagic, sizeof(kSnapshotMagic)) != 0) {
+        return false;
+    }
+
+    uint32_t version;
+    std::memcpy(&version, data_ + sizeof(kSnapshotMagic), sizeof(version));
+    return version == kSnapshotVersion;
+}
+
+bool SnapshotReader::FindSection(SnapshotSection section, SnapshotReader& body) const {
+    if (!ValidateHeader()) {
+        return false;
+    }
+
+    size_t offset = kHeaderSize;
+    while (size_ - offset >= kSectionHeaderSize) {
+        uint32_t tag;
+        uint64_t length;
+        std::memcpy(&tag, data_ + offset, sizeof(tag));
+        std::memcpy(&length, data_ + offset + sizeof(tag), sizeof(length));
+        offset += kSectionHeaderSize;
+
+        if (length > size_ - offset) {
+            return false;   // Truncated
+        }
+        if (tag == static_cast<uint32_t>(section)) {
+            body = SnapshotReader(data_ + offset, static_cast<size_t>(length));
+            return true;
+        }
+        offset += static_cast<size_t>(length);
+    }
+    return false;
+}
+
+bool SnapshotReader::ReadU8(uint8_t& value) {
+    return Take(&value, sizeof(value));
+}
+
+bool SnapshotReader::ReadU16(uint16_t& value) {
+    return Take(&value, sizeof(value));
+}
+
+bool SnapshotReader::ReadU32(uint32_t& value) {
+    return Take(&value, sizeof(value));
+}
+
+bool SnapshotReader::ReadU64(uint64_t& value) {
+    return Take(&value, sizeof(value));
+}
+
+bool SnapshotReader::ReadDouble(double& value) {
+    return Take(&value, sizeof(value));
+}
+
+bool SnapshotReader::ReadString(std::string& value) {
+    uint32_t length;
+    if (!ReadU32(length)) {
+        return false;
+    }
+    if (length > size_ - offset_) {
+        failed_ = true;
+        return false;
+    }
+    value.assign(data_ + offset_, length);
+    offset_ += length;
+    return true;
+}
+
+bool SnapshotReader::ReadTimePoint(TimePoint& value) {
+    uint64_t raw;
+    if (!ReadU64(raw)) {
+        return false;
+    }
+
+    int64_t nanoseconds = static_cast<int64_t>(raw);
+    value = nanoseconds == kMinTimePoint ? TimePoint::min() :
+        TimePoint(std::chrono::duration_cast<TimePoint::duration>(std::chrono::nanoseconds(nanoseconds)));
+    return true;
+}
+
+bool SnapshotReader::ReadSystemTime(SYSTEMTIME& value) {
+    uint16_t fields[8];
+    if (!Take(fields, sizeof(fields))) {
+        return false;
+    }
+    value.wYear = fields[0];
+    value.wMonth = fields[1];
+    value.wDayOfWeek = fields[2];
+    value.wDay = fields[3];
+    value.wHour = fields[4];
+    value.wMinute = fields[5];
+    value.wSecond = fields[6];
+    value.wMilliseconds = fields[7];
+    return true;
+}
+
+bool SnapshotReader::ReadEvent(SecurityEvent& event) {
+    uint8_t type, threat_level;
+    uint32_t process_id, thread_id, metadata_count;
+    if (!ReadU8(type) || !ReadU8(threat_level) ||
+        !ReadString(event.process_path) || !ReadString(event.target_path) ||
+        !ReadString(event.description) ||
+        !ReadU32(process_id) || !ReadU32(thread_id) ||
+        !ReadSystemTime(event.timestamp) ||
+        !ReadCount(metadata_count, 2 * sizeof(uint32_t))) {
+        return false;
+    }
+
+    if (type > static_cast<uint8_t>(EventType::EXPLOIT_ATTEMPT) ||
+        threat_level > static_cast<uint8_t>(ThreatLevel::CRITICAL)) {
+        failed_ = true;
+        return false;
+    }
+
+    event.type = static_cast<EventType>(type);
+    event.threat_level = static_cast<ThreatLevel>(threat_level);
+    event.process_id = process_id;
+    event.thread_id = thread_id;
+
+    event.metadata.clear();
+    event.metadata.reserve(metadata_count);
+    for (uint32_t i = 0; i < metadata_count; ++i) {
+        std::string key, value;
+        if (!ReadString(key) || !ReadString(value)) {
+            return false;
+        }
+        event.metadata.emplace(std::move(key), std::move(value));
+    }
+    return true;
+}
+
+bool SnapshotReader::SkipString() {
+    uint32_t length;
+    if (!ReadU32(length)) {
+        return false;
+    }
+    if (length > size_ - offset_) {
+        failed_ = true;
+        return false;
+    }
+    offset_ += length;
+    return true;
+}
+
+bool SnapshotReader::SkipEvent(ThreatLevel& threat_level, DWORD& process_id) {
+    uint8_t type, level;
+    uint32_t pid, thread_id, metadata_count;
+    SYSTEMTIME timestamp;
+    if (!ReadU8(type) || !ReadU8(level) ||
+        !SkipString() || !SkipString() || !SkipString() ||
+        !ReadU32(pid) || !ReadU32(thread_id) ||
+        !ReadSystemTime(timestamp) ||
+        !ReadCount(metadata_count, 2 * sizeof(uint32_t))) {
+        return false;
+    }
+
+    if (type > static_cast<uint8_t>(EventType::EXPLOIT_ATTEMPT) ||
+        level > static_cast<uint8_t>(ThreatLevel::CRITICAL)) {
+        failed_ = true;
+        return false;
+    }
+
+    for (uint32_t i = 0; i < 2 * metadata_count; ++i) {
+        if (!SkipString()) {
+            return false;
+        }
+    }
+
+    threat_level = static_cast<ThreatLevel>(level);
+    process_id = pid;
+    return true;
+}
+
+bool SnapshotReader::ReadCount(uint32_t& count, size_t min_element_size) {
+    if (!ReadU32(count)) {
+        return false;
+    }
+    if (min_element_size != 0 && count > (size_ - offset_) / min_element_size) {
+        failed_ = true;
+        return false;
+    }
+    return true;
+}
+
+bool ArchivedEvents::Load(SnapshotReader& reader, uint32_t count) {
+    offsets_.reserve(count + 1);
+    threat_levels_.reserve(count);
+    process_ids_.reserve(count);
+
+    const char* start = reader.Position();
+    for (uint32_t i = 0; i < count; ++i) {
+        ThreatLevel threat_level;
+        DWORD process_id;
+        offsets_.push_back(static_cast<size_t>(reader.Position() - start));
+        if (!reader.SkipEvent(threat_level, process_id)) {
+            return false;
+        }
+        threat_levels_.push_back(threat_level);
+        process_ids_.push_back(process_id);
+    }
+    offsets_.push_back(static_cast<size_t>(reader.Position() - start));
+
+    data_.assign(start, offsets_.back());
+    return true;
+}
+
+EventRef ArchivedEvents::Get(uint32_t index) const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    EventRef& decoded = decoded_[index];
+    if (!decoded) {
+        // Validated by Load()
+        auto event = std::make_shared<SecurityEvent>();
+        SnapshotReader reader(data_.data() + offsets_[index], GetEncodedSize(index));
+        reader.ReadEvent(*event);
+        decoded = std::move(event);
+    }
+    return decoded;
+}
+
+void ArchivedEvents::WriteEvent(uint32_t index, SnapshotWriter& writer) const {
+    writer.WriteRaw(data_.data() + offsets_[index], GetEncodedSize(index));
+}
+
+#ifdef _WIN32
+
+MappedFile::MappedFile()
+    : data_(nullptr), size_(0), file_(INVALID_HANDLE_VALUE), mapping_(nullptr) {
+}
+
+bool MappedFile::Open(const std::string& path, bool sequential) {
+    Close();
+
+    file_ = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr,
+                        OPEN_EXISTING, sequential ? FILE_FLAG_SEQUENTIAL_SCAN : FILE_FLAG_RANDOM_ACCESS, nullptr);
+    if (file_ == INVALID_HANDLE_VALUE) {
+        return false;
+    }
+
+    LARGE_INTEGER size;
+    if (!GetFileSizeEx(file_, &size) || size.QuadPart == 0) {
+        Close();
+        return false;
+    }
+
+    mapping_ = CreateFileMappingA(file_, nullptr, PAGE_READONLY, 0, 0, nullptr);
+    if (mapping_ == nullptr) {
+        Close();
+        return false;
+    }
+
+    data_ = static_cast<const char*>(MapViewOfFile(mapping_, FILE_MAP_READ, 0, 0, 0));
+    if (data_ == nullptr) {
+        Close();
+        return false;
+    }
+    size_ = static_cast<size_t>(size.QuadPart);
+    return true;
+}
+
+void MappedFile::Close() {
+    if (data_ != nullptr) {
+        UnmapViewOfFile(data_);
+    }
+    if (mapping_ != nullptr) {
+        CloseHandle(mapping_);
+    }
+    if (file_ != INVALID_HANDLE_VALUE) {
+        CloseHandle(file_);
+    }
+    data_ = nullptr;
+    size_ = 0;
+    mapping_ = nullptr;
+    file_ = INVALID_HANDLE_VALUE;
+}
+
+#else
+
+MappedFile::MappedFile() : data_(nullptr), size_(0), fd_(-1) {
+}
+
+bool MappedFile::Open(const std::string& path, bool sequential) {
+    Close();
+
+    fd_ = ::open(path.c_str(), O_RDONLY);
+    if (fd_ < 0) {
+        return false;
+    }
+
+    struct stat info;
+    if (::fstat(fd_, &info) != 0 || info.st_size <= 0) {
+        Close();
+        return false;
+    }
+
+    void* mapped = ::mmap(nullptr, static_cast<size_t>(info.st_size), PROT_READ, MAP_PRIVATE, fd_, 0);
+    if (mapped == MAP_FAILED) {
+        Close();
+        return false;
+    }
+
+    // Restore reads the snapshot front to back exactly once; indexes only
+    // want the pages they probe
+    ::madvise(mapped, static_cast<size_t>(info.st_size), sequential ? MADV_SEQUENTIAL : MADV_RANDOM);
+
+    data_ = static_cast<const char*>(mapped);
+    size_ = static_cast<size_t>(info.st_size);
+    return true;
+}
+
+void MappedFile::Close() {
+    if (data_ != nullptr) {
+        ::munmap(const_cast<char*>(data_), size_);
+    }
+    if (fd_ >= 0) {
+        ::close(fd_);
+    }
+    data_ = nullptr;
+    size_ = 0;
+    fd_ = -1;
+}
+
+#endif
+
+MappedFile::~MappedFile() {
+    Close();
+}
+
+} // namespace HIPS
@@ -0,0 +1,89 @@
+/*
+ * Multi-Resolution Window Aggregates Implementation
+ */
+
+#include "window_aggregates.h"
+
+namespace HIPS {
+
+static int64_t ToMilliseconds(const std::chrono::system_clock::time_point& time) {
+    return std::chrono::duration_cast<std::chrono::milliseconds>(time.time_since_epoch()).count();
+}
+
+// Floor division, so times before the epoch still fall into whole buckets
+static int64_t BucketOf(int64_t ms, int64_t bucket_ms) {
+    return ms >= 0 ? ms / bucket_ms : -((-ms + bucket_ms - 1) / bucket_ms);
+}
+
+static size_t SlotOf(int64_t index, size_t slots) {
+    int64_t slot = index % static_cast<int64_t>(slots);
+    return static_cast<size_t>(slot < 0 ? slot + static_cast<int64_t>(slots) : slot);
+}
+
+void MultiResolutionWindow::Add(const time_point& time, ThreatLevel level) {
+    const int64_t ms = ToMilliseconds(time);
+    const int64_t index = BucketOf(ms, kFineBucketMs);
+
+    // Older than the fine ring: straight into its coarse bucket
+    if (newest_fine_ != INT64_MIN && index <= newest_fine_ - static_cast<int64_t>(kFineBuckets)) {
+        ThreatCounts counts;
+        counts.Add(level);
+        AddCoarse(BucketOf(ms, kCoarseBucketMs), counts);
+        return;
+    }
+
+    // A slot still holding an older second is rolled up before reuse, so
+    // fine and coarse buckets never count the same event
+    Bucket& bucket = fine_[SlotOf(index, kFineBuckets)];
+    if (bucket.index != index) {
+        if (bucket.index != INT64_MIN) {
+            AddCoarse(BucketOf(bucket.index * kFineBucketMs, kCoarseBucketMs), bucket.counts);
+        }
+        bucket.index = index;
+        bucket.counts = ThreatCounts();
+    }
+    bucket.counts.Add(level);
+
+    if (index > newest_fine_) {
+        newest_fine_ = index;
+    }
+}
+
+void MultiResolutionWindow::AddCoarse(int64_t index, const ThreatCounts& counts) {
+    Bucket& bucket = coarse_[SlotOf(index, kCoarseBuckets)];
+    if (bucket.index == index) {
+        bucket.counts.Merge(counts);
+    } else if (bucket.index < index) {
+        bucket.index = index;
+        bucket.counts = counts;
+    }
+    // Otherwise the slot holds a newer minute and the counts are past the horizon
+}
+
+ThreatCounts MultiResolutionWindow::Count(const time_point& now, std::chrono::milliseconds window) const {
+    const int64_t end = ToMilliseconds(now);
+    const int64_t start = end - window.count();
+
+    ThreatCounts counts;
+    for (const auto& bucket : fine_) {
+        if (bucket.index != INT64_MIN &&
+            (bucket.index + 1) * kFineBucketMs > start && bucket.index * kFineBucketMs <= end) {
+            counts.Merge(bucket.counts);
+        }
+    }
+    for (const auto& bucket : coarse_) {
+        if (bucket.index != INT64_MIN &&
+            (bucket.index + 1) * kCoarseBucketMs > start && bucket.index * kCoarseBucketMs <= end) {
+            counts.Merge(bucket.counts);
+        }
+    }
+    return counts;
+}
+
+void MultiResolutionWindow::Clear() {
+    fine_.fill(Bucket());
+    coarse_.fill(Bucket());
+    newest_fine_ = INT64_MIN;
+}
+
+} // namespace HIPS
@@ -0,0 +1,110 @@
+/*
+ * Worker Pool Implementation
+ */
+
+#include "worker_pool.h"
+#include <algorithm>
+#include <atomic>
+
+namespace HIPS {
+
+WorkerPool::WorkerPool(size_t thread_count) : stopping_(false) {
+    if (thread_count == 0) {
+        thread_count = std::max<size_t>(std::thread::hardware_concurrency(), 1);
+    }
+
+    threads_.reserve(thread_count);
+    for (size_t i = 0; i < thread_count; ++i) {
+        threads_.emplace_back(&WorkerPool::WorkerThreadFunction, this);
+    }
+}
+
+WorkerPool::~WorkerPool() {
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        stopping_ = true;
+    }
+    queue_cv_.notify_all();
+
+    for (auto& thread : threads_) {
+        thread.join();
+    }
+}
+
+void WorkerPool::Submit(std::function<void()> task) {
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        queue_.push_back(std::move(task));
+    }
+    queue_cv_.notify_one();
+}
+
+void WorkerPool::RunAll(const std::vector<std::function<void()>>& tasks) {
+    if (tasks.empty()) {
+        return;
+    }
+
+    // Workers and the caller claim tasks from a shared index; a helper that
+    // starts after every task is claimed returns immediately
+    struct Batch {
+        const std::vector<std::function<void()>>* tasks;
+        size_t count;
+        std::atomic<size_t> next{0};
+        size_t remaining;
+        std::mutex mutex;
+        std::condition_variable done_cv;
+    };
+    auto batch = std::make_shared<Batch>();
+    batch->tasks = &tasks;
+    batch->count = tasks.size();
+    batch->remaining = tasks.size();
+
+    auto run = [batch]() {
+        size_t finished = 0;
+        for (size_t index = batch->next++; index < batch->count; index = batch->next++) {
+            (*batch->tasks)[index]();
+            finished++;
+        }
+        if (finished > 0) {
+            std::lock_guard<std::mutex> lock(batch->mutex);
+            batch->remaining -= finished;
+            if (batch->remaining == 0) {
+                batch->done_cv.notify_all();
+            }
+        }
+    };
+
+    const size_t helpers = std::min(tasks.size() - 1, threads_.size());
+    for (size_t i = 0; i < helpers; ++i) {
+        Submit(run);
+    }
+    run();
+
+    // tasks outlives every claim: helpers only touch it after claiming an
+    // index, and all claimed tasks finish before remaining reaches zero
+    std::unique_lock<std::mutex> lock(batch->mutex);
+    batch->done_cv.wait(lock, [&batch]() { return batch->remaining == 0; });
+}
+
+std::shared_ptr<WorkerPool> WorkerPool::Shared() {
+    static std::shared_ptr<WorkerPool> pool = std::make_shared<WorkerPool>();
+    return pool;
+}
+
+void WorkerPool::WorkerThreadFunction() {
+    for (;;) {
+        std::function<void()> task;
+        {
+            std::unique_lock<std::mutex> lock(mutex_);
+            queue_cv_.wait(lock, [this]() { return stopping_ || !queue_.empty(); });
+            if (queue_.empty()) {
+                return;
+            }
+            task = std::move(queue_.front());
+            queue_.pop_front();
+        }
+        task();
+    }
+}
+
+} // namespace HIPS
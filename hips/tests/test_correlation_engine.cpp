@@ -1,7 +1,10 @@
 #include <gtest/gtest.h>
 #include "correlation_engine.h"
 #include <thread>
+#include <vector>
+#include <algorithm>
 #include <chrono>
+#include <cstdio>
 
 using namespace HIPS;
 
@@ -123,6 +126,57 @@ TEST_F(CorrelationEngineTest, ProcessBasedCorrelationTest) {
     EXPECT_TRUE(found_process_correlation);
 }
 
+TEST_F(CorrelationEngineTest, ProcessScoreAndThreatLevelTest) {
+    CorrelationConfig config;
+    config.min_events_for_correlation = 3;
+    config.min_correlation_score = 0.0;
+    config.enable_time_correlation = false;
+    config.enable_target_correlation = false;
+    config.enable_sequence_correlation = false;
+    config.enable_threat_escalation = false;
+    config.enable_lineage_correlation = false;
+    
+    struct Mix {
+        std::vector<ThreatLevel> levels;
+        double score;
+        ThreatLevel combined;
+    };
+    const ThreatLevel L = ThreatLevel::LOW, M = ThreatLevel::MEDIUM;
+    const ThreatLevel H = ThreatLevel::HIGH, C = ThreatLevel::CRITICAL;
+    // Score: min(total / 10, 0.3) + 0.4 * high share + 0.2 for one process
+    const Mix mixes[] = {
+        {{L, L, L}, 0.5, L},
+        {{L, M, H}, 0.3 + 0.4 / 3 + 0.2, H},
+        {{H, H, L, L}, 0.7, H},
+        {{M, M, M, M, M}, 0.5, H},              // Five events raise the highest level
+        {{L, M, H, L, L}, 0.58, C},
+        {{H, H, H}, 0.9, C},                    // Three high
+        {{C, H, H}, 0.9, C},
+        {{C, L, M}, 0.3 + 0.4 / 3 + 0.2, C},
+    };
+    
+    for (const Mix& mix : mixes) {
+        EXPECT_TRUE(engine->Initialize(config));
+        for (ThreatLevel level : mix.levels) {
+            SecurityEvent event = event1;
+            event.threat_level = level;
+            engine->ProcessEvent(event);
+        }
+        
+        // The group over every event of the mix
+        const CorrelatedEventGroup* full = nullptr;
+        auto correlations = engine->GetActiveCorrelations();
+        for (const auto& group : correlations) {
+            if (group.type == CorrelationType::PROCESS_BASED && group.events.size() == mix.levels.size()) {
+                full = &group;
+            }
+        }
+        ASSERT_NE(full, nullptr);
+        EXPECT_NEAR(full->correlation_score, mix.score, 1e-9);
+        EXPECT_EQ(full->combined_threat_level, mix.combined);
+    }
+}
+
 TEST_F(CorrelationEngineTest, TargetBasedCorrelationTest) {
     CorrelationConfig config;
     config.min_events_for_correlation = 2;
@@ -204,6 +258,49 @@ TEST_F(CorrelationEngineTest, ThreatEscalationTest) {
     EXPECT_TRUE(found_escalation);
 }
 
+TEST_F(CorrelationEngineTest, EscalationStepsLeaveWithTrimmedEventsTest) {
+    CorrelationConfig config;
+    config.min_events_for_correlation = 2;
+    config.max_events_per_process = 4;
+    config.enable_process_correlation = false;
+    config.enable_target_correlation = false;
+    config.enable_time_correlation = false;
+    config.enable_sequence_correlation = false;
+    config.enable_lineage_correlation = false;
+    EXPECT_TRUE(engine->Initialize(config));
+    
+    SecurityEvent event = event1;
+    event.threat_level = ThreatLevel::MEDIUM;
+    engine->ProcessEvent(event);
+    event.threat_level = ThreatLevel::HIGH;
+    engine->ProcessEvent(event);
+    
+    auto correlations = engine->GetActiveCorrelations();
+    ASSERT_EQ(correlations.size(), 1);
+    EXPECT_EQ(correlations[0].type, CorrelationType::THREAT_ESCALATION);
+    EXPECT_EQ(correlations[0].metadata.at("escalation_steps"), "2");
+    EXPECT_EQ(correlations[0].metadata.at("current_threat_level"),
+              std::to_string(static_cast<int>(ThreatLevel::HIGH)));
+    
+    // Push both escalation steps out of the per-process window
+    event.threat_level = ThreatLevel::LOW;
+    for (int i = 0; i < 4; ++i) {
+        engine->ProcessEvent(event);
+    }
+    
+    // A single new step is not enough to escalate again
+    event.threat_level = ThreatLevel::MEDIUM;
+    engine->ProcessEvent(event);
+    EXPECT_EQ(engine->GetCorrelationCount(), 1);
+    
+    event.threat_level = ThreatLevel::HIGH;
+    engine->ProcessEvent(event);
+    event.threat_level = ThreatLevel::CRITICAL;
+    engine->ProcessEvent(event);
+    EXPECT_EQ(engine->GetCorrelationCount(), 2);
+    EXPECT_EQ(engine->GetActiveCorrelations().back().metadata.at("escalation_steps"), "3");
+}
+
 TEST_F(CorrelationEngineTest, SequenceBasedCorrelationTest) {
     CorrelationConfig config;
     config.min_events_for_correlation = 3;
@@ -321,13 +418,15 @@ TEST_F(CorrelationEngineTest, TimeWindowTest) {
     config.min_events_for_correlation = 2;
     config.min_correlation_score = 0.5;
     
+    auto clock = std::make_shared<SimulatedClock>();
+    engine->SetClock(clock);
     EXPECT_TRUE(engine->Initialize(config));
     
     // Process first event
     engine->ProcessEvent(event1);
     
-    // Wait longer than time window
-    std::this_thread::sleep_for(std::chrono::seconds(3));
+    // Move past the time window
+    clock->Advance(std::chrono::seconds(3));
     
     // Process second event - should NOT correlate due to time window
     engine->ProcessEvent(event2);
@@ -372,6 +471,1321 @@ TEST_F(CorrelationEngineTest, MultipleProcessesTest) {
     EXPECT_GE(correlations.size(), 1);
 }
 
+TEST_F(CorrelationEngineTest, SequenceOrderMattersTest) {
+    CorrelationConfig config;
+    config.enable_process_correlation = false;
+    config.enable_time_correlation = false;
+    config.enable_target_correlation = false;
+    config.enable_threat_escalation = false;
+    
+    EXPECT_TRUE(engine->Initialize(config));
+    
+    // Registry -> File -> Process creation is the persistence chain reversed
+    engine->ProcessEvent(event3);
+    engine->ProcessEvent(event2);
+    engine->ProcessEvent(event1);
+    
+    for (const auto& corr : engine->GetActiveCorrelations()) {
+        EXPECT_NE(corr.type, CorrelationType::SEQUENCE_BASED);
+    }
+}
+
+TEST_F(CorrelationEngineTest, SequenceRequiresSameLineageTest) {
+    CorrelationConfig config;
+    config.enable_process_correlation = false;
+    config.enable_time_correlation = false;
+    config.enable_target_correlation = false;
+    config.enable_threat_escalation = false;
+    
+    EXPECT_TRUE(engine->Initialize(config));
+    
+    // Unrelated processes do not complete the chain
+    SecurityEvent unrelated_file = event2;
+    unrelated_file.process_id = 4321;
+    SecurityEvent unrelated_reg = event3;
+    unrelated_reg.process_id = 4321;
+    
+    engine->ProcessEvent(event1);
+    engine->ProcessEvent(unrelated_file);
+    engine->ProcessEvent(unrelated_reg);
+    EXPECT_EQ(engine->GetActiveCorrelationCount(), 0);
+    
+    // A child spawned by the dropper does
+    SecurityEvent child_creation = event1;
+    child_creation.process_id = 5555;
+    child_creation.metadata["parent_pid"] = "1234";
+    SecurityEvent child_file = event2;
+    child_file.process_id = 5555;
+    SecurityEvent child_reg = event3;
+    child_reg.process_id = 5555;
+    
+    engine->ProcessEvent(child_creation);
+    engine->ProcessEvent(child_file);
+    engine->ProcessEvent(child_reg);
+    
+    bool found_sequence = false;
+    for (const auto& corr : engine->GetActiveCorrelations()) {
+        if (corr.type == CorrelationType::SEQUENCE_BASED) {
+            found_sequence = true;
+            EXPECT_EQ(corr.metadata.at("pattern_name"), "multi_stage_persistence");
+            EXPECT_EQ(corr.events.size(), 3);
+        }
+    }
+    EXPECT_TRUE(found_sequence);
+}
+
+TEST_F(CorrelationEngineTest, CustomAttackPatternTest) {
+    CorrelationConfig config;
+    config.enable_process_correlation = false;
+    config.enable_time_correlation = false;
+    config.enable_target_correlation = false;
+    config.enable_threat_escalation = false;
+    
+    AttackPattern pattern;
+    pattern.name = "run_key_after_network";
+    pattern.description = "Autostart entry after outbound connection";
+    pattern.scope = PatternScope::SAME_PROCESS;
+    pattern.threat_level = ThreatLevel::HIGH;
+    pattern.steps.resize(2);
+    pattern.steps[0].event_types = {EventType::NETWORK_CONNECTION};
+    pattern.steps[1].event_types = {EventType::REGISTRY_MODIFICATION};
+    pattern.steps[1].target_pattern = "currentversion\\run";
+    pattern.steps[1].min_threat_level = ThreatLevel::HIGH;
+    config.attack_patterns = {pattern};
+    
+    EXPECT_TRUE(engine->Initialize(config));
+    
+    SecurityEvent connection = event1;
+    connection.type = EventType::NETWORK_CONNECTION;
+    
+    SecurityEvent other_key = event3;
+    other_key.target_path = "HKLM\\Software\\Vendor";
+    
+    engine->ProcessEvent(connection);
+    engine->ProcessEvent(other_key);
+    EXPECT_EQ(engine->GetActiveCorrelationCount(), 0);
+    EXPECT_EQ(engine->GetPartialMatchCount(), 1);
+    
+    engine->ProcessEvent(event3);
+    
+    auto correlations = engine->GetActiveCorrelations();
+    ASSERT_EQ(correlations.size(), 1);
+    EXPECT_EQ(correlations[0].type, CorrelationType::SEQUENCE_BASED);
+    EXPECT_EQ(correlations[0].combined_threat_level, ThreatLevel::HIGH);
+    EXPECT_EQ(engine->GetPartialMatchCount(), 0);
+}
+
+TEST_F(CorrelationEngineTest, ConcurrentProducersTest) {
+    CorrelationConfig config;
+    config.shard_count = 4;
+    EXPECT_TRUE(engine->Initialize(config));
+    
+    const int kThreads = 4;
+    const int kEventsPerThread = 500;
+    std::vector<std::thread> producers;
+    for (int t = 0; t < kThreads; ++t) {
+        producers.emplace_back([this, t]() {
+            SecurityEvent event = event2;
+            for (int i = 0; i < kEventsPerThread; ++i) {
+                event.process_id = static_cast<DWORD>(1000 + t * 100 + i % 10);
+                event.target_path = "C:\\test\\file" + std::to_string(i % 20) + ".dll";
+                engine->ProcessEvent(event);
+            }
+        });
+    }
+    for (auto& producer : producers) {
+        producer.join();
+    }
+    
+    EXPECT_EQ(engine->GetProcessedEventCount(), kThreads * kEventsPerThread);
+    EXPECT_GT(engine->GetCorrelationCount(), 0);
+    EXPECT_LE(engine->GetActiveCorrelationCount(), config.max_correlation_groups);
+}
+
+TEST_F(CorrelationEngineTest, CallbackMayQueryEngineTest) {
+    CorrelationConfig config;
+    config.min_correlation_score = 0.5;
+    EXPECT_TRUE(engine->Initialize(config));
+    
+    uint64_t observed_active = 0;
+    engine->RegisterCorrelationCallback([this, &observed_active](const CorrelatedEventGroup&) {
+        // Re-entering the engine from the callback must not deadlock
+        observed_active = engine->GetActiveCorrelationCount();
+        engine->GetActiveCorrelations();
+    });
+    
+    engine->ProcessEvent(event1);
+    engine->ProcessEvent(event2);
+    engine->ProcessEvent(event3);
+    
+    EXPECT_GT(observed_active, 0);
+}
+
+TEST_F(CorrelationEngineTest, MemoryBudgetEvictsLeastRecentlyUsedTest) {
+    CorrelationConfig config;
+    config.shard_count = 1;
+    config.max_tracked_memory_bytes = 64 * 1024;
+    EXPECT_TRUE(engine->Initialize(config));
+    
+    SecurityEvent event = event1;
+    for (int i = 0; i < 5000; ++i) {
+        event.target_path = "C:\\unique\\file" + std::to_string(i) + ".tmp";
+        engine->ProcessEvent(event);
+    }
+    
+    EXPECT_GT(engine->GetBudgetEvictionCount(), 0);
+    EXPECT_LE(engine->GetTrackedMemoryBytes(), config.max_tracked_memory_bytes);
+    EXPECT_LT(engine->GetTrackedKeyCount(), 5000);
+}
+
+TEST_F(CorrelationEngineTest, IdleKeysExpireTest) {
+    CorrelationConfig config;
+    config.key_idle_timeout_seconds = 1;
+    config.max_tracked_memory_bytes = 0;
+    auto clock = std::make_shared<SimulatedClock>();
+    engine->SetClock(clock);
+    EXPECT_TRUE(engine->Initialize(config));
+    
+    engine->ProcessEvent(event2);
+    EXPECT_EQ(engine->GetTrackedKeyCount(), 2);
+    
+    clock->Advance(std::chrono::milliseconds(3100));
+    engine->DetectCorrelations();
+    
+    EXPECT_EQ(engine->GetTrackedKeyCount(), 0);
+    EXPECT_EQ(engine->GetIdleEvictionCount(), 2);
+    EXPECT_EQ(engine->GetBudgetEvictionCount(), 0);
+}
+
+TEST_F(CorrelationEngineTest, LineageBasedCorrelationTest) {
+    CorrelationConfig config;
+    config.enable_process_correlation = false;
+    config.enable_sequence_correlation = false;
+    config.enable_threat_escalation = false;
+    config.enable_time_correlation = false;
+    config.enable_target_correlation = false;
+    EXPECT_TRUE(engine->Initialize(config));
+    
+    // Dropper 7000 spawns 7001, which performs the persistence write
+    SecurityEvent spawn = event1;
+    spawn.process_id = 7001;
+    spawn.metadata["parent_pid"] = "7000";
+    
+    SecurityEvent dropper_write = event2;
+    dropper_write.process_id = 7000;
+    
+    SecurityEvent child_write = event3;
+    child_write.process_id = 7001;
+    
+    engine->ProcessEvent(spawn);
+    engine->ProcessEvent(dropper_write);
+    engine->ProcessEvent(child_write);
+    
+    auto correlations = engine->GetActiveCorrelations();
+    auto it = std::find_if(correlations.begin(), correlations.end(), [](const CorrelatedEventGroup& group) {
+        return group.type == CorrelationType::LINEAGE_BASED;
+    });
+    ASSERT_NE(it, correlations.end());
+    EXPECT_EQ(it->metadata.at("root_process_id"), "7000");
+    EXPECT_EQ(it->metadata.at("process_count"), "2");
+    EXPECT_EQ(engine->GetLineageProcessCount(), 2);
+}
+
+TEST_F(CorrelationEngineTest, UnrelatedProcessesNotLineageCorrelatedTest) {
+    CorrelationConfig config;
+    config.enable_process_correlation = false;
+    config.enable_sequence_correlation = false;
+    config.enable_threat_escalation = false;
+    EXPECT_TRUE(engine->Initialize(config));
+    
+    SecurityEvent spawn = event1;
+    spawn.process_id = 7101;
+    spawn.metadata["parent_pid"] = "7100";
+    
+    SecurityEvent unrelated = event2;
+    unrelated.process_id = 7200;
+    
+    engine->ProcessEvent(spawn);
+    engine->ProcessEvent(unrelated);
+    engine->ProcessEvent(unrelated);
+    engine->ProcessEvent(event3);
+    
+    for (const auto& group : engine->GetActiveCorrelations()) {
+        EXPECT_NE(group.type, CorrelationType::LINEAGE_BASED);
+    }
+}
+
+TEST_F(CorrelationEngineTest, ReadCorrelationsCursorTest) {
+    CorrelationConfig config;
+    config.min_correlation_score = 0.5;
+    EXPECT_TRUE(engine->Initialize(config));
+    
+    engine->ProcessEvent(event1);
+    engine->ProcessEvent(event2);
+    engine->ProcessEvent(event3);
+    
+    uint64_t cursor = 0;
+    std::vector<CorrelationGroupPtr> groups;
+    size_t first_read = engine->ReadCorrelations(cursor, 1000, groups);
+    EXPECT_GT(first_read, 0);
+    EXPECT_EQ(first_read, engine->GetActiveCorrelationCount());
+    
+    // Nothing new since the last read
+    groups.clear();
+    EXPECT_EQ(engine->ReadCorrelations(cursor, 1000, groups), 0);
+    
+    // Readers share the stored group rather than copying it
+    size_t visited = 0;
+    engine->ForEachActiveCorrelation([&visited](const CorrelatedEventGroup& group) {
+        EXPECT_EQ(group.summary.event_count, group.events.size());
+        visited++;
+    });
+    EXPECT_EQ(visited, first_read);
+}
+
+TEST_F(CorrelationEngineTest, CorrelationMemoryBudgetTest) {
+    CorrelationConfig config;
+    config.max_correlation_memory_bytes = 32 * 1024;
+    config.enable_sequence_correlation = false;
+    EXPECT_TRUE(engine->Initialize(config));
+    
+    SecurityEvent event = event2;
+    for (DWORD pid = 1; pid <= 200; ++pid) {
+        event.process_id = pid;
+        event.target_path = "C:\\budget\\" + std::to_string(pid);
+        for (int i = 0; i < 3; ++i) {
+            engine->ProcessEvent(event);
+        }
+    }
+    
+    EXPECT_GT(engine->GetEvictedCorrelationCount(), 0);
+    EXPECT_LE(engine->GetCorrelationMemoryBytes(), config.max_correlation_memory_bytes);
+}
+
+TEST_F(CorrelationEngineTest, StateSnapshotRoundTripTest) {
+    CorrelationConfig config;
+    config.enable_sequence_correlation = false;
+    config.enable_time_correlation = false;
+    EXPECT_TRUE(engine->Initialize(config));
+    
+    SecurityEvent spawn = event1;
+    spawn.process_id = 1234;
+    spawn.metadata["parent_pid"] = "1000";
+    engine->ProcessEvent(spawn);
+    engine->ProcessEvent(event2);
+    
+    SnapshotWriter writer;
+    engine->SaveState(writer);
+    
+    CorrelationEngine restored;
+    EXPECT_TRUE(restored.Initialize(config));
+    EXPECT_TRUE(restored.RestoreState(SnapshotReader(writer.Data().data(), writer.Size())));
+    EXPECT_EQ(restored.GetProcessedEventCount(), 2);
+    EXPECT_EQ(restored.GetTrackedKeyCount(), engine->GetTrackedKeyCount());
+    EXPECT_EQ(restored.GetLineageProcessCount(), 2);
+    EXPECT_EQ(restored.GetActiveCorrelationCount(), 0);
+    
+    // The restored window continues where the original left off
+    restored.ProcessEvent(event3);
+    auto correlations = restored.GetActiveCorrelations();
+    auto it = std::find_if(correlations.begin(), correlations.end(), [](const CorrelatedEventGroup& group) {
+        return group.type == CorrelationType::PROCESS_BASED;
+    });
+    ASSERT_NE(it, correlations.end());
+    EXPECT_EQ(it->events.size(), 3);
+    EXPECT_EQ(it->events[1].target_path, event2.target_path);
+    
+    // Groups survive a second round trip without being re-reported
+    SnapshotWriter second;
+    restored.SaveState(second);
+    int callbacks = 0;
+    CorrelationEngine again;
+    EXPECT_TRUE(again.Initialize(config));
+    again.RegisterCorrelationCallback([&callbacks](const CorrelatedEventGroup&) { callbacks++; });
+    EXPECT_TRUE(again.RestoreState(SnapshotReader(second.Data().data(), second.Size())));
+    EXPECT_EQ(again.GetActiveCorrelationCount(), restored.GetActiveCorrelationCount());
+    EXPECT_EQ(again.GetCorrelationCount(), restored.GetCorrelationCount());
+    EXPECT_EQ(callbacks, 0);
+}
+
+TEST_F(CorrelationEngineTest, StateSnapshotArchivedEventsTest) {
+    SnapshotWriter writer(false);
+    SecurityEvent tagged = event1;
+    tagged.metadata["parent_pid"] = "1000";
+    writer.WriteEvent(tagged);
+    writer.WriteEvent(event2);
+    
+    // Validated up front, decoded once on first use
+    ArchivedEvents archived;
+    SnapshotReader reader(writer.Data().data(), writer.Size());
+    ASSERT_TRUE(archived.Load(reader, 2));
+    EXPECT_TRUE(reader.AtEnd());
+    EXPECT_EQ(archived.GetThreatLevel(1), ThreatLevel::HIGH);
+    EXPECT_EQ(archived.GetProcessId(0), 1234);
+    EventRef first = archived.Get(0);
+    EXPECT_EQ(first.get(), archived.Get(0).get());
+    EXPECT_EQ(first->metadata.at("parent_pid"), "1000");
+    EXPECT_EQ(archived.Get(1)->target_path, event2.target_path);
+    
+    std::string damaged = writer.Data();
+    damaged[0] = static_cast<char>(EventType::EXPLOIT_ATTEMPT) + 1;
+    ArchivedEvents rejected;
+    SnapshotReader damaged_reader(damaged.data(), damaged.size());
+    EXPECT_FALSE(rejected.Load(damaged_reader, 2));
+    
+    // Restored events that were never decoded are saved again unchanged
+    CorrelationConfig config;
+    config.enable_sequence_correlation = false;
+    config.enable_time_correlation = false;
+    EXPECT_TRUE(engine->Initialize(config));
+    engine->ProcessEvent(tagged);
+    engine->ProcessEvent(event2);
+    SnapshotWriter first_snapshot;
+    engine->SaveState(first_snapshot);
+    
+    CorrelationEngine restored;
+    EXPECT_TRUE(restored.Initialize(config));
+    EXPECT_TRUE(restored.RestoreState(SnapshotReader(first_snapshot.Data().data(), first_snapshot.Size())));
+    SnapshotWriter second_snapshot;
+    restored.SaveState(second_snapshot);
+    EXPECT_EQ(second_snapshot.Size(), first_snapshot.Size());
+    
+    CorrelationEngine again;
+    EXPECT_TRUE(again.Initialize(config));
+    EXPECT_TRUE(again.RestoreState(SnapshotReader(second_snapshot.Data().data(), second_snapshot.Size())));
+    again.ProcessEvent(event3);
+    auto correlations = again.GetActiveCorrelations();
+    auto it = std::find_if(correlations.begin(), correlations.end(), [](const CorrelatedEventGroup& group) {
+        return group.type == CorrelationType::PROCESS_BASED;
+    });
+    ASSERT_NE(it, correlations.end());
+    ASSERT_EQ(it->events.size(), 3);
+    EXPECT_EQ(it->events[0].metadata.at("parent_pid"), "1000");
+    EXPECT_EQ(it->events[1].target_path, event2.target_path);
+    EXPECT_EQ(it->events[2].description, event3.description);
+}
+
+TEST_F(CorrelationEngineTest, StateSnapshotFileAndVersionTest) {
+    EXPECT_TRUE(engine->Initialize());
+    engine->ProcessEvent(event2);
+    
+    const std::string path = ::testing::TempDir() + "hips_correlation_test.snapshot";
+    SnapshotWriter writer;
+    engine->SaveState(writer);
+    ASSERT_TRUE(writer.WriteToFile(path));
+    
+    {
+        MappedFile file;
+        ASSERT_TRUE(file.Open(path));
+        ASSERT_EQ(file.Size(), writer.Size());
+        
+        CorrelationEngine restored;
+        EXPECT_TRUE(restored.Initialize());
+        EXPECT_TRUE(restored.RestoreState(SnapshotReader(file.Data(), file.Size())));
+        EXPECT_EQ(restored.GetTrackedKeyCount(), 2);
+    }
+    std::remove(path.c_str());
+    
+    // Another format version is rejected and leaves the engine empty
+    std::string data = writer.Data();
+    data[8] = static_cast<char>(kSnapshotVersion + 1);
+    EXPECT_FALSE(engine->RestoreState(SnapshotReader(data.data(), data.size())));
+    EXPECT_EQ(engine->GetTrackedKeyCount(), 0);
+    
+    // Truncated data fails cleanly
+    data = writer.Data().substr(0, writer.Size() - 5);
+    EXPECT_FALSE(engine->RestoreState(SnapshotReader(data.data(), data.size())));
+    EXPECT_EQ(engine->GetTrackedKeyCount(), 0);
+}
+
+TEST_F(CorrelationEngineTest, TopTargetsAndProcessesTest) {
+    CorrelationConfig config;
+    config.shard_count = 4;
+    config.heavy_hitter_count = 8;
+    EXPECT_TRUE(engine->Initialize(config));
+    
+    // One file touched by 20 processes among many cold files
+    for (DWORD pid = 1; pid <= 20; ++pid) {
+        SecurityEvent hot = event2;
+        hot.process_id = 1000 + pid;
+        hot.target_path = "C:\\shared\\hot.dll";
+        engine->ProcessEvent(hot);
+    }
+    for (int i = 0; i < 200; ++i) {
+        SecurityEvent cold = event2;
+        cold.process_id = 7;
+        cold.target_path = "C:\\cold\\" + std::to_string(i) + ".txt";
+        engine->ProcessEvent(cold);
+    }
+    
+    auto targets = engine->GetTopTargets(3);
+    ASSERT_EQ(targets.size(), 3);
+    EXPECT_EQ(targets[0].target, "C:\\shared\\hot.dll");
+    EXPECT_GE(targets[0].estimated_events, 20);
+    EXPECT_LE(targets[0].guaranteed_events, 20);
+    EXPECT_GE(targets[0].distinct_processes, 17);
+    EXPECT_LE(targets[0].distinct_processes, 23);
+    
+    auto processes = engine->GetTopProcesses(1);
+    ASSERT_EQ(processes.size(), 1);
+    EXPECT_EQ(processes[0].process_id, 7);
+    EXPECT_EQ(processes[0].estimated_events, 200);
+    
+    // Sketches are bounded per shard
+    EXPECT_LE(engine->GetTopTargets(1000).size(), 4 * 8);
+}
+
+TEST_F(CorrelationEngineTest, TopProcessesAgeWithoutIngestTest) {
+    CorrelationConfig config;
+    config.shard_count = 1;
+    config.enable_time_correlation = false;
+    auto clock = std::make_shared<SimulatedClock>();
+    engine->SetClock(clock);
+    EXPECT_TRUE(engine->Initialize(config));
+    
+    SecurityEvent event = event2;
+    event.process_id = 7;
+    for (int i = 0; i < 8; ++i) {
+        engine->ProcessEvent(event);
+    }
+    
+    // Readers report the aged counts and leave the sketches alone, so
+    // reading twice does not age them twice
+    clock->Advance(std::chrono::seconds(config.time_window_seconds));
+    for (int read = 0; read < 2; ++read) {
+        auto processes = engine->GetTopProcesses(1);
+        ASSERT_EQ(processes.size(), 1);
+        EXPECT_EQ(processes[0].estimated_events, 4);
+    }
+    
+    engine->ProcessEvent(event);
+    auto processes = engine->GetTopProcesses(1);
+    ASSERT_EQ(processes.size(), 1);
+    EXPECT_EQ(processes[0].estimated_events, 5);
+}
+
+TEST_F(CorrelationEngineTest, HeavyHitterCountChangesAtRuntimeTest) {
+    CorrelationConfig config;
+    config.shard_count = 1;
+    config.enable_time_correlation = false;
+    config.heavy_hitter_count = 2;
+    EXPECT_TRUE(engine->Initialize(config));
+    
+    auto send = [this](DWORD pid, int count) {
+        SecurityEvent event = event2;
+        event.process_id = pid;
+        for (int i = 0; i < count; ++i) {
+            engine->ProcessEvent(event);
+        }
+    };
+    send(1, 30);
+    send(2, 20);
+    EXPECT_EQ(engine->GetTopProcesses(10).size(), 2);
+    
+    // Growing keeps the monitored keys and makes room for more
+    config.heavy_hitter_count = 4;
+    engine->SetConfiguration(config);
+    send(3, 10);
+    send(4, 5);
+    auto processes = engine->GetTopProcesses(10);
+    ASSERT_EQ(processes.size(), 4);
+    EXPECT_EQ(processes[0].process_id, 1);
+    EXPECT_EQ(processes[0].estimated_events, 30);
+    
+    // Shrinking keeps the most frequent
+    config.heavy_hitter_count = 1;
+    engine->SetConfiguration(config);
+    processes = engine->GetTopProcesses(10);
+    ASSERT_EQ(processes.size(), 1);
+    EXPECT_EQ(processes[0].process_id, 1);
+    EXPECT_EQ(processes[0].estimated_events, 30);
+    
+    config.heavy_hitter_count = 0;
+    engine->SetConfiguration(config);
+    send(1, 1);
+    EXPECT_TRUE(engine->GetTopProcesses(10).empty());
+}
+
+TEST_F(CorrelationEngineTest, SketchTargetTrackingTest) {
+    CorrelationConfig config;
+    config.shard_count = 1;
+    config.heavy_hitter_count = 4;
+    config.sketch_target_tracking = true;
+    config.enable_process_correlation = false;
+    config.enable_time_correlation = false;
+    EXPECT_TRUE(engine->Initialize(config));
+    
+    std::vector<CorrelatedEventGroup> groups;
+    engine->RegisterCorrelationCallback([&](const CorrelatedEventGroup& group) {
+        if (group.type == CorrelationType::TARGET_BASED) {
+            groups.push_back(group);
+        }
+    });
+    
+    for (DWORD pid = 1; pid <= 3; ++pid) {
+        SecurityEvent hot = event2;
+        hot.process_id = pid;
+        engine->ProcessEvent(hot);
+    }
+    
+    // Only process keys are tracked exactly
+    EXPECT_EQ(engine->GetTrackedKeyCount(), 3);
+    ASSERT_EQ(groups.size(), 1);
+    EXPECT_EQ(groups[0].events.size(), 3);
+    EXPECT_EQ(groups[0].metadata["distinct_processes"], "3");
+}
+
+namespace {
+
+SYSTEMTIME MakeSystemTime(int hour, int minute, int second) {
+    SYSTEMTIME st = {};
+    st.wYear = 2024;
+    st.wMonth = 3;
+    st.wDay = 15;
+    st.wHour = static_cast<unsigned short>(hour);
+    st.wMinute = static_cast<unsigned short>(minute);
+    st.wSecond = static_cast<unsigned short>(second);
+    return st;
+}
+
+CorrelationConfig EventTimeConfig() {
+    CorrelationConfig config;
+    config.use_event_time = true;
+    config.enable_process_correlation = false;
+    config.enable_time_correlation = false;
+    config.enable_target_correlation = false;
+    config.enable_sequence_correlation = false;
+    config.enable_threat_escalation = false;
+    config.enable_lineage_correlation = false;
+    return config;
+}
+
+} // namespace
+
+TEST_F(CorrelationEngineTest, EventTimeReordersOutOfOrderEventsTest) {
+    CorrelationConfig config = EventTimeConfig();
+    config.enable_threat_escalation = true;
+    config.min_events_for_correlation = 2;
+    config.allowed_lateness_ms = 5000;
+    EXPECT_TRUE(engine->Initialize(config));
+    
+    // An escalation delivered newest first
+    const ThreatLevel levels[] = {ThreatLevel::HIGH, ThreatLevel::MEDIUM, ThreatLevel::LOW};
+    for (int i = 0; i < 3; ++i) {
+        SecurityEvent event = event1;
+        event.threat_level = levels[i];
+        event.timestamp = MakeSystemTime(10, 0, 2 - i);
+        engine->ProcessEvent(event);
+    }
+    
+    // Nothing is correlated until the watermark passes the events
+    EXPECT_EQ(engine->GetBufferedEventCount(), 3);
+    EXPECT_EQ(engine->GetProcessedEventCount(), 0);
+    
+    SecurityEvent later = event1;
+    later.threat_level = ThreatLevel::LOW;
+    later.timestamp = MakeSystemTime(10, 0, 10);
+    engine->ProcessEvent(later);
+    
+    EXPECT_EQ(engine->GetBufferedEventCount(), 1);
+    EXPECT_EQ(engine->GetProcessedEventCount(), 3);
+    EXPECT_EQ(engine->GetLateEventCount(), 0);
+    
+    auto correlations = engine->GetActiveCorrelations();
+    ASSERT_EQ(correlations.size(), 1);
+    EXPECT_EQ(correlations[0].type, CorrelationType::THREAT_ESCALATION);
+    EXPECT_EQ(correlations[0].events[0].threat_level, ThreatLevel::MEDIUM);
+    EXPECT_EQ(correlations[0].events[1].threat_level, ThreatLevel::HIGH);
+    
+    engine->AdvanceWatermark(std::chrono::system_clock::time_point::max());
+    EXPECT_EQ(engine->GetBufferedEventCount(), 0);
+    EXPECT_EQ(engine->GetProcessedEventCount(), 4);
+}
+
+TEST_F(CorrelationEngineTest, EventTimeWindowsTest) {
+    CorrelationConfig config = EventTimeConfig();
+    config.enable_process_correlation = true;
+    config.allowed_lateness_ms = 0;
+    EXPECT_TRUE(engine->Initialize(config));
+    
+    // Arriving together but an hour apart in event time
+    for (int hour = 1; hour <= 3; ++hour) {
+        SecurityEvent event = event2;
+        event.timestamp = MakeSystemTime(hour, 0, 0);
+        engine->ProcessEvent(event);
+    }
+    EXPECT_EQ(engine->GetActiveCorrelationCount(), 0);
+    
+    // Within one window in event time
+    for (int second = 0; second < 3; ++second) {
+        SecurityEvent event = event2;
+        event.process_id = 4321;
+        event.timestamp = MakeSystemTime(3, 0, second * 10);
+        engine->ProcessEvent(event);
+    }
+    EXPECT_EQ(engine->GetActiveCorrelationCount(), 1);
+    EXPECT_EQ(engine->GetBufferedEventCount(), 0);
+}
+
+TEST_F(CorrelationEngineTest, LateEventPolicyTest) {
+    CorrelationConfig config = EventTimeConfig();
+    config.allowed_lateness_ms = 1000;
+    config.late_event_policy = LateEventPolicy::DROP;
+    EXPECT_TRUE(engine->Initialize(config));
+    
+    SecurityEvent event = event1;
+    event.timestamp = MakeSystemTime(12, 0, 30);
+    engine->ProcessEvent(event);
+    
+    // Within the lateness bound: reordered, not late
+    event.timestamp = MakeSystemTime(12, 0, 29);
+    engine->ProcessEvent(event);
+    EXPECT_EQ(engine->GetLateEventCount(), 0);
+    
+    // Behind the watermark
+    event.timestamp = MakeSystemTime(12, 0, 20);
+    engine->ProcessEvent(event);
+    EXPECT_EQ(engine->GetLateEventCount(), 1);
+    EXPECT_EQ(engine->GetDroppedLateEventCount(), 1);
+    
+    config.late_event_policy = LateEventPolicy::MERGE;
+    EXPECT_TRUE(engine->Initialize(config));
+    event.timestamp = MakeSystemTime(12, 0, 30);
+    engine->ProcessEvent(event);
+    event.timestamp = MakeSystemTime(12, 0, 20);
+    engine->ProcessEvent(event);
+    EXPECT_EQ(engine->GetLateEventCount(), 1);
+    EXPECT_EQ(engine->GetDroppedLateEventCount(), 0);
+    
+    // The late event is correlated at once; the other still waits
+    EXPECT_EQ(engine->GetProcessedEventCount(), 1);
+    EXPECT_EQ(engine->GetBufferedEventCount(), 1);
+}
+
+TEST_F(CorrelationEngineTest, LateEventOutsideWindowIsNotCorrelatedTest) {
+    CorrelationConfig config = EventTimeConfig();
+    config.enable_time_correlation = true;
+    config.allowed_lateness_ms = 0;
+    config.late_event_policy = LateEventPolicy::MERGE;
+    EXPECT_TRUE(engine->Initialize(config));
+    
+    SecurityEvent event = event2;
+    event.timestamp = MakeSystemTime(12, 0, 0);
+    engine->ProcessEvent(event);
+    event.timestamp = MakeSystemTime(12, 0, 1);
+    engine->ProcessEvent(event);
+    
+    // Eleven hours late: merged, but no longer part of any burst
+    event.timestamp = MakeSystemTime(1, 0, 0);
+    engine->ProcessEvent(event);
+    EXPECT_EQ(engine->GetLateEventCount(), 1);
+    EXPECT_EQ(engine->GetActiveCorrelationCount(), 0);
+    
+    // Late but inside the window: joins the burst in timestamp order
+    event.timestamp = MakeSystemTime(11, 59, 59);
+    engine->ProcessEvent(event);
+    auto correlations = engine->GetActiveCorrelations();
+    ASSERT_EQ(correlations.size(), 1);
+    EXPECT_EQ(correlations[0].type, CorrelationType::TIME_BASED);
+    ASSERT_EQ(correlations[0].events.size(), 3);
+    EXPECT_EQ(correlations[0].events[0].timestamp.wHour, 11);
+    EXPECT_EQ(correlations[0].events[2].timestamp.wSecond, 1);
+}
+
+TEST_F(CorrelationEngineTest, ClockStepBackKeepsHeavyHittersTest) {
+    CorrelationConfig config;
+    config.shard_count = 1;
+    config.enable_time_correlation = false;
+    auto ahead = std::make_shared<SimulatedClock>();
+    auto behind = std::make_shared<SimulatedClock>(ahead->Now());
+    ahead->Advance(std::chrono::minutes(5));
+    engine->SetClock(ahead);
+    EXPECT_TRUE(engine->Initialize(config));
+    
+    SecurityEvent event = event2;
+    event.process_id = 7;
+    for (int i = 0; i < 10; ++i) {
+        engine->ProcessEvent(event);
+    }
+    
+    // The wall clock steps back to an earlier window; the sketches keep
+    // their counts instead of being reset
+    engine->SetClock(behind);
+    engine->ProcessEvent(event);
+    
+    auto processes = engine->GetTopProcesses(1);
+    ASSERT_EQ(processes.size(), 1);
+    EXPECT_EQ(processes[0].process_id, 7);
+    EXPECT_EQ(processes[0].estimated_events, 11);
+}
+
+TEST_F(CorrelationEngineTest, FutureTimestampsAreClampedTest) {
+    CorrelationConfig config = EventTimeConfig();
+    config.allowed_lateness_ms = 1000;
+    config.max_event_time_skew_ms = 60000;
+    auto clock = std::make_shared<SimulatedClock>();
+    engine->SetClock(clock);
+    EXPECT_TRUE(engine->Initialize(config));
+    
+    // A host whose clock is decades ahead
+    SecurityEvent skewed = event1;
+    skewed.timestamp = MakeSystemTime(12, 0, 0);
+    skewed.timestamp.wYear = 2100;
+    engine->ProcessEvent(skewed);
+    EXPECT_EQ(engine->GetClampedEventCount(), 1);
+    EXPECT_LE(engine->GetWatermark(), clock->Now() + std::chrono::milliseconds(60000));
+    
+    // Events stamped with the current time are still on time afterwards
+    clock->Advance(std::chrono::milliseconds(120000));
+    SecurityEvent current = event1;
+    current.timestamp = {};
+    engine->ProcessEvent(current);
+    EXPECT_EQ(engine->GetLateEventCount(), 0);
+    EXPECT_EQ(engine->GetClampedEventCount(), 1);
+}
+
+TEST_F(CorrelationEngineTest, ReorderBufferIsBoundedTest) {
+    CorrelationConfig config = EventTimeConfig();
+    config.allowed_lateness_ms = 3600 * 1000;
+    config.max_reorder_buffer_events = 4;
+    EXPECT_TRUE(engine->Initialize(config));
+    
+    for (int second = 0; second < 10; ++second) {
+        SecurityEvent event = event1;
+        event.timestamp = MakeSystemTime(8, 0, second);
+        engine->ProcessEvent(event);
+    }
+    EXPECT_EQ(engine->GetBufferedEventCount(), 4);
+    EXPECT_EQ(engine->GetProcessedEventCount(), 6);
+    
+    // The watermark followed the early releases
+    SecurityEvent old = event1;
+    old.timestamp = MakeSystemTime(8, 0, 1);
+    engine->ProcessEvent(old);
+    EXPECT_EQ(engine->GetLateEventCount(), 1);
+}
+
+TEST_F(CorrelationEngineTest, ParallelDetectionMatchesSerialTest) {
+    // Ingest with an unreachable threshold so the sweeps find the groups
+    CorrelationConfig config;
+    config.shard_count = 8;
+    config.min_correlation_score = 1.1;
+    
+    auto run = [&](bool parallel) {
+        CorrelationEngine sweep_engine;
+        CorrelationConfig engine_config = config;
+        engine_config.parallel_detection = parallel;
+        EXPECT_TRUE(sweep_engine.Initialize(engine_config));
+        sweep_engine.SetWorkerPool(std::make_shared<WorkerPool>(4));
+        
+        for (DWORD pid = 100; pid < 140; ++pid) {
+            for (int i = 0; i < 4; ++i) {
+                SecurityEvent event = (i % 2 == 0) ? event2 : event3;
+                event.process_id = pid;
+                event.threat_level = i < 2 ? ThreatLevel::MEDIUM : ThreatLevel::HIGH;
+                event.target_path = "C:\\shared\\t" + std::to_string(pid % 5);
+                sweep_engine.ProcessEvent(event);
+            }
+        }
+        
+        engine_config.min_correlation_score = 0.6;
+        sweep_engine.SetConfiguration(engine_config);
+        std::vector<std::string> found;
+        for (const auto& group : sweep_engine.DetectCorrelations()) {
+            found.push_back(std::to_string(static_cast<int>(group.type)) + " " + group.description);
+        }
+        
+        // A second sweep finds nothing new
+        EXPECT_TRUE(sweep_engine.DetectCorrelations().empty());
+        return found;
+    };
+    
+    std::vector<std::string> serial = run(false);
+    std::vector<std::string> parallel = run(true);
+    EXPECT_FALSE(serial.empty());
+    EXPECT_EQ(parallel, serial);
+}
+
+TEST(WorkerPoolTest, RunAllRunsEveryTaskOnce) {
+    WorkerPool pool(3);
+    EXPECT_EQ(pool.GetThreadCount(), 3);
+    
+    std::vector<std::atomic<int>> runs(100);
+    std::vector<std::function<void()>> tasks;
+    for (size_t i = 0; i < runs.size(); ++i) {
+        tasks.push_back([&runs, i]() { runs[i]++; });
+    }
+    pool.RunAll(tasks);
+    
+    for (const auto& count : runs) {
+        EXPECT_EQ(count.load(), 1);
+    }
+    
+    // Nested batches complete because callers run tasks themselves
+    std::atomic<int> nested{0};
+    std::vector<std::function<void()>> outer;
+    for (int i = 0; i < 6; ++i) {
+        outer.push_back([&pool, &nested]() {
+            std::vector<std::function<void()>> inner(4, [&nested]() { nested++; });
+            pool.RunAll(inner);
+        });
+    }
+    pool.RunAll(outer);
+    EXPECT_EQ(nested.load(), 24);
+}
+
+TEST_F(CorrelationEngineTest, SimulatedClockFastForwardTest) {
+    CorrelationConfig config;
+    config.time_window_seconds = 60;
+    config.enable_time_correlation = false;
+    config.enable_target_correlation = false;
+    config.enable_sequence_correlation = false;
+    config.enable_threat_escalation = false;
+    config.enable_lineage_correlation = false;
+    
+    auto clock = std::make_shared<SimulatedClock>();
+    engine->SetClock(clock);
+    EXPECT_TRUE(engine->Initialize(config));
+    
+    // Half an hour apart, the events never share a window
+    for (int i = 0; i < 3; ++i) {
+        engine->ProcessEvent(event2);
+        clock->Advance(std::chrono::minutes(30));
+    }
+    EXPECT_EQ(engine->GetCorrelationCount(), 0);
+    
+    for (int i = 0; i < 3; ++i) {
+        engine->ProcessEvent(event2);
+        clock->Advance(std::chrono::seconds(10));
+    }
+    EXPECT_EQ(engine->GetCorrelationCount(), 1);
+    
+    // Hours later the idle keys are gone
+    clock->Advance(std::chrono::hours(6));
+    engine->DetectCorrelations();
+    EXPECT_EQ(engine->GetTrackedKeyCount(), 0);
+}
+
+TEST(ClockTest, SleepForFollowsSimulatedTime) {
+    auto clock = std::make_shared<SimulatedClock>();
+    std::atomic<bool> running{true};
+    std::atomic<bool> woke{false};
+    
+    std::thread sleeper([&]() {
+        SleepFor(*clock, std::chrono::hours(1), running);
+        woke = true;
+    });
+    
+    std::this_thread::sleep_for(std::chrono::milliseconds(50));
+    EXPECT_FALSE(woke.load());
+    clock->Advance(std::chrono::minutes(59));
+    std::this_thread::sleep_for(std::chrono::milliseconds(50));
+    EXPECT_FALSE(woke.load());
+    clock->Advance(std::chrono::minutes(1));
+    sleeper.join();
+    EXPECT_TRUE(woke.load());
+    
+    // Clearing the flag ends the wait without advancing the clock
+    woke = false;
+    std::thread stopped([&]() {
+        SleepFor(*clock, std::chrono::hours(1), running);
+        woke = true;
+    });
+    running = false;
+    stopped.join();
+    EXPECT_TRUE(woke.load());
+}
+
+TEST_F(CorrelationEngineTest, SubSecondBurstWindowTest) {
+    CorrelationConfig config;
+    config.burst_window_ms = 500;
+    config.enable_process_correlation = false;
+    config.enable_target_correlation = false;
+    config.enable_sequence_correlation = false;
+    config.enable_threat_escalation = false;
+    config.enable_lineage_correlation = false;
+    
+    auto clock = std::make_shared<SimulatedClock>();
+    engine->SetClock(clock);
+    EXPECT_TRUE(engine->Initialize(config));
+    
+    // 300 ms apart, no three high-threat events fit in half a second
+    for (int i = 0; i < 4; ++i) {
+        engine->ProcessEvent(event2);
+        clock->Advance(std::chrono::milliseconds(300));
+    }
+    EXPECT_EQ(engine->GetCorrelationCount(), 0);
+    
+    clock->Advance(std::chrono::seconds(1));
+    for (int i = 0; i < 3; ++i) {
+        engine->ProcessEvent(event2);
+        clock->Advance(std::chrono::milliseconds(100));
+    }
+    EXPECT_EQ(engine->GetCorrelationCount(), 1);
+    
+    auto correlations = engine->GetActiveCorrelations();
+    ASSERT_EQ(correlations.size(), 1);
+    EXPECT_EQ(correlations[0].type, CorrelationType::TIME_BASED);
+    EXPECT_EQ(correlations[0].metadata.at("window_ms"), "500");
+}
+
+TEST_F(CorrelationEngineTest, LongProcessWindowUsesAggregatesTest) {
+    CorrelationConfig config;
+    config.process_window_ms = 30 * 60 * 1000;
+    config.max_events_per_process = 2;
+    config.enable_time_correlation = false;
+    config.enable_target_correlation = false;
+    config.enable_sequence_correlation = false;
+    config.enable_threat_escalation = false;
+    config.enable_lineage_correlation = false;
+    
+    auto clock = std::make_shared<SimulatedClock>();
+    engine->SetClock(clock);
+    EXPECT_TRUE(engine->Initialize(config));
+    
+    // Only two raw events are kept, but the aggregate counts all three
+    // events of the slow chain
+    for (int i = 0; i < 3; ++i) {
+        engine->ProcessEvent(event2);
+        clock->Advance(std::chrono::minutes(10));
+    }
+    EXPECT_EQ(engine->GetCorrelationCount(), 1);
+    
+    auto correlations = engine->GetActiveCorrelations();
+    ASSERT_EQ(correlations.size(), 1);
+    EXPECT_EQ(correlations[0].type, CorrelationType::PROCESS_BASED);
+    EXPECT_EQ(correlations[0].events.size(), 2);
+    EXPECT_EQ(correlations[0].metadata.at("window_event_count"), "3");
+    EXPECT_EQ(correlations[0].metadata.at("window_ms"), std::to_string(30 * 60 * 1000));
+    
+    // Keys outlive the default time window while the long window is open
+    clock->Advance(std::chrono::minutes(5));
+    engine->DetectCorrelations();
+    EXPECT_EQ(engine->GetTrackedKeyCount(), 2);
+    
+    clock->Advance(std::chrono::hours(1));
+    engine->DetectCorrelations();
+    EXPECT_EQ(engine->GetTrackedKeyCount(), 0);
+}
+
+TEST_F(CorrelationEngineTest, AggregateWindowsAreClampedToHorizonTest) {
+    CorrelationConfig config;
+    config.process_window_ms = 2 * 60 * 60 * 1000;
+    config.time_window_seconds = 3 * 60 * 60;       // Inherited by target windows
+    EXPECT_TRUE(engine->Initialize(config));
+    EXPECT_EQ(engine->GetConfiguration().process_window_ms, MultiResolutionWindow::kHorizonMs);
+    EXPECT_EQ(engine->GetConfiguration().target_window_ms, MultiResolutionWindow::kHorizonMs);
+    EXPECT_EQ(engine->GetConfiguration().time_window_seconds, 3 * 60 * 60);
+    
+    // Raw windows have no horizon
+    config.max_raw_window_seconds = 0;
+    engine->SetConfiguration(config);
+    EXPECT_EQ(engine->GetConfiguration().process_window_ms, 2 * 60 * 60 * 1000);
+    EXPECT_EQ(engine->GetConfiguration().target_window_ms, 0);
+}
+
+TEST(MultiResolutionWindowTest, CountsFineAndCoarseBuckets) {
+    const auto start = std::chrono::system_clock::time_point(std::chrono::hours(1000));
+    MultiResolutionWindow window;
+    
+    // One event per 10 seconds for 20 minutes; most roll up into minutes
+    for (int i = 0; i < 120; ++i) {
+        window.Add(start + std::chrono::seconds(10 * i),
+                   i % 4 == 0 ? ThreatLevel::HIGH : ThreatLevel::LOW);
+    }
+    const auto now = start + std::chrono::seconds(1190);
+    
+    ThreatCounts all = window.Count(now, std::chrono::minutes(30));
+    EXPECT_EQ(all.total, 120);
+    EXPECT_EQ(all.HighThreat(), 30);
+    
+    // Fine buckets answer exactly
+    EXPECT_EQ(window.Count(now, std::chrono::seconds(30)).total, 4);
+    
+    // Coarse buckets are whole minutes: the window is rounded out
+    ThreatCounts ten_minutes = window.Count(now, std::chrono::minutes(10));
+    EXPECT_GE(ten_minutes.total, 60);
+    EXPECT_LE(ten_minutes.total, 66);
+    
+    // Late events land in their own minute
+    window.Add(start, ThreatLevel::CRITICAL);
+    EXPECT_EQ(window.Count(now, std::chrono::minutes(30)).Count(ThreatLevel::CRITICAL), 1);
+    
+    // Beyond the horizon nothing is left
+    EXPECT_EQ(window.Count(now + std::chrono::hours(3), std::chrono::minutes(30)).total, 0);
+    
+    window.Clear();
+    EXPECT_EQ(window.Count(now, std::chrono::minutes(30)).total, 0);
+}
+
+TEST(SequenceMatcherTest, MaxGapExpiresPartialMatch) {
+    AttackPattern pattern;
+    pattern.name = "gap";
+    pattern.scope = PatternScope::SAME_PROCESS;
+    pattern.steps.resize(2);
+    pattern.steps[0].event_types = {EventType::PROCESS_CREATION};
+    pattern.steps[1].event_types = {EventType::FILE_MODIFICATION};
+    pattern.steps[1].max_gap_seconds = 5;
+    
+    SequenceMatcher matcher;
+    matcher.Compile({pattern}, 60, 100);
+    
+    SecurityEvent start = {};
+    start.type = EventType::PROCESS_CREATION;
+    start.process_id = 42;
+    SecurityEvent next = start;
+    next.type = EventType::FILE_MODIFICATION;
+    
+    auto t0 = std::chrono::system_clock::now();
+    std::vector<SequenceMatch> completed;
+    
+    matcher.ProcessEvent(start, t0, completed);
+    matcher.ProcessEvent(next, t0 + std::chrono::seconds(10), completed);
+    EXPECT_TRUE(completed.empty());
+    EXPECT_EQ(matcher.GetActiveMatchCount(), 0);
+    
+    matcher.ProcessEvent(start, t0 + std::chrono::seconds(20), completed);
+    matcher.ProcessEvent(next, t0 + std::chrono::seconds(22), completed);
+    ASSERT_EQ(completed.size(), 1);
+    EXPECT_EQ(completed[0].root_process_id, 42);
+    EXPECT_EQ(completed[0].events.size(), 2);
+}
+
+TEST(SequenceMatcherTest, PartialMatchesAreBounded) {
+    SequenceMatcher matcher;
+    matcher.Compile(DefaultAttackPatterns(), 60, 10);
+    
+    SecurityEvent start = {};
+    start.type = EventType::PROCESS_CREATION;
+    
+    auto now = std::chrono::system_clock::now();
+    std::vector<SequenceMatch> completed;
+    for (DWORD pid = 1; pid <= 50; ++pid) {
+        start.process_id = pid;
+        matcher.ProcessEvent(start, now, completed);
+    }
+    
+    EXPECT_EQ(matcher.GetActiveMatchCount(), 10);
+    EXPECT_EQ(matcher.GetDroppedMatchCount(), 40);
+    
+    matcher.ExpireMatches(now + std::chrono::seconds(61));
+    EXPECT_EQ(matcher.GetActiveMatchCount(), 0);
+}
+
+struct WheelItem {
+    TimerWheel<WheelItem>::Node node;
+    uint64_t fired_at = 0;
+};
+
+TEST(TimerWheelTest, FiresAtExpiryAcrossLevels) {
+    TimerWheel<WheelItem> wheel;
+    wheel.Advance(1000, [](WheelItem&) {});
+    
+    const uint64_t delays[] = {1, 63, 64, 65, 4095, 4096, 300000};
+    std::vector<WheelItem> items(sizeof(delays) / sizeof(delays[0]));
+    for (size_t i = 0; i < items.size(); ++i) {
+        items[i].node.owner = &items[i];
+        wheel.Schedule(items[i].node, 1000 + delays[i]);
+    }
+    EXPECT_EQ(wheel.Size(), items.size());
+    
+    // Advance in uneven steps; every timer must fire exactly at its tick
+    uint64_t tick = 1000;
+    while (wheel.Size() > 0) {
+        uint64_t step = (tick % 7) + 1;
+        tick += step;
+        wheel.Advance(tick, [tick](WheelItem& item) { item.fired_at = tick; });
+        for (auto& item : items) {
+            if (item.fired_at == tick) {
+                EXPECT_GE(tick, item.node.expiry_tick);
+                EXPECT_LT(tick - item.node.expiry_tick, step);
+            }
+        }
+    }
+    for (const auto& item : items) {
+        EXPECT_NE(item.fired_at, 0u);
+    }
+}
+
+TEST(TimerWheelTest, CancelledTimerDoesNotFire) {
+    TimerWheel<WheelItem> wheel;
+    wheel.Advance(10, [](WheelItem&) {});
+    
+    WheelItem kept, cancelled;
+    kept.node.owner = &kept;
+    cancelled.node.owner = &cancelled;
+    wheel.Schedule(kept.node, 20);
+    wheel.Schedule(cancelled.node, 20);
+    wheel.Cancel(cancelled.node);
+    
+    wheel.Advance(30, [](WheelItem& item) { item.fired_at = 30; });
+    EXPECT_EQ(kept.fired_at, 30u);
+    EXPECT_EQ(cancelled.fired_at, 0u);
+    EXPECT_EQ(wheel.Size(), 0u);
+}
+
+TEST(ProcessLineageTableTest, AncestorsNearestFirst) {
+    ProcessLineageTable lineage;
+    auto now = std::chrono::system_clock::now();
+    lineage.RecordProcessStart(20, 10, now);
+    lineage.RecordProcessStart(30, 20, now);
+    lineage.RecordProcessStart(40, 30, now);
+    
+    std::vector<DWORD> ancestors;
+    lineage.GetAncestors(40, ancestors);
+    EXPECT_EQ(ancestors, (std::vector<DWORD>{30, 20, 10}));
+    EXPECT_TRUE(lineage.IsAncestor(10, 40));
+    EXPECT_FALSE(lineage.IsAncestor(40, 10));
+    EXPECT_EQ(lineage.GetParent(20), 10);
+    
+    lineage.Configure(16, 2);
+    ancestors.clear();
+    lineage.GetAncestors(40, ancestors);
+    EXPECT_EQ(ancestors.size(), 2);
+}
+
+TEST(ProcessLineageTableTest, ReusedParentPidIsNotAnAncestor) {
+    ProcessLineageTable lineage;
+    auto now = std::chrono::system_clock::now();
+    std::vector<DWORD> evicted;
+    lineage.RecordProcessStart(20, 10, now);
+    lineage.RecordProcessStart(10, 5, now + std::chrono::seconds(1));
+    
+    // pid 10 now belongs to a process started after 20
+    EXPECT_FALSE(lineage.IsAncestor(10, 20));
+    EXPECT_EQ(lineage.GetParent(20), 0);
+    EXPECT_TRUE(lineage.IsAncestor(5, 10));
+}
+
+TEST(ProcessLineageTableTest, ExitedHistoryIsBounded) {
+    ProcessLineageTable lineage;
+    lineage.Configure(2, 16);
+    auto now = std::chrono::system_clock::now();
+    std::vector<DWORD> evicted;
+    
+    for (DWORD pid = 100; pid < 105; ++pid) {
+        lineage.RecordProcessStart(pid, 1, now);
+    }
+    for (DWORD pid = 100; pid < 105; ++pid) {
+        lineage.RecordProcessExit(pid, now, evicted);
+    }
+    
+    EXPECT_EQ(evicted, (std::vector<DWORD>{100, 101, 102}));
+    EXPECT_EQ(lineage.GetExitedProcessCount(), 2);
+    EXPECT_TRUE(lineage.IsAncestor(1, 104));
+    EXPECT_FALSE(lineage.Contains(100));
+}
+
+TEST(CorrelationGroupStoreTest, DuplicatesAndEviction) {
+    CorrelationGroupStore store;
+    store.Configure(2, 0);
+    
+    auto make_group = [](DWORD pid) {
+        CorrelatedEventGroup group;
+        group.type = CorrelationType::PROCESS_BASED;
+        SecurityEvent event = {};
+        event.process_id = pid;
+        group.events.push_back(event);
+        group.summary = SummarizeEvents(group.events);
+        return group;
+    };
+    
+    EXPECT_NE(store.Add(make_group(1)), nullptr);
+    EXPECT_EQ(store.Add(make_group(1)), nullptr);
+    EXPECT_NE(store.Add(make_group(2)), nullptr);
+    EXPECT_NE(store.Add(make_group(3)), nullptr);
+    EXPECT_EQ(store.Size(), 2);
+    EXPECT_EQ(store.GetEvictedCount(), 1);
+    
+    // Group 1 was evicted, so it is no longer a duplicate
+    EXPECT_NE(store.Add(make_group(1)), nullptr);
+    
+    uint64_t cursor = 0;
+    std::vector<CorrelationGroupPtr> groups;
+    EXPECT_EQ(store.Read(cursor, 10, groups), 2);
+    EXPECT_EQ(groups[0]->summary.first_process_id, 3);
+    EXPECT_EQ(groups[1]->summary.first_process_id, 1);
+    EXPECT_EQ(cursor, store.GetNextSequence());
+}
+
+TEST(HeavyHitterSketchTest, CountMinNeverUnderestimates) {
+    CountMinSketch sketch(64, 4);
+    for (uint64_t key = 0; key < 1000; ++key) {
+        for (uint64_t i = 0; i <= key % 5; ++i) {
+            sketch.Add(key);
+        }
+    }
+    
+    uint64_t total_error = 0;
+    for (uint64_t key = 0; key < 1000; ++key) {
+        ASSERT_GE(sketch.Estimate(key), key % 5 + 1);
+        total_error += sketch.Estimate(key) - (key % 5 + 1);
+    }
+    EXPECT_LT(total_error / 1000, 100);
+    
+    sketch.Decay();
+    sketch.Clear();
+    EXPECT_EQ(sketch.Estimate(3), 0);
+}
+
+TEST(HeavyHitterSketchTest, SpaceSavingFindsHeavyKeys) {
+    SpaceSavingTopK<int> top(10);
+    for (int i = 0; i < 10000; ++i) {
+        top.Offer(i % 3 == 0 ? 1 : 100 + i);        // Key 1 is a third of the stream
+        if (i % 5 == 0) {
+            top.Offer(2);
+        }
+    }
+    
+    ASSERT_NE(top.Find(1), nullptr);
+    ASSERT_NE(top.Find(2), nullptr);
+    EXPECT_EQ(top.Size(), 10);
+    EXPECT_GE(top.Find(1)->count, 3334);
+    EXPECT_LE(top.Find(1)->count - top.Find(1)->error, 3334);
+    
+    top.Decay();
+    EXPECT_GE(top.Find(1)->count, 1667);
+}
+
+TEST(HeavyHitterSketchTest, SpaceSavingResizeKeepsHeaviestKeys) {
+    SpaceSavingTopK<int> top(4);
+    for (int key = 1; key <= 4; ++key) {
+        top.Offer(key, static_cast<uint64_t>(key * 10));
+    }
+    
+    top.Resize(2);
+    EXPECT_EQ(top.Capacity(), 2);
+    EXPECT_EQ(top.Size(), 2);
+    ASSERT_NE(top.Find(4), nullptr);
+    ASSERT_NE(top.Find(3), nullptr);
+    EXPECT_EQ(top.Find(4)->count, 40);
+    EXPECT_EQ(top.Find(1), nullptr);
+    
+    // The heap still replaces the minimum
+    top.Offer(5, 1);
+    EXPECT_EQ(top.Find(3), nullptr);
+    EXPECT_EQ(top.Find(5)->count, 31);
+    EXPECT_EQ(top.Find(5)->error, 30);
+}
+
+TEST(HeavyHitterSketchTest, HyperLogLogEstimates) {
+    HyperLogLog small, large;
+    for (uint64_t i = 0; i < 10; ++i) {
+        small.Add(i);
+        small.Add(i);
+    }
+    EXPECT_EQ(small.Estimate(), 10);
+    
+    for (uint64_t i = 0; i < 5000; ++i) {
+        large.Add(i * 7919);
+    }
+    EXPECT_GT(large.Estimate(), 3500);
+    EXPECT_LT(large.Estimate(), 6500);
+    
+    large.Merge(small);
+    EXPECT_GT(large.Estimate(), 3500);
+}
+
 int main(int argc, char** argv) {
     ::testing::InitGoogleTest(&argc, argv);
     return RUN_ALL_TESTS();
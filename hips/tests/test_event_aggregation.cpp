@@ -0,0 +1,345 @@
+#include <gtest/gtest.h>
+#include "event_aggregation.h"
+#include <thread>
+#include <chrono>
+#include <algorithm>
+#include <functional>
+#ifndef _WIN32
+#include <unistd.h>
+#endif
+
+using namespace HIPS;
+
+namespace {
+
+SecurityEvent MakeEvent(EventType type, ThreatLevel level, DWORD pid, const std::string& target) {
+    SecurityEvent event;
+    event.type = type;
+    event.threat_level = level;
+    event.process_id = pid;
+    event.thread_id = 1;
+    event.process_path = "C:\\test\\agent_" + std::to_string(pid) + ".exe";
+    event.target_path = target;
+    event.description = "Aggregation test event";
+    GetSystemTime(&event.timestamp);
+    return event;
+}
+
+// Poll until the condition holds or the timeout expires
+bool WaitFor(const std::function<bool()>& condition, int timeout_ms = 10000) {
+    auto deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(timeout_ms);
+    while (std::chrono::steady_clock::now() < deadline) {
+        if (condition()) {
+            return true;
+        }
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    }
+    return condition();
+}
+
+CorrelationConfig ProcessOnlyConfig() {
+    CorrelationConfig config;
+    config.enable_time_correlation = false;
+    config.enable_target_correlation = false;
+    config.enable_sequence_correlation = false;
+    config.enable_threat_escalation = false;
+    config.enable_lineage_correlation = false;
+    return config;
+}
+
+} // namespace
+
+class EventAggregationTest : public ::testing::Test {
+protected:
+    void SetUp() override {
+        AggregationCollectorConfig config;
+        config.engine_config = ProcessOnlyConfig();
+        ASSERT_TRUE(collector.Initialize(config));
+        ASSERT_TRUE(collector.Start());
+        ASSERT_NE(collector.GetPort(), 0);
+    }
+
+    void TearDown() override {
+        collector.Stop();
+    }
+
+    AggregationAgentConfig AgentConfig(const std::string& agent_id) const {
+        AggregationAgentConfig config;
+        config.agent_id = agent_id;
+        config.collector_address = "127.0.0.1:" + std::to_string(collector.GetPort());
+        config.max_batch_events = 64;
+        config.max_batch_delay_ms = 5;
+        return config;
+    }
+
+    AggregationCollector collector;
+};
+
+TEST_F(EventAggregationTest, MultipleAgentsOverLoopback) {
+    const int kAgents = 3;
+    const int kEventsPerAgent = 500;
+
+    std::vector<std::unique_ptr<AggregationAgent>> agents;
+    for (int a = 0; a < kAgents; ++a) {
+        agents.push_back(std::make_unique<AggregationAgent>());
+        ASSERT_TRUE(agents.back()->Initialize(AgentConfig("agent-" + std::to_string(a))));
+        ASSERT_TRUE(agents.back()->Start());
+    }
+
+    for (int i = 0; i < kEventsPerAgent; ++i) {
+        for (int a = 0; a < kAgents; ++a) {
+            EXPECT_TRUE(agents[a]->Submit(MakeEvent(EventType::FILE_ACCESS, ThreatLevel::LOW,
+                                                    static_cast<DWORD>(100 + i % 7),
+                                                    "C:\\data\\f" + std::to_string(i) + ".txt")));
+        }
+    }
+
+    EXPECT_TRUE(WaitFor([&] { return collector.GetReceivedEventCount() == kAgents * kEventsPerAgent; }));
+    for (auto& agent : agents) {
+        EXPECT_TRUE(WaitFor([&] { return agent->GetAckedEventCount() == kEventsPerAgent; }));
+        EXPECT_EQ(agent->GetSentEventCount(), static_cast<uint64_t>(kEventsPerAgent));
+        EXPECT_EQ(agent->GetDroppedEventCount(), 0u);
+        agent->Stop();
+    }
+
+    auto stats = collector.GetAgentStats();
+    ASSERT_EQ(stats.size(), static_cast<size_t>(kAgents));
+    for (const auto& agent : stats) {
+        EXPECT_EQ(agent.last_sequence, static_cast<uint64_t>(kEventsPerAgent));
+        EXPECT_EQ(agent.received_events, static_cast<uint64_t>(kEventsPerAgent));
+        EXPECT_EQ(agent.missing_events, 0u);
+        EXPECT_EQ(agent.duplicate_events, 0u);
+
+        // Each agent has its own correlation partition
+        auto engine = collector.GetAgentEngine(agent.agent_id);
+        ASSERT_NE(engine, nullptr);
+        EXPECT_EQ(engine->GetProcessedEventCount(), static_cast<uint64_t>(kEventsPerAgent));
+    }
+    EXPECT_EQ(collector.GetAgentEngine("unknown"), nullptr);
+}
+
+TEST_F(EventAggregationTest, StopFlushesQueuedEvents) {
+    // Nothing would be sent before Stop() without the final flush
+    AggregationAgentConfig config = AgentConfig("stopping-agent");
+    config.max_batch_events = 1000;
+    config.max_batch_delay_ms = 60000;
+
+    AggregationAgent agent;
+    ASSERT_TRUE(agent.Initialize(config));
+    ASSERT_TRUE(agent.Start());
+    ASSERT_TRUE(WaitFor([&] { return agent.IsConnected(); }));
+    for (int i = 0; i < 10; ++i) {
+        agent.Submit(MakeEvent(EventType::FILE_ACCESS, ThreatLevel::LOW, 3, "C:\\s.txt"));
+    }
+    EXPECT_EQ(agent.GetSentEventCount(), 0u);
+
+    EXPECT_TRUE(agent.Stop());
+    EXPECT_EQ(agent.GetQueuedEventCount(), 0u);
+    EXPECT_EQ(agent.GetAckedEventCount(), 10u);
+    EXPECT_EQ(collector.GetReceivedEventCount(), 10u);
+}
+
+TEST_F(EventAggregationTest, OldConnectionKeepsNewerOneConnected) {
+    // Two connections for one agent id, as while a reconnect races the
+    // old connection's timeout
+    AggregationAgent first, second;
+    ASSERT_TRUE(first.Initialize(AgentConfig("shared-agent")));
+    ASSERT_TRUE(first.Start());
+    ASSERT_TRUE(WaitFor([&] { return first.IsConnected(); }));
+    ASSERT_TRUE(second.Initialize(AgentConfig("shared-agent")));
+    ASSERT_TRUE(second.Start());
+    ASSERT_TRUE(WaitFor([&] { return second.IsConnected(); }));
+
+    auto connected = [&] {
+        auto stats = collector.GetAgentStats();
+        return stats.size() == 1 && stats[0].connected;
+    };
+    first.Stop();
+    std::this_thread::sleep_for(std::chrono::milliseconds(300));
+    EXPECT_TRUE(connected());
+
+    second.Stop();
+    EXPECT_TRUE(WaitFor([&] { return !connected(); }));
+}
+
+TEST_F(EventAggregationTest, EventsAreTaggedWithAgentId) {
+    std::mutex mutex;
+    std::vector<std::string> tagged;
+    collector.RegisterCorrelationCallback([&](const std::string& agent_id, const CorrelatedEventGroup& group) {
+        std::lock_guard<std::mutex> lock(mutex);
+        for (const auto& event : group.events) {
+            auto it = event.metadata.find("agent_id");
+            tagged.push_back(it != event.metadata.end() ? it->second : "");
+        }
+        tagged.push_back(agent_id);
+    });
+
+    AggregationAgent agent;
+    ASSERT_TRUE(agent.Initialize(AgentConfig("tagging-agent")));
+    ASSERT_TRUE(agent.Start());
+    for (int i = 0; i < 3; ++i) {
+        agent.Submit(MakeEvent(EventType::FILE_MODIFICATION, ThreatLevel::HIGH, 4321, "C:\\x.dll"));
+    }
+
+    EXPECT_TRUE(WaitFor([&] {
+        std::lock_guard<std::mutex> lock(mutex);
+        return !tagged.empty();
+    }));
+    agent.Stop();
+
+    std::lock_guard<std::mutex> lock(mutex);
+    for (const auto& id : tagged) {
+        EXPECT_EQ(id, "tagging-agent");
+    }
+}
+
+TEST_F(EventAggregationTest, CrossHostCorrelationAcrossAgents) {
+    std::mutex mutex;
+    std::vector<CrossHostCorrelation> reports;
+    collector.RegisterCrossHostCallback([&](const CrossHostCorrelation& report) {
+        std::lock_guard<std::mutex> lock(mutex);
+        reports.push_back(report);
+    });
+
+    AggregationAgent first, second, benign;
+    ASSERT_TRUE(first.Initialize(AgentConfig("host-a")));
+    ASSERT_TRUE(second.Initialize(AgentConfig("host-b")));
+    ASSERT_TRUE(benign.Initialize(AgentConfig("host-c")));
+    ASSERT_TRUE(first.Start());
+    ASSERT_TRUE(second.Start());
+    ASSERT_TRUE(benign.Start());
+
+    // Low-threat activity on a third host does not count toward the spread
+    for (int i = 0; i < 3; ++i) {
+        benign.Submit(MakeEvent(EventType::FILE_ACCESS, ThreatLevel::LOW, 77, "C:\\benign.txt"));
+    }
+
+    // The same high-threat process pattern on two hosts
+    for (AggregationAgent* agent : {&first, &second}) {
+        for (int i = 0; i < 3; ++i) {
+            agent->Submit(MakeEvent(EventType::FILE_MODIFICATION, ThreatLevel::HIGH, 1234,
+                                    "C:\\Windows\\System32\\payload" + std::to_string(i) + ".dll"));
+        }
+    }
+
+    EXPECT_TRUE(WaitFor([&] { return collector.GetCrossHostCorrelationCount() >= 1; }));
+    EXPECT_TRUE(WaitFor([&] { return collector.GetReceivedEventCount() == 9; }));
+    first.Stop();
+    second.Stop();
+    benign.Stop();
+
+    std::lock_guard<std::mutex> lock(mutex);
+    ASSERT_EQ(reports.size(), 1u);
+    EXPECT_EQ(reports[0].signature, "PROCESS_BASED");
+    std::vector<std::string> ids = reports[0].agent_ids;
+    std::sort(ids.begin(), ids.end());
+    EXPECT_EQ(ids, (std::vector<std::string>{"host-a", "host-b"}));
+    ASSERT_EQ(reports[0].groups.size(), 2u);
+    EXPECT_GE(reports[0].groups[0]->combined_threat_level, ThreatLevel::HIGH);
+}
+
+#ifndef _WIN32
+TEST(EventAggregationLocalSocketTest, UnixSocketTransport) {
+    const std::string path = "/tmp/hips_aggregation_test_" + std::to_string(getpid()) + ".sock";
+
+    AggregationCollectorConfig collector_config;
+    collector_config.listen_address = "unix:" + path;
+    AggregationCollector collector;
+    ASSERT_TRUE(collector.Initialize(collector_config));
+    ASSERT_TRUE(collector.Start());
+    EXPECT_EQ(collector.GetPort(), 0);
+
+    AggregationAgentConfig agent_config;
+    agent_config.agent_id = "local-agent";
+    agent_config.collector_address = "unix:" + path;
+    AggregationAgent agent;
+    ASSERT_TRUE(agent.Initialize(agent_config));
+    ASSERT_TRUE(agent.Start());
+
+    for (int i = 0; i < 100; ++i) {
+        agent.Submit(MakeEvent(EventType::FILE_ACCESS, ThreatLevel::LOW, 10, "/tmp/f" + std::to_string(i)));
+    }
+    EXPECT_TRUE(WaitFor([&] { return collector.GetReceivedEventCount() == 100; }));
+    EXPECT_TRUE(agent.IsConnected());
+
+    agent.Stop();
+    collector.Stop();
+    EXPECT_NE(access(path.c_str(), F_OK), 0);
+}
+#endif
+
+TEST(EventAggregationBackpressureTest, FullQueueDropsEvents) {
+    // Nothing listens on the discard port, so the queue only fills
+    AggregationAgentConfig config;
+    config.agent_id = "isolated-agent";
+    config.collector_address = "127.0.0.1:9";
+    config.max_queued_events = 10;
+    config.reconnect_delay_ms = 50;
+
+    AggregationAgent agent;
+    ASSERT_TRUE(agent.Initialize(config));
+    ASSERT_TRUE(agent.Start());
+
+    int accepted = 0;
+    for (int i = 0; i < 25; ++i) {
+        if (agent.Submit(MakeEvent(EventType::FILE_ACCESS, ThreatLevel::LOW, 1, "C:\\q.txt"))) {
+            accepted++;
+        }
+    }
+
+    EXPECT_EQ(accepted, 10);
+    EXPECT_EQ(agent.GetQueuedEventCount(), 10u);
+    EXPECT_EQ(agent.GetDroppedEventCount(), 15u);
+    EXPECT_FALSE(agent.IsConnected());
+    EXPECT_TRUE(agent.Stop());
+}
+
+TEST(EventAggregationBackpressureTest, ResendsAfterReconnect) {
+    AggregationCollectorConfig collector_config;
+    auto collector = std::make_unique<AggregationCollector>();
+    ASSERT_TRUE(collector->Initialize(collector_config));
+    ASSERT_TRUE(collector->Start());
+    const uint16_t port = collector->GetPort();
+
+    AggregationAgentConfig config;
+    config.agent_id = "reconnecting-agent";
+    config.collector_address = "127.0.0.1:" + std::to_string(port);
+    config.max_batch_delay_ms = 5;
+    config.reconnect_delay_ms = 50;
+
+    AggregationAgent agent;
+    ASSERT_TRUE(agent.Initialize(config));
+    ASSERT_TRUE(agent.Start());
+    for (int i = 0; i < 50; ++i) {
+        agent.Submit(MakeEvent(EventType::FILE_ACCESS, ThreatLevel::LOW, 2, "C:\\a.txt"));
+    }
+    ASSERT_TRUE(WaitFor([&] { return agent.GetAckedEventCount() == 50; }));
+
+    // Events submitted while the collector is down wait in the agent
+    collector->Stop();
+    for (int i = 0; i < 50; ++i) {
+        agent.Submit(MakeEvent(EventType::FILE_ACCESS, ThreatLevel::LOW, 2, "C:\\b.txt"));
+    }
+
+    collector_config.listen_address = "127.0.0.1:" + std::to_string(port);
+    collector = std::make_unique<AggregationCollector>();
+    ASSERT_TRUE(collector->Initialize(collector_config));
+    ASSERT_TRUE(collector->Start());
+
+    EXPECT_TRUE(WaitFor([&] { return agent.GetAckedEventCount() == 100; }));
+    EXPECT_GE(agent.GetReconnectCount(), 1u);
+    agent.Stop();
+
+    // The new collector sees the agent's sequence continue where it left off
+    auto stats = collector->GetAgentStats();
+    ASSERT_EQ(stats.size(), 1u);
+    EXPECT_EQ(stats[0].last_sequence, 100u);
+    EXPECT_EQ(stats[0].received_events, 50u);
+    EXPECT_EQ(stats[0].missing_events, 50u);
+    collector->Stop();
+}
+
+int main(int argc, char** argv) {
+    ::testing::InitGoogleTest(&argc, argv);
+    return RUN_ALL_TESTS();
+}
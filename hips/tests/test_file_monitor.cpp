@@ -1,9 +1,30 @@
 #include <gtest/gtest.h>
 #include "file_monitor.h"
+#include "directory_snapshot.h"
+#include "path_classifier.h"
+#include "process_identity_cache.h"
+#include "notify_decoder.h"
+#include "content_hasher.h"
+#include "baseline_scanner.h"
+#include "inventory_database.h"
+#include "worker_pool.h"
 #include <filesystem>
 #include <fstream>
 #include <thread>
 #include <chrono>
+#include <mutex>
+#include <condition_variable>
+#include <functional>
+#include <algorithm>
+#include <map>
+#include <cstring>
+#ifdef __linux__
+#include "linux_file_watcher.h"
+#include <fcntl.h>
+#include <unistd.h>
+#include <cerrno>
+#include <sys/fanotify.h>
+#endif
 
 using namespace HIPS;
 
@@ -212,6 +233,1102 @@ TEST_F(FileMonitorTest, CallbackFunctionality) {
     // This test mainly ensures the callback mechanism doesn't crash
 }
 
+TEST(PathClassifierTest, ClassifiesDefaults) {
+    PathClassifier classifier;
+    
+    PathClassification driver = classifier.Classify("c:\\windows\\System32\\drivers\\evil.SYS");
+    EXPECT_TRUE(driver.system_file);
+    EXPECT_TRUE(driver.critical_directory);
+    EXPECT_TRUE(driver.extension_class & EXTENSION_EXECUTABLE);
+    EXPECT_TRUE(classifier.IsReported(driver));
+    
+    // System file names match whole names in any directory
+    EXPECT_TRUE(classifier.Classify("D:\\copy\\NTDLL.DLL").system_file);
+    EXPECT_FALSE(classifier.Classify("D:\\copy\\xntdll.dll").system_file);
+    
+    const std::string readme = "C:/Program Files (x86)/App/readme.TXT";
+    PathClassification text = classifier.Classify(readme);
+    EXPECT_TRUE(text.critical_directory);
+    EXPECT_FALSE(text.system_file);
+    EXPECT_EQ(text.extension_class, EXTENSION_EXCLUDED);
+    EXPECT_FALSE(classifier.IsReported(text));
+    EXPECT_EQ(readme.substr(text.extension_offset, text.extension_length), ".TXT");
+    
+    // Dots in directory names are not extensions
+    PathClassification plain = classifier.Classify("/etc/cron.d/job");
+    EXPECT_EQ(plain.extension_offset, std::string::npos);
+    EXPECT_EQ(plain.extension_class, 0);
+    EXPECT_FALSE(plain.critical_directory);
+    EXPECT_TRUE(classifier.IsReported(plain));
+    
+    // Too long to be configured; still reported as the extension
+    PathClassification long_extension = classifier.Classify("/tmp/a.extension12");
+    EXPECT_EQ(long_extension.extension_length, 12u);
+    EXPECT_EQ(long_extension.extension_class, 0);
+}
+
+TEST(PathClassifierTest, CompilesConfiguredSets) {
+    PathClassifierConfig config;
+    config.included_extensions = {"EXE", ".Ps1"};
+    config.critical_directories = {"/etc"};
+    for (int i = 0; i < 500; ++i) {
+        config.executable_extensions.push_back("x" + std::to_string(i));
+    }
+    PathClassifier classifier(config);
+    
+    EXPECT_TRUE(classifier.IsReported(classifier.Classify("/tmp/tool.exe")));
+    EXPECT_TRUE(classifier.IsReported(classifier.Classify("/tmp/script.PS1")));
+    EXPECT_FALSE(classifier.IsReported(classifier.Classify("/tmp/lib.dll")));
+    EXPECT_FALSE(classifier.IsReported(classifier.Classify("/tmp/noextension")));
+    EXPECT_TRUE(classifier.Classify("/etc/passwd").critical_directory);
+    EXPECT_FALSE(classifier.Classify("/usr/etc/passwd").critical_directory);
+    
+    // Every key of the perfect hash is found, nothing else is
+    for (int i = 0; i < 500; ++i) {
+        EXPECT_TRUE(classifier.Classify("/f.X" + std::to_string(i)).extension_class & EXTENSION_EXECUTABLE);
+    }
+    EXPECT_EQ(classifier.Classify("/f.x500").extension_class, 0);
+    EXPECT_EQ(classifier.Classify("/f.y1").extension_class, 0);
+}
+
+TEST(ProcessIdentityCacheTest, ReusedPidsAreNotConfused) {
+    ProcessIdentityCache cache;
+    int queries = 0;
+    cache.SetResolver([&queries](DWORD pid, ProcessIdentity& identity) {
+        queries++;
+        identity.start_time = 200;
+        identity.path = "/usr/bin/new-" + std::to_string(pid);
+        return true;
+    });
+    
+    cache.Insert(42, ProcessIdentity{100, "/usr/bin/old"});
+    std::string path;
+    EXPECT_TRUE(cache.Lookup(42, 100, path));
+    EXPECT_EQ(path, "/usr/bin/old");
+    EXPECT_FALSE(cache.Lookup(42, 200, path));
+    
+    // Termination of the old process; the new one is resolved once
+    cache.Invalidate(42, 100);
+    EXPECT_EQ(cache.Resolve(42), "/usr/bin/new-42");
+    EXPECT_EQ(cache.Resolve(42), "/usr/bin/new-42");
+    EXPECT_EQ(queries, 1);
+    EXPECT_TRUE(cache.Lookup(42, 200, path));
+    
+    // An invalidation for another start time leaves the entry alone
+    cache.Invalidate(42, 100);
+    EXPECT_TRUE(cache.Lookup(42, path));
+    
+    ProcessIdentityStats stats = cache.GetStats();
+    EXPECT_EQ(stats.hits, 4u);
+    EXPECT_EQ(stats.misses, 2u);
+    EXPECT_EQ(stats.stale, 1u);
+    EXPECT_EQ(stats.resolutions, 1u);
+    EXPECT_EQ(stats.invalidations, 1u);
+    EXPECT_EQ(stats.entries, 1u);
+    EXPECT_NEAR(stats.HitRate(), 4.0 / 6.0, 1e-9);
+    
+    // Unresolvable processes are not cached
+    cache.SetResolver([](DWORD, ProcessIdentity&) { return false; });
+    EXPECT_EQ(cache.Resolve(7), "Unknown");
+    EXPECT_EQ(cache.GetStats().entries, 1u);
+}
+
+#ifdef __linux__
+TEST(ProcessIdentityCacheTest, QueriesRunningProcess) {
+    ProcessIdentity identity;
+    ASSERT_TRUE(ProcessIdentityCache::QueryProcess(static_cast<DWORD>(getpid()), identity));
+    EXPECT_EQ(identity.path, std::filesystem::read_symlink("/proc/self/exe").string());
+    EXPECT_GT(identity.start_time, 0u);
+    
+    ProcessIdentityCache cache;
+    ProcessIdentity refreshed;
+    ASSERT_TRUE(cache.Refresh(static_cast<DWORD>(getpid()), refreshed));
+    EXPECT_EQ(refreshed.start_time, identity.start_time);
+}
+#endif
+
+TEST(NotifyDecoderTest, DecodesRecordsIntoScratchBuffer) {
+    // Records in FILE_NOTIFY_INFORMATION layout: a.exe, U+00E9, a surrogate
+    // pair (U+1F4F7), an unpaired high surrogate, then one cut short
+    const std::vector<std::vector<uint16_t>> names = {
+        {'a', '.', 'e', 'x', 'e'}, {'d', '\\', 0x00E9}, {0xD83D, 0xDCF7}, {0xD83D, 'x'}, {'l', 'o', 's', 't'}
+    };
+    const size_t header = offsetof(FILE_NOTIFY_INFORMATION, FileName);
+    std::vector<BYTE> buffer;
+    for (size_t i = 0; i < names.size(); ++i) {
+        size_t offset = buffer.size();
+        size_t record = (header + names[i].size() * 2 + 3) & ~size_t(3);
+        buffer.resize(offset + record, 0);
+        DWORD fields[3] = {i + 1 < names.size() ? static_cast<DWORD>(record) : 0, FILE_ACTION_ADDED,
+                           static_cast<DWORD>(names[i].size() * 2)};
+        std::memcpy(&buffer[offset], fields, sizeof(fields));
+        for (size_t j = 0; j < names[i].size(); ++j) {
+            buffer[offset + header + 2 * j] = static_cast<BYTE>(names[i][j] & 0xFF);
+            buffer[offset + header + 2 * j + 1] = static_cast<BYTE>(names[i][j] >> 8);
+        }
+    }
+    
+    NotifyBufferDecoder decoder("C:\\Watch");
+    std::vector<std::string> paths;
+    size_t records = decoder.Decode(buffer.data(), buffer.size() - 4, [&paths](std::string_view path, DWORD action) {
+        EXPECT_EQ(action, static_cast<DWORD>(FILE_ACTION_ADDED));
+        paths.emplace_back(path);
+    });
+    
+    ASSERT_EQ(records, 4u);
+    EXPECT_EQ(paths[0], "C:\\Watch\\a.exe");
+    EXPECT_EQ(paths[1], "C:\\Watch\\d\\\xC3\xA9");
+    EXPECT_EQ(paths[2], "C:\\Watch\\\xF0\x9F\x93\xB7");
+    EXPECT_EQ(paths[3], "C:\\Watch\\\xEF\xBF\xBDx");
+    
+    // The scratch buffer is reused once it fits the longest name
+    size_t capacity = decoder.GetScratchCapacity();
+    decoder.Decode(buffer.data(), buffer.size(), [](std::string_view, DWORD) {});
+    EXPECT_EQ(decoder.GetScratchCapacity(), capacity);
+}
+
+TEST(ContentHasherTest, ComputesDigests) {
+    Sha256 empty;
+    EXPECT_EQ(empty.Final(), "e3b0c44298fc1c149afbf4c8996fb92427ae41e4649b934ca495991b7852b855");
+    
+    // Split across block boundaries; both hashes are incremental
+    std::string message = "abcdbcdecdefdefgefghfghighijhijkijkljklmklmnlmnomnopnopq";
+    Sha256 sha256;
+    sha256.Update(message.data(), 10);
+    sha256.Update(message.data() + 10, message.size() - 10);
+    EXPECT_EQ(sha256.Final(), "248d6a61d20638b8e5c026930c3e6039a33ce45964ff2167f6ecedd419db06c1");
+    
+    EXPECT_EQ(Xxh64().Final(), 0xEF46DB3751D8E999ULL);
+    std::string bytes;
+    for (int i = 0; i < 1280; ++i) {
+        bytes.push_back(static_cast<char>(i % 256));
+    }
+    Xxh64 xxh64;
+    for (size_t offset = 0; offset < bytes.size(); offset += 7) {
+        xxh64.Update(bytes.data() + offset, std::min<size_t>(7, bytes.size() - offset));
+    }
+    EXPECT_EQ(xxh64.Final(), 0xAFC184AD7938A354ULL);
+}
+
+TEST(ContentHasherTest, CachesByFileIdentity) {
+    std::filesystem::path path = std::filesystem::temp_directory_path() / "hips_hash_test.bin";
+    {
+        std::ofstream file(path, std::ios::binary);
+        file << "abc";
+    }
+    
+    ContentHasher hasher(1);
+    FileHashes first;
+    ASSERT_TRUE(hasher.Hash(path.string(), first));
+    EXPECT_EQ(first.sha256, "ba7816bf8f01cfea414140de5dae2223b00361a396177a9cb410ff61f20015ad");
+    EXPECT_EQ(first.Xxh64Hex(), "44bc2cf5ad770999");
+    EXPECT_EQ(first.size, 3u);
+    
+    FileHashes second;
+    ASSERT_TRUE(hasher.Hash(path.string(), second));
+    EXPECT_EQ(second.sha256, first.sha256);
+    EXPECT_EQ(hasher.GetStats().files_hashed, 1u);
+    EXPECT_EQ(hasher.GetStats().cache_hits, 1u);
+    
+    // A rewrite changes the identity and is hashed again, asynchronously
+    {
+        std::ofstream file(path, std::ios::binary | std::ios::app);
+        file << "d";
+    }
+    std::mutex mutex;
+    std::condition_variable done_cv;
+    bool done = false;
+    FileHashes rewritten;
+    ASSERT_TRUE(hasher.HashAsync(path.string(), [&](bool ok, const FileHashes& hashes) {
+        EXPECT_TRUE(ok);
+        std::lock_guard<std::mutex> lock(mutex);
+        rewritten = hashes;
+        done = true;
+        done_cv.notify_all();
+    }));
+    {
+        std::unique_lock<std::mutex> lock(mutex);
+        ASSERT_TRUE(done_cv.wait_for(lock, std::chrono::seconds(5), [&] { return done; }));
+    }
+    EXPECT_EQ(rewritten.sha256, "88d4266fd4e6338d13b845fcf289579d209c897823b9217da3e161936f031589");
+    EXPECT_EQ(hasher.GetStats().files_hashed, 2u);
+    
+    // Files over the size limit are not read
+    hasher.ClearCache();
+    hasher.SetMaxFileSize(2);
+    EXPECT_FALSE(hasher.Hash(path.string(), second));
+    std::filesystem::remove(path);
+}
+
+TEST(DirectorySnapshotTest, DiffReconstructsChanges) {
+    std::filesystem::path root = std::filesystem::temp_directory_path() / "hips_snapshot_test";
+    std::filesystem::remove_all(root);
+    std::filesystem::create_directories(root / "sub" / "deep");
+    auto write = [](const std::filesystem::path& path, const std::string& content) {
+        std::ofstream file(path);
+        file << content;
+    };
+    write(root / "kept.bin", "same");
+    write(root / "grown.bin", "a");
+    write(root / "sub" / "gone.bin", "x");
+    write(root / "sub" / "deep" / "hidden.bin", "x");
+    
+    WorkerPool pool(2);
+    DirectorySnapshot before = DirectorySnapshot::Capture(root.string(), 1, 1000, &pool);
+    EXPECT_FALSE(before.IsTruncated());
+    EXPECT_EQ(before.GetEntryCount(), 5u);     // deep/ is listed, its contents are below the depth
+    EXPECT_EQ(before.Find((root / "sub" / "deep" / "hidden.bin").string()), nullptr);
+    
+    write(root / "grown.bin", "abc");
+    std::filesystem::remove(root / "sub" / "gone.bin");
+    write(root / "sub" / "new.bin", "x");
+    DirectorySnapshot after = DirectorySnapshot::Capture(root.string(), 1, 1000, &pool);
+    
+    std::vector<std::pair<std::string, DWORD>> changes;
+    after.Diff(before, [&](const std::string& path, DWORD action) { changes.emplace_back(path, action); });
+    std::sort(changes.begin(), changes.end());
+    std::vector<std::pair<std::string, DWORD>> expected = {
+        {(root / "grown.bin").string(), FILE_ACTION_MODIFIED},
+        {(root / "sub" / "gone.bin").string(), FILE_ACTION_REMOVED},
+        {(root / "sub" / "new.bin").string(), FILE_ACTION_ADDED},
+    };
+    std::sort(expected.begin(), expected.end());
+    EXPECT_EQ(changes, expected);
+    
+    // A truncated capture reports no removals
+    DirectorySnapshot partial = DirectorySnapshot::Capture(root.string(), 1, 2, nullptr);
+    EXPECT_TRUE(partial.IsTruncated());
+    EXPECT_EQ(partial.GetEntryCount(), 2u);
+    size_t removals = 0;
+    partial.Diff(after, [&](const std::string&, DWORD action) { removals += action == FILE_ACTION_REMOVED; });
+    EXPECT_EQ(removals, 0u);
+    
+    // and diffing against one reports no additions
+    size_t additions = 0;
+    after.Diff(partial, [&](const std::string&, DWORD action) { additions += action == FILE_ACTION_ADDED; });
+    EXPECT_EQ(additions, 0u);
+    
+    std::filesystem::remove_all(root);
+}
+
+TEST(BaselineScannerTest, WalksToDepthAcrossWorkers) {
+    std::filesystem::path root = std::filesystem::temp_directory_path() / "hips_baseline_test";
+    std::filesystem::remove_all(root);
+    for (int i = 0; i < 8; ++i) {
+        std::filesystem::path directory = root / ("d" + std::to_string(i)) / "inner";
+        std::filesystem::create_directories(directory / "deep");
+        std::ofstream(root / ("d" + std::to_string(i)) / "top.bin") << "abc";
+        std::ofstream(directory / "mid.bin") << "abc";
+        std::ofstream(directory / "deep" / "hidden.bin") << "abc";
+    }
+    
+    auto pool = std::make_shared<WorkerPool>(4);
+    BaselineScanner scanner(pool, std::make_shared<ContentHasher>(1));
+    BaselineScanOptions options;
+    options.max_depth = 2;
+    options.threads = 4;
+    options.hash_contents = true;
+    std::mutex mutex;
+    std::vector<InventoryEntry> entries;
+    BaselineScanStats stats = scanner.Scan({root.string(), (root / "missing").string()}, options,
+                                           [&](const InventoryEntry& entry) {
+        std::lock_guard<std::mutex> lock(mutex);
+        entries.push_back(entry);
+    });
+    
+    // deep/ is listed, its contents are below the depth
+    EXPECT_FALSE(stats.truncated);
+    EXPECT_EQ(stats.files, 16u);
+    EXPECT_EQ(stats.directories, 24u);
+    EXPECT_EQ(stats.hashed_files, 16u);
+    EXPECT_EQ(stats.hashed_bytes, 48u);
+    EXPECT_EQ(entries.size(), 40u);
+    for (const auto& entry : entries) {
+        EXPECT_EQ(entry.path.find("hidden.bin"), std::string::npos);
+        if (!entry.IsDirectory()) {
+            EXPECT_TRUE(entry.hashed);
+            EXPECT_EQ(entry.size, 3u);
+            EXPECT_EQ(entry.hashes.sha256, "ba7816bf8f01cfea414140de5dae2223b00361a396177a9cb410ff61f20015ad");
+        }
+    }
+    
+    // The entry budget truncates, and a cancelled scanner stops at once
+    options.max_entries = 5;
+    EXPECT_TRUE(scanner.Scan({root.string()}, options, nullptr).truncated);
+    options.max_entries = 1000;
+    scanner.Cancel();
+    BaselineScanStats cancelled = scanner.Scan({root.string()}, options, nullptr);
+    EXPECT_TRUE(cancelled.truncated);
+    EXPECT_EQ(cancelled.files + cancelled.directories, 0u);
+    
+    // 2 KB at 10 KB/s, less the 100 ms burst
+    IoBudget budget(10 * 1024);
+    auto started = std::chrono::steady_clock::now();
+    budget.Consume(1024);
+    budget.Consume(1024);
+    EXPECT_GE(std::chrono::steady_clock::now() - started, std::chrono::milliseconds(80));
+    std::atomic<bool> stop(true);
+    EXPECT_FALSE(budget.Consume(1024 * 1024, &stop));
+    
+    // A large file at a low budget does not hold up a cancel
+    std::filesystem::remove_all(root);
+    std::filesystem::create_directories(root);
+    std::ofstream(root / "large.bin") << std::string(4 * 1024 * 1024, 'x');
+    BaselineScanner throttled(pool, std::make_shared<ContentHasher>(1));
+    options.io_bytes_per_second = 1024 * 1024;
+    std::thread canceller([&throttled]() {
+        std::this_thread::sleep_for(std::chrono::milliseconds(100));
+        throttled.Cancel();
+    });
+    started = std::chrono::steady_clock::now();
+    BaselineScanStats interrupted = throttled.Scan({root.string()}, options, nullptr);
+    canceller.join();
+    EXPECT_LT(std::chrono::steady_clock::now() - started, std::chrono::seconds(1));
+    EXPECT_TRUE(interrupted.truncated);
+    EXPECT_EQ(interrupted.hashed_files, 0u);
+    
+    std::filesystem::remove_all(root);
+}
+
+TEST(InventoryDatabaseTest, PersistsAcrossReopen) {
+    const std::string path = (std::filesystem::temp_directory_path() / "hips_inventory_test.db").string();
+    std::filesystem::remove(path);
+    auto make = [](const std::string& file, uint64_t size) {
+        InventoryEntry entry;
+        entry.path = "/data/" + file;
+        entry.size = size;
+        entry.modified_ns = static_cast<int64_t>(size) * 1000;
+        entry.attributes = 0644;
+        return entry;
+    };
+    
+    InventoryDatabase database;
+    ASSERT_TRUE(database.Open(path));   // Missing files open empty
+    for (int i = 0; i < 100; ++i) {
+        database.Put(make("file" + std::to_string(i), i));
+    }
+    InventoryEntry hashed = make("hashed.exe", 3);
+    hashed.hashed = true;
+    hashed.hashes.sha256 = "ba7816bf8f01cfea414140de5dae2223b00361a396177a9cb410ff61f20015ad";
+    hashed.hashes.xxh64 = 0x44bc2cf5ad770999ULL;
+    database.Put(hashed);
+    ASSERT_TRUE(database.Flush());
+    EXPECT_EQ(database.GetStats().compacted_records, 101u);
+    
+    // Updates and removals go to the log until the next compaction
+    database.Put(make("file7", 700));
+    database.Remove("/data/file8");
+    database.Remove("/data/missing");
+    ASSERT_TRUE(database.Flush());
+    EXPECT_EQ(database.Size(), 100u);
+    database.Close();
+    
+    // A torn append is ignored and cut off by the next flush
+    {
+        std::ofstream torn(path, std::ios::binary | std::ios::app);
+        torn << "partial";
+    }
+    InventoryDatabase reopened;
+    ASSERT_TRUE(reopened.Open(path));
+    InventoryDatabaseStats stats = reopened.GetStats();
+    EXPECT_EQ(stats.entries, 100u);
+    EXPECT_EQ(stats.log_records, 2u);
+    InventoryEntry entry;
+    ASSERT_TRUE(reopened.Lookup("/data/file7", entry));
+    EXPECT_EQ(entry.size, 700u);
+    EXPECT_FALSE(reopened.Lookup("/data/file8", entry));
+    ASSERT_TRUE(reopened.Lookup("/data/file9", entry));
+    EXPECT_EQ(entry.modified_ns, 9000);
+    EXPECT_EQ(entry.attributes, 0644u);
+    ASSERT_TRUE(reopened.Lookup("/data/hashed.exe", entry));
+    EXPECT_TRUE(entry.hashed);
+    EXPECT_EQ(entry.hashes.sha256, hashed.hashes.sha256);
+    EXPECT_EQ(entry.hashes.xxh64, hashed.hashes.xxh64);
+    
+    reopened.Put(make("file100", 100));
+    ASSERT_TRUE(reopened.Flush());
+    ASSERT_TRUE(reopened.Compact());
+    stats = reopened.GetStats();
+    EXPECT_EQ(stats.entries, 101u);
+    EXPECT_EQ(stats.compacted_records, 101u);
+    EXPECT_EQ(stats.log_records, 0u);
+    size_t visited = 0;
+    reopened.ForEach([&](const InventoryEntry&) { visited++; });
+    EXPECT_EQ(visited, 101u);
+    EXPECT_TRUE(reopened.Lookup("/data/file100", entry));
+    
+    // Root markers survive the log and a compaction, and are not entries
+    EXPECT_FALSE(reopened.IsRootComplete("/data", 1));
+    reopened.MarkRootComplete("/data", 3);
+    ASSERT_TRUE(reopened.Flush());
+    reopened.Close();
+    ASSERT_TRUE(reopened.Open(path));
+    EXPECT_TRUE(reopened.IsRootComplete("/data", 3));
+    EXPECT_FALSE(reopened.IsRootComplete("/data", 4));
+    EXPECT_FALSE(reopened.IsRootComplete("/other", 0));
+    ASSERT_TRUE(reopened.Compact());
+    reopened.Close();
+    ASSERT_TRUE(reopened.Open(path));
+    EXPECT_TRUE(reopened.IsRootComplete("/data", 3));
+    EXPECT_EQ(reopened.Size(), 101u);
+    visited = 0;
+    reopened.ForEach([&](const InventoryEntry&) { visited++; });
+    EXPECT_EQ(visited, 101u);
+    EXPECT_FALSE(reopened.Lookup("/data", entry));
+    reopened.Close();
+    
+    // Not an inventory database
+    {
+        std::ofstream garbage(path, std::ios::binary | std::ios::trunc);
+        garbage << std::string(128, 'x');
+    }
+    EXPECT_FALSE(reopened.Open(path));
+    std::filesystem::remove(path);
+}
+
+#ifdef __linux__
+// Poll until condition holds or two seconds pass
+static bool WaitFor(const std::function<bool()>& condition) {
+    for (int i = 0; i < 200; ++i) {
+        if (condition()) {
+            return true;
+        }
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    }
+    return condition();
+}
+
+TEST_F(FileMonitorTest, LinuxBackendReportsFileEvents) {
+    std::mutex mutex;
+    std::vector<SecurityEvent> events;
+    monitor->RegisterCallback([&](const SecurityEvent& event) {
+        std::lock_guard<std::mutex> lock(mutex);
+        events.push_back(event);
+    });
+    
+    EXPECT_TRUE(monitor->Initialize());
+    monitor->SetIncludedExtensions({".exe"});
+    monitor->AddWatchPath(test_dir.string());
+    ASSERT_TRUE(monitor->Start());
+    
+    std::filesystem::path exe_file = std::filesystem::canonical(test_dir) / "dropper.exe";
+    {
+        std::ofstream file(exe_file);
+        file << "MZ";
+    }
+    std::filesystem::remove(exe_file);
+    
+    EXPECT_TRUE(WaitFor([&]() {
+        std::lock_guard<std::mutex> lock(mutex);
+        bool added = false, removed = false;
+        for (const auto& event : events) {
+            if (event.target_path == exe_file.string()) {
+                added |= event.type == EventType::FILE_ACCESS;
+                removed |= event.type == EventType::FILE_DELETION;
+            }
+        }
+        return added && removed;
+    }));
+    EXPECT_TRUE(monitor->Stop());
+}
+
+TEST_F(FileMonitorTest, ShardsManyRootsAcrossWorkers) {
+    std::mutex mutex;
+    std::vector<std::string> paths;
+    monitor->RegisterCallback([&](const SecurityEvent& event) {
+        std::lock_guard<std::mutex> lock(mutex);
+        paths.push_back(event.target_path);
+    });
+    
+    // More roots than WaitForMultipleObjects could ever take
+    EXPECT_TRUE(monitor->Initialize());
+    monitor->SetIncludedExtensions({".exe"});
+    monitor->SetWorkerThreads(3);
+    const std::filesystem::path base = std::filesystem::canonical(test_dir);
+    for (int i = 0; i < 80; ++i) {
+        std::filesystem::create_directories(base / ("root" + std::to_string(i)));
+        monitor->AddWatchPath((base / ("root" + std::to_string(i))).string());
+    }
+    monitor->AddWatchPath((base / "missing").string());
+    ASSERT_TRUE(monitor->Start());
+    
+    // Remove one root; the others keep reporting
+    monitor->RemoveWatchPath((base / "root0").string());
+    for (int i : {1, 40, 79}) {
+        std::ofstream file(base / ("root" + std::to_string(i)) / "tool.exe");
+        file << "MZ";
+    }
+    
+    EXPECT_TRUE(WaitFor([&]() {
+        std::lock_guard<std::mutex> lock(mutex);
+        for (int i : {1, 40, 79}) {
+            auto expected = (base / ("root" + std::to_string(i)) / "tool.exe").string();
+            if (std::find(paths.begin(), paths.end(), expected) == paths.end()) {
+                return false;
+            }
+        }
+        return true;
+    }));
+    EXPECT_TRUE(monitor->Stop());
+}
+
+TEST_F(FileMonitorTest, AttachesContentHashes) {
+    std::mutex mutex;
+    std::vector<SecurityEvent> events;
+    monitor->RegisterCallback([&](const SecurityEvent& event) {
+        std::lock_guard<std::mutex> lock(mutex);
+        events.push_back(event);
+    });
+    
+    auto hasher = std::make_shared<ContentHasher>(1);
+    EXPECT_TRUE(monitor->Initialize());
+    monitor->SetIncludedExtensions({".exe"});
+    monitor->SetContentHasher(hasher);
+    monitor->SetContentHashing(true);
+    const std::filesystem::path base = std::filesystem::canonical(test_dir);
+    monitor->AddWatchPath(base.string());
+    ASSERT_TRUE(monitor->Start());
+    
+    {
+        std::ofstream file(base / "hashed.exe");
+        file << "abc";
+    }
+    EXPECT_TRUE(WaitFor([&]() {
+        std::lock_guard<std::mutex> lock(mutex);
+        for (const auto& event : events) {
+            auto sha256 = event.metadata.find("sha256");
+            if (sha256 != event.metadata.end() &&
+                sha256->second == "ba7816bf8f01cfea414140de5dae2223b00361a396177a9cb410ff61f20015ad") {
+                return event.metadata.at("xxh64") == "44bc2cf5ad770999";
+            }
+        }
+        return false;
+    }));
+    EXPECT_TRUE(monitor->Stop());
+    EXPECT_GE(hasher->GetStats().files_hashed, 1u);
+}
+
+TEST_F(FileMonitorTest, BaselineScanReportsExistingExecutables) {
+    const std::filesystem::path base = std::filesystem::canonical(test_dir);
+    std::filesystem::create_directories(base / "a" / "b");
+    std::ofstream(base / "a" / "dropper.exe") << "abc";
+    std::ofstream(base / "a" / "notes.txt") << "abc";
+    std::ofstream(base / "a" / "b" / "deeper.exe") << "abc";
+    
+    // Without an extension only the execute bit marks an executable, and
+    // a link to one is not reported itself
+    std::ofstream(base / "a" / "tool") << "abc";
+    std::ofstream(base / "a" / "data") << "abc";
+    std::filesystem::permissions(base / "a" / "tool", std::filesystem::perms::owner_exec,
+                                 std::filesystem::perm_options::add);
+    std::filesystem::create_symlink(base / "a" / "tool", base / "a" / "tool_link");
+    
+    std::mutex mutex;
+    std::vector<SecurityEvent> events;
+    monitor->RegisterCallback([&](const SecurityEvent& event) {
+        std::lock_guard<std::mutex> lock(mutex);
+        events.push_back(event);
+    });
+    
+    EXPECT_TRUE(monitor->Initialize());
+    for (const char* path : {"/etc", "/usr/bin", "/usr/sbin", "/usr/local/bin"}) {
+        monitor->RemoveWatchPath(path);
+    }
+    monitor->SetScanDepth(1);
+    monitor->SetContentHasher(std::make_shared<ContentHasher>(1));
+    monitor->SetContentHashing(true);
+    monitor->SetBaselineScanOnStart(true);
+    monitor->AddWatchPath(base.string());
+    EXPECT_FALSE(monitor->RunBaselineScan());      // Not running
+    ASSERT_TRUE(monitor->Start());
+    
+    // The scan on start and the one on demand may overlap
+    EXPECT_TRUE(WaitFor([&]() { return monitor->GetBaselineInventory() != nullptr; }));
+    while (!monitor->RunBaselineScan()) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    }
+    auto inventory = monitor->GetBaselineInventory();
+    ASSERT_NE(inventory, nullptr);
+    BaselineScanStats stats = monitor->GetBaselineScanStats();
+    EXPECT_EQ(stats.files, 5u);     // b/ is below the scan depth
+    EXPECT_EQ(stats.directories, 2u);
+    EXPECT_GE(inventory->size(), 7u);
+    
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        std::map<std::string, size_t> baseline;
+        for (const auto& event : events) {
+            if (event.metadata.count("baseline")) {
+                baseline[std::filesystem::path(event.target_path).filename().string()]++;
+                EXPECT_EQ(event.metadata.at("sha256"),
+                          "ba7816bf8f01cfea414140de5dae2223b00361a396177a9cb410ff61f20015ad");
+            }
+        }
+        // Once per scan
+        std::map<std::string, size_t> expected = {{"dropper.exe", 2}, {"tool", 2}};
+        EXPECT_EQ(baseline, expected);
+    }
+    EXPECT_TRUE(monitor->Stop());
+}
+
+TEST_F(FileMonitorTest, ReportsOfflineChangesFromInventory) {
+    const std::filesystem::path base = std::filesystem::canonical(test_dir);
+    const std::string database = (base / "inventory.db").string();
+    std::filesystem::create_directories(base / "tree");
+    std::ofstream(base / "tree" / "kept.exe") << "abc";
+    std::ofstream(base / "tree" / "changed.exe") << "abc";
+    std::ofstream(base / "tree" / "deleted.exe") << "abc";
+    
+    std::mutex mutex;
+    std::vector<SecurityEvent> events;
+    auto run = [&](FileSystemMonitor& instance) {
+        instance.RegisterCallback([&](const SecurityEvent& event) {
+            std::lock_guard<std::mutex> lock(mutex);
+            events.push_back(event);
+        });
+        EXPECT_TRUE(instance.Initialize());
+        for (const char* path : {"/etc", "/usr/bin", "/usr/sbin", "/usr/local/bin"}) {
+            instance.RemoveWatchPath(path);
+        }
+        instance.SetIncludedExtensions({".exe"});
+        instance.SetContentHasher(std::make_shared<ContentHasher>(1));
+        instance.SetContentHashing(true);
+        instance.SetBaselineScanOnStart(true);
+        instance.SetInventoryDatabase(database);
+        instance.AddWatchPath((base / "tree").string());
+        ASSERT_TRUE(instance.Start());
+        EXPECT_TRUE(WaitFor([&]() { return instance.GetBaselineInventory() != nullptr; }));
+        EXPECT_TRUE(instance.Stop());
+    };
+    
+    run(*monitor);
+    EXPECT_EQ(monitor->GetInventoryDatabaseStats().entries, 3u);
+    monitor->Shutdown();
+    
+    // While nothing is watching; the rewrite keeps size and mtime
+    auto mtime = std::filesystem::last_write_time(base / "tree" / "changed.exe");
+    std::ofstream(base / "tree" / "changed.exe") << "xyz";
+    std::filesystem::last_write_time(base / "tree" / "changed.exe", mtime);
+    std::filesystem::remove(base / "tree" / "deleted.exe");
+    std::ofstream(base / "tree" / "added.exe") << "abc";
+    
+    events.clear();
+    FileSystemMonitor restarted;
+    run(restarted);
+    std::map<std::string, EventType> offline;
+    for (const auto& event : events) {
+        EXPECT_EQ(event.metadata.count("baseline"), 0u);
+        if (event.metadata.count("offline")) {
+            offline[std::filesystem::path(event.target_path).filename().string()] = event.type;
+        }
+    }
+    std::map<std::string, EventType> expected = {
+        {"added.exe", EventType::FILE_ACCESS},
+        {"changed.exe", EventType::FILE_MODIFICATION},
+        {"deleted.exe", EventType::FILE_DELETION},
+    };
+    EXPECT_EQ(offline, expected);
+    EXPECT_EQ(restarted.GetInventoryDatabaseStats().entries, 3u);
+    restarted.Shutdown();
+}
+
+TEST_F(FileMonitorTest, PartialInventoryIsNotDiffed) {
+    const std::filesystem::path base = std::filesystem::canonical(test_dir);
+    const std::string database = (base / "inventory.db").string();
+    const std::string tree = (base / "tree").string();
+    std::filesystem::create_directories(base / "tree");
+    std::ofstream(base / "tree" / "seen.exe") << "abc";
+    std::ofstream(base / "tree" / "unseen.exe") << "abc";
+    
+    // What a cancelled scan leaves behind: one entry and no root marker
+    {
+        InventoryDatabase partial;
+        ASSERT_TRUE(partial.Open(database));
+        InventoryEntry entry;
+        entry.path = (base / "tree" / "seen.exe").string();
+        entry.size = 3;
+        partial.Put(entry);
+        ASSERT_TRUE(partial.Flush());
+    }
+    
+    std::mutex mutex;
+    std::vector<SecurityEvent> events;
+    auto run = [&](FileSystemMonitor& instance) {
+        instance.RegisterCallback([&](const SecurityEvent& event) {
+            std::lock_guard<std::mutex> lock(mutex);
+            events.push_back(event);
+        });
+        EXPECT_TRUE(instance.Initialize());
+        for (const char* path : {"/etc", "/usr/bin", "/usr/sbin", "/usr/local/bin"}) {
+            instance.RemoveWatchPath(path);
+        }
+        instance.SetIncludedExtensions({".exe"});
+        instance.SetBaselineScanOnStart(true);
+        instance.SetInventoryDatabase(database);
+        instance.AddWatchPath(tree);
+        ASSERT_TRUE(instance.Start());
+        EXPECT_TRUE(WaitFor([&]() { return instance.GetBaselineInventory() != nullptr; }));
+        EXPECT_TRUE(instance.Stop());
+    };
+    
+    run(*monitor);
+    size_t baseline = 0;
+    for (const auto& event : events) {
+        EXPECT_EQ(event.metadata.count("offline"), 0u) << event.target_path;
+        baseline += event.metadata.count("baseline");
+    }
+    EXPECT_EQ(baseline, 2u);
+    monitor->Shutdown();
+    
+    // The completed scan marked the root, so the next start diffs it
+    std::ofstream(base / "tree" / "added.exe") << "abc";
+    events.clear();
+    FileSystemMonitor restarted;
+    run(restarted);
+    std::vector<std::string> offline;
+    for (const auto& event : events) {
+        if (event.metadata.count("offline")) {
+            offline.push_back(std::filesystem::path(event.target_path).filename().string());
+        }
+    }
+    EXPECT_EQ(offline, std::vector<std::string>{"added.exe"});
+    restarted.Shutdown();
+}
+
+TEST_F(FileMonitorTest, OverflowIsRebuiltFromSnapshot) {
+    const std::filesystem::path base = std::filesystem::canonical(test_dir);
+    {
+        std::ofstream seed(base / "seed.exe");
+        seed << "MZ";
+    }
+    
+    // Hold the reactor in the first callback so the kernel queue overflows
+    std::mutex mutex;
+    std::condition_variable released_cv;
+    bool released = false;
+    std::vector<SecurityEvent> events;
+    monitor->RegisterCallback([&](const SecurityEvent& event) {
+        std::unique_lock<std::mutex> lock(mutex);
+        released_cv.wait(lock, [&] { return released; });
+        events.push_back(event);
+    });
+    
+    EXPECT_TRUE(monitor->Initialize());
+    monitor->SetIncludedExtensions({".exe"});
+    monitor->AddWatchPath(base.string());
+    ASSERT_TRUE(monitor->Start());
+    auto root_stats = [&]() {
+        for (const auto& stats : monitor->GetWatchRootStats()) {
+            if (stats.path == base.string()) {
+                return stats;
+            }
+        }
+        return WatchRootStats();
+    };
+    ASSERT_TRUE(WaitFor([&]() { return root_stats().snapshot_entries == 1; }));
+    
+    for (int i = 0; i < 20000; ++i) {
+        std::ofstream file(base / ("burst" + std::to_string(i) + ".exe"));
+    }
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        released = true;
+    }
+    released_cv.notify_all();
+    
+    EXPECT_TRUE(WaitFor([&]() { return root_stats().rescans >= 1; }));
+    WatchRootStats stats = root_stats();
+    EXPECT_GE(stats.overflows, 1u);
+    EXPECT_GE(stats.reconstructed_changes, 1u);
+    EXPECT_GT(stats.buffer_bytes, 64u * 1024);
+    
+    // The last files were created after the queue filled
+    const std::string last = (base / "burst19999.exe").string();
+    EXPECT_TRUE(WaitFor([&]() {
+        std::lock_guard<std::mutex> lock(mutex);
+        return std::any_of(events.begin(), events.end(), [&](const SecurityEvent& event) {
+            return event.target_path == last && event.metadata.count("reconstructed");
+        });
+    }));
+    EXPECT_TRUE(monitor->Stop());
+}
+
+class LinuxFileWatcherTest : public ::testing::Test {
+protected:
+    void SetUp() override {
+        root = std::filesystem::temp_directory_path() / "hips_watcher_test";
+        std::filesystem::remove_all(root);
+        std::filesystem::create_directories(root);
+        root = std::filesystem::canonical(root);
+    }
+    
+    void TearDown() override {
+        watcher.Stop();
+        if (runner.joinable()) {
+            runner.join();
+        }
+        watcher.Close();
+        
+        std::error_code ec;
+        std::filesystem::remove_all(root, ec);
+    }
+    
+    bool Start(bool fanotify) {
+        watcher.SetFanotifyEnabled(fanotify);
+        if (!watcher.Open({root.string()}, 3, [this](const LinuxFileWatcher::Change& change) {
+                std::lock_guard<std::mutex> lock(mutex);
+                changes.push_back(change);
+            })) {
+            return false;
+        }
+        runner = std::thread([this]() { watcher.Run(); });
+        return true;
+    }
+    
+    bool Seen(const std::filesystem::path& path, DWORD action, DWORD process_id = 0) {
+        return WaitFor([&]() {
+            std::lock_guard<std::mutex> lock(mutex);
+            for (const auto& change : changes) {
+                if (change.path == path.string() && change.action == action &&
+                    (process_id == 0 || change.process_id == process_id)) {
+                    return true;
+                }
+            }
+            return false;
+        });
+    }
+    
+    std::filesystem::path root;
+    LinuxFileWatcher watcher;
+    std::thread runner;
+    std::mutex mutex;
+    std::vector<LinuxFileWatcher::Change> changes;
+};
+
+TEST_F(LinuxFileWatcherTest, InotifyWatchesNewDirectories) {
+    ASSERT_TRUE(Start(false));
+    EXPECT_EQ(watcher.GetBackend(), LinuxFileWatcher::Backend::INOTIFY);
+    EXPECT_EQ(watcher.GetWatchCount(), 1);
+    
+    // A directory created after Open() is watched as it appears
+    std::filesystem::create_directories(root / "new");
+    ASSERT_TRUE(Seen(root / "new", FILE_ACTION_ADDED));
+    {
+        std::ofstream file(root / "new" / "payload.bin");
+        file << "data";
+    }
+    EXPECT_TRUE(Seen(root / "new" / "payload.bin", FILE_ACTION_ADDED));
+    EXPECT_TRUE(Seen(root / "new" / "payload.bin", FILE_ACTION_MODIFIED));
+    EXPECT_EQ(watcher.GetWatchCount(), 2);
+    
+    std::filesystem::rename(root / "new" / "payload.bin", root / "moved.bin");
+    EXPECT_TRUE(Seen(root / "new" / "payload.bin", FILE_ACTION_RENAMED_OLD_NAME));
+    EXPECT_TRUE(Seen(root / "moved.bin", FILE_ACTION_RENAMED_NEW_NAME));
+    
+    // Watches stop at the depth limit
+    std::filesystem::create_directories(root / "new" / "a" / "b" / "c");
+    EXPECT_TRUE(Seen(root / "new" / "a" / "b", FILE_ACTION_ADDED));
+    EXPECT_TRUE(WaitFor([&]() { return watcher.GetWatchCount() == 4; }));
+}
+
+TEST_F(LinuxFileWatcherTest, FanotifyReportsActingProcess) {
+    ASSERT_TRUE(Start(true));
+    if (watcher.GetBackend() != LinuxFileWatcher::Backend::FANOTIFY) {
+        GTEST_SKIP() << "fanotify is not permitted here";
+    }
+    
+    const DWORD self = static_cast<DWORD>(getpid());
+    std::filesystem::create_directories(root / "sub");
+    {
+        std::ofstream file(root / "sub" / "payload.bin");
+        file << "data";
+    }
+    std::filesystem::remove(root / "sub" / "payload.bin");
+    
+    EXPECT_TRUE(Seen(root / "sub", FILE_ACTION_ADDED, self));
+    EXPECT_TRUE(Seen(root / "sub" / "payload.bin", FILE_ACTION_ADDED, self));
+    EXPECT_TRUE(Seen(root / "sub" / "payload.bin", FILE_ACTION_MODIFIED, self));
+    EXPECT_TRUE(Seen(root / "sub" / "payload.bin", FILE_ACTION_REMOVED, self));
+}
+
+TEST_F(LinuxFileWatcherTest, MissingRootsFail) {
+    EXPECT_FALSE(watcher.Open({(root / "missing").string()}, 3, nullptr));
+    EXPECT_EQ(watcher.GetBackend(), LinuxFileWatcher::Backend::NONE);
+}
+
+TEST_F(LinuxFileWatcherTest, PartitionKeepsFilesystemsTogether) {
+    std::filesystem::create_directories(root / "a");
+    std::filesystem::create_directories(root / "b");
+    std::vector<std::string> roots = {(root / "a").string(), "/proc", (root / "b").string(),
+                                      (root / "missing").string()};
+    
+    auto shards = LinuxFileWatcher::PartitionRoots(roots, 4);
+    ASSERT_EQ(shards.size(), 2u);
+    EXPECT_EQ(shards[0], (std::vector<std::string>{(root / "a").string(), (root / "b").string()}));
+    EXPECT_EQ(shards[1], std::vector<std::string>{"/proc"});
+    
+    shards = LinuxFileWatcher::PartitionRoots(roots, 1);
+    ASSERT_EQ(shards.size(), 1u);
+    EXPECT_EQ(shards[0].size(), 3u);
+}
+
+class FileAccessGuardTest : public ::testing::Test {
+protected:
+    void SetUp() override {
+        root = std::filesystem::temp_directory_path() / "hips_guard_test";
+        std::filesystem::remove_all(root);
+        std::filesystem::create_directories(root);
+        root = std::filesystem::canonical(root);
+        
+        // Files exist before the guard holds opens
+        for (const char* name : {"allowed.bin", "blocked.bin"}) {
+            std::ofstream file(root / name);
+            file << "data";
+        }
+    }
+    
+    void TearDown() override {
+        guard.Stop();
+        std::error_code ec;
+        std::filesystem::remove_all(root, ec);
+    }
+    
+    // Result of open(2): 0 on success, errno otherwise
+    static int TryOpen(const std::filesystem::path& path) {
+        int fd = open(path.c_str(), O_RDONLY);
+        if (fd < 0) {
+            return errno;
+        }
+        close(fd);
+        return 0;
+    }
+    
+    std::filesystem::path root;
+    FileAccessGuard guard;
+};
+
+TEST_F(FileAccessGuardTest, DeniedOpensFail) {
+    std::atomic<int> denied_calls(0);
+    FileAccessDecider decider = [&](const FileAccessRequest& request) {
+        if (request.path == (root / "blocked.bin").string()) {
+            EXPECT_EQ(request.process_id, static_cast<DWORD>(getpid()));
+            EXPECT_FALSE(request.process_path.empty());
+            denied_calls++;
+            return false;
+        }
+        return true;
+    };
+    if (!guard.Start({root.string()}, 3, decider, std::chrono::milliseconds(1000))) {
+        GTEST_SKIP() << "fanotify permission events are not permitted here";
+    }
+    
+    EXPECT_EQ(TryOpen(root / "blocked.bin"), EPERM);
+    EXPECT_EQ(TryOpen(root / "allowed.bin"), 0);
+    EXPECT_EQ(denied_calls.load(), 1);
+    
+    AccessDecisionStats stats = guard.GetStats();
+    EXPECT_GE(stats.decisions, 2u);
+    EXPECT_EQ(stats.denied, 1u);
+    EXPECT_EQ(stats.timed_out, 0u);
+    EXPECT_GT(stats.max_us, 0.0);
+}
+
+TEST_F(FileAccessGuardTest, SlowDecidersFailOpen) {
+    FileAccessDecider decider = [](const FileAccessRequest&) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(300));
+        return false;
+    };
+    if (!guard.Start({root.string()}, 3, decider, std::chrono::milliseconds(20))) {
+        GTEST_SKIP() << "fanotify permission events are not permitted here";
+    }
+    
+    auto started = std::chrono::steady_clock::now();
+    EXPECT_EQ(TryOpen(root / "blocked.bin"), 0);
+    EXPECT_LT(std::chrono::steady_clock::now() - started, std::chrono::milliseconds(250));
+    EXPECT_GE(guard.GetStats().timed_out, 1u);
+}
+
+TEST_F(FileAccessGuardTest, VerdictsAreCached) {
+    std::atomic<int> calls(0);
+    FileAccessDecider decider = [&](const FileAccessRequest& request) {
+        if (request.path == (root / "blocked.bin").string()) {
+            calls++;
+            return false;
+        }
+        return true;
+    };
+    if (!guard.Start({root.string()}, 3, decider, std::chrono::milliseconds(1000))) {
+        GTEST_SKIP() << "fanotify permission events are not permitted here";
+    }
+    
+    for (int i = 0; i < 5; ++i) {
+        EXPECT_EQ(TryOpen(root / "blocked.bin"), EPERM);
+    }
+    EXPECT_EQ(calls.load(), 1);
+    EXPECT_GE(guard.GetStats().cache_hits, 4u);
+    
+    // Cleared verdicts are decided again
+    guard.ClearVerdictCache();
+    EXPECT_EQ(TryOpen(root / "blocked.bin"), EPERM);
+    EXPECT_EQ(calls.load(), 2);
+}
+
+TEST_F(FileAccessGuardTest, VerdictsFromBeforeARuleChangeAreNotCached) {
+    std::atomic<int> calls(0);
+    FileAccessDecider decider = [&](const FileAccessRequest& request) {
+        if (request.path == (root / "blocked.bin").string()) {
+            // The rules change while the first decision is under way
+            if (calls++ == 0) {
+                guard.ClearVerdictCache();
+            }
+            return false;
+        }
+        return true;
+    };
+    if (!guard.Start({root.string()}, 3, decider, std::chrono::milliseconds(1000))) {
+        GTEST_SKIP() << "fanotify permission events are not permitted here";
+    }
+    
+    EXPECT_EQ(TryOpen(root / "blocked.bin"), EPERM);
+    EXPECT_EQ(TryOpen(root / "blocked.bin"), EPERM);
+    EXPECT_EQ(calls.load(), 2);
+    EXPECT_EQ(TryOpen(root / "blocked.bin"), EPERM);
+    EXPECT_EQ(calls.load(), 2);
+}
+
+TEST(FileAccessGuardEventsTest, UnknownVersionEventsAreAllowedAndClosed) {
+    // A pipe stands in for the fanotify descriptor and collects responses
+    int responses[2];
+    ASSERT_EQ(pipe(responses), 0);
+    
+    std::vector<int> fds = {open("/dev/null", O_RDONLY), -1, open("/dev/null", O_RDONLY)};
+    ASSERT_GE(fds[0], 0);
+    ASSERT_GE(fds[2], 0);
+    alignas(struct fanotify_event_metadata) char buffer[3 * sizeof(struct fanotify_event_metadata)];
+    for (size_t i = 0; i < fds.size(); ++i) {
+        struct fanotify_event_metadata event = {};
+        event.event_len = sizeof(event);
+        event.vers = FANOTIFY_METADATA_VERSION + 1;
+        event.metadata_len = sizeof(event);
+        event.fd = fds[i];
+        std::memcpy(buffer + i * sizeof(event), &event, sizeof(event));
+    }
+    
+    EXPECT_EQ(FileAccessGuard::AllowEvents(responses[1], buffer, sizeof(buffer)), 2u);
+    for (int fd : {fds[0], fds[2]}) {
+        EXPECT_EQ(fcntl(fd, F_GETFD), -1);
+        EXPECT_EQ(errno, EBADF);
+        
+        struct fanotify_response response;
+        ASSERT_EQ(read(responses[0], &response, sizeof(response)), static_cast<ssize_t>(sizeof(response)));
+        EXPECT_EQ(response.fd, fd);
+        EXPECT_EQ(response.response, static_cast<uint32_t>(FAN_ALLOW));
+    }
+    close(responses[0]);
+    close(responses[1]);
+}
+#endif
+
 int main(int argc, char** argv) {
     ::testing::InitGoogleTest(&argc, argv);
     return RUN_ALL_TESTS();
@@ -1,7 +1,11 @@
 #include <gtest/gtest.h>
 #include "hips_core.h"
+#include "self_protection.h"
 #include <thread>
 #include <chrono>
+#include <cstdio>
+#include <fstream>
+#include <vector>
 
 using namespace HIPS;
 
@@ -169,6 +173,72 @@ TEST_F(HIPSEngineTest, StopWithoutStartTest) {
 }
 
 // Utility function tests
+TEST_F(HIPSEngineTest, ThreatSignatureLoading) {
+    EXPECT_FALSE(engine->UpdateThreatSignatures("/nonexistent/signatures.txt"));
+    
+    const std::string path = "hips_test_signatures.txt";
+    {
+        std::ofstream signatures(path);
+        signatures << "# known bad\n"
+                   << "BA7816BF8F01CFEA414140DE5DAE2223B00361A396177A9CB410FF61F20015AD Test.Dropper\n"
+                   << "not-a-hash\n";
+    }
+    EXPECT_TRUE(engine->UpdateThreatSignatures(path));
+    std::remove(path.c_str());
+}
+
+TEST_F(HIPSEngineTest, ThreatSignatureMatchIsCritical) {
+    SecurityEvent event;
+    event.type = EventType::FILE_MODIFICATION;
+    event.threat_level = ThreatLevel::LOW;
+    event.process_id = 0;
+    event.thread_id = 0;
+    event.target_path = "/tmp/dropped.bin";
+    GetSystemTime(&event.timestamp);
+    EXPECT_FALSE(engine->SubmitEvent(event));     // Not initialized
+    
+    EXPECT_TRUE(engine->Initialize());
+    const std::string path = "hips_test_signatures.txt";
+    {
+        std::ofstream signatures(path);
+        signatures << "BA7816BF8F01CFEA414140DE5DAE2223B00361A396177A9CB410FF61F20015AD Test.Dropper\n";
+    }
+    ASSERT_TRUE(engine->UpdateThreatSignatures(path));
+    std::remove(path.c_str());
+    
+    std::vector<SecurityEvent> received;
+    engine->RegisterEventHandler(EventType::FILE_MODIFICATION,
+        [&received](const SecurityEvent& handled) { received.push_back(handled); });
+    
+    // Monitors report hashes in lower case
+    event.metadata["sha256"] = "ba7816bf8f01cfea414140de5dae2223b00361a396177a9cb410ff61f20015ad";
+    EXPECT_TRUE(engine->SubmitEvent(event));
+    event.metadata["sha256"] = std::string(64, '0');
+    EXPECT_TRUE(engine->SubmitEvent(event));
+    
+    ASSERT_EQ(received.size(), 2u);
+    EXPECT_EQ(received[0].threat_level, ThreatLevel::CRITICAL);
+    EXPECT_EQ(received[0].metadata.at("threat_signature"), "Test.Dropper");
+    EXPECT_EQ(received[1].threat_level, ThreatLevel::LOW);
+    EXPECT_EQ(received[1].metadata.count("threat_signature"), 0u);
+}
+
+TEST(SelfProtectionHashTest, VerifyFileHash) {
+    const std::string path = "hips_test_verify.bin";
+    {
+        std::ofstream file(path, std::ios::binary);
+        file << "abc";
+    }
+    SelfProtectionEngine protection;
+    EXPECT_TRUE(protection.VerifyFileHash(path, "ba7816bf8f01cfea414140de5dae2223b00361a396177a9cb410ff61f20015ad"));
+    EXPECT_TRUE(protection.VerifyFileHash(path, "BA7816BF8F01CFEA414140DE5DAE2223B00361A396177A9CB410FF61F20015AD"));
+    EXPECT_FALSE(protection.VerifyFileHash(path, "ca7816bf8f01cfea414140de5dae2223b00361a396177a9cb410ff61f20015ad"));
+    EXPECT_FALSE(protection.VerifyFileHash(path, "ba7816bf"));
+    EXPECT_FALSE(protection.VerifyFileHash("/nonexistent/file.bin",
+                                           "ba7816bf8f01cfea414140de5dae2223b00361a396177a9cb410ff61f20015ad"));
+    std::remove(path.c_str());
+}
+
 TEST(UtilityFunctionsTest, EventTypeStringConversion) {
     EXPECT_EQ(EventTypeToString(EventType::FILE_ACCESS), "FILE_ACCESS");
     EXPECT_EQ(EventTypeToString(EventType::PROCESS_CREATION), "PROCESS_CREATION");